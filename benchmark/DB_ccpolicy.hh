@@ -0,0 +1,217 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+#include "compiler.hh"
+#include "Sto.hh"
+
+namespace bench {
+
+// Runtime concurrency control policy of one table (DBParams::RuntimeCC)
+//
+// Rows of a runtime table carry TLockVersion<true> versions, and writers
+// always lock them when they access them. The policy decides what readers
+// do: under OCC they read optimistically and validate at commit, under 2PL
+// they take a read lock, and under adaptive they follow the row's own hint,
+// which TLockVersion<true> flips at random as the row is unlocked.
+//
+// Switching modes is safe without draining transactions. The modes share one
+// version format; a transaction pins each item's mode the first time it
+// touches the item (TransItem::cc_mode), so a transaction that straddles a
+// switch keeps the modes it started with; and optimistic and locked readers
+// of one row coexist, as they already do under adaptive locking. TicToc
+// keeps read and write timestamps in every row, so a TicToc table cannot be
+// switched this way and is not one of the modes.
+//
+// The policy counts the table's row accesses and how many of them were
+// contended: the row was locked by another transaction when it was selected,
+// or the select or the commit-time validation failed. Each thread adds its
+// counts to the table's window every flush_period accesses; the thread that
+// fills a window compares the contended fraction to the thresholds and moves
+// one step toward 2PL if it is above hi, or toward OCC if it is below lo.
+// Column-granularity selects are not counted and follow the row hints.
+class cc_policy {
+public:
+    enum class mode_id : int { OCC = 0, Adaptive, TwoPL };
+
+    static const char *mode_name(mode_id m) {
+        static const char *const names[] = {"occ", "adaptive", "2pl"};
+        return names[static_cast<int>(m)];
+    }
+
+    struct config {
+        uint64_t window;  // accesses per decision
+        double lo;        // contended fraction below which to step toward OCC
+        double hi;        // and above which to step toward 2PL
+        mode_id initial;
+    };
+
+    // Configuration of tables constructed from now on
+    static config& defaults() {
+        static config c = {1 << 16, 0.002, 0.02, mode_id::OCC};
+        return c;
+    }
+
+    // stand-in member type for indexes without a runtime policy
+    struct disabled {
+        template <typename VersionType>
+        void before_access(TransProxy&, const VersionType&, bool) {}
+        void conflict() {}
+        void reset_stats() {}
+        void print_stats(std::ostream&, const char*) const {}
+    };
+
+    cc_policy()
+        : cfg_(defaults()), mode_(static_cast<int>(cfg_.initial)),
+          window_accesses_(0), window_contended_(0) {
+        always_assert(cfg_.window > 0 && cfg_.lo <= cfg_.hi, "bad cc_policy config");
+        reset_stats();
+    }
+    cc_policy(const cc_policy&) = delete;
+    cc_policy& operator=(const cc_policy&) = delete;
+
+    mode_id mode() const {
+        return static_cast<mode_id>(mode_.load(std::memory_order_relaxed));
+    }
+    // Pin the table to @m until the next decision
+    void set_mode(mode_id m) {
+        mode_.store(static_cast<int>(m), std::memory_order_relaxed);
+    }
+
+    // Called before @item is first selected for read (or for update, if
+    // @update) by the current transaction. Items the transaction already
+    // accessed keep their mode and are not counted again.
+    void before_access(TransProxy& item, const TLockVersion<true>& vers, bool update) {
+        if (item.has_read() || item.has_write())
+            return;
+        item.cc_mode(read_mode());
+        auto v = vers.value();
+        bool contended = (v & TransactionTid::lock_bit)
+            || (update && (v & TransactionTid::threadid_mask));
+        auto& lc = local();
+        ++lc.naccesses;
+        lc.ncontended += contended;
+        if (lc.naccesses == flush_period)
+            flush(lc);
+    }
+
+    // Called when a select or a validation of one of the table's rows fails
+    void conflict() {
+        ++local().ncontended;
+    }
+
+    // Forget counts and switches so far; switch times are reported relative
+    // to this call
+    void reset_stats() {
+        std::lock_guard<std::mutex> lk(decide_lock_);
+        start_ = clock::now();
+        total_accesses_ = total_contended_ = 0;
+        switches_.clear();
+    }
+    void print_stats(std::ostream& w, const char *table_name) const {
+        std::lock_guard<std::mutex> lk(decide_lock_);
+        char buf[256];
+        snprintf(buf, sizeof(buf), "%s: cc %s, %llu accesses, %.3f%% contended, %zu switches\n",
+                 table_name, mode_name(mode()), (unsigned long long) total_accesses_,
+                 total_accesses_ ? 100.0 * total_contended_ / total_accesses_ : 0.0,
+                 switches_.size());
+        w << buf;
+        for (auto& s : switches_) {
+            snprintf(buf, sizeof(buf), "  %.3fs: %s -> %s (%.3f%% contended)\n",
+                     s.seconds, mode_name(s.from), mode_name(s.to), 100.0 * s.contended);
+            w << buf;
+        }
+    }
+
+private:
+    typedef std::chrono::steady_clock clock;
+    static constexpr uint64_t flush_period = 256;
+
+    // allocated by each thread on first use, and padded to keep them apart
+    struct local_counters {
+        uint64_t naccesses = 0;
+        uint64_t ncontended = 0;
+        char pad[CACHE_LINE_SIZE - 2 * sizeof(uint64_t)];
+    };
+
+    struct switch_record {
+        double seconds;
+        mode_id from;
+        mode_id to;
+        double contended;
+    };
+
+    config cfg_;
+    std::atomic<int> mode_;
+    std::atomic<uint64_t> window_accesses_;
+    std::atomic<uint64_t> window_contended_;
+    std::unique_ptr<local_counters> locals_[MAX_THREADS];
+
+    mutable std::mutex decide_lock_;
+    clock::time_point start_;
+    uint64_t total_accesses_;
+    uint64_t total_contended_;
+    std::vector<switch_record> switches_;
+
+    local_counters& local() {
+        auto& lc = locals_[TThread::id()];
+        if (!lc)
+            lc.reset(new local_counters());
+        return *lc;
+    }
+
+    CCMode read_mode() const {
+        switch (mode()) {
+        case mode_id::OCC:
+            return CCMode::opt;
+        case mode_id::TwoPL:
+            return CCMode::lock;
+        default:
+            return CCMode::none;
+        }
+    }
+
+    void flush(local_counters& lc) {
+        window_contended_.fetch_add(lc.ncontended, std::memory_order_relaxed);
+        uint64_t n = window_accesses_.fetch_add(lc.naccesses, std::memory_order_relaxed) + lc.naccesses;
+        lc.naccesses = lc.ncontended = 0;
+        if (n >= cfg_.window)
+            decide();
+    }
+
+    void decide() {
+        std::unique_lock<std::mutex> lk(decide_lock_, std::try_to_lock);
+        if (!lk.owns_lock())
+            return;
+        uint64_t n = window_accesses_.exchange(0, std::memory_order_relaxed);
+        uint64_t c = window_contended_.exchange(0, std::memory_order_relaxed);
+        if (n < cfg_.window) {
+            // another thread decided on this window
+            window_accesses_.fetch_add(n, std::memory_order_relaxed);
+            window_contended_.fetch_add(c, std::memory_order_relaxed);
+            return;
+        }
+        total_accesses_ += n;
+        total_contended_ += c;
+
+        double f = double(c) / n;
+        int from = mode_.load(std::memory_order_relaxed), to = from;
+        if (f > cfg_.hi && from < static_cast<int>(mode_id::TwoPL))
+            ++to;
+        else if (f < cfg_.lo && from > static_cast<int>(mode_id::OCC))
+            --to;
+        if (to != from) {
+            mode_.store(to, std::memory_order_relaxed);
+            std::chrono::duration<double> t = clock::now() - start_;
+            switches_.push_back({t.count(), static_cast<mode_id>(from), static_cast<mode_id>(to), f});
+        }
+    }
+};
+
+}; // namespace bench
@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TCheckpoint.hh"
+#include "TLog.hh"
+#include "Transaction.hh"
+
+namespace bench {
+
+// Checkpoints and recovery for the logged tables of a database. Tables are
+// added under their (nonzero) log ids. A checkpoint holds every part of
+// every table at one snapshot: the read tid for MVCC tables, the hybrid
+// snapshot tid for OCC tables, whose overwritten rows are kept while the
+// checkpoint runs. Recovery loads the latest checkpoint in parallel, then
+// replays the log records committed after its snapshot, each table's in TID
+// order and the tables in parallel.
+class db_checkpointer {
+public:
+    db_checkpointer(bool mvcc, std::function<void()> thread_init)
+        : mvcc_(mvcc), thread_init_(std::move(thread_init)) {}
+
+    template <typename Index>
+    void add(Index& t) {
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        uint32_t id = t.log_id();
+        always_assert(id != 0, "checkpointed tables need log ids");
+        if (tables_.size() < id)
+            tables_.resize(id);
+        table& tb = tables_[id - 1];
+        tb.nparts = t.checkpoint_parts();
+        tb.scan = [&t] (TCheckpoint::writer& w, size_t part, size_t nparts) {
+            t.snapshot_scan([&w] (const key_type& k, const value_type& v) {
+                w.add(&k, sizeof(k), &v, sizeof(v));
+            }, part, nparts);
+        };
+        tb.load = [&t] (const char* key, uint32_t key_length,
+                        const char* value, uint32_t value_length) {
+            always_assert(key_length == sizeof(key_type) && value_length == sizeof(value_type),
+                          "checkpoint row does not match its table");
+            t.nontrans_put(unaligned<key_type>(key), unaligned<value_type>(value));
+        };
+        tb.replay = [&t] (const TLog::record& r) {
+            replay(t, r);
+        };
+    }
+
+    // Take a checkpoint into a new subdirectory of @dir. The calling thread
+    // holds the snapshot as TThread @first_thread_id; @nthreads checkpoint
+    // threads use the ids after it.
+    bool checkpoint(const std::string& dir, unsigned nthreads, int first_thread_id,
+                    TCheckpoint::stats& st) {
+        TThread::set_id(first_thread_id);
+        std::vector<TCheckpoint::task> tasks;
+        for (uint32_t i = 0; i != tables_.size(); ++i) {
+            auto& tb = tables_[i];
+            for (size_t p = 0; tb.scan && p != tb.nparts; ++p)
+                tasks.push_back({i + 1, uint32_t(p), [&tb, p] (TCheckpoint::writer& w) {
+                    tb.scan(w, p, tb.nparts);
+                }});
+        }
+        // parts of the largest tables first
+        std::stable_sort(tasks.begin(), tasks.end(), [this] (const TCheckpoint::task& a,
+                                                             const TCheckpoint::task& b) {
+            return tables_[a.table - 1].nparts > tables_[b.table - 1].nparts;
+        });
+
+        TransactionGuard guard;
+        Sto::declare_read_only();
+        auto tid = mvcc_ ? Sto::read_tid<true>() : Sto::snapshot_tid();
+        return TCheckpoint::write(dir, tid, tasks, nthreads, first_thread_id + 1,
+                                  thread_init_, st);
+    }
+
+    // Load the latest checkpoint in @ckpt_dir, then replay the logs in
+    // @log_dir, if any, from its snapshot on. Call before any transaction
+    // runs; statistics go to @w.
+    bool recover(const std::string& ckpt_dir, const std::string& log_dir,
+                 unsigned nthreads, std::ostream& w) {
+        TCheckpoint::stats st;
+        bool ok = TCheckpoint::read(ckpt_dir, nthreads, thread_init_,
+            [this] (uint32_t table, const char* key, uint32_t key_length,
+                    const char* value, uint32_t value_length) {
+                always_assert(table != 0 && table <= tables_.size() && tables_[table - 1].load,
+                              "checkpoint of an unknown table");
+                tables_[table - 1].load(key, key_length, value, value_length);
+            }, st);
+        if (!ok) {
+            w << "No usable checkpoint in " << ckpt_dir << std::endl;
+            return false;
+        }
+        TCheckpoint::print_stats(w, "checkpoint loaded", st);
+        if (log_dir.empty())
+            return true;
+
+        auto start = read_tsc();
+        std::vector<pending_log> logs(tables_.size());
+        std::atomic<uint64_t> nrecords(0);
+        TLog::epoch_type persistent = TLog::recover(log_dir, [&] (const TLog::record& r) {
+            if (r.tid() <= st.tid)
+                return;
+            always_assert(r.table() != 0 && r.table() <= tables_.size() && tables_[r.table() - 1].replay,
+                          "log record of an unknown table");
+            pending_log& l = logs[r.table() - 1];
+            std::lock_guard<std::mutex> guard(l.mutex);
+            l.records.push_back({*r.h, std::string(r.key, r.key_length()),
+                                 std::string(r.value ? r.value : "", r.value_length())});
+            ++nrecords;
+        });
+
+        std::atomic<size_t> next(0);
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i != nthreads; ++i)
+            threads.emplace_back([&, i] () {
+                TThread::set_id(i);
+                thread_init_();
+                for (size_t t; (t = next++) < logs.size(); ) {
+                    auto& recs = logs[t].records;
+                    std::stable_sort(recs.begin(), recs.end(), [] (const logged& a, const logged& b) {
+                        return a.h.tid < b.h.tid;
+                    });
+                    for (auto& lr : recs) {
+                        TLog::record r;
+                        r.h = &lr.h;
+                        r.key = lr.key.data();
+                        r.value = lr.h.value_length == TLog::delete_length ? nullptr : lr.value.data();
+                        tables_[t].replay(r);
+                    }
+                    recs.clear();
+                }
+            });
+        for (auto& t : threads)
+            t.join();
+
+        char buf[256];
+        snprintf(buf, sizeof(buf), "log replayed: %llu records through epoch %llu, %.1f ms\n",
+                 (unsigned long long) nrecords.load(), (unsigned long long) persistent,
+                 (read_tsc() - start) / PROC_TSC_FREQ / 1e6);
+        w << buf;
+        return true;
+    }
+
+private:
+    struct table {
+        size_t nparts = 0;
+        std::function<void(TCheckpoint::writer&, size_t, size_t)> scan;
+        std::function<void(const char*, uint32_t, const char*, uint32_t)> load;
+        std::function<void(const TLog::record&)> replay;
+    };
+    struct logged {
+        TLog::record_header h;
+        std::string key;
+        std::string value;
+    };
+    struct pending_log {
+        std::mutex mutex;
+        std::vector<logged> records;
+    };
+
+    bool mvcc_;
+    std::function<void()> thread_init_;
+    std::vector<table> tables_;
+
+    // Keys, rows and commutators are logged and checkpointed as raw bytes
+    template <typename T>
+    static T unaligned(const char* p) {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type buf;
+        memcpy(&buf, p, sizeof(T));
+        return *reinterpret_cast<T*>(&buf);
+    }
+
+    template <typename Index>
+    static void replay(Index& t, const TLog::record& r) {
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        typedef typename Index::comm_type comm_type;
+        always_assert(r.key_length() == sizeof(key_type), "log record does not match its table");
+        key_type key = unaligned<key_type>(r.key);
+        if (r.is_delete()) {
+            t.nontrans_remove(key);
+        } else if (r.cell() == TLog::delta_cell) {
+            always_assert(r.value_length() == sizeof(comm_type), "log record does not match its table");
+            value_type *row = t.nontrans_get(key);
+            always_assert(row, "commutative update of a missing row");
+            unaligned<comm_type>(r.value).operate(*row);
+        } else {
+            always_assert(r.value_length() == sizeof(value_type), "log record does not match its table");
+            if (r.cell() == 0)
+                t.nontrans_put(key, unaligned<value_type>(r.value));
+            else
+                t.nontrans_put_cell(key, r.cell() - 1, unaligned<value_type>(r.value));
+        }
+    }
+};
+
+}; // namespace bench
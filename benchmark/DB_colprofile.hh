@@ -0,0 +1,228 @@
+#pragma once
+
+#include <atomic>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
+
+#include "compiler.hh"
+#include "TThread.hh"
+
+#ifndef BENCH_PROFILE_COLUMNS
+#define BENCH_PROFILE_COLUMNS 0
+#endif
+
+namespace bench {
+
+// Per-table column access profiler (enabled with BENCH_PROFILE_COLUMNS=1).
+//
+// Records, for every row type stored in a bench index, how often each column
+// is read and written, how often two columns are accessed together in the
+// same row access, and how many commit-time validation failures hit the cell
+// a column lives in. The profile is written out as plain text and consumed by
+// the codegen (sto-core/codegen, "-p" option) to produce column groups.
+//
+// Profile format, one block per row type:
+//
+//   table <struct_name> <ncols> <naccesses>
+//   col <col_id> <reads> <writes> <conflicts>
+//   pair <col_a> <col_b> <coaccesses>     (col_a < col_b, nonzero only)
+//   end
+//
+// Conflicts are attributed at cell granularity: a failed check on a cell is
+// charged to every column mapped to that cell under the current layout. Row
+// types declare their column count as a trailing NamedColumn::COLCOUNT; for
+// row types without one, the columns any thread has accessed so far stand in.
+class column_profile_base {
+public:
+    static constexpr int max_columns = 32;
+
+    struct thread_counters {
+        int ncols;
+        uint64_t naccesses;
+        uint64_t reads[max_columns];
+        uint64_t writes[max_columns];
+        uint64_t conflicts[max_columns];
+        uint64_t coaccesses[max_columns][max_columns];
+    };
+
+    column_profile_base(std::string name, int ncols)
+        : name_(std::move(name)), ncols_(ncols) {
+        always_assert(ncols <= max_columns, "too many columns for the column profiler");
+        std::lock_guard<std::mutex> lk(registry_lock());
+        registry().push_back(this);
+    }
+    virtual ~column_profile_base() = default;
+
+    const std::string& name() const {
+        return name_;
+    }
+
+    // Merge all per-thread counters and write every registered table profile
+    // to @filename. Must be called after all worker threads have finished.
+    static bool dump(const char *filename) {
+        std::ofstream out(filename);
+        if (!out.is_open())
+            return false;
+        std::lock_guard<std::mutex> lk(registry_lock());
+        for (auto p : registry())
+            p->write(out);
+        return true;
+    }
+
+protected:
+    thread_counters& local() {
+        auto& tc = per_thread_[TThread::id()];
+        if (!tc) {
+            tc.reset(new thread_counters());
+            tc->ncols = ncols_.load(std::memory_order_relaxed);
+        }
+        return *tc;
+    }
+
+    // Number of columns of the row type, or of the widest row access seen
+    int ncols() const {
+        return ncols_.load(std::memory_order_relaxed);
+    }
+
+    template <typename Accesses>
+    void record_accesses(const Accesses& accesses) {
+        auto& tc = local();
+        ++tc.naccesses;
+        for (auto it = accesses.begin(); it != accesses.end(); ++it) {
+            int a = it->col_id;
+            always_assert(a < max_columns, "too many columns for the column profiler");
+            if (a >= tc.ncols) {
+                tc.ncols = a + 1;
+                int n = ncols_.load(std::memory_order_relaxed);
+                while (n < tc.ncols && !ncols_.compare_exchange_weak(n, tc.ncols, std::memory_order_relaxed))
+                    ;
+            }
+            auto acc = static_cast<uint8_t>(it->access);
+            if (acc & 1u)
+                ++tc.reads[a];
+            if (acc & 2u)
+                ++tc.writes[a];
+            for (auto jt = it + 1; jt != accesses.end(); ++jt) {
+                int b = jt->col_id;
+                if (a < b)
+                    ++tc.coaccesses[a][b];
+                else if (b < a)
+                    ++tc.coaccesses[b][a];
+            }
+        }
+    }
+
+private:
+    void write(std::ostream& out) const {
+        thread_counters sum {};
+        sum.ncols = ncols();
+        for (auto& tc : per_thread_) {
+            if (!tc)
+                continue;
+            if (tc->ncols > sum.ncols)
+                sum.ncols = tc->ncols;
+            sum.naccesses += tc->naccesses;
+            for (int i = 0; i < max_columns; ++i) {
+                sum.reads[i] += tc->reads[i];
+                sum.writes[i] += tc->writes[i];
+                sum.conflicts[i] += tc->conflicts[i];
+                for (int j = i + 1; j < max_columns; ++j)
+                    sum.coaccesses[i][j] += tc->coaccesses[i][j];
+            }
+        }
+        if (sum.naccesses == 0)
+            return;
+
+        out << "table " << name_ << " " << sum.ncols << " " << sum.naccesses << std::endl;
+        for (int i = 0; i < sum.ncols; ++i)
+            out << "col " << i << " " << sum.reads[i] << " " << sum.writes[i] << " " << sum.conflicts[i] << std::endl;
+        for (int i = 0; i < sum.ncols; ++i) {
+            for (int j = i + 1; j < sum.ncols; ++j) {
+                if (sum.coaccesses[i][j] != 0)
+                    out << "pair " << i << " " << j << " " << sum.coaccesses[i][j] << std::endl;
+            }
+        }
+        out << "end" << std::endl;
+    }
+
+    static std::vector<column_profile_base*>& registry() {
+        static std::vector<column_profile_base*> r;
+        return r;
+    }
+    static std::mutex& registry_lock() {
+        static std::mutex m;
+        return m;
+    }
+
+    std::string name_;
+    std::atomic<int> ncols_;
+    std::unique_ptr<thread_counters> per_thread_[MAX_THREADS];
+};
+
+// RowType::NamedColumn::COLCOUNT, or 0 if the row type does not declare it
+template <typename RowType, typename = void>
+struct declared_column_count : std::integral_constant<int, 0> {};
+
+template <typename RowType>
+struct declared_column_count<RowType, decltype((void) RowType::NamedColumn::COLCOUNT)>
+    : std::integral_constant<int, static_cast<int>(RowType::NamedColumn::COLCOUNT)> {};
+
+template <typename RowType>
+class column_profile : public column_profile_base {
+public:
+    static column_profile& get() {
+        static column_profile instance;
+        return instance;
+    }
+
+    // Called on every column-granularity row access (select_row/range_scan).
+    template <typename Accesses>
+    static void access(const Accesses& accesses) {
+        if (BENCH_PROFILE_COLUMNS)
+            get().record_accesses(accesses);
+    }
+
+    // Called when validation of cell @cell fails at commit time.
+    // Container is the IndexValueContainer providing the column-to-cell map.
+    template <typename Container>
+    static void conflict(int cell) {
+        if (BENCH_PROFILE_COLUMNS) {
+            auto& self = get();
+            auto& tc = self.local();
+            int ncols = self.ncols();
+            if (tc.ncols < ncols)
+                tc.ncols = ncols;
+            for (int i = 0; i < ncols; ++i) {
+                if (Container::map(i) == cell)
+                    ++tc.conflicts[i];
+            }
+        }
+    }
+
+private:
+    column_profile()
+        : column_profile_base(struct_name(), declared_column_count<RowType>::value) {}
+
+    // Row type name without namespace qualifiers, which is what the codegen
+    // uses as @name (e.g. "tpcc::district_value" -> "district_value").
+    static std::string struct_name() {
+        int status = 0;
+        const char *mangled = typeid(RowType).name();
+        char *demangled = abi::__cxa_demangle(mangled, nullptr, nullptr, &status);
+        std::string name = (status == 0) ? std::string(demangled) : std::string(mangled);
+        free(demangled);
+        auto pos = name.rfind("::");
+        if (pos != std::string::npos)
+            name = name.substr(pos + 2);
+        return name;
+    }
+};
+
+}; // namespace bench
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "compiler.hh"
+#include "Transaction.hh"
+
+namespace bench {
+
+// The read and write set a transaction declares before it runs. Keys are
+// opaque 64-bit names for records (or groups of records) that the workload
+// chooses; two transactions are ordered if one writes a key the other reads
+// or writes.
+class det_locks {
+public:
+    static constexpr unsigned max_locks = 32;
+
+    struct lock {
+        uint64_t key;
+        bool write;
+    };
+
+    // Compose a key from a small table number and up to 56 bits of fields
+    static uint64_t key(unsigned table, uint64_t fields) {
+        return (uint64_t(table) << 56) | (fields & ((uint64_t(1) << 56) - 1));
+    }
+
+    void read(uint64_t k) {
+        add(k, false);
+    }
+    void write(uint64_t k) {
+        add(k, true);
+    }
+
+    unsigned size() const {
+        return n_;
+    }
+    const lock& operator[](unsigned i) const {
+        return locks_[i];
+    }
+
+    void clear() {
+        n_ = 0;
+    }
+    // Sort by key and merge duplicates; a key both read and written is
+    // written
+    void normalize() {
+        std::sort(locks_, locks_ + n_, [] (const lock& a, const lock& b) {
+            return a.key < b.key;
+        });
+        unsigned j = 0;
+        for (unsigned i = 0; i != n_; ++i) {
+            if (j && locks_[j - 1].key == locks_[i].key)
+                locks_[j - 1].write |= locks_[i].write;
+            else
+                locks_[j++] = locks_[i];
+        }
+        n_ = j;
+    }
+
+private:
+    unsigned n_ = 0;
+    lock locks_[max_locks];
+
+    void add(uint64_t k, bool write) {
+        always_assert(n_ < max_locks, "too many declared locks");
+        locks_[n_++] = {k, write};
+    }
+};
+
+// Deterministic batched execution for high-contention workloads, after
+// Calvin and BOHM. The worker threads together fill a batch of
+// transactions, each with its declared locks; plan, in parallel by key, the
+// order in which each key's holders run; then execute the batch, each
+// transaction once the earlier holders of its keys have finished. Readers of
+// a key between two writers run concurrently. Transactions whose declared
+// sets cover their accesses never conflict and so commit on the first try.
+//
+// The execute function still runs an ordinary STO transaction (a RETRY
+// body), so an access outside the declared set, or a conflict on an index
+// structure, is caught by validation and retried as usual. Every
+// transaction waits only on transactions earlier in the batch, so the
+// execution cannot deadlock.
+template <typename Txn>
+class det_executor {
+public:
+    det_executor(int nworkers, unsigned batch_per_worker)
+        : nworkers_(nworkers), batch_per_worker_(batch_per_worker),
+          nslots_(size_t(nworkers) * batch_per_worker),
+          slots_(new slot[nslots_]), planners_(nworkers),
+          stop_(false), cursor_(0), barrier_count_(0), barrier_gen_(0) {
+        always_assert(nworkers > 0 && batch_per_worker > 0, "empty deterministic batch");
+    }
+    det_executor(const det_executor&) = delete;
+    det_executor& operator=(const det_executor&) = delete;
+
+    // Run by each of the nworkers threads, as @worker, until @stop()
+    // returns true between batches (only worker 0 calls it).
+    // @generate(txn, locks) fills in the next transaction of this worker
+    // and declares its locks; @execute(txn) runs it. Returns the number of
+    // transactions this worker executed.
+    template <typename G, typename E, typename S>
+    uint64_t run(int worker, G generate, E execute, S stop) {
+        uint64_t nexecuted = 0;
+        while (true) {
+            if (worker == 0)
+                stop_.store(stop(), std::memory_order_relaxed);
+            barrier();
+            if (stop_.load(std::memory_order_relaxed))
+                break;
+
+            slot* first = &slots_[size_t(worker) * batch_per_worker_];
+            for (slot* s = first; s != first + batch_per_worker_; ++s) {
+                s->locks.clear();
+                generate(s->txn, s->locks);
+                s->locks.normalize();
+            }
+            if (worker == 0)
+                cursor_.store(0, std::memory_order_relaxed);
+            barrier();
+
+            plan(worker);
+            barrier();
+
+            size_t i;
+            while ((i = cursor_.fetch_add(1, std::memory_order_relaxed)) < nslots_) {
+                slot& s = slots_[i];
+                unsigned n = s.locks.size();
+                for (unsigned j = 0; j != n; ++j)
+                    if (s.wait[j])
+                        spin_until([&] {
+                            return s.wait[j]->load(std::memory_order_acquire) == 0;
+                        });
+                execute(s.txn);
+                for (unsigned j = 0; j != n; ++j)
+                    s.own[j]->fetch_sub(1, std::memory_order_release);
+                ++nexecuted;
+            }
+        }
+        return nexecuted;
+    }
+
+private:
+    // A group is a writer or a run of consecutive readers of one key. Its
+    // counter, the number of members yet to finish, lives in the group's
+    // first member's slot.
+    struct slot {
+        Txn txn;
+        det_locks locks;
+        std::atomic<unsigned>* wait[det_locks::max_locks];
+        std::atomic<unsigned>* own[det_locks::max_locks];
+        std::atomic<unsigned> group[det_locks::max_locks];
+    };
+
+    struct key_state {
+        std::atomic<unsigned>* cur;
+        std::atomic<unsigned>* prev;
+        bool cur_read;
+    };
+
+    struct planner {
+        std::unordered_map<uint64_t, key_state> keys;
+    };
+
+    int nworkers_;
+    unsigned batch_per_worker_;
+    size_t nslots_;
+    std::unique_ptr<slot[]> slots_;
+    std::vector<planner> planners_;
+    std::atomic<bool> stop_;
+    std::atomic<size_t> cursor_;
+    std::atomic<int> barrier_count_;
+    std::atomic<unsigned> barrier_gen_;
+
+    int partition(uint64_t key) const {
+        return int(((key * 0x9E3779B97F4A7C15ULL) >> 32) % unsigned(nworkers_));
+    }
+
+    // Order the batch's holders of the keys in @worker's partition
+    void plan(int worker) {
+        auto& keys = planners_[worker].keys;
+        keys.clear();
+        for (size_t i = 0; i != nslots_; ++i) {
+            slot& s = slots_[i];
+            for (unsigned j = 0; j != s.locks.size(); ++j) {
+                auto& l = s.locks[j];
+                if (partition(l.key) != worker)
+                    continue;
+                auto it = keys.find(l.key);
+                if (it == keys.end())
+                    it = keys.emplace(l.key, key_state{nullptr, nullptr, false}).first;
+                key_state& ks = it->second;
+                if (!l.write && ks.cur && ks.cur_read) {
+                    // join the current readers
+                    ks.cur->store(ks.cur->load(std::memory_order_relaxed) + 1,
+                                  std::memory_order_relaxed);
+                    s.wait[j] = ks.prev;
+                    s.own[j] = ks.cur;
+                } else {
+                    s.group[j].store(1, std::memory_order_relaxed);
+                    s.wait[j] = ks.cur;
+                    s.own[j] = &s.group[j];
+                    ks.prev = ks.cur;
+                    ks.cur = &s.group[j];
+                    ks.cur_read = !l.write;
+                }
+            }
+        }
+    }
+
+    void barrier() {
+        unsigned gen = barrier_gen_.load(std::memory_order_acquire);
+        if (barrier_count_.fetch_add(1, std::memory_order_acq_rel) + 1 == nworkers_) {
+            barrier_count_.store(0, std::memory_order_relaxed);
+            barrier_gen_.store(gen + 1, std::memory_order_release);
+        } else {
+            spin_until([&] {
+                return barrier_gen_.load(std::memory_order_acquire) != gen;
+            });
+        }
+    }
+
+    // Waits are usually short; yield now and then in case the machine has
+    // more workers than cores
+    template <typename F>
+    static void spin_until(F done) {
+        for (unsigned n = 1; !done(); ++n) {
+            if (n % 1024 == 0)
+                std::this_thread::yield();
+            else
+                relax_fence();
+        }
+    }
+};
+
+} // namespace bench
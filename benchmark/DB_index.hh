@@ -13,14 +13,21 @@
 #include "masstree_scan.hh"
 #include "string.hh"
 
+#include <atomic>
 #include <vector>
 #include "DB_structs.hh"
+#include "DB_colprofile.hh"
+#include "DB_ccpolicy.hh"
 #include "VersionSelector.hh"
 #include "MVCC.hh"
 
 #include "TBox.hh"
 #include "TMvBox.hh"
 
+#ifndef BENCH_MULTIGET
+#define BENCH_MULTIGET 1
+#endif
+
 namespace bench {
 
 class version_adapter {
@@ -239,6 +246,169 @@ public:
 
 };
 
+// Hybrid OCC/MVCC row history (DBParams::Hybrid)
+//
+// Rows stay single-version OCC rows. Only while declared read-only
+// transactions are active do writers preserve the value they are about to
+// overwrite, tagged with the tid it was committed at; otherwise nothing is
+// kept and leftover history is dropped on the next write. Snapshot readers
+// use find() when the current row is newer than their snapshot.
+template <typename V>
+class hybrid_history {
+public:
+    typedef TransactionTid::type tid_type;
+
+    struct node {
+        tid_type tid;
+        V row;
+        node *next;
+
+        node(tid_type t, const V& r, node *n) : tid(t), row(r), next(n) {}
+    };
+
+    // stand-in member type for non-hybrid indexes
+    struct disabled {
+        void save(const V&, tid_type, const Transaction&) {}
+        const V *find(tid_type) const {
+            return nullptr;
+        }
+    };
+
+    hybrid_history() : head_(nullptr) {}
+
+    // Called from install() with the row locked, before the row is modified.
+    void save(const V& row, tid_type version, const Transaction& txn) {
+        // our commit tid must be assigned before we look for snapshot readers:
+        // a reader registering after this point gets a snapshot covering it
+        txn.commit_tid();
+        fence();
+        node *h = head_.load(std::memory_order_relaxed);
+        if (!Sto::snapshot_readers_active()) {
+            if (h != nullptr) {
+                head_.store(nullptr, std::memory_order_release);
+                retire(h);
+            }
+            return;
+        }
+        node *n = new node(version & TransactionTid::max_value, row, h);
+        head_.store(n, std::memory_order_release);
+
+        // versions older than the newest one visible to the oldest snapshot
+        // are unreachable
+        tid_type inf = txn.snapshot_tid_inf();
+        for (node *p = n; p != nullptr; p = p->next) {
+            if (p->tid <= inf) {
+                node *dead = p->next;
+                p->next = nullptr;
+                retire(dead);
+                break;
+            }
+        }
+    }
+
+    const V *find(tid_type rtid) const {
+        for (node *n = head_.load(std::memory_order_acquire); n != nullptr; n = n->next) {
+            if (n->tid <= rtid)
+                return &n->row;
+        }
+        return nullptr;
+    }
+
+private:
+    static void retire(node *n) {
+        while (n != nullptr) {
+            node *next = n->next;
+            Transaction::rcu_delete(n);
+            n = next;
+        }
+    }
+
+    std::atomic<node*> head_;
+};
+
+// Number of keys select_rows() hashes and prefetches as one group
+constexpr size_t multiget_group_size = 16;
+
+// Batched point lookups (select_rows) of n keys. Keys are processed in
+// groups: @prefetch_step(i, step) runs step @step of the lookup of key i
+// and prefetches what the next step reads, for every key of the group and
+// for steps 0, 1, ... until it returns false for all of them. Only then
+// does @select_one(i) finish each lookup and register its reads, so the
+// cache misses of a group overlap. out[i] is what select_row(keys[i],
+// access) would return; returns false at the first abort.
+template <typename Ret, typename PrefetchStep, typename SelectOne>
+bool select_rows_grouped(size_t n, Ret *out, PrefetchStep prefetch_step, SelectOne select_one) {
+    for (size_t base = 0; base < n; base += multiget_group_size) {
+        size_t m = std::min(n - base, multiget_group_size);
+        for (int step = 0, more = 1; more; ++step) {
+            more = 0;
+            for (size_t i = base; i < base + m; ++i)
+                more |= prefetch_step(i, step);
+        }
+        for (size_t i = base; i < base + m; ++i) {
+            out[i] = select_one(i);
+            if (!std::get<0>(out[i]))
+                return false;
+        }
+    }
+    return true;
+}
+
+// select_rows_grouped steps that prefetch what @idx.lookup_address() names
+template <typename Index>
+bool prefetch_lookup_step(const Index& idx, const typename Index::key_type& k, int step) {
+    const void *p = idx.lookup_address(k, step);
+    if (p != nullptr)
+        prefetch(p);
+    return p != nullptr;
+}
+
+// Redo logging (TLog) for an index. Tables with a nonzero log id append a
+// record for every row they install; keys and rows are logged as raw bytes.
+class index_log {
+public:
+    void set_log_id(uint32_t id) {
+        log_id_ = id;
+    }
+    uint32_t log_id() const {
+        return log_id_;
+    }
+
+protected:
+    // buckets per checkpoint part of a hash index
+    static constexpr size_t checkpoint_part_buckets = 1 << 20;
+
+    bool logging() const {
+        return log_id_ && TLog::enabled();
+    }
+    // @cell is TLog's: 0 for the whole row, c + 1 for cell c only
+    template <typename K, typename V>
+    void log_row(Transaction& txn, const K& key, const V& row, uint32_t cell = 0) {
+        TLog::append(txn.commit_tid(), log_id_, cell, &key, sizeof(K), &row, sizeof(V));
+    }
+    template <typename K, typename C>
+    void log_delta(Transaction& txn, const K& key, const C& comm) {
+        TLog::append(txn.commit_tid(), log_id_, TLog::delta_cell, &key, sizeof(K), &comm, sizeof(C));
+    }
+    template <typename K>
+    void log_delete(Transaction& txn, const K& key) {
+        TLog::append(txn.commit_tid(), log_id_, 0, &key, sizeof(K), nullptr, 0);
+    }
+    // MVCC: log an installed version
+    template <typename E, typename H>
+    void log_history(Transaction& txn, const E* e, H* h) {
+        if (h->status_is(MvStatus::DELETED))
+            log_delete(txn, e->key);
+        else if (h->status_is(MvStatus::DELTA))
+            log_delta(txn, e->key, h->commutator());
+        else
+            log_row(txn, e->key, *h->vp());
+    }
+
+private:
+    uint32_t log_id_ = 0;
+};
+
 template <typename K, typename V, typename DBParams>
 class index_common {
 public:
@@ -2,7 +2,7 @@
 
 namespace bench {
 template <typename K, typename V, typename DBParams>
-class ordered_index : public TObject {
+class ordered_index : public TObject, public index_log {
 public:
     typedef K key_type;
     typedef V value_type;
@@ -20,18 +20,23 @@ public:
 
     typedef typename value_type::NamedColumn NamedColumn;
     typedef IndexValueContainer<V, version_type> value_container_type;
+    typedef typename std::conditional<DBParams::Hybrid, hybrid_history<V>,
+                                      typename hybrid_history<V>::disabled>::type history_type;
+    typedef typename std::conditional<DBParams::RuntimeCC, cc_policy,
+                                      cc_policy::disabled>::type cc_policy_type;
 
     static constexpr bool value_is_small = is_small<V>::value;
 
     static constexpr bool index_read_my_write = DBParams::RdMyWr;
 
-    struct internal_elem {
+    // history_type is a base so that it takes no space when disabled
+    struct internal_elem : history_type {
         key_type key;
         value_container_type row_container;
         bool deleted;
 
         internal_elem(const key_type& k, const value_type& v, bool valid)
-            : key(k),
+            : history_type(), key(k),
               row_container((valid ? Sto::initialized_tid() : (Sto::initialized_tid() | invalid_bit)),
                             !valid, v),
               deleted(false) {}
@@ -39,6 +44,9 @@ public:
         version_type& version() {
             return row_container.row_version();
         }
+        history_type& history() {
+            return *this;
+        }
 
         bool valid() {
             return !(version().value() & invalid_bit);
@@ -104,6 +112,8 @@ public:
     }
 
     void table_init() {
+        always_assert(!DBParams::Hybrid || value_container_type::num_versions == 1,
+                      "hybrid mode requires row-granularity versions");
         if (ti == nullptr)
             ti = threadinfo::make(threadinfo::TI_MAIN, -1);
         table_.initialize(*ti);
@@ -125,11 +135,24 @@ public:
         return fetch_and_add(&key_gen_, 1);
     }
 
+    // This table's runtime concurrency control policy (DBParams::RuntimeCC)
+    cc_policy_type& runtime_cc() {
+        return cc_policy_;
+    }
+
+    // See unordered_index::lookup_address. Nothing is worth prefetching
+    // ahead: a Masstree descent prefetches each node as it reaches it.
+    const void* lookup_address(const key_type&, int) const {
+        return nullptr;
+    }
+
     sel_return_type
     select_row(const key_type& key, RowAccess acc) {
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
         internal_elem *e = lp.value();
+        if (snapshot_mode())
+            return snapshot_select(found ? e : nullptr);
         if (found) {
             return select_row(reinterpret_cast<uintptr_t>(e), acc);
         } else {
@@ -142,11 +165,49 @@ public:
         return sel_return_type(false, false, 0, nullptr);
     }
 
+    // Batched point lookups (see select_rows_grouped). The only step is the
+    // tree descent, which prefetches the element found, so the element
+    // cache misses overlap with the remaining descents of the group.
+    bool
+    select_rows(const key_type *keys, size_t n, RowAccess access, sel_return_type *out) {
+        internal_elem *elems[multiget_group_size];
+        node_type *nodes[multiget_group_size];
+        nodeversion_value_type versions[multiget_group_size];
+        return select_rows_grouped(n, out,
+            [&] (size_t i, int) {
+                size_t j = i % multiget_group_size;
+                unlocked_cursor_type lp(table_, keys[i]);
+                if (lp.find_unlocked(*ti)) {
+                    elems[j] = lp.value();
+                    prefetch(elems[j]);
+                    prefetch(&elems[j]->version());
+                } else {
+                    elems[j] = nullptr;
+                    nodes[j] = lp.node();
+                    versions[j] = lp.full_version_value();
+                }
+                return false;
+            },
+            [&] (size_t i) -> sel_return_type {
+                size_t j = i % multiget_group_size;
+                if (snapshot_mode())
+                    return snapshot_select(elems[j]);
+                else if (elems[j] != nullptr)
+                    return select_row(reinterpret_cast<uintptr_t>(elems[j]), access);
+                else if (register_internode_version(nodes[j], versions[j]))
+                    return sel_return_type(true, false, 0, nullptr);
+                else
+                    return sel_return_type(false, false, 0, nullptr);
+            });
+    }
+
     sel_return_type
     select_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
         internal_elem *e = lp.value();
+        if (snapshot_mode())
+            return snapshot_select(found ? e : nullptr);
         if (found) {
             return select_row(reinterpret_cast<uintptr_t>(e), accesses);
         } else {
@@ -161,6 +222,11 @@ public:
     sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
         auto e = reinterpret_cast<internal_elem *>(rid);
+        if (snapshot_mode()) {
+            always_assert(access != RowAccess::UpdateValue, "update in a read-only transaction");
+            return snapshot_select(e);
+        }
+
         bool ok = true;
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
@@ -181,6 +247,8 @@ public:
             }
         }
 
+        if (access != RowAccess::None)
+            cc_policy_.before_access(row_item, e->version(), access == RowAccess::UpdateValue);
         switch (access) {
             case RowAccess::UpdateValue:
                 ok = version_adapter::select_for_update(row_item, e->version());
@@ -194,8 +262,10 @@ public:
                 break;
         }
 
-        if (!ok)
+        if (!ok) {
+            cc_policy_.conflict();
             goto abort;
+        }
 
         return sel_return_type(true, true, rid, &(e->row_container.row));
 
@@ -206,8 +276,13 @@ public:
     sel_return_type
     select_row(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
         auto e = reinterpret_cast<internal_elem*>(rid);
+        if (snapshot_mode())
+            return snapshot_select(e);
+
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
+        column_profile<value_type>::access(accesses);
+
         // Translate from column accesses to cell accesses
         // all buffered writes are only stored in the wdata_ of the row item (to avoid redundant copies)
         auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
@@ -245,6 +320,7 @@ public:
     }
 
     void update_row(uintptr_t rid, value_type *new_row) {
+        always_assert(!snapshot_mode(), "update in a read-only transaction");
         auto e = reinterpret_cast<internal_elem*>(rid);
         auto row_item = Sto::item(this, item_key_t::row_item_key(e));
         if (value_is_small) {
@@ -255,6 +331,7 @@ public:
     }
 
     void update_row(uintptr_t rid, const comm_type &comm) {
+        always_assert(!snapshot_mode(), "update in a read-only transaction");
         assert(&comm);
         auto row_item = Sto::item(this, item_key_t::row_item_key(reinterpret_cast<internal_elem *>(rid)));
         row_item.add_commute(comm);
@@ -264,6 +341,7 @@ public:
     // if a row already exists, then use select (FOR UPDATE) instead
     ins_return_type
     insert_row(const key_type& key, value_type *vptr, bool overwrite = false) {
+        always_assert(!snapshot_mode(), "insert in a read-only transaction");
         cursor_type lp(table_, key);
         bool found = lp.find_insert(*ti);
         if (found) {
@@ -361,6 +439,7 @@ public:
 
     del_return_type
     delete_row(const key_type& key) {
+        always_assert(!snapshot_mode(), "delete in a read-only transaction");
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
         if (found) {
@@ -408,15 +487,20 @@ public:
         assert((limit == -1) || (limit > 0));
         auto node_callback = [&] (leaf_type* node,
             typename unlocked_cursor_type::nodeversion_value_type version) {
-            return ((!phantom_protection) || register_internode_version(node, version));
+            return ((!phantom_protection) || snapshot_mode() || register_internode_version(node, version));
         };
 
         auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
 
         auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            if (snapshot_mode())
+                return snapshot_scan_row(key, e, callback, ret, count);
+
             TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
                                                       : Sto::fresh_item(this, item_key_t::row_item_key(e));
 
+            column_profile<value_type>::access(accesses);
+
             bool any_has_write;
             std::array<TransItem*, value_container_type::num_versions> cell_items {};
             std::tie(any_has_write, cell_items) = extract_item_list<value_container_type>(cell_accesses, this, e);
@@ -472,10 +556,13 @@ public:
         assert((limit == -1) || (limit > 0));
         auto node_callback = [&] (leaf_type* node,
                                   typename unlocked_cursor_type::nodeversion_value_type version) {
-            return ((!phantom_protection) || register_internode_version(node, version));
+            return ((!phantom_protection) || snapshot_mode() || register_internode_version(node, version));
         };
 
         auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
+            if (snapshot_mode())
+                return snapshot_scan_row(key, e, callback, ret, count);
+
             TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
                                                       : Sto::fresh_item(this, item_key_t::row_item_key(e));
 
@@ -498,6 +585,7 @@ public:
             switch (access) {
                 case RowAccess::ObserveValue:
                 case RowAccess::ObserveExists:
+                    cc_policy_.before_access(row_item, e->version(), false);
                     ok = row_item.observe(e->version());
                     break;
                 case RowAccess::None:
@@ -507,8 +595,10 @@ public:
                     break;
             }
 
-            if (!ok)
+            if (!ok) {
+                cc_policy_.conflict();
                 return false;
+            }
 
             // skip invalid (inserted but yet committed) values, but do not abort
             if (!e->valid()) {
@@ -557,6 +647,44 @@ public:
         }
     }
 
+    bool nontrans_remove(const key_type& k) {
+        return _remove(k);
+    }
+
+    // install cell @cell of @v, or all of @v into a new row
+    void nontrans_put_cell(const key_type& k, int cell, const value_type& v) {
+        unlocked_cursor_type lp(table_, k);
+        if (lp.find_unlocked(*ti))
+            lp.value()->row_container.install_cell(cell, &v);
+        else
+            nontrans_put(k, v);
+    }
+
+    // Checkpoints (TCheckpoint): the whole tree is one part. The rows are
+    // those of the snapshot of the calling read-only transaction, so the
+    // index must keep overwritten rows for it (DBParams::Hybrid).
+    size_t checkpoint_parts() const {
+        return 1;
+    }
+
+    template <typename F>
+    void snapshot_scan(F f, size_t, size_t) {
+        always_assert(DBParams::Hybrid, "OCC checkpoints need hybrid snapshots");
+        value_type row;
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        auto value_callback = [&] (const lcdf::Str&, internal_elem *e, bool& ret, bool&) {
+            if (snapshot_copy(e, row))
+                f(e->key, row);
+            ret = true;
+            return true;
+        };
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+            scanner(lcdf::Str(), node_callback, value_callback, -1);
+        table_.scan(lcdf::Str(), true, scanner, *ti);
+    }
+
     // TObject interface methods
     bool lock(TransItem& item, Transaction &txn) override {
         assert(!is_internode(item));
@@ -577,10 +705,16 @@ public:
         } else {
             auto key = item.key<item_key_t>();
             auto e = key.internal_elem_ptr();
+            bool ok;
             if (key.is_row_item())
-                return e->version().cp_check_version(txn, item);
+                ok = e->version().cp_check_version(txn, item);
             else
-                return e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
+                ok = e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
+            if (!ok) {
+                column_profile<value_type>::template conflict<value_container_type>(key.cell_num());
+                cc_policy_.conflict();
+            }
+            return ok;
         }
     }
 
@@ -591,9 +725,14 @@ public:
 
         if (key.is_row_item()) {
             //assert(e->version.is_locked());
+            if (DBParams::Hybrid && !has_insert(item))
+                e->history().save(e->row_container.row, e->version().value(), txn);
+
             if (has_delete(item)) {
                 assert(e->valid() && !e->deleted);
                 e->deleted = true;
+                if (logging())
+                    log_delete(txn, e->key);
                 txn.set_version(e->version());
                 return;
             }
@@ -628,6 +767,9 @@ public:
                     }
                 }
             }
+            if (logging())
+                log_row(txn, e->key, e->row_container.row,
+                        has_insert(item) || has_row_update(item) || item.has_commute() ? 0 : 1);
             txn.set_version_unlock(e->version(), item);
         } else {
             // skip installation if row-level update is present
@@ -646,6 +788,9 @@ public:
 
                     e->row_container.install_cell(key.cell_num(), vptr);
                 }
+                if (logging())
+                    log_row(txn, e->key, e->row_container.row,
+                            row_item.has_commute() ? 0 : key.cell_num() + 1);
             }
 
             txn.set_version_unlock(e->row_container.version_at(key.cell_num()), item);
@@ -749,6 +894,79 @@ protected:
 private:
     table_type table_;
     uint64_t key_gen_;
+    cc_policy_type cc_policy_;
+
+    // Hybrid mode: declared read-only transactions bypass OCC entirely
+    static bool snapshot_mode() {
+        return DBParams::Hybrid && Sto::read_only();
+    }
+
+    sel_return_type snapshot_select(internal_elem *e) {
+        const value_type *vptr = (e == nullptr) ? nullptr : snapshot_row(e);
+        if (vptr == nullptr)
+            return sel_return_type(true, false, 0, nullptr);
+        return sel_return_type(true, true, reinterpret_cast<uintptr_t>(e), vptr);
+    }
+
+    template <typename Callback>
+    bool snapshot_scan_row(const lcdf::Str& key, internal_elem *e, Callback& callback, bool& ret, bool& count) {
+        const value_type *vptr = snapshot_row(e);
+        if (vptr == nullptr) {
+            ret = true;
+            count = false;
+            return true;
+        }
+        ret = callback(key_type(key), *vptr);
+        return true;
+    }
+
+    // Returns the row as of the transaction's snapshot, or nullptr if it did
+    // not exist then. Committing writers are waited out rather than causing
+    // an abort; current values are copied to transaction scratch space.
+    const value_type *snapshot_row(internal_elem *e) {
+        auto rtid = Sto::snapshot_tid();
+        while (true) {
+            auto v = e->version().value();
+            if (TransactionTid::is_locked(v)) {
+                relax_fence();
+                continue;
+            }
+            acquire_fence();
+            if ((v & TransactionTid::max_value) > rtid)
+                return e->history().find(rtid);
+            if ((v & invalid_bit) || e->deleted)
+                return nullptr;
+            auto vptr = Sto::tx_alloc(&e->row_container.row);
+            fence();
+            if (e->version().value() == v)
+                return vptr;
+        }
+    }
+
+    // snapshot_row() into @row rather than scratch space
+    bool snapshot_copy(internal_elem *e, value_type& row) {
+        auto rtid = Sto::snapshot_tid();
+        while (true) {
+            auto v = e->version().value();
+            if (TransactionTid::is_locked(v)) {
+                relax_fence();
+                continue;
+            }
+            acquire_fence();
+            if ((v & TransactionTid::max_value) > rtid) {
+                const value_type *h = e->history().find(rtid);
+                if (h != nullptr)
+                    row = *h;
+                return h != nullptr;
+            }
+            if ((v & invalid_bit) || e->deleted)
+                return false;
+            row = e->row_container.row;
+            fence();
+            if (e->version().value() == v)
+                return true;
+        }
+    }
 
     static bool
     access_all(std::array<access_t, value_container_type::num_versions>& cell_accesses, std::array<TransItem*, value_container_type::num_versions>& cell_items, value_container_type& row_container) {
@@ -846,7 +1064,7 @@ __thread typename ordered_index<K, V, DBParams>::table_params::threadinfo_type
 *ordered_index<K, V, DBParams>::ti;
 
 template <typename K, typename V, typename DBParams>
-class mvcc_ordered_index : public TObject {
+class mvcc_ordered_index : public TObject, public index_log {
 public:
     typedef K key_type;
     typedef V value_type;
@@ -959,6 +1177,18 @@ public:
         return fetch_and_add(&key_gen_, 1);
     }
 
+    // MVCC tables have no runtime concurrency control policy
+    static cc_policy::disabled& runtime_cc() {
+        static cc_policy::disabled none;
+        return none;
+    }
+
+    // See unordered_index::lookup_address. Nothing is worth prefetching
+    // ahead: a Masstree descent prefetches each node as it reaches it.
+    const void* lookup_address(const key_type&, int) const {
+        return nullptr;
+    }
+
     sel_return_type
     select_row(const key_type& key, RowAccess acc) {
         unlocked_cursor_type lp(table_, key);
@@ -967,6 +1197,8 @@ public:
         if (found) {
             return select_row(reinterpret_cast<uintptr_t>(e), acc);
         } else {
+            if (Sto::read_only())
+                return sel_return_type(true, false, 0, nullptr);
             if (!register_internode_version(lp.node(), lp.full_version_value()))
                 goto abort;
             return sel_return_type(true, false, 0, nullptr);
@@ -976,6 +1208,42 @@ public:
         return sel_return_type(false, false, 0, nullptr);
     }
 
+    // Batched point lookups (see select_rows_grouped). The only step is the
+    // tree descent, which prefetches the element found, so the element
+    // cache misses overlap with the remaining descents of the group.
+    bool
+    select_rows(const key_type *keys, size_t n, RowAccess access, sel_return_type *out) {
+        internal_elem *elems[multiget_group_size];
+        node_type *nodes[multiget_group_size];
+        nodeversion_value_type versions[multiget_group_size];
+        return select_rows_grouped(n, out,
+            [&] (size_t i, int) {
+                size_t j = i % multiget_group_size;
+                unlocked_cursor_type lp(table_, keys[i]);
+                if (lp.find_unlocked(*ti)) {
+                    elems[j] = lp.value();
+                    prefetch(elems[j]);
+                    prefetch(&elems[j]->row);
+                } else {
+                    elems[j] = nullptr;
+                    nodes[j] = lp.node();
+                    versions[j] = lp.full_version_value();
+                }
+                return false;
+            },
+            [&] (size_t i) -> sel_return_type {
+                size_t j = i % multiget_group_size;
+                if (Sto::read_only() && elems[j] == nullptr)
+                    return sel_return_type(true, false, 0, nullptr);
+                else if (elems[j] != nullptr)
+                    return select_row(reinterpret_cast<uintptr_t>(elems[j]), access);
+                else if (register_internode_version(nodes[j], versions[j]))
+                    return sel_return_type(true, false, 0, nullptr);
+                else
+                    return sel_return_type(false, false, 0, nullptr);
+            });
+    }
+
     sel_return_type
     select_row(const key_type& key, std::initializer_list<column_access_t> accesses) {
         unlocked_cursor_type lp(table_, key);
@@ -994,6 +1262,9 @@ public:
 
     sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
+        if (Sto::read_only())
+            return select_row_read_only(rid, access);
+
         auto e = reinterpret_cast<internal_elem *>(rid);
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
@@ -1051,6 +1322,7 @@ public:
     }
 
     void update_row(uintptr_t rid, value_type* new_row) {
+        always_assert(!Sto::read_only(), "update in a read-only transaction");
         auto row_item = Sto::item(this, item_key_t::row_item_key(reinterpret_cast<internal_elem *>(rid)));
         // TODO: address this extra copying issue
         row_item.add_write(new_row);
@@ -1060,6 +1332,7 @@ public:
     }
 
     void update_row(uintptr_t rid, const comm_type &comm) {
+        always_assert(!Sto::read_only(), "update in a read-only transaction");
         auto row_item = Sto::item(this, item_key_t::row_item_key(reinterpret_cast<internal_elem *>(rid)));
         // TODO: address this extra copying issue
         row_item.add_commute(comm);
@@ -1069,6 +1342,7 @@ public:
     // if a row already exists, then use select (FOR UPDATE) instead
     ins_return_type
     insert_row(const key_type& key, value_type *vptr, bool overwrite = false) {
+        always_assert(!Sto::read_only(), "insert in a read-only transaction");
         cursor_type lp(table_, key);
         bool found = lp.find_insert(*ti);
         if (found) {
@@ -1147,6 +1421,7 @@ public:
 
     del_return_type
     delete_row(const key_type& key) {
+        always_assert(!Sto::read_only(), "delete in a read-only transaction");
         unlocked_cursor_type lp(table_, key);
         bool found = lp.find_unlocked(*ti);
         if (found) {
@@ -1197,7 +1472,7 @@ public:
         assert((limit == -1) || (limit > 0));
         auto node_callback = [&] (leaf_type* node,
                                   typename unlocked_cursor_type::nodeversion_value_type version) {
-            return ((!phantom_protection) || register_internode_version(node, version));
+            return ((!phantom_protection) || Sto::read_only() || register_internode_version(node, version));
         };
 
         auto value_callback = [&] (const lcdf::Str& key, internal_elem *e, bool& ret, bool& count) {
@@ -1209,22 +1484,24 @@ public:
                 return true;
             }
 
-            TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
-                                                      : Sto::fresh_item(this, item_key_t::row_item_key(e));
+            if (!Sto::read_only()) {
+                TransProxy row_item = index_read_my_write ? Sto::item(this, item_key_t::row_item_key(e))
+                                                          : Sto::fresh_item(this, item_key_t::row_item_key(e));
 
-            if (index_read_my_write) {
-                if (has_delete(row_item)) {
-                    ret = true;
-                    count = false;
-                    return true;
-                }
-                if (has_row_update(row_item)) {
-                    ret = callback(key_type(key), *(row_item.template raw_write_value<value_type *>()));
-                    return true;
+                if (index_read_my_write) {
+                    if (has_delete(row_item)) {
+                        ret = true;
+                        count = false;
+                        return true;
+                    }
+                    if (has_row_update(row_item)) {
+                        ret = callback(key_type(key), *(row_item.template raw_write_value<value_type *>()));
+                        return true;
+                    }
                 }
-            }
 
-            MvAccess::template read<value_type>(row_item, h);
+                MvAccess::template read<value_type>(row_item, h);
+            }
 
 #if SAFE_FLATTEN
             auto vptr = h->vp_safe_flatten();
@@ -1273,6 +1550,37 @@ public:
         }
     }
 
+    bool nontrans_remove(const key_type& k) {
+        return _remove(k);
+    }
+
+    // MVCC rows are a single cell
+    void nontrans_put_cell(const key_type& k, int, const value_type& v) {
+        nontrans_put(k, v);
+    }
+
+    // Checkpoints (TCheckpoint): the whole tree is one part, read at the
+    // read tid of the calling read-only transaction.
+    size_t checkpoint_parts() const {
+        return 1;
+    }
+
+    template <typename F>
+    void snapshot_scan(F f, size_t, size_t) {
+        auto node_callback = [] (leaf_type*, typename unlocked_cursor_type::nodeversion_value_type) {
+            return true;
+        };
+        auto value_callback = [&] (const lcdf::Str&, internal_elem *e, bool& ret, bool&) {
+            if (auto vp = snapshot_value(e))
+                f(e->key, *vp);
+            ret = true;
+            return true;
+        };
+        range_scanner<decltype(node_callback), decltype(value_callback), false>
+            scanner(lcdf::Str(), node_callback, value_callback, -1);
+        table_.scan(lcdf::Str(), true, scanner, *ti);
+    }
+
     // TObject interface methods
     bool lock(TransItem& item, Transaction& txn) override {
         assert(!is_internode(item));
@@ -1336,13 +1644,15 @@ public:
         }
     }
 
-    void install(TransItem& item, Transaction&) override {
+    void install(TransItem& item, Transaction& txn) override {
         assert(!is_internode(item));
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
         auto h = item.template write_value<history_type*>();
 
         e->row.cp_install(h);
+        if (logging())
+            log_history(txn, e, h);
     }
 
     void unlock(TransItem& item) override {
@@ -1437,6 +1747,44 @@ private:
     table_type table_;
     uint64_t key_gen_;
 
+    // Declared read-only transactions read the snapshot at the read tid
+    // directly. Nothing is left in the tset: such a transaction has no
+    // writes to observe and nothing to validate at commit.
+    sel_return_type
+    select_row_read_only(uintptr_t rid, RowAccess access) {
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        history_type *h = e->row.find(txn_read_tid());
+
+        if (h->status_is(UNUSED) || h->status_is(DELETED))
+            return { true, false, 0, nullptr };
+        if (access == RowAccess::None)
+            return { true, true, rid, nullptr };
+#if SAFE_FLATTEN
+        auto vp = h->vp_safe_flatten();
+        if (vp == nullptr)
+            return { false, false, 0, nullptr };
+#else
+        auto vp = h->vp();
+        assert(vp);
+#endif
+        return { true, true, rid, vp };
+    }
+
+    // The row at the read tid, or nullptr if there was none
+    const value_type *snapshot_value(internal_elem *e) {
+        history_type *h = e->row.find(txn_read_tid());
+        if (h->status_is(UNUSED) || h->status_is(DELETED))
+            return nullptr;
+#if SAFE_FLATTEN
+        value_type *vp;
+        while ((vp = h->vp_safe_flatten()) == nullptr)
+            relax_fence();
+        return vp;
+#else
+        return h->vp();
+#endif
+    }
+
     static bool
     access_all(std::array<access_t, internal_elem::num_versions>&, std::array<TransItem*, internal_elem::num_versions>&, internal_elem*) {
         always_assert(false, "Not implemented.");
@@ -7,10 +7,10 @@ namespace db_params {
 
 // Benchmark parameters
 constexpr const char *db_params_id_names[] = {
-    "none", "default", "opaque", "2pl", "adaptive", "swiss", "tictoc", "mvcc"};
+    "none", "default", "opaque", "2pl", "adaptive", "swiss", "tictoc", "mvcc", "hybrid", "runtime"};
 
 enum class db_params_id : int {
-    None = 0, Default, Opaque, TwoPL, Adaptive, Swiss, TicToc, MVCC
+    None = 0, Default, Opaque, TwoPL, Adaptive, Swiss, TicToc, MVCC, Hybrid, Runtime
 };
 
 inline std::ostream &operator<<(std::ostream &os, const db_params_id &id) {
@@ -41,6 +41,8 @@ public:
     static constexpr bool Swiss = false;
     static constexpr bool TicToc = false;
     static constexpr bool MVCC = false;
+    static constexpr bool Hybrid = false;
+    static constexpr bool RuntimeCC = false;
     static constexpr bool NodeTrack = false;
     static constexpr bool Commute = false;
 };
@@ -97,6 +99,25 @@ public:
     static constexpr bool Commute = true;
 };
 
+// Hybrid OCC/MVCC: writers run single-version OCC (with opaque, globally
+// ordered commit tids), declared read-only transactions read a snapshot
+class db_hybrid_params : public db_default_params {
+public:
+    static constexpr db_params_id Id = db_params_id::Hybrid;
+    static constexpr bool Opaque = true;
+    static constexpr bool Hybrid = true;
+};
+
+// Per-table concurrency control chosen at runtime (bench::cc_policy): rows
+// use adaptive-locking versions, and each table switches its readers between
+// OCC, adaptive locking and 2PL as its contention changes
+class db_runtime_params : public db_default_params {
+public:
+    static constexpr db_params_id Id = db_params_id::Runtime;
+    static constexpr bool Adaptive = true;
+    static constexpr bool RuntimeCC = true;
+};
+
 class db_default_node_params : public db_default_params {
 public:
     static constexpr bool NodeTrack = true;
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "compiler.hh"
+
+namespace bench {
+
+// H-Store-style partitioned execution. Every transaction holds the locks of
+// the partitions it touches while it runs. A transaction whose partitions
+// all belong to the running thread then has them to itself: it updates rows
+// in place through the nontrans_ methods, without STO tracking, and keeps a
+// db_undo_log to take its updates back if it fails. Other transactions run
+// as ordinary STO transactions under the same locks.
+class db_partition_locks {
+public:
+    static constexpr unsigned max_partitions = 32;
+
+    // The partitions of one transaction
+    class set {
+    public:
+        void add(uint64_t p) {
+            for (unsigned i = 0; i != n_; ++i)
+                if (ps_[i] == p)
+                    return;
+            always_assert(n_ < max_partitions, "transaction touches too many partitions");
+            ps_[n_++] = p;
+        }
+        // Whether every partition is in [@first, @last]
+        bool within(uint64_t first, uint64_t last) const {
+            for (unsigned i = 0; i != n_; ++i)
+                if (ps_[i] < first || ps_[i] > last)
+                    return false;
+            return true;
+        }
+
+    private:
+        unsigned n_ = 0;
+        uint64_t ps_[max_partitions];
+
+        friend class db_partition_locks;
+    };
+
+    // Partitions 0 to @n - 1
+    explicit db_partition_locks(size_t n)
+        : locks_(new partition_lock[n]), n_(n) {
+    }
+    db_partition_locks(const db_partition_locks&) = delete;
+    db_partition_locks& operator=(const db_partition_locks&) = delete;
+
+    // Lock @s's partitions in increasing order, so that transactions
+    // locking several cannot deadlock
+    void lock(set& s) {
+        std::sort(s.ps_, s.ps_ + s.n_);
+        for (unsigned i = 0; i != s.n_; ++i) {
+            assert(s.ps_[i] < n_);
+            auto& held = locks_[s.ps_[i]].held;
+            unsigned n = 0;
+            while (held.exchange(true, std::memory_order_acquire))
+                while (held.load(std::memory_order_relaxed)) {
+                    if (++n % 1024 == 0)
+                        std::this_thread::yield();
+                    else
+                        relax_fence();
+                }
+        }
+    }
+    void unlock(const set& s) {
+        for (unsigned i = 0; i != s.n_; ++i)
+            locks_[s.ps_[i]].held.store(false, std::memory_order_release);
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) partition_lock {
+        std::atomic<bool> held{false};
+    };
+
+    std::unique_ptr<partition_lock[]> locks_;
+    size_t n_;
+};
+
+// In-place updates and inserts of a partition-local transaction, undone in
+// reverse order by rollback(). Keys and rows are saved as raw bytes, as for
+// logging and checkpoints.
+class db_undo_log {
+public:
+    // @k's row in @t for updating in place, or nullptr if there is none.
+    // The row as it was is saved first.
+    template <typename Index>
+    typename Index::value_type* update(Index& t, const typename Index::key_type& k) {
+        auto row = t.nontrans_get(k);
+        if (row)
+            save(&t, &undo_update<Index>, &k, sizeof(k), row, sizeof(*row));
+        return row;
+    }
+
+    // Insert @v under @k, which must not be in @t yet
+    template <typename Index>
+    void insert(Index& t, const typename Index::key_type& k, const typename Index::value_type& v) {
+        assert(!t.nontrans_get(k));
+        t.nontrans_put(k, v);
+        save(&t, &undo_insert<Index>, &k, sizeof(k), nullptr, 0);
+    }
+
+    bool empty() const {
+        return entries_.empty();
+    }
+    // Keep the changes
+    void commit() {
+        entries_.clear();
+        data_.clear();
+    }
+    // Take the changes back
+    void rollback() {
+        for (auto it = entries_.rbegin(); it != entries_.rend(); ++it)
+            it->undo(it->table, data_.data() + it->offset);
+        commit();
+    }
+
+private:
+    struct entry {
+        void (*undo)(void* table, const char* image);
+        void* table;
+        size_t offset;
+    };
+
+    std::vector<entry> entries_;
+    std::vector<char> data_;
+
+    void save(void* table, void (*undo)(void*, const char*),
+              const void* key, size_t key_length, const void* row, size_t row_length) {
+        size_t offset = data_.size();
+        data_.resize(offset + key_length + row_length);
+        memcpy(&data_[offset], key, key_length);
+        if (row_length)
+            memcpy(&data_[offset + key_length], row, row_length);
+        entries_.push_back({undo, table, offset});
+    }
+
+    template <typename T>
+    static T unaligned(const char* p) {
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type buf;
+        memcpy(&buf, p, sizeof(T));
+        return *reinterpret_cast<T*>(&buf);
+    }
+
+    template <typename Index>
+    static void undo_update(void* table, const char* image) {
+        typedef typename Index::key_type key_type;
+        typedef typename Index::value_type value_type;
+        auto row = static_cast<Index*>(table)->nontrans_get(unaligned<key_type>(image));
+        assert(row);
+        memcpy(static_cast<void*>(row), image + sizeof(key_type), sizeof(value_type));
+    }
+
+    template <typename Index>
+    static void undo_insert(void* table, const char* image) {
+        typedef typename Index::key_type key_type;
+        static_cast<Index*>(table)->nontrans_remove(unaligned<key_type>(image));
+    }
+};
+
+}; // namespace bench
@@ -3,7 +3,7 @@
 namespace bench {
 // unordered index implemented as hashtable
 template <typename K, typename V, typename DBParams>
-class unordered_index : public index_common<K, V, DBParams>, public TObject {
+class unordered_index : public index_common<K, V, DBParams>, public TObject, public index_log {
 public:
     // Premable
     using C = index_common<K, V, DBParams>;
@@ -35,26 +35,34 @@ public:
     using C::index_read_my_write;
 
     typedef typename get_occ_version<DBParams>::type bucket_version_type;
+    typedef typename std::conditional<DBParams::Hybrid, hybrid_history<V>,
+                                      typename hybrid_history<V>::disabled>::type history_type;
+    typedef typename std::conditional<DBParams::RuntimeCC, cc_policy,
+                                      cc_policy::disabled>::type cc_policy_type;
 
     typedef std::hash<K> Hash;
     typedef std::equal_to<K> Pred;
 
     // our hashtable is an array of linked lists.
     // an internal_elem is the node type for these linked lists
-    struct internal_elem {
+    // history_type is a base so that it takes no space when disabled
+    struct internal_elem : history_type {
         internal_elem *next;
         key_type key;
         value_container_type row_container;
         bool deleted;
 
         internal_elem(const key_type& k, const value_type& v, bool valid)
-            : next(nullptr), key(k),
+            : history_type(), next(nullptr), key(k),
               row_container((valid ? Sto::initialized_tid() : (Sto::initialized_tid() | invalid_bit)), !valid, v),
               deleted(false) {}
 
         version_type& version() {
             return row_container.row_version();
         }
+        history_type& history() {
+            return *this;
+        }
 
         bool valid() {
             return !(version().value() & invalid_bit);
@@ -82,6 +90,7 @@ private:
     Pred pred_;
 
     uint64_t key_gen_;
+    cc_policy_type cc_policy_;
 
     // used to mark whether a key is a bucket (for bucket version checks)
     // or a pointer (which will always have the lower 3 bits as 0)
@@ -102,6 +111,8 @@ public:
     // Main constructor
     unordered_index(size_t size, Hash h = Hash(), Pred p = Pred()) :
             map_(), hasher_(h), pred_(p), key_gen_(0) {
+        always_assert(!DBParams::Hybrid || value_container_type::num_versions == 1,
+                      "hybrid mode requires row-granularity versions");
         map_.resize(size);
     }
 
@@ -119,21 +130,42 @@ public:
         return fetch_and_add(&key_gen_, 1);
     }
 
+    // This table's runtime concurrency control policy (DBParams::RuntimeCC)
+    cc_policy_type& runtime_cc() {
+        return cc_policy_;
+    }
+
+    // Lines a lookup of k reads, in order: step 0 is its bucket, step 1 the
+    // head of the bucket's chain (read from the bucket, so fetch step 0
+    // first), step 2 the head's version; nullptr after the last step.
+    // Interleaved executors prefetch each step and run other transactions
+    // while it arrives.
+    const void* lookup_address(const key_type& k, int step) const {
+        const bucket_entry& buck = map_[find_bucket_idx(k)];
+        if (step == 0)
+            return &buck;
+        internal_elem *head = buck.head;
+        if (step == 1 || head == nullptr)
+            return head;
+        return step == 2 ? &head->version() : nullptr;
+    }
+
     sel_return_type
     select_row(const key_type& k, RowAccess access) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
-        internal_elem *e = find_in_bucket(buck, k);
+        return select_row_in_bucket(map_[find_bucket_idx(k)], k, access);
+    }
 
-        if (e != nullptr) {
-            return select_row(reinterpret_cast<uintptr_t>(e), access);
-        } else {
-            if (!Sto::item(this, make_bucket_key(buck)).observe(buck_vers)) {
-                return sel_abort;
-            }
-            return { true, false, 0, nullptr };
-        }
+    // Batched point lookups (see select_rows_grouped), stepping through
+    // lookup_address for every key of a group
+    bool
+    select_rows(const key_type *keys, size_t n, RowAccess access, sel_return_type *out) {
+        return select_rows_grouped(n, out,
+            [this, keys] (size_t i, int step) {
+                return prefetch_lookup_step(*this, keys[i], step);
+            },
+            [this, keys, access] (size_t i) {
+                return select_row(keys[i], access);
+            });
     }
 
     sel_return_type
@@ -143,6 +175,9 @@ public:
         fence();
         internal_elem *e = find_in_bucket(buck, k);
 
+        if (snapshot_mode())
+            return snapshot_select(e);
+
         if (e != nullptr) {
             return select_row(reinterpret_cast<uintptr_t>(e), accesses);
         } else {
@@ -156,6 +191,11 @@ public:
     sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
         auto e = reinterpret_cast<internal_elem*>(rid);
+        if (snapshot_mode()) {
+            always_assert(access != RowAccess::UpdateValue, "update in a read-only transaction");
+            return snapshot_select(e);
+        }
+
         bool ok = true;
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
@@ -176,6 +216,8 @@ public:
             }
         }
 
+        if (access != RowAccess::None)
+            cc_policy_.before_access(row_item, e->version(), access == RowAccess::UpdateValue);
         switch (access) {
             case RowAccess::UpdateValue:
                 ok = version_adapter::select_for_update(row_item, e->version());
@@ -189,8 +231,10 @@ public:
                 break;
         }
 
-        if (!ok)
+        if (!ok) {
+            cc_policy_.conflict();
             return sel_abort;
+        }
 
         return { true, true, rid, &(e->row_container.row) };
     }
@@ -198,8 +242,12 @@ public:
     sel_return_type
     select_row(uintptr_t rid, std::initializer_list<column_access_t> accesses) {
         auto e = reinterpret_cast<internal_elem*>(rid);
+        if (snapshot_mode())
+            return snapshot_select(e);
+
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
+        column_profile<value_type>::access(accesses);
         auto cell_accesses = column_to_cell_accesses<value_container_type>(accesses);
 
         std::array<TransItem*, value_container_type::num_versions> cell_items {};
@@ -232,12 +280,14 @@ public:
     }
 
     void update_row(uintptr_t rid, value_type *new_row) {
+        always_assert(!snapshot_mode(), "update in a read-only transaction");
         auto e = reinterpret_cast<internal_elem*>(rid);
         auto row_item = Sto::item(this, item_key_t::row_item_key(e));
         row_item.acquire_write(e->version(), new_row);
     }
 
     void update_row(uintptr_t rid, const comm_type &comm) {
+        always_assert(!snapshot_mode(), "update in a read-only transaction");
         assert(&comm);
         auto row_item = Sto::item(this, item_key_t::row_item_key(reinterpret_cast<internal_elem *>(rid)));
         row_item.add_commute(comm);
@@ -245,6 +295,7 @@ public:
 
     ins_return_type
     insert_row(const key_type& k, value_type *vptr, bool overwrite = false) {
+        always_assert(!snapshot_mode(), "insert in a read-only transaction");
         bucket_entry& buck = map_[find_bucket_idx(k)];
 
         buck.version.lock_exclusive();
@@ -305,6 +356,7 @@ public:
     // until commit time
     del_return_type
     delete_row(const key_type& k) {
+        always_assert(!snapshot_mode(), "delete in a read-only transaction");
         bucket_entry& buck = map_[find_bucket_idx(k)];
         bucket_version_type buck_vers = buck.version;
         fence();
@@ -370,6 +422,37 @@ public:
         buck.version.unlock_exclusive();
     }
 
+    bool nontrans_remove(const key_type& k) {
+        return remove(k);
+    }
+
+    // install cell @cell of @v, or all of @v into a new row
+    void nontrans_put_cell(const key_type& k, int cell, const value_type& v) {
+        internal_elem *e = find_in_bucket(map_[find_bucket_idx(k)], k);
+        if (e == nullptr)
+            nontrans_put(k, v);
+        else
+            e->row_container.install_cell(cell, &v);
+    }
+
+    // Checkpoints (TCheckpoint): a part is a range of buckets. The rows are
+    // those of the snapshot of the calling read-only transaction, so the
+    // index must keep overwritten rows for it (DBParams::Hybrid).
+    size_t checkpoint_parts() const {
+        return std::max(nbuckets() / checkpoint_part_buckets, size_t(1));
+    }
+
+    template <typename F>
+    void snapshot_scan(F f, size_t part, size_t nparts) {
+        always_assert(DBParams::Hybrid, "OCC checkpoints need hybrid snapshots");
+        value_type row;
+        for (size_t i = nbuckets() * part / nparts, end = nbuckets() * (part + 1) / nparts;
+             i != end; ++i)
+            for (internal_elem *e = map_[i].head; e != nullptr; e = e->next)
+                if (snapshot_copy(e, row))
+                    f(e->key, row);
+    }
+
     // TObject interface methods
     bool lock(TransItem& item, Transaction& txn) override {
         assert(!is_bucket(item));
@@ -389,10 +472,16 @@ public:
         } else {
             auto key = item.key<item_key_t>();
             auto e = key.internal_elem_ptr();
+            bool ok;
             if (key.is_row_item())
-                return e->version().cp_check_version(txn, item);
+                ok = e->version().cp_check_version(txn, item);
             else
-                return e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
+                ok = e->row_container.version_at(key.cell_num()).cp_check_version(txn, item);
+            if (!ok) {
+                column_profile<value_type>::template conflict<value_container_type>(key.cell_num());
+                cc_policy_.conflict();
+            }
+            return ok;
         }
     }
 
@@ -402,10 +491,15 @@ public:
         auto e = key.internal_elem_ptr();
 
         if (key.is_row_item()) {
+            if (DBParams::Hybrid && !has_insert(item))
+                e->history().save(e->row_container.row, e->version().value(), txn);
+
             if (has_delete(item)) {
                 assert(e->valid() && !e->deleted);
                 e->deleted = true;
                 fence();
+                if (logging())
+                    log_delete(txn, e->key);
                 txn.set_version(e->version());
                 return;
             }
@@ -428,6 +522,9 @@ public:
                     }
                 }
             }
+            if (logging())
+                log_row(txn, e->key, e->row_container.row,
+                        has_insert(item) || has_row_update(item) || item.has_commute() ? 0 : 1);
             txn.set_version_unlock(e->version(), item);
         } else {
             auto row_item = Sto::item(this, item_key_t::row_item_key(e));
@@ -440,6 +537,9 @@ public:
                     auto vptr = row_item.template raw_write_value<value_type*>();
                     e->row_container.install_cell(key.cell_num(), vptr);
                 }
+                if (logging())
+                    log_row(txn, e->key, e->row_container.row,
+                            row_item.has_commute() ? 0 : key.cell_num() + 1);
             }
             txn.set_version_unlock(e->row_container.version_at(key.cell_num()), item);
         }
@@ -467,6 +567,85 @@ public:
     }
 
 private:
+    sel_return_type
+    select_row_in_bucket(bucket_entry& buck, const key_type& k, RowAccess access) {
+        bucket_version_type buck_vers = buck.version;
+        fence();
+        internal_elem *e = find_in_bucket(buck, k);
+
+        if (snapshot_mode())
+            return snapshot_select(e);
+
+        if (e != nullptr) {
+            return select_row(reinterpret_cast<uintptr_t>(e), access);
+        } else {
+            if (!Sto::item(this, make_bucket_key(buck)).observe(buck_vers)) {
+                return sel_abort;
+            }
+            return { true, false, 0, nullptr };
+        }
+    }
+
+    // Hybrid mode: declared read-only transactions bypass OCC entirely
+    static bool snapshot_mode() {
+        return DBParams::Hybrid && Sto::read_only();
+    }
+
+    sel_return_type snapshot_select(internal_elem *e) {
+        const value_type *vptr = (e == nullptr) ? nullptr : snapshot_row(e);
+        if (vptr == nullptr)
+            return { true, false, 0, nullptr };
+        return { true, true, reinterpret_cast<uintptr_t>(e), vptr };
+    }
+
+    // Returns the row as of the transaction's snapshot, or nullptr if it did
+    // not exist then. Committing writers are waited out rather than causing
+    // an abort; current values are copied to transaction scratch space.
+    const value_type *snapshot_row(internal_elem *e) {
+        auto rtid = Sto::snapshot_tid();
+        while (true) {
+            auto v = e->version().value();
+            if (TransactionTid::is_locked(v)) {
+                relax_fence();
+                continue;
+            }
+            acquire_fence();
+            if ((v & TransactionTid::max_value) > rtid)
+                return e->history().find(rtid);
+            if ((v & invalid_bit) || e->deleted)
+                return nullptr;
+            auto vptr = Sto::tx_alloc(&e->row_container.row);
+            fence();
+            if (e->version().value() == v)
+                return vptr;
+        }
+    }
+
+    // snapshot_row() into @row rather than scratch space
+    bool snapshot_copy(internal_elem *e, value_type& row) {
+        auto rtid = Sto::snapshot_tid();
+        while (true) {
+            auto v = e->version().value();
+            if (TransactionTid::is_locked(v)) {
+                relax_fence();
+                continue;
+            }
+            acquire_fence();
+            if ((v & TransactionTid::max_value) > rtid) {
+                const value_type *h = e->history().find(rtid);
+                if (h != nullptr)
+                    row = *h;
+                return h != nullptr;
+            }
+            if ((v & invalid_bit) || e->deleted)
+                return false;
+            row = e->row_container.row;
+            fence();
+            if (e->version().value() == v)
+                return true;
+        }
+    }
+
     static bool
     access_all(std::array<access_t, value_container_type::num_versions>& cell_accesses, std::array<TransItem*, value_container_type::num_versions>& cell_items, value_container_type& row_container) {
         for (size_t idx = 0; idx < cell_accesses.size(); ++idx) {
@@ -575,7 +754,7 @@ private:
 
 // MVCC variant
 template <typename K, typename V, typename DBParams>
-class mvcc_unordered_index : public index_common<K, V, DBParams>, public TObject {
+class mvcc_unordered_index : public index_common<K, V, DBParams>, public TObject, public index_log {
 public:
     // Premable
     using C = index_common<K, V, DBParams>;
@@ -676,21 +855,43 @@ public:
         return fetch_and_add(&key_gen_, 1);
     }
 
+    // MVCC tables have no runtime concurrency control policy
+    static cc_policy::disabled& runtime_cc() {
+        static cc_policy::disabled none;
+        return none;
+    }
+
+    // Lines a lookup of k reads, in order: step 0 is its bucket, step 1 the
+    // head of the bucket's chain (read from the bucket, so fetch step 0
+    // first), step 2 the head's row; nullptr after the last step.
+    // Interleaved executors prefetch each step and run other transactions
+    // while it arrives.
+    const void* lookup_address(const key_type& k, int step) const {
+        const bucket_entry& buck = map_[find_bucket_idx(k)];
+        if (step == 0)
+            return &buck;
+        internal_elem *head = buck.head;
+        if (step == 1 || head == nullptr)
+            return head;
+        return step == 2 ? &head->row : nullptr;
+    }
+
     sel_return_type
     select_row(const key_type& k, RowAccess access) {
-        bucket_entry& buck = map_[find_bucket_idx(k)];
-        bucket_version_type buck_vers = buck.version;
-        fence();
-        internal_elem *e = find_in_bucket(buck, k);
+        return select_row_in_bucket(map_[find_bucket_idx(k)], k, access);
+    }
 
-        if (e != nullptr) {
-            return select_row(reinterpret_cast<uintptr_t>(e), access);
-        } else {
-            if (!Sto::item(this, make_bucket_key(buck)).observe(buck_vers)) {
-                return sel_abort;
-            }
-            return { true, false, 0, nullptr };
-        }
+    // Batched point lookups (see select_rows_grouped), stepping through
+    // lookup_address for every key of a group
+    bool
+    select_rows(const key_type *keys, size_t n, RowAccess access, sel_return_type *out) {
+        return select_rows_grouped(n, out,
+            [this, keys] (size_t i, int step) {
+                return prefetch_lookup_step(*this, keys[i], step);
+            },
+            [this, keys, access] (size_t i) {
+                return select_row(keys[i], access);
+            });
     }
 
     sel_return_type
@@ -712,6 +913,9 @@ public:
 
     sel_return_type
     select_row(uintptr_t rid, RowAccess access) {
+        if (Sto::read_only())
+            return select_row_read_only(rid, access);
+
         auto e = reinterpret_cast<internal_elem*>(rid);
         TransProxy row_item = Sto::item(this, item_key_t::row_item_key(e));
 
@@ -767,12 +971,14 @@ public:
     }
 
     void update_row(uintptr_t rid, value_type *new_row) {
+        always_assert(!Sto::read_only(), "update in a read-only transaction");
         auto e = reinterpret_cast<internal_elem*>(rid);
         auto row_item = Sto::item(this, item_key_t::row_item_key(e));
         row_item.add_write(new_row);
     }
     
     void update_row(uintptr_t rid, const comm_type &comm) {
+        always_assert(!Sto::read_only(), "update in a read-only transaction");
         assert(&comm);
         auto row_item = Sto::item(this, item_key_t::row_item_key(reinterpret_cast<internal_elem *>(rid)));
         row_item.add_commute(comm);
@@ -780,6 +986,7 @@ public:
 
     ins_return_type
     insert_row(const key_type& k, value_type *vptr, bool overwrite = false) {
+        always_assert(!Sto::read_only(), "insert in a read-only transaction");
         bucket_entry& buck = map_[find_bucket_idx(k)];
 
         buck.version.lock_exclusive();
@@ -834,6 +1041,7 @@ public:
     // until commit time
     del_return_type
     delete_row(const key_type& k) {
+        always_assert(!Sto::read_only(), "delete in a read-only transaction");
         bucket_entry& buck = map_[find_bucket_idx(k)];
         bucket_version_type buck_vers = buck.version;
         fence();
@@ -896,6 +1104,30 @@ public:
         buck.version.unlock_exclusive();
     }
 
+    bool nontrans_remove(const key_type& k) {
+        return remove(k);
+    }
+
+    // MVCC rows are a single cell
+    void nontrans_put_cell(const key_type& k, int, const value_type& v) {
+        nontrans_put(k, v);
+    }
+
+    // Checkpoints (TCheckpoint): a part is a range of buckets; rows are read
+    // at the read tid of the calling read-only transaction.
+    size_t checkpoint_parts() const {
+        return std::max(nbuckets() / checkpoint_part_buckets, size_t(1));
+    }
+
+    template <typename F>
+    void snapshot_scan(F f, size_t part, size_t nparts) {
+        for (size_t i = nbuckets() * part / nparts, end = nbuckets() * (part + 1) / nparts;
+             i != end; ++i)
+            for (internal_elem *e = map_[i].head; e != nullptr; e = e->next)
+                if (auto vp = snapshot_value(e))
+                    f(e->key, *vp);
+    }
+
     // TObject interface methods
     bool lock(TransItem& item, Transaction& txn) override {
         assert(!is_bucket(item));
@@ -951,13 +1183,15 @@ public:
         }
     }
 
-    void install(TransItem& item, Transaction&) override {
+    void install(TransItem& item, Transaction& txn) override {
         assert(!is_bucket(item));
         auto key = item.key<item_key_t>();
         auto e = key.internal_elem_ptr();
         auto h = item.template write_value<history_type*>();
 
         e->row.cp_install(h);
+        if (logging())
+            log_history(txn, e, h);
     }
 
     void unlock(TransItem& item) override {
@@ -979,6 +1213,62 @@ public:
     }
 
 private:
+    sel_return_type
+    select_row_in_bucket(bucket_entry& buck, const key_type& k, RowAccess access) {
+        bucket_version_type buck_vers = buck.version;
+        fence();
+        internal_elem *e = find_in_bucket(buck, k);
+
+        if (e != nullptr) {
+            return select_row(reinterpret_cast<uintptr_t>(e), access);
+        } else {
+            if (Sto::read_only())
+                return { true, false, 0, nullptr };
+            if (!Sto::item(this, make_bucket_key(buck)).observe(buck_vers)) {
+                return sel_abort;
+            }
+            return { true, false, 0, nullptr };
+        }
+    }
+
+    // Declared read-only transactions read the snapshot at the read tid
+    // directly. Nothing is left in the tset: such a transaction has no
+    // writes to observe and nothing to validate at commit.
+    sel_return_type
+    select_row_read_only(uintptr_t rid, RowAccess access) {
+        auto e = reinterpret_cast<internal_elem*>(rid);
+        history_type *h = e->row.find(txn_read_tid());
+
+        if (h->status_is(UNUSED) || h->status_is(DELETED))
+            return { true, false, 0, nullptr };
+        if (access == RowAccess::None)
+            return { true, true, rid, nullptr };
+#if SAFE_FLATTEN
+        auto vp = h->vp_safe_flatten();
+        if (vp == nullptr)
+            return { false, false, 0, nullptr };
+#else
+        auto vp = h->vp();
+        assert(vp);
+#endif
+        return { true, true, rid, vp };
+    }
+
+    // The row at the read tid, or nullptr if there was none
+    const value_type *snapshot_value(internal_elem *e) {
+        history_type *h = e->row.find(txn_read_tid());
+        if (h->status_is(UNUSED) || h->status_is(DELETED))
+            return nullptr;
+#if SAFE_FLATTEN
+        value_type *vp;
+        while ((vp = h->vp_safe_flatten()) == nullptr)
+            relax_fence();
+        return vp;
+#else
+        return h->vp();
+#endif
+    }
+
     // remove a k-v node during transactions (with locks)
     void _remove(internal_elem *el) {
         bucket_entry& buck = map_[find_bucket_idx(el->key)];
@@ -1,3 +1,7 @@
+#include <atomic>
+#include <chrono>
+#include <unistd.h>
+
 #include "clp.h"
 
 #include "DB_profiler.hh"
@@ -6,20 +10,58 @@
 
 double db_params::constants::processor_tsc_frequency;
 
-enum { opt_nthrs = 1, opt_time };
+enum { opt_nthrs = 1, opt_time, opt_period, opt_minperiod, opt_backlog, opt_coop, opt_sample };
 
 struct cmd_params {
     int num_threads;
     double time_limit;
-
-    cmd_params() : num_threads(1), time_limit(10.0) {}
+    int epoch_period;      // us; 0 keeps the default
+    int epoch_min_period;  // us; 0 keeps the default
+    int backlog_limit;     // 0 keeps the default
+    bool cooperative;
+    int sample_ms;         // 0 disables the memory curve
+
+    cmd_params() : num_threads(1), time_limit(10.0), epoch_period(0),
+                   epoch_min_period(0), backlog_limit(0), cooperative(false),
+                   sample_ms(100) {}
 };
 
 static const Clp_Option options[] = {
     { "nthreads", 't', opt_nthrs, Clp_ValInt, Clp_Optional },
     { "time", 'l', opt_time, Clp_ValDouble, Clp_Optional },
+    { "epoch-period", 0, opt_period, Clp_ValInt, Clp_Optional },
+    { "epoch-min-period", 0, opt_minperiod, Clp_ValInt, Clp_Optional },
+    { "backlog-limit", 0, opt_backlog, Clp_ValInt, Clp_Optional },
+    { "cooperative", 'c', opt_coop, 0, Clp_Negate },
+    { "sample", 's', opt_sample, Clp_ValInt, Clp_Optional },
 };
 
+static long resident_kb() {
+    long size = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &size, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Prints one line of the memory curve every @sample_ms until @running clears
+static void sample_memory(int sample_ms, const std::atomic<bool>& running) {
+    using clock = std::chrono::steady_clock;
+    auto begin = clock::now();
+    printf("%8s %10s %10s %10s %10s\n", "ms", "epoch", "period_us", "backlog", "rss_kb");
+    while (running.load()) {
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(clock::now() - begin).count();
+        printf("%8ld %10llu %10u %10zu %10ld\n", (long) ms,
+               (unsigned long long) Transaction::global_epochs.global_epoch.load(),
+               Transaction::get_epoch_period(), Transaction::rcu_backlog(), resident_kb());
+        fflush(stdout);
+        usleep(sample_ms * 1000);
+    }
+}
+
 int main(int argc, const char * const *argv) {
     typedef db_params::db_default_params params;
     typedef garbage_bench::garbage_runner<params> r_type_nopred;
@@ -42,6 +84,21 @@ int main(int argc, const char * const *argv) {
         case opt_time:
             p.time_limit = clp->val.d;
             break;
+        case opt_period:
+            p.epoch_period = clp->val.i;
+            break;
+        case opt_minperiod:
+            p.epoch_min_period = clp->val.i;
+            break;
+        case opt_backlog:
+            p.backlog_limit = clp->val.i;
+            break;
+        case opt_coop:
+            p.cooperative = !clp->negated;
+            break;
+        case opt_sample:
+            p.sample_ms = clp->val.i;
+            break;
         default:
             ret_code = 1;
             clp_stop = true;
@@ -70,14 +127,32 @@ int main(int argc, const char * const *argv) {
 
     size_t ncommits;
 
-    pthread_t advancer;
-    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
-    pthread_detach(advancer);
+    if (p.epoch_period > 0)
+        Transaction::set_epoch_cycle(p.epoch_period);
+    if (p.epoch_min_period > 0)
+        Transaction::set_epoch_cycle_min(p.epoch_min_period);
+    if (p.backlog_limit > 0)
+        Transaction::set_rcu_backlog_limit(p.backlog_limit);
+    Transaction::set_cooperative_epochs(p.cooperative);
+    if (!p.cooperative) {
+        pthread_t advancer;
+        pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+        pthread_detach(advancer);
+    }
+
+    std::atomic<bool> running(true);
+    std::thread sampler;
+    if (p.sample_ms > 0)
+        sampler = std::thread(sample_memory, p.sample_ms, std::cref(running));
 
     prof.start(Profiler::perf_mode::record);
     ncommits = r_nopred.run();
     prof.finish(ncommits);
 
+    running = false;
+    if (sampler.joinable())
+        sampler.join();
+
     auto counters = Transaction::txp_counters_combined();
     auto ndreq = counters.p(txp_rcu_del_req);
     auto ndareq = counters.p(txp_rcu_delarr_req);
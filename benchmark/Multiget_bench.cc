@@ -0,0 +1,228 @@
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <random>
+
+#include "clp.h"
+#include "DB_index.hh"
+#include "DB_params.hh"
+#include "DB_profiler.hh"
+#include "PlatformFeatures.hh"
+
+// Microbenchmark for batched point lookups (unordered_index::select_rows).
+// Read-only transactions look up a batch of uniformly random keys in a hash
+// table much larger than the last-level cache, either one key at a time or
+// all at once. The difference is the gain from memory-level parallelism.
+
+namespace mget {
+
+struct mget_key {
+    mget_key() = default;
+    mget_key(uint64_t k) : k(k) {}
+    bool operator==(const mget_key& other) const {
+        return k == other.k;
+    }
+    bool operator!=(const mget_key& other) const {
+        return !(*this == other);
+    }
+    operator lcdf::Str() const {
+        return lcdf::Str((const char *)this, sizeof(*this));
+    }
+
+    uint64_t k;
+};
+
+struct mget_value {
+    enum class NamedColumn : int { value = 0 };
+
+    uint64_t value;
+    uint64_t payload[7];
+};
+
+}; // namespace mget
+
+namespace std {
+
+template <>
+struct hash<mget::mget_key> {
+    size_t operator() (const mget::mget_key& arg) const {
+        return arg.k;
+    }
+};
+
+};
+
+namespace mget {
+
+using namespace db_params;
+
+enum { opt_nthrs = 1, opt_time, opt_keys, opt_batch, opt_mget };
+
+static const Clp_Option options[] = {
+    { "nthreads",  't', opt_nthrs, Clp_ValInt,          Clp_Optional },
+    { "time",      'l', opt_time,  Clp_ValDouble,       Clp_Optional },
+    { "keys",      'k', opt_keys,  Clp_ValUnsignedLong, Clp_Optional },
+    { "batch",     'b', opt_batch, Clp_ValInt,          Clp_Optional },
+    { "multiget",  'm', opt_mget,  Clp_NoVal,           Clp_Negate| Clp_Optional },
+};
+
+static inline void print_usage(const char *argv_0) {
+    std::stringstream ss;
+    ss << "Usage of " << std::string(argv_0) << ":" << std::endl
+       << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
+       << "    Specify the number of threads (default 1)." << std::endl
+       << "  --time=<NUM> (or -l<NUM>)" << std::endl
+       << "    Specify the time (duration) for which the benchmark is run (default 5 seconds)." << std::endl
+       << "  --keys=<NUM> (or -k<NUM>)" << std::endl
+       << "    Specify the number of keys in the table (default 10 million)." << std::endl
+       << "  --batch=<NUM> (or -b<NUM>)" << std::endl
+       << "    Specify the number of keys looked up per transaction (default 16)." << std::endl
+       << "  --multiget (or -m)" << std::endl
+       << "    Look up all keys of a transaction with select_rows (default true);" << std::endl
+       << "    --no-multiget uses one select_row call per key." << std::endl;
+    std::cout << ss.str() << std::flush;
+}
+
+typedef bench::unordered_index<mget_key, mget_value, db_default_params> table_type;
+typedef table_type::sel_return_type sel_return_type;
+
+static constexpr size_t max_batch = 256;
+static constexpr size_t keys_per_thread = 1 << 20;
+
+void prepopulation_thread(table_type& table, uint64_t key_begin, uint64_t key_end) {
+    for (uint64_t i = key_begin; i < key_end; ++i)
+        table.nontrans_put(mget_key(i), mget_value{i, {}});
+}
+
+void runner_thread(int thread_id, table_type& table, uint64_t nkeys, int batch, bool multiget,
+                   double time_limit, uint64_t start_t, uint64_t& txn_cnt) {
+    ::TThread::set_id(thread_id);
+    set_affinity(thread_id);
+
+    std::mt19937_64 gen(thread_id);
+    std::uniform_int_distribution<uint64_t> dist(0, nkeys - 1);
+    std::vector<mget_key> keys(keys_per_thread);
+    for (auto& k : keys)
+        k = mget_key(dist(gen));
+
+    uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
+    uint64_t local_cnt = 0;
+    size_t pos = 0;
+    volatile uint64_t sum = 0;
+
+    while ((read_tsc() - start_t) < tsc_diff) {
+        if (pos + batch > keys.size())
+            pos = 0;
+        const mget_key *txn_keys = &keys[pos];
+
+        TRANSACTION {
+            sel_return_type rows[max_batch];
+            if (multiget) {
+                TXN_DO(table.select_rows(txn_keys, batch, bench::RowAccess::ObserveValue, rows));
+            } else {
+                for (int i = 0; i < batch; ++i) {
+                    rows[i] = table.select_row(txn_keys[i], bench::RowAccess::ObserveValue);
+                    TXN_DO(std::get<0>(rows[i]));
+                }
+            }
+            for (int i = 0; i < batch; ++i)
+                sum += std::get<3>(rows[i])->value;
+        } RETRY(true);
+
+        pos += batch;
+        ++local_cnt;
+    }
+
+    txn_cnt = local_cnt;
+}
+
+int execute(int argc, const char *const *argv) {
+    int num_threads = 1;
+    double time_limit = 5.0;
+    uint64_t nkeys = 10000000;
+    int batch = 16;
+    bool multiget = true;
+
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    int ret = 0;
+    int opt;
+    bool clp_stop = false;
+    while (!clp_stop && ((opt = Clp_Next(clp)) != Clp_Done)) {
+        switch (opt) {
+        case opt_nthrs:
+            num_threads = clp->val.i;
+            break;
+        case opt_time:
+            time_limit = clp->val.d;
+            break;
+        case opt_keys:
+            nkeys = clp->val.ul;
+            break;
+        case opt_batch:
+            batch = clp->val.i;
+            break;
+        case opt_mget:
+            multiget = !clp->negated;
+            break;
+        default:
+            print_usage(argv[0]);
+            ret = 1;
+            clp_stop = true;
+            break;
+        }
+    }
+    Clp_DeleteParser(clp);
+    if (ret != 0)
+        return ret;
+
+    always_assert(batch > 0 && (size_t)batch <= max_batch, "invalid batch size");
+
+    table_type table(nkeys);
+
+    std::cout << "Prepopulating table..." << std::endl;
+    {
+        static constexpr uint64_t nprepop = 16;
+        std::vector<std::thread> prepopulators;
+        uint64_t segment = (nkeys + nprepop - 1) / nprepop;
+        for (uint64_t begin = 0; begin < nkeys; begin += segment)
+            prepopulators.emplace_back(prepopulation_thread, std::ref(table), begin,
+                                       std::min(begin + segment, nkeys));
+        for (auto& t : prepopulators)
+            t.join();
+    }
+    std::cout << "Running " << (multiget ? "select_rows" : "select_row") << " with "
+              << batch << " keys per transaction." << std::endl;
+
+    bench::db_profiler prof(false/*don't spawn perf*/);
+    std::vector<std::thread> runners;
+    std::vector<uint64_t> txn_cnts(size_t(num_threads), 0);
+
+    prof.start(Profiler::perf_mode::record);
+    for (int i = 0; i < num_threads; ++i)
+        runners.emplace_back(runner_thread, i, std::ref(table), nkeys, batch, multiget,
+                             time_limit, prof.start_timestamp(), std::ref(txn_cnts[i]));
+    for (auto& t : runners)
+        t.join();
+
+    uint64_t total_txn_cnt = 0;
+    for (auto& cnt : txn_cnts)
+        total_txn_cnt += cnt;
+    prof.finish(total_txn_cnt);
+
+    return 0;
+}
+
+}; // namespace mget
+
+double db_params::constants::processor_tsc_frequency;
+
+int main(int argc, const char *const *argv) {
+    Sto::global_init();
+
+    auto cpu_freq = determine_cpu_freq();
+    if (cpu_freq == 0.0)
+        return 1;
+    db_params::constants::processor_tsc_frequency = cpu_freq;
+
+    return mget::execute(argc, argv);
+}
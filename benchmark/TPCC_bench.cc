@@ -28,6 +28,18 @@ const Clp_Option options[] = {
         { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "verbose",      'v', opt_verb,  Clp_NoVal,     Clp_Negate | Clp_Optional },
         { "mix",          'm', opt_mix,   Clp_ValInt,    Clp_Optional },
+        { "column-profile", 'f', opt_cprof, Clp_ValString, Clp_Optional },
+        { "log-dir",      'd', opt_logdir, Clp_ValString, Clp_Optional },
+        { "loggers",      'k', opt_nloggers, Clp_ValInt, Clp_Optional },
+        { "checkpoint",    0,  opt_ckptdir, Clp_ValString, Clp_Optional },
+        { "checkpoint-interval", 0, opt_ckptint, Clp_ValDouble, Clp_Optional },
+        { "checkpointers", 0,  opt_nckpt, Clp_ValInt,    Clp_Optional },
+        { "recover",       0,  opt_recover, Clp_NoVal,   Clp_Negate | Clp_Optional },
+        { "coroutines",    0,  opt_coro,  Clp_ValInt,    Clp_Optional },
+        { "deterministic", 0,  opt_det,   Clp_ValInt,    Clp_Optional },
+        { "partitioned",   0,  opt_part,  Clp_NoVal,     Clp_Negate | Clp_Optional },
+        { "remote-percent", 0, opt_remote, Clp_ValInt,   Clp_Optional },
+        { "flatten-depth", 0,  opt_flat,  Clp_ValInt,    Clp_Optional },
 };
 
 const char* workload_mix_names[] = { "Full", "NO-only", "NO+P-only" };
@@ -42,7 +54,7 @@ void print_usage(const char *argv_0) {
     ss << "Usage of " << std::string(argv_0) << ":" << std::endl
        << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
        << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
-       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode" << std::endl
+       << "      default, opaque, hybrid, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode" << std::endl
        << "  --nwarehouses=<NUM> (or -w<NUM>)" << std::endl
        << "    Specify the number of warehouses (default 1)." << std::endl
        << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
@@ -67,7 +79,44 @@ void print_usage(const char *argv_0) {
        << "    Specify workload mix:" << std::endl
        << "    0. Full mix (default)" << std::endl
        << "    1. New-order only" << std::endl
-       << "    2. New-order plus Payment only" << std::endl;
+       << "    2. New-order plus Payment only" << std::endl
+       << "  --column-profile=<FILE> (or -f<FILE>)" << std::endl
+       << "    Write per-table column access profile to FILE after the run (requires PROFILE_COLUMNS=1)." << std::endl
+       << "    The profile can be fed to the codegen (-p) to generate column groups." << std::endl
+       << "  --log-dir=<DIR> (or -d<DIR>)" << std::endl
+       << "    Write a redo log of every committed transaction to DIR (default off)." << std::endl
+       << "    Implies --gc; commits become durable once their epoch does, so use" << std::endl
+       << "    a short --gc-rate to keep acknowledgement latency low." << std::endl
+       << "  --loggers=<NUM> (or -k<NUM>)" << std::endl
+       << "    Number of logger threads, and log files, when logging (default 1)." << std::endl
+       << "  --checkpoint=<DIR>" << std::endl
+       << "    Checkpoint the database into DIR after loading it (needs an MVCC or the hybrid dbid)." << std::endl
+       << "  --checkpoint-interval=<NUM>" << std::endl
+       << "    Also take a checkpoint every NUM seconds while the benchmark runs (default 0, never)." << std::endl
+       << "    Compare throughput with and without to measure the cost of checkpointing." << std::endl
+       << "  --checkpointers=<NUM>" << std::endl
+       << "    Number of threads writing a checkpoint (default 1). Recovery uses --nthreads threads." << std::endl
+       << "  --recover" << std::endl
+       << "    Instead of loading the database, recover it from the latest checkpoint in the" << std::endl
+       << "    --checkpoint directory and the logs in --log-dir, then run the benchmark." << std::endl
+       << "  --coroutines=<NUM>" << std::endl
+       << "    Run NUM interleaved transactions per thread as coroutines; new-order prefetches" << std::endl
+       << "    the index entries of its rows while the others run (default 0, off). Each" << std::endl
+       << "    thread uses NUM TThread ids. Requires a build with COROUTINES=1." << std::endl
+       << "  --deterministic=<NUM>" << std::endl
+       << "    Run transactions in deterministic batches of NUM per thread, each scheduled by its" << std::endl
+       << "    declared read and write sets so that none abort (default 0, off). Works with any" << std::endl
+       << "    --dbid; needs --mix=1 or --mix=2." << std::endl
+       << "  --partitioned" << std::endl
+       << "    Lock each transaction's warehouses while it runs; new-orders and payments that touch" << std::endl
+       << "    only the thread's own warehouses then update in place without STO tracking, and the" << std::endl
+       << "    rest run as STO transactions (default false)." << std::endl
+       << "  --remote-percent=<NUM>" << std::endl
+       << "    Percentage of new-orders with a remotely supplied line and of payments for a remote" << std::endl
+       << "    customer (default: the TPC-C rates, 1% of order lines and 15% of payments)." << std::endl
+       << "  --flatten-depth=<NUM>" << std::endl
+       << "    Run a background thread that flattens the delta chain of a row every NUM commutative" << std::endl
+       << "    updates, so readers fold short chains (default 0, off). Needs an MVCC dbid." << std::endl;
 
     std::cout << ss.str() << std::flush;
 }
@@ -170,6 +219,12 @@ int main(int argc, const char *const *argv) {
             std::cerr << "Warning: No node tracking option for opaque versions." << std::endl;
         }
         break;
+    case db_params_id::Hybrid:
+        ret_code = tpcc_h(argc, argv);
+        if (node_tracking || enable_commute) {
+            std::cerr << "Warning: No node tracking or commute option for hybrid versions." << std::endl;
+        }
+        break;
     /*
     case db_params_id::TwoPL:
         ret_code = tpcc_access<db_2pl_params>::execute(argc, argv);
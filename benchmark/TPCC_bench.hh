@@ -21,6 +21,10 @@
 #include "DB_index.hh"
 #include "DB_params.hh"
 #include "DB_profiler.hh"
+#include "DB_checkpoint.hh"
+#include "DB_deterministic.hh"
+#include "DB_partition.hh"
+#include "TCoroutine.hh"
 #include "PlatformFeatures.hh"
 
 #define A_GEN_CUSTOMER_ID           1023
@@ -32,7 +36,9 @@
 // @section: clp parser definitions
 enum {
     opt_dbid = 1, opt_nwhs, opt_nthrs, opt_time, opt_perf, opt_pfcnt, opt_gc,
-    opt_gr, opt_node, opt_comm, opt_verb, opt_mix
+    opt_gr, opt_node, opt_comm, opt_verb, opt_mix, opt_cprof, opt_logdir, opt_nloggers,
+    opt_ckptdir, opt_ckptint, opt_nckpt, opt_recover, opt_coro, opt_det,
+    opt_part, opt_remote, opt_flat
 };
 
 extern const char* workload_mix_names[];
@@ -48,6 +54,7 @@ extern int tpcc_dcn(int, char const* const*);
 
 extern int tpcc_o(int, char const* const*);
 extern int tpcc_oc(int, char const* const*);
+extern int tpcc_h(int, char const* const*);
 
 extern int tpcc_m(int, char const* const*);
 extern int tpcc_mc(int, char const* const*);
@@ -189,6 +196,14 @@ public:
     explicit inline tpcc_db(const std::string& db_file_name) = delete;
     inline ~tpcc_db();
     void thread_init_all();
+    // Number the tables for TLog, in a fixed order, so that a log can be
+    // replayed into a database built with the same warehouse count
+    void set_log_ids();
+    template <typename F>
+    void for_each_table(F f);
+    // Order ids are handed out from memory; after recovery, continue each
+    // district's from its last recovered order
+    void recover_order_ids();
 
     int num_warehouses() const {
         return static_cast<int>(num_whs_);
@@ -271,6 +286,14 @@ public:
     tpcc_delivery_queue& delivery_queue() {
         return dlvy_queue_;
     }
+    // Partitioned execution: one partition per warehouse, numbered by
+    // warehouse id. Null unless enabled.
+    void enable_partition_locks() {
+        partition_locks_.reset(new bench::db_partition_locks(num_whs_ + 1));
+    }
+    bench::db_partition_locks* partition_locks() {
+        return partition_locks_.get();
+    }
 
 private:
     size_t num_whs_;
@@ -305,6 +328,7 @@ private:
 
     tpcc_oid_generator oid_gen_;
     tpcc_delivery_queue dlvy_queue_;
+    std::unique_ptr<bench::db_partition_locks> partition_locks_;
 
     friend class tpcc_access<DBParams>;
 };
@@ -321,9 +345,13 @@ public:
         stock_level
     };
 
-    tpcc_runner(int id, tpcc_db<DBParams>& database, uint64_t w_start, uint64_t w_end, uint64_t w_own, int mix)
+    // @remote_pct, if not negative, is the percentage of new-orders and
+    // payments that involve a remote warehouse, in place of the TPC-C
+    // rates (1% of order lines, 15% of payments)
+    tpcc_runner(int id, tpcc_db<DBParams>& database, uint64_t w_start, uint64_t w_end, uint64_t w_own, int mix,
+                int remote_pct = -1)
         : ig(id, database.num_warehouses()), db(database), mix(mix), runner_id(id),
-          w_id_start(w_start), w_id_end(w_end), w_id_owned(w_own) {}
+          w_id_start(w_start), w_id_end(w_end), w_id_owned(w_own), remote_pct(remote_pct) {}
 
     inline txn_type next_transaction() {
         uint64_t x = ig.random(1, 100);
@@ -348,11 +376,69 @@ public:
             return txn_type::payment;
     }
 
+    // Inputs of a new-order transaction, drawn before it runs
+    struct neworder_input {
+        uint64_t q_w_id;
+        uint64_t q_d_id;
+        uint64_t q_c_id;
+        uint64_t num_items;
+        uint64_t ol_i_ids[15];
+        uint64_t ol_supply_w_ids[15];
+        uint64_t ol_quantities[15];
+        uint32_t o_entry_d;
+        bool all_local;
+    };
+
+    struct payment_input {
+        uint64_t q_w_id;
+        uint64_t q_d_id;
+        uint64_t q_c_w_id;
+        uint64_t q_c_d_id;
+        uint64_t q_c_id;
+        std::string last_name;
+        bool by_name;
+        int64_t h_amount;
+        uint32_t h_date;
+    };
+
+    inline void gen_neworder_input(neworder_input& in);
     inline void run_txn_neworder();
+    inline void run_txn_neworder(const neworder_input& in);
+    inline void gen_payment_input(payment_input& in);
     inline void run_txn_payment();
+    inline void run_txn_payment(const payment_input& in);
     inline void run_txn_orderstatus();
+    inline void run_txn_orderstatus(uint64_t q_w_id);
     inline void run_txn_delivery(uint64_t wid);
     inline void run_txn_stocklevel();
+    inline void run_txn_stocklevel(uint64_t q_w_id);
+
+    // Partitioned execution (tpcc_db::enable_partition_locks): each
+    // transaction runs under the locks of its warehouses. New-orders and
+    // payments whose warehouses are all this runner's update in place
+    // (run_local_*, which return false after rolling back if they fail);
+    // the rest run as STO transactions.
+    inline bool run_local_neworder(const neworder_input& in);
+    inline bool run_local_payment(const payment_input& in);
+    template <typename F>
+    inline void run_partitioned(uint64_t q_w_id, F f);
+
+    // A new-order or payment with its input generated ahead of time, for
+    // deterministic execution
+    struct det_txn {
+        txn_type type;
+        neworder_input no;
+        payment_input pm;
+    };
+    inline void gen_det_txn(det_txn& t, bench::det_locks& locks);
+    inline void run_det_txn(const det_txn& t);
+#if STO_COROUTINES
+    // Run one transaction of @type as a coroutine. New-order prefetches the
+    // index entries of its rows and suspends before it starts; the others
+    // run straight through.
+    inline TCoroutine::task run_txn_coro(txn_type type, uint64_t delivery_w_id);
+    inline bool prefetch_neworder(const neworder_input& in, int step);
+#endif
 
     inline uint64_t owned_warehouse() const {
         return w_id_owned;
@@ -366,6 +452,8 @@ private:
     uint64_t w_id_start;
     uint64_t w_id_end;
     uint64_t w_id_owned;
+    int remote_pct;
+    bench::db_undo_log undo;
 
     friend class tpcc_access<DBParams>;
 };
@@ -448,52 +536,93 @@ tpcc_db<DBParams>::~tpcc_db() {
 }
 
 template <typename DBParams>
-void tpcc_db<DBParams>::thread_init_all() {
-    tbl_its_->thread_init();
+template <typename F>
+void tpcc_db<DBParams>::for_each_table(F f) {
+    f(*tbl_its_);
 #if TPCC_SPLIT_TABLE
-    tbl_whs_const_.thread_init();
-    tbl_whs_comm_.thread_init();
+    f(tbl_whs_const_);
+    f(tbl_whs_comm_);
     for (auto& t : tbl_dts_const_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_dts_comm_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_cus_const_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_cus_comm_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_ods_const_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_ods_comm_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_ols_const_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_ols_comm_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_sts_const_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_sts_comm_)
-        t.thread_init();
+        f(t);
 #else
-    tbl_whs_.thread_init();
+    f(tbl_whs_);
     for (auto& t : tbl_dts_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_cus_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_ods_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_ols_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_sts_)
-        t.thread_init();
+        f(t);
 #endif
     for (auto& t : tbl_cni_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_oci_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_nos_)
-        t.thread_init();
+        f(t);
     for (auto& t : tbl_hts_)
-        t.thread_init();
+        f(t);
+}
+
+template <typename DBParams>
+void tpcc_db<DBParams>::thread_init_all() {
+    for_each_table([](auto& t) { t.thread_init(); });
+}
+
+template <typename DBParams>
+void tpcc_db<DBParams>::set_log_ids() {
+    uint32_t id = 0;
+    for_each_table([&id](auto& t) { t.set_log_id(++id); });
+}
+
+template <typename DBParams>
+void tpcc_db<DBParams>::recover_order_ids() {
+    TThread::set_id(0);
+    thread_init_all();
+    for (uint64_t wid = 1; wid <= num_whs_; ++wid) {
+        for (uint64_t did = 1; did <= NUM_DISTRICTS_PER_WAREHOUSE; ++did) {
+            uint64_t last_oid = 0;
+            auto scan_callback = [&] (const order_key& key, const auto&) -> bool {
+                last_oid = bswap(key.o_id);
+                return true;
+            };
+            order_key k0(wid, did, 0);
+            order_key k1(wid, did, std::numeric_limits<uint64_t>::max());
+            TRANSACTION_E {
+                Sto::declare_read_only();
+#if TPCC_SPLIT_TABLE
+                bool success = tbl_orders_const(wid)
+#else
+                bool success = tbl_orders(wid)
+#endif
+                        .template range_scan<decltype(scan_callback), true/*reverse*/>(k1, k0, scan_callback, RowAccess::None, false, 1);
+                TXN_DO_E(success);
+            } RETRY_E(true);
+            if (last_oid)
+                oid_gen_.set(wid, did, last_oid + 1);
+        }
+    }
 }
 
 // @section: db prepopulation functions
@@ -906,20 +1035,70 @@ public:
         always_assert(r == 0, "pthread_barrier_destroy failed");
     }
 
+#if STO_COROUTINES
+    // The runner loop with @nslots transactions in flight; returns the
+    // number executed
+    static uint64_t run_coroutines(tpcc_db<DBParams>& db, tpcc_runner<DBParams>& runner, int nslots,
+                                   uint64_t start_t, uint64_t tsc_diff, uint64_t w_start, uint64_t w_end) {
+        typedef typename tpcc_runner<DBParams>::txn_type txn_type;
+        TCoroutine::scheduler sched(runner.runner_id * nslots, nslots);
+        return sched.run([&] (int) -> TCoroutine::task {
+            while ((read_tsc() - start_t) < tsc_diff) {
+                // Deliveries for the owned warehouse go first. Each is taken
+                // off the queue here, so no two slots run the same one.
+                auto own_w_id = runner.owned_warehouse();
+                if (own_w_id != 0 && db.delivery_queue().read(own_w_id) > 0) {
+                    db.delivery_queue().dequeue(own_w_id, 1);
+                    return runner.run_txn_coro(txn_type::delivery, own_w_id);
+                }
+                txn_type t = runner.next_transaction();
+                if (t != txn_type::delivery)
+                    return runner.run_txn_coro(t, 0);
+                // enqueued for the owner thread, not executed
+                db.delivery_queue().enqueue(runner.ig.random(w_start, w_end));
+            }
+            return {};
+        });
+    }
+#endif
+
+    typedef bench::det_executor<typename tpcc_runner<DBParams>::det_txn> det_executor_type;
+
     static void tpcc_runner_thread(tpcc_db<DBParams>& db, db_profiler& prof, int runner_id, uint64_t w_start,
-                                   uint64_t w_end, uint64_t w_own, double time_limit, int mix, uint64_t& txn_cnt) {
-        tpcc_runner<DBParams> runner(runner_id, db, w_start, w_end, w_own, mix);
+                                   uint64_t w_end, uint64_t w_own, double time_limit, int mix, int remote_pct,
+                                   int nslots, det_executor_type* det, uint64_t& txn_cnt) {
+        tpcc_runner<DBParams> runner(runner_id, db, w_start, w_end, w_own, mix, remote_pct);
         typedef typename tpcc_runner<DBParams>::txn_type txn_type;
 
         uint64_t local_cnt = 0;
 
-        ::TThread::set_id(runner_id);
+        // coroutine slots take TThread ids runner_id * nslots and up
+        ::TThread::set_id(nslots > 0 ? runner_id * nslots : runner_id);
         set_affinity(runner_id);
         db.thread_init_all();
 
         uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
         auto start_t = prof.start_timestamp();
 
+#if STO_COROUTINES
+        if (nslots > 0) {
+            txn_cnt = run_coroutines(db, runner, nslots, start_t, tsc_diff, w_start, w_end);
+            return;
+        }
+#endif
+
+        if (det) {
+            typedef typename tpcc_runner<DBParams>::det_txn det_txn;
+            txn_cnt = det->run(runner_id, [&runner] (det_txn& t, bench::det_locks& locks) {
+                runner.gen_det_txn(t, locks);
+            }, [&runner] (const det_txn& t) {
+                runner.run_det_txn(t);
+            }, [start_t, tsc_diff] () {
+                return (read_tsc() - start_t) >= tsc_diff;
+            });
+            return;
+        }
+
         while (true) {
             // Executed enqueued delivery transactions, if any
             auto own_w_id = runner.owned_warehouse();
@@ -930,7 +1109,9 @@ public:
 
                 if (num_to_run > 0) {
                     for (num_run = 0; num_run < num_to_run; ++num_run) {
-                        runner.run_txn_delivery(own_w_id);
+                        runner.run_partitioned(own_w_id, [&] () {
+                            runner.run_txn_delivery(own_w_id);
+                        });
                         if ((read_tsc() - start_t) >= tsc_diff) {
                             stop = true;
                             ++num_run;
@@ -986,7 +1167,8 @@ public:
     }
 
     static uint64_t run_benchmark(tpcc_db<DBParams>& db, db_profiler& prof, int num_runners,
-                                  double time_limit, int mix, const bool verbose) {
+                                  double time_limit, int mix, int remote_pct, int nslots,
+                                  unsigned det_batch, const bool verbose) {
         int q = db.num_warehouses() / num_runners;
         int r = db.num_warehouses() % num_runners;
 
@@ -998,6 +1180,10 @@ public:
             return (rid >= nwh) ? 0 : (rid + 1);
         };
 
+        std::unique_ptr<det_executor_type> det;
+        if (det_batch > 0)
+            det.reset(new det_executor_type(num_runners, det_batch));
+
         if (q == 0) {
             q = (num_runners + db.num_warehouses() - 1) / db.num_warehouses();
             int qq = q;
@@ -1011,7 +1197,8 @@ public:
                     fprintf(stdout, "runner %d: [%d, %d], own: %d\n", i, wid, wid, calc_own_w_id(i));
                 }
                 runner_thrs.emplace_back(tpcc_runner_thread, std::ref(db), std::ref(prof),
-                                         i, wid, wid, calc_own_w_id(i), time_limit, mix, std::ref(txn_cnts[i]));
+                                         i, wid, wid, calc_own_w_id(i), time_limit, mix, remote_pct,
+                                         nslots, det.get(), std::ref(txn_cnts[i]));
             }
         } else {
             int last_xend = 1;
@@ -1027,7 +1214,7 @@ public:
                 }
                 runner_thrs.emplace_back(tpcc_runner_thread, std::ref(db), std::ref(prof),
                                          i, last_xend, next_xend - 1, calc_own_w_id(i), time_limit, mix,
-                                         std::ref(txn_cnts[i]));
+                                         remote_pct, nslots, det.get(), std::ref(txn_cnts[i]));
                 last_xend = next_xend;
             }
 
@@ -1055,6 +1242,18 @@ public:
         bool enable_gc = false;
         unsigned gc_rate = Transaction::get_epoch_cycle();
         bool verbose = false;
+        const char *column_profile_file = nullptr;
+        const char *log_dir = nullptr;
+        int num_loggers = 1;
+        const char *checkpoint_dir = nullptr;
+        double checkpoint_interval = 0;
+        int num_checkpointers = 1;
+        bool recover = false;
+        int num_coroutines = 0;
+        int det_batch = 0;
+        bool partitioned = false;
+        int remote_pct = -1;
+        int flatten_depth = 0;
 
         Clp_Parser *clp = Clp_NewParser(argc, argv, noptions, options);
 
@@ -1098,6 +1297,47 @@ public:
                         mix = 0;
                     }
                     break;
+                case opt_cprof:
+                    column_profile_file = clp->val.s;
+                    break;
+                case opt_logdir:
+                    log_dir = clp->val.s;
+                    break;
+                case opt_nloggers:
+                    num_loggers = clp->val.i;
+                    break;
+                case opt_ckptdir:
+                    checkpoint_dir = clp->val.s;
+                    break;
+                case opt_ckptint:
+                    checkpoint_interval = clp->val.d;
+                    break;
+                case opt_nckpt:
+                    num_checkpointers = clp->val.i;
+                    break;
+                case opt_recover:
+                    recover = !clp->negated;
+                    break;
+                case opt_coro:
+                    num_coroutines = clp->val.i;
+                    break;
+                case opt_det:
+                    det_batch = clp->val.i;
+                    break;
+                case opt_part:
+                    partitioned = !clp->negated;
+                    break;
+                case opt_remote:
+                    remote_pct = clp->val.i;
+                    if (remote_pct > 100 || remote_pct < 0) {
+                        std::cerr << "--remote-percent must be between 0 and 100" << std::endl;
+                        ret = 1;
+                        clp_stop = true;
+                    }
+                    break;
+                case opt_flat:
+                    flatten_depth = clp->val.i;
+                    break;
                 default:
                     ::print_usage(argv[0]);
                     ret = 1;
@@ -1125,12 +1365,63 @@ public:
                       << (counter_mode ? "counter" : "record") << " mode" << std::endl;
         }
 
+        if (recover && !checkpoint_dir) {
+            std::cerr << "--recover needs --checkpoint" << std::endl;
+            return 1;
+        }
+        if (checkpoint_dir && !DBParams::MVCC && !DBParams::Hybrid) {
+            std::cerr << "Checkpoints need snapshots: use an MVCC or the hybrid dbid" << std::endl;
+            return 1;
+        }
+        if (num_coroutines > 0 && !STO_COROUTINES) {
+            std::cerr << "--coroutines requires a build with COROUTINES=1" << std::endl;
+            return 1;
+        }
+        if (det_batch > 0 && (mix == 0 || num_coroutines > 0)) {
+            std::cerr << "--deterministic needs --mix=1 or --mix=2 and no --coroutines" << std::endl;
+            return 1;
+        }
+        if (partitioned && (det_batch > 0 || num_coroutines > 0 || log_dir || checkpoint_dir)) {
+            // partition-local updates are neither logged nor versioned
+            std::cerr << "--partitioned cannot be combined with --deterministic, --coroutines,"
+                      << " --log-dir or --checkpoint" << std::endl;
+            return 1;
+        }
+        if (flatten_depth > 0 && !DBParams::MVCC) {
+            std::cerr << "--flatten-depth needs an MVCC dbid" << std::endl;
+            return 1;
+        }
+        always_assert(size_t(num_warehouses) <= tpcc_delivery_queue::max_whs, "too many warehouses");
+        // worker TThread ids, then the checkpointers', then the flattener's
+        int num_worker_ids = num_threads * std::max(num_coroutines, 1);
+        always_assert(num_worker_ids + 2 + num_checkpointers <= MAX_THREADS, "too many threads");
+
         db_profiler prof(spawn_perf);
         tpcc_db<DBParams> db(num_warehouses);
+        bench::db_checkpointer checkpointer(DBParams::MVCC, [&db] () { db.thread_init_all(); });
+        if (log_dir || checkpoint_dir)
+            db.set_log_ids();
+        if (checkpoint_dir)
+            db.for_each_table([&checkpointer] (auto& t) { checkpointer.add(t); });
+        if (partitioned)
+            db.enable_partition_locks();
+
+        if (recover) {
+            std::cout << "Recovering database..." << std::endl;
+            if (!checkpointer.recover(checkpoint_dir, log_dir ? log_dir : "", num_threads, std::cout))
+                return 1;
+            db.recover_order_ids();
+            std::cout << "Recovery complete." << std::endl;
+        } else {
+            std::cout << "Prepopulating database..." << std::endl;
+            prepopulate_db(db);
+            std::cout << "Prepopulation complete." << std::endl;
+        }
 
-        std::cout << "Prepopulating database..." << std::endl;
-        prepopulate_db(db);
-        std::cout << "Prepopulation complete." << std::endl;
+        if (log_dir) {
+            // log epochs become durable only as the global epoch advances
+            enable_gc = true;
+        }
 
         std::thread advancer;
         std::cout << "Garbage collection: ";
@@ -1143,10 +1434,73 @@ public:
         }
         std::cout << std::endl << std::flush;
 
+        // The log starts empty, so it must begin where a checkpoint ends:
+        // the loaded (or recovered) database is checkpointed first.
+        if (checkpoint_dir) {
+            TCheckpoint::stats st;
+            if (!checkpointer.checkpoint(checkpoint_dir, num_checkpointers, num_worker_ids, st))
+                return 1;
+            TCheckpoint::print_stats(std::cout, "checkpoint", st);
+        }
+        if (log_dir) {
+            std::cout << "Logging to " << log_dir << " with " << num_loggers << " logger(s)" << std::endl;
+            if (!TLog::start(log_dir, num_loggers))
+                return 1;
+        }
+
+        std::atomic<bool> checkpoints_done(false);
+        std::thread checkpoint_thread;
+        if (checkpoint_dir && checkpoint_interval > 0)
+            checkpoint_thread = std::thread([&] () {
+                while (true) {
+                    for (double slept = 0; slept < checkpoint_interval && !checkpoints_done; slept += 0.01)
+                        usleep(10000);
+                    if (checkpoints_done)
+                        break;
+                    TCheckpoint::stats st;
+                    if (!checkpointer.checkpoint(checkpoint_dir, num_checkpointers, num_worker_ids, st)) {
+                        std::cerr << "Checkpoint failed" << std::endl;
+                        break;
+                    }
+                    TCheckpoint::print_stats(std::cout, "checkpoint", st);
+                }
+            });
+
+        if (flatten_depth > 0) {
+            std::cout << "Flattening delta chains every " << flatten_depth << " deltas" << std::endl;
+            MvFlattener::set_depth(flatten_depth);
+            MvFlattener::start(num_worker_ids + num_checkpointers);
+        }
+
         prof.start(profiler_mode);
-        auto num_trans = run_benchmark(db, prof, num_threads, time_limit, mix, verbose);
+        auto num_trans = run_benchmark(db, prof, num_threads, time_limit, mix, remote_pct,
+                                       num_coroutines, std::max(det_batch, 0), verbose);
         prof.finish(num_trans);
 
+        if (flatten_depth > 0) {
+            MvFlattener::stop();
+            MvFlattener::print_stats(std::cout);
+        }
+
+        if (checkpoint_thread.joinable()) {
+            checkpoints_done = true;
+            checkpoint_thread.join();
+        }
+
+        if (log_dir) {
+            TLog::stop();
+            TLog::print_stats(std::cout);
+        }
+
+        if (column_profile_file != nullptr) {
+            if (!BENCH_PROFILE_COLUMNS)
+                std::cout << "Warning: column profiling not compiled in (build with PROFILE_COLUMNS=1)" << std::endl;
+            else if (!column_profile_base::dump(column_profile_file))
+                std::cerr << "Failed to write column profile to " << column_profile_file << std::endl;
+            else
+                std::cout << "Column profile written to " << column_profile_file << std::endl;
+        }
+
         size_t remaining_deliveries = 0;
         for (int wh = 1; wh <= db.num_warehouses(); wh++) {
             remaining_deliveries += db.delivery_queue().read(wh);
@@ -26,35 +26,23 @@ using stock_value = tpcc::stock_value;
 using tpcc::c_data_info;
 
 template <>
-class Commutator<warehouse_value> {
+class Commutator<warehouse_value>
+    : public on_field<warehouse_value, uint64_t, &warehouse_value::w_ytd, add<uint64_t>> {
 public:
     Commutator() = default;
 
-    explicit Commutator(int64_t delta_ytd) : delta_ytd(delta_ytd) {}
-
-    warehouse_value& operate(warehouse_value &w) const {
-        w.w_ytd += (uint64_t)delta_ytd;
-        return w;
-    }
-
-private:
-    int64_t delta_ytd;
+    explicit Commutator(int64_t delta_ytd)
+        : on_field(add<uint64_t>((uint64_t)delta_ytd)) {}
 };
 
 template <>
-class Commutator<district_value> {
+class Commutator<district_value>
+    : public on_field<district_value, int64_t, &district_value::d_ytd, add<int64_t>> {
 public:
     Commutator() = default;
 
-    explicit Commutator(int64_t delta_ytd) : delta_ytd(delta_ytd) {}
-
-    district_value& operate(district_value &d) const {
-        d.d_ytd += delta_ytd;
-        return d;
-    }
-
-private:
-    int64_t delta_ytd;
+    explicit Commutator(int64_t delta_ytd)
+        : on_field(add<int64_t>(delta_ytd)) {}
 };
 
 /*
@@ -26,7 +26,7 @@ using namespace bench;
 
 class tpcc_oid_generator {
 public:
-    static constexpr size_t max_whs = 32;
+    static constexpr size_t max_whs = 1024;
     static constexpr size_t max_dts = 16;
 
     tpcc_oid_generator() {
@@ -45,13 +45,17 @@ public:
         return oid_gens[wid % max_whs][did % max_dts];
     }
 
+    void set(uint64_t wid, uint64_t did, uint64_t next_oid) {
+        oid_gens[wid % max_whs][did % max_dts] = next_oid;
+    }
+
 private:
     uint64_t oid_gens[max_whs][max_dts];
 };
 
 class tpcc_delivery_queue {
 public:
-    static constexpr size_t max_whs = 32;
+    static constexpr size_t max_whs = 1024;
 
     tpcc_delivery_queue() {
         bzero(num_enqueued, sizeof(num_enqueued));
@@ -101,7 +105,8 @@ struct warehouse_const_value {
                                    w_city,
                                    w_state,
                                    w_zip,
-                                   w_tax };
+                                   w_tax,
+                                   COLCOUNT };
 
     var_string<10> w_name;
     var_string<20> w_street_1;
@@ -113,7 +118,7 @@ struct warehouse_const_value {
 };
 
 struct warehouse_comm_value {
-    enum class NamedColumn : int { w_ytd = 0 };
+    enum class NamedColumn : int { w_ytd = 0, COLCOUNT };
 
     uint64_t       w_ytd;
 };
@@ -126,7 +131,8 @@ struct warehouse_value {
                                    w_state,
                                    w_zip,
                                    w_tax,
-                                   w_ytd };
+                                   w_ytd,
+                                   COLCOUNT };
 
     var_string<10> w_name;
     var_string<20> w_street_1;
@@ -168,7 +174,8 @@ struct district_const_value {
                                    d_city,
                                    d_state,
                                    d_zip,
-                                   d_tax };
+                                   d_tax,
+                                   COLCOUNT };
 
     var_string<10> d_name;
     var_string<20> d_street_1;
@@ -180,7 +187,7 @@ struct district_const_value {
 };
 
 struct district_comm_value {
-    enum class NamedColumn : int { d_ytd = 0 };
+    enum class NamedColumn : int { d_ytd = 0, COLCOUNT };
 
     int64_t d_ytd;
     // we use the separate oid generator for better semantics in transactions
@@ -195,7 +202,8 @@ struct district_value {
         d_state,
         d_zip,
         d_tax,
-        d_ytd };
+        d_ytd,
+        COLCOUNT };
 
     var_string<10> d_name;
     var_string<20> d_street_1;
@@ -249,7 +257,7 @@ struct customer_idx_key {
 };
 
 struct customer_idx_value {
-    enum class NamedColumn : int { c_ids = 0 };
+    enum class NamedColumn : int { c_ids = 0, COLCOUNT };
 
     // Default constructor is never directly called; it's included to make the
     // compiles happy with MVCC history element construction
@@ -303,7 +311,8 @@ struct customer_const_value {
                                    c_since,
                                    c_credit,
                                    c_credit_lim,
-                                   c_discount };
+                                   c_discount,
+                                   COLCOUNT };
 
     var_string<16>  c_first;
     fix_string<2>   c_middle;
@@ -325,7 +334,8 @@ struct customer_comm_value {
                                    c_ytd_payment,
                                    c_payment_cnt,
                                    c_delivery_cnt,
-                                   c_data };
+                                   c_data,
+                                   COLCOUNT };
 
     int64_t         c_balance;
     int64_t         c_ytd_payment;
@@ -354,7 +364,8 @@ struct customer_value {
         c_ytd_payment,
         c_payment_cnt,
         c_delivery_cnt,
-        c_data };
+        c_data,
+        COLCOUNT };
 
     var_string<16>  c_first;
     fix_string<2>   c_middle;
@@ -417,7 +428,8 @@ struct history_value {
                                    h_w_id,
                                    h_date,
                                    h_amount,
-                                   h_data };
+                                   h_data,
+                                   COLCOUNT };
 
     uint64_t       h_c_id;
     uint64_t       h_c_d_id;
@@ -492,7 +504,8 @@ struct order_const_value{
     enum class NamedColumn : int { o_c_id = 0,
                                    o_entry_d,
                                    o_ol_cnt,
-                                   o_all_local };
+                                   o_all_local,
+                                   COLCOUNT };
 
     uint64_t o_c_id;
     uint32_t o_entry_d;
@@ -501,7 +514,7 @@ struct order_const_value{
 };
 
 struct order_comm_value {
-    enum class NamedColumn : int { o_carrier_id = 0 };
+    enum class NamedColumn : int { o_carrier_id = 0, COLCOUNT };
 
     uint64_t o_carrier_id;
 };
@@ -511,7 +524,8 @@ struct order_value{
                                    o_carrier_id,
                                    o_entry_d,
                                    o_ol_cnt,
-                                   o_all_local };
+                                   o_all_local,
+                                   COLCOUNT };
 
     uint64_t o_c_id;
     uint64_t o_carrier_id;
@@ -558,7 +572,8 @@ struct orderline_const_value {
                                    ol_supply_w_id,
                                    ol_quantity,
                                    ol_amount,
-                                   ol_dist_info };
+                                   ol_dist_info,
+                                   COLCOUNT };
 
     uint64_t       ol_i_id;
     uint64_t       ol_supply_w_id;
@@ -568,7 +583,7 @@ struct orderline_const_value {
 };
 
 struct orderline_comm_value {
-    enum class NamedColumn : int { ol_delivery_d = 0 };
+    enum class NamedColumn : int { ol_delivery_d = 0, COLCOUNT };
 
     uint32_t ol_delivery_d;
 };
@@ -579,7 +594,8 @@ struct orderline_value {
                                    ol_delivery_d,
                                    ol_quantity,
                                    ol_amount,
-                                   ol_dist_info };
+                                   ol_dist_info,
+                                   COLCOUNT };
 
     uint64_t       ol_i_id;
     uint64_t       ol_supply_w_id;
@@ -593,6 +609,7 @@ struct orderline_value {
 // ITEM
 
 struct item_key {
+    item_key() = default;
     item_key(uint64_t id) {
         i_id = bswap(id);
     }
@@ -618,7 +635,8 @@ struct item_value {
     enum class NamedColumn : int { i_im_id = 0,
                                    i_price,
                                    i_name,
-                                   i_data };
+                                   i_data,
+                                   COLCOUNT };
 
     uint64_t       i_im_id;
     uint32_t       i_price;
@@ -629,6 +647,7 @@ struct item_value {
 // STOCK
 
 struct stock_key {
+    stock_key() = default;
     stock_key(uint64_t w, uint64_t i) {
         s_w_id = bswap(w);
         s_i_id = bswap(i);
@@ -655,7 +674,8 @@ struct stock_key {
 #if TPCC_SPLIT_TABLE
 struct stock_const_value {
     enum class NamedColumn : int { s_dists = 0,
-                                   s_data };
+                                   s_data,
+                                   COLCOUNT };
 
     fix_string<24> s_dists[NUM_DISTRICTS_PER_WAREHOUSE];
     var_string<50> s_data;
@@ -665,7 +685,8 @@ struct stock_comm_value {
     enum class NamedColumn : int { s_quantity = 0,
                                    s_ytd,
                                    s_order_cnt,
-                                   s_remote_cnt };
+                                   s_remote_cnt,
+                                   COLCOUNT };
 
     int32_t        s_quantity;
     uint32_t       s_ytd;
@@ -679,7 +700,8 @@ struct stock_value {
                                    s_order_cnt,
                                    s_remote_cnt,
                                    s_dists,
-                                   s_data };
+                                   s_data,
+                                   COLCOUNT };
 
     int32_t        s_quantity;
     uint32_t       s_ytd;
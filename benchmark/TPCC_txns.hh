@@ -10,48 +10,85 @@
 namespace tpcc {
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_neworder() {
-#if TABLE_FINE_GRAINED
-    typedef warehouse_value::NamedColumn wh_nc;
-    typedef district_value::NamedColumn dt_nc;
-    typedef customer_value::NamedColumn cu_nc;
-    typedef stock_value::NamedColumn st_nc;
-#endif
-
-    uint64_t q_w_id  = ig.random(w_id_start, w_id_end);
-    uint64_t q_d_id = ig.random(1, 10);
-    uint64_t q_c_id = ig.gen_customer_id();
-    uint64_t num_items = ig.random(5, 15);
+void tpcc_runner<DBParams>::gen_neworder_input(neworder_input& in) {
+    in.q_w_id  = ig.random(w_id_start, w_id_end);
+    in.q_d_id = ig.random(1, 10);
+    in.q_c_id = ig.gen_customer_id();
+    in.num_items = ig.random(5, 15);
     //uint64_t rbk = ig.random(1, 100); //XXX no rollbacks
 
-    uint64_t ol_i_ids[15];
-    uint64_t ol_supply_w_ids[15];
-    uint64_t ol_quantities[15];
+    in.o_entry_d = ig.gen_date();
 
-    uint32_t o_entry_d = ig.gen_date();
+    in.all_local = true;
 
-    bool all_local = true;
+    // with remote_pct set, one line of a remote order is supplied remotely
+    uint64_t remote_line = in.num_items;
+    if (remote_pct >= 0 && ig.num_warehouses() > 1 && ig.random(1, 100) <= uint64_t(remote_pct))
+        remote_line = ig.random(0, in.num_items - 1);
 
-    for (uint64_t i = 0; i < num_items; ++i) {
+    for (uint64_t i = 0; i < in.num_items; ++i) {
         uint64_t ol_i_id = ig.gen_item_id();
         //XXX no rollbacks
         //if ((i == (num_items - 1)) && rbk == 1)
         //    ol_i_ids[i] = 0;
         //else
-        ol_i_ids[i] = ol_i_id;
-
-        bool supply_from_remote = (ig.num_warehouses() > 1) && (ig.random(1, 100) == 1);
-        uint64_t ol_s_w_id = q_w_id;
+        in.ol_i_ids[i] = ol_i_id;
+
+        bool supply_from_remote;
+        if (remote_pct >= 0)
+            supply_from_remote = (i == remote_line);
+        else
+            supply_from_remote = (ig.num_warehouses() > 1) && (ig.random(1, 100) == 1);
+        uint64_t ol_s_w_id = in.q_w_id;
         if (supply_from_remote) {
             do {
                 ol_s_w_id = ig.random(1, ig.num_warehouses());
-            } while (ol_s_w_id == q_w_id);
-            all_local = false;
+            } while (ol_s_w_id == in.q_w_id);
+            in.all_local = false;
         }
-        ol_supply_w_ids[i] = ol_s_w_id;
+        in.ol_supply_w_ids[i] = ol_s_w_id;
 
-        ol_quantities[i] = ig.random(1, 10);
+        in.ol_quantities[i] = ig.random(1, 10);
     }
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_neworder() {
+    neworder_input in;
+    gen_neworder_input(in);
+    auto locks = db.partition_locks();
+    if (!locks) {
+        run_txn_neworder(in);
+        return;
+    }
+    bench::db_partition_locks::set ps;
+    ps.add(in.q_w_id);
+    for (uint64_t i = 0; i < in.num_items; ++i)
+        ps.add(in.ol_supply_w_ids[i]);
+    locks->lock(ps);
+    if (!ps.within(w_id_start, w_id_end) || !run_local_neworder(in))
+        run_txn_neworder(in);
+    locks->unlock(ps);
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_neworder(const neworder_input& in) {
+#if TABLE_FINE_GRAINED
+    typedef warehouse_value::NamedColumn wh_nc;
+    typedef district_value::NamedColumn dt_nc;
+    typedef customer_value::NamedColumn cu_nc;
+    typedef stock_value::NamedColumn st_nc;
+#endif
+
+    uint64_t q_w_id = in.q_w_id;
+    uint64_t q_d_id = in.q_d_id;
+    uint64_t q_c_id = in.q_c_id;
+    uint64_t num_items = in.num_items;
+    const uint64_t* ol_i_ids = in.ol_i_ids;
+    const uint64_t* ol_supply_w_ids = in.ol_supply_w_ids;
+    const uint64_t* ol_quantities = in.ol_quantities;
+    uint32_t o_entry_d = in.o_entry_d;
+    bool all_local = in.all_local;
 
     // holding outputs of the transaction
     volatile var_string<16> out_cus_last;
@@ -203,12 +240,34 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
 
     TXP_ACCOUNT(txp_tpcc_no_stage4, num_items);
 
+#if BENCH_MULTIGET
+    // look up all items (and, for all-local orders, all stocks) at once
+    item_key item_keys[15];
+    typename tpcc_db<DBParams>::it_table_type::sel_return_type item_rows[15];
+    for (uint64_t i = 0; i < num_items; ++i)
+        item_keys[i] = item_key(ol_i_ids[i]);
+    CHK(db.tbl_items().select_rows(item_keys, num_items, RowAccess::ObserveValue, item_rows));
+#if !TPCC_SPLIT_TABLE && !TABLE_FINE_GRAINED
+    stock_key stock_keys[15];
+    typename tpcc_db<DBParams>::st_table_type::sel_return_type stock_rows[15];
+    if (all_local) {
+        for (uint64_t i = 0; i < num_items; ++i)
+            stock_keys[i] = stock_key(q_w_id, ol_i_ids[i]);
+        CHK(db.tbl_stocks(q_w_id).select_rows(stock_keys, num_items, RowAccess::ObserveValue, stock_rows));
+    }
+#endif
+#endif
+
     for (uint64_t i = 0; i < num_items; ++i) {
         uint64_t iid = ol_i_ids[i];
         uint64_t wid = ol_supply_w_ids[i];
         uint64_t qty = ol_quantities[i];
 
+#if BENCH_MULTIGET
+        std::tie(abort, result, std::ignore, value) = item_rows[i];
+#else
         std::tie(abort, result, std::ignore, value) = db.tbl_items().select_row(item_key(iid), RowAccess::ObserveValue);
+#endif
         CHK(abort);
         assert(result);
         uint64_t oid = reinterpret_cast<const item_value *>(value)->i_im_id;
@@ -249,6 +308,11 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
             db.tbl_stocks_comm(wid).update_row(row, new_smv);
         }
 #else
+#if BENCH_MULTIGET && !TABLE_FINE_GRAINED
+        if (all_local)
+            std::tie(abort, result, row, value) = stock_rows[i];
+        else
+#endif
         std::tie(abort, result, row, value) = db.tbl_stocks(wid).select_row(stock_key(wid, iid),
 #if TABLE_FINE_GRAINED
             {{st_nc::s_quantity, Commute ? access_t::write : access_t::update},
@@ -337,43 +401,75 @@ void tpcc_runner<DBParams>::run_txn_neworder() {
 }
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_payment() {
-#if TABLE_FINE_GRAINED
-    typedef warehouse_value::NamedColumn wh_nc;
-    typedef district_value::NamedColumn dt_nc;
-    typedef customer_value::NamedColumn cu_nc;
-#endif
+void tpcc_runner<DBParams>::gen_payment_input(payment_input& in) {
+    in.q_w_id = ig.random(w_id_start, w_id_end);
+    in.q_d_id = ig.random(1, 10);
 
-    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
-    uint64_t q_d_id = ig.random(1, 10);
-
-    uint64_t q_c_w_id, q_c_d_id, q_c_id;
-    std::string last_name;
     auto x = ig.random(1, 100);
     auto y = ig.random(1, 100);
 
-    bool is_home = (ig.num_warehouses() == 1) || (x <= 85);
-    bool by_name = (y <= 60);
+    bool is_home = (ig.num_warehouses() == 1)
+        || (remote_pct >= 0 ? x > uint64_t(remote_pct) : x <= 85);
+    in.by_name = (y <= 60);
 
     if (is_home) {
-        q_c_w_id = q_w_id;
-        q_c_d_id = q_d_id;
+        in.q_c_w_id = in.q_w_id;
+        in.q_c_d_id = in.q_d_id;
     } else {
         do {
-            q_c_w_id = ig.random(1, ig.num_warehouses());
-        } while (q_c_w_id == q_w_id);
-        q_c_d_id = ig.random(1, 10);
+            in.q_c_w_id = ig.random(1, ig.num_warehouses());
+        } while (in.q_c_w_id == in.q_w_id);
+        in.q_c_d_id = ig.random(1, 10);
     }
 
-    if (by_name) {
-        last_name = ig.gen_customer_last_name_run();
-        q_c_id = 0;
+    if (in.by_name) {
+        in.last_name = ig.gen_customer_last_name_run();
+        in.q_c_id = 0;
     } else {
-        q_c_id = ig.gen_customer_id();
+        in.last_name.clear();
+        in.q_c_id = ig.gen_customer_id();
     }
 
-    int64_t h_amount = ig.random(100, 500000);
-    uint32_t h_date = ig.gen_date();
+    in.h_amount = ig.random(100, 500000);
+    in.h_date = ig.gen_date();
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_payment() {
+    payment_input in;
+    gen_payment_input(in);
+    auto locks = db.partition_locks();
+    if (!locks) {
+        run_txn_payment(in);
+        return;
+    }
+    bench::db_partition_locks::set ps;
+    ps.add(in.q_w_id);
+    ps.add(in.q_c_w_id);
+    locks->lock(ps);
+    if (!ps.within(w_id_start, w_id_end) || !run_local_payment(in))
+        run_txn_payment(in);
+    locks->unlock(ps);
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_payment(const payment_input& in) {
+#if TABLE_FINE_GRAINED
+    typedef warehouse_value::NamedColumn wh_nc;
+    typedef district_value::NamedColumn dt_nc;
+    typedef customer_value::NamedColumn cu_nc;
+#endif
+
+    uint64_t q_w_id = in.q_w_id;
+    uint64_t q_d_id = in.q_d_id;
+    uint64_t q_c_w_id = in.q_c_w_id;
+    uint64_t q_c_d_id = in.q_c_d_id;
+    // set from the customer index when selecting by name
+    uint64_t q_c_id = in.q_c_id;
+    const std::string& last_name = in.last_name;
+    bool by_name = in.by_name;
+    int64_t h_amount = in.h_amount;
+    uint32_t h_date = in.h_date;
 
     // holding outputs of the transaction
     volatile var_string<10> out_w_name, out_d_name;
@@ -689,11 +785,18 @@ void tpcc_runner<DBParams>::run_txn_payment() {
 
 template <typename DBParams>
 void tpcc_runner<DBParams>::run_txn_orderstatus() {
+    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
+    run_partitioned(q_w_id, [&] () {
+        run_txn_orderstatus(q_w_id);
+    });
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_orderstatus(uint64_t q_w_id) {
 #if TABLE_FINE_GRAINED
     typedef customer_value::NamedColumn cu_nc;
     typedef orderline_value::NamedColumn ol_nc;
 #endif
-    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
     uint64_t q_d_id = ig.random(1, 10);
 
     std::string last_name;
@@ -725,7 +828,7 @@ void tpcc_runner<DBParams>::run_txn_orderstatus() {
 
     size_t starts = 0;
 
-    TXN {
+    ROTXN {
     ++starts;
 
     bool success, result;
@@ -1112,13 +1215,20 @@ void tpcc_runner<DBParams>::run_txn_delivery(uint64_t q_w_id) {
 }
 
 template <typename DBParams>
-void tpcc_runner<DBParams>::run_txn_stocklevel(){
+void tpcc_runner<DBParams>::run_txn_stocklevel() {
+    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
+    run_partitioned(q_w_id, [&] () {
+        run_txn_stocklevel(q_w_id);
+    });
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_txn_stocklevel(uint64_t q_w_id) {
 #if TABLE_FINE_GRAINED
     typedef orderline_value::NamedColumn ol_nc;
     typedef stock_value::NamedColumn st_nc;
 #endif
 
-    uint64_t q_w_id = ig.random(w_id_start, w_id_end);
     uint64_t q_d_id = ig.random(1, 10);
     auto threshold = (int32_t)ig.random(10, 20);
 
@@ -1144,7 +1254,7 @@ void tpcc_runner<DBParams>::run_txn_stocklevel(){
 
     size_t starts = 0;
 
-    TXN {
+    ROTXN {
     ++starts;
 
     ol_iids.clear();
@@ -1200,4 +1310,292 @@ void tpcc_runner<DBParams>::run_txn_stocklevel(){
     TXP_ACCOUNT(txp_tpcc_st_aborts, starts - 1);
 }
 
+template <typename DBParams>
+template <typename F>
+void tpcc_runner<DBParams>::run_partitioned(uint64_t q_w_id, F f) {
+    auto locks = db.partition_locks();
+    if (!locks) {
+        f();
+        return;
+    }
+    bench::db_partition_locks::set ps;
+    ps.add(q_w_id);
+    locks->lock(ps);
+    f();
+    locks->unlock(ps);
+}
+
+// New-order on rows no other thread can reach: reads go straight to the
+// rows and updates are made in place, with no STO tracking. With split
+// tables new-orders always run as STO transactions.
+template <typename DBParams>
+bool tpcc_runner<DBParams>::run_local_neworder(const neworder_input& in) {
+#if TPCC_SPLIT_TABLE
+    (void) in;
+    return false;
+#else
+    uint64_t q_w_id = in.q_w_id;
+    uint64_t q_d_id = in.q_d_id;
+    uint64_t q_c_id = in.q_c_id;
+
+    volatile var_string<16> out_cus_last;
+    volatile fix_string<2> out_cus_credit;
+    volatile var_string<24> out_item_names[15];
+    volatile double out_total_amount = 0.0;
+
+    auto wv = db.tbl_warehouses().nontrans_get(warehouse_key(q_w_id));
+    auto dv = db.tbl_districts(q_w_id).nontrans_get(district_key(q_w_id, q_d_id));
+    auto cv = db.tbl_customers(q_w_id).nontrans_get(customer_key(q_w_id, q_d_id, q_c_id));
+    assert(wv && dv && cv);
+    int64_t wh_tax_rate = wv->w_tax;
+    int64_t dt_tax_rate = dv->d_tax;
+    auto cus_discount = cv->c_discount;
+    out_cus_last = cv->c_last;
+    out_cus_credit = cv->c_credit;
+
+    uint64_t dt_next_oid = db.oid_generator().next(q_w_id, q_d_id);
+
+    order_key ok(q_w_id, q_d_id, dt_next_oid);
+    order_value ov;
+    ov.o_c_id = q_c_id;
+    ov.o_carrier_id = 0;
+    ov.o_all_local = in.all_local ? 1 : 0;
+    ov.o_entry_d = in.o_entry_d;
+    ov.o_ol_cnt = in.num_items;
+    undo.insert(db.tbl_orders(q_w_id), ok, ov);
+    undo.insert(db.tbl_neworders(q_w_id), ok, bench::dummy_row::row);
+    undo.insert(db.tbl_order_customer_index(q_w_id), order_cidx_key(q_w_id, q_d_id, q_c_id, dt_next_oid),
+                bench::dummy_row::row);
+
+    for (uint64_t i = 0; i < in.num_items; ++i) {
+        uint64_t iid = in.ol_i_ids[i];
+        uint64_t wid = in.ol_supply_w_ids[i];
+        uint64_t qty = in.ol_quantities[i];
+
+        auto iv = db.tbl_items().nontrans_get(item_key(iid));
+        if (!iv || iv->i_im_id == 0) {
+            undo.rollback();
+            return false;
+        }
+        uint32_t i_price = iv->i_price;
+        out_item_names[i] = iv->i_name;
+
+        auto sv = undo.update(db.tbl_stocks(wid), stock_key(wid, iid));
+        assert(sv);
+        if ((sv->s_quantity - 10) >= (int32_t) qty)
+            sv->s_quantity -= qty;
+        else
+            sv->s_quantity += (91 - (int32_t) qty);
+        sv->s_ytd += qty;
+        sv->s_order_cnt += 1;
+        if (wid != q_w_id)
+            sv->s_remote_cnt += 1;
+
+        double ol_amount = qty * i_price/100.0;
+
+        orderline_value olv;
+        olv.ol_i_id = iid;
+        olv.ol_supply_w_id = wid;
+        olv.ol_delivery_d = 0;
+        olv.ol_quantity = qty;
+        olv.ol_amount = ol_amount;
+        olv.ol_dist_info = sv->s_dists[q_d_id - 1];
+        undo.insert(db.tbl_orderlines(q_w_id), orderline_key(q_w_id, q_d_id, dt_next_oid, i + 1), olv);
+
+        out_total_amount += ol_amount * (1.0 - cus_discount/100.0) * (1.0 + (wh_tax_rate + dt_tax_rate)/100.0);
+    }
+
+    undo.commit();
+    return true;
+#endif
+}
+
+// Payment on rows no other thread can reach; see run_local_neworder
+template <typename DBParams>
+bool tpcc_runner<DBParams>::run_local_payment(const payment_input& in) {
+#if TPCC_SPLIT_TABLE
+    (void) in;
+    return false;
+#else
+    uint64_t q_w_id = in.q_w_id;
+    uint64_t q_d_id = in.q_d_id;
+    uint64_t q_c_w_id = in.q_c_w_id;
+    uint64_t q_c_d_id = in.q_c_d_id;
+    uint64_t q_c_id = in.q_c_id;
+    int64_t h_amount = in.h_amount;
+
+    volatile var_string<10> out_w_name, out_d_name;
+    volatile var_string<20> out_w_street_1, out_w_street_2, out_w_city;
+    volatile var_string<20> out_d_street_1, out_d_street_2, out_d_city;
+    volatile fix_string<2> out_w_state, out_d_state;
+    volatile fix_string<9> out_w_zip, out_d_zip;
+    volatile uint32_t out_c_since;
+    volatile int64_t out_c_credit_lim;
+    volatile int64_t out_c_discount;
+    volatile int64_t out_c_balance;
+    (void)out_c_since;
+    (void)out_c_credit_lim;
+    (void)out_c_discount;
+    (void)out_c_balance;
+
+    auto wv = undo.update(db.tbl_warehouses(), warehouse_key(q_w_id));
+    assert(wv);
+    out_w_name = wv->w_name;
+    out_w_street_1 = wv->w_street_1;
+    out_w_street_2 = wv->w_street_2;
+    out_w_city = wv->w_city;
+    out_w_state = wv->w_state;
+    out_w_zip = wv->w_zip;
+    wv->w_ytd += h_amount;
+
+    auto dv = undo.update(db.tbl_districts(q_w_id), district_key(q_w_id, q_d_id));
+    assert(dv);
+    out_d_name = dv->d_name;
+    out_d_street_1 = dv->d_street_1;
+    out_d_street_2 = dv->d_street_2;
+    out_d_city = dv->d_city;
+    out_d_state = dv->d_state;
+    out_d_zip = dv->d_zip;
+    dv->d_ytd += h_amount;
+
+    if (in.by_name) {
+        auto civ = db.tbl_customer_index(q_c_w_id).nontrans_get(customer_idx_key(q_c_w_id, q_c_d_id, in.last_name));
+        if (!civ) {
+            undo.rollback();
+            return false;
+        }
+        uint64_t rows[100];
+        int cnt = 0;
+        for (auto it = civ->c_ids.begin(); cnt < 100 && it != civ->c_ids.end(); ++it, ++cnt)
+            rows[cnt] = *it;
+        q_c_id = rows[cnt / 2];
+    }
+
+    auto cv = undo.update(db.tbl_customers(q_c_w_id), customer_key(q_c_w_id, q_c_d_id, q_c_id));
+    assert(cv);
+    out_c_since = cv->c_since;
+    out_c_credit_lim = cv->c_credit_lim;
+    out_c_discount = cv->c_discount;
+    out_c_balance = cv->c_balance;
+    cv->c_balance -= h_amount;
+    cv->c_payment_cnt += 1;
+    cv->c_ytd_payment += h_amount;
+    if (cv->c_credit == "BC") {
+        c_data_info info(q_c_id, q_c_d_id, q_c_w_id, q_d_id, q_w_id, h_amount);
+        cv->c_data.insert_left(info.buf(), c_data_info::len);
+    }
+
+    history_value hv;
+    hv.h_c_id = q_c_id;
+    hv.h_c_d_id = q_c_d_id;
+    hv.h_c_w_id = q_c_w_id;
+    hv.h_d_id = q_d_id;
+    hv.h_w_id = q_w_id;
+    hv.h_date = in.h_date;
+    hv.h_amount = h_amount;
+    hv.h_data = std::string(out_w_name.c_str()) + "    " + std::string(out_d_name.c_str());
+    undo.insert(db.tbl_histories(q_c_w_id), history_key(db.tbl_histories(q_c_w_id).gen_key()), hv);
+
+    undo.commit();
+    return true;
+#endif
+}
+
+// Deterministic execution locks. Transactions conflict on the warehouse and
+// district rows, on the stock rows that new-orders update, and on customer
+// rows, which are locked a district at a time because payments select
+// customers by last name while they run.
+template <typename DBParams>
+void tpcc_runner<DBParams>::gen_det_txn(det_txn& t, bench::det_locks& locks) {
+    enum { lk_warehouse = 1, lk_district, lk_customers, lk_stock };
+    t.type = next_transaction();
+    if (t.type == txn_type::new_order) {
+        auto& in = t.no;
+        gen_neworder_input(in);
+        locks.read(bench::det_locks::key(lk_warehouse, in.q_w_id));
+        locks.read(bench::det_locks::key(lk_district, (in.q_w_id << 4) | in.q_d_id));
+        locks.read(bench::det_locks::key(lk_customers, (in.q_w_id << 4) | in.q_d_id));
+        for (uint64_t i = 0; i < in.num_items; ++i)
+            locks.write(bench::det_locks::key(lk_stock, (in.ol_supply_w_ids[i] << 20) | in.ol_i_ids[i]));
+    } else {
+        assert(t.type == txn_type::payment);
+        auto& in = t.pm;
+        gen_payment_input(in);
+        locks.write(bench::det_locks::key(lk_warehouse, in.q_w_id));
+        locks.write(bench::det_locks::key(lk_district, (in.q_w_id << 4) | in.q_d_id));
+        locks.write(bench::det_locks::key(lk_customers, (in.q_c_w_id << 4) | in.q_c_d_id));
+    }
+}
+
+template <typename DBParams>
+void tpcc_runner<DBParams>::run_det_txn(const det_txn& t) {
+    if (t.type == txn_type::new_order)
+        run_txn_neworder(t.no);
+    else
+        run_txn_payment(t.pm);
+}
+
+#if STO_COROUTINES
+template <typename DBParams>
+bool tpcc_runner<DBParams>::prefetch_neworder(const neworder_input& in, int step) {
+    bool any = false;
+    auto fetch = [&any] (const void* p) {
+        if (p) {
+            prefetch(p);
+            any = true;
+        }
+    };
+    uint64_t q_w_id = in.q_w_id;
+#if TPCC_SPLIT_TABLE
+    fetch(db.tbl_warehouses_const().lookup_address(warehouse_key(q_w_id), step));
+    fetch(db.tbl_districts_const(q_w_id).lookup_address(district_key(q_w_id, in.q_d_id), step));
+    fetch(db.tbl_customers_const(q_w_id).lookup_address(customer_key(q_w_id, in.q_d_id, in.q_c_id), step));
+#else
+    fetch(db.tbl_warehouses().lookup_address(warehouse_key(q_w_id), step));
+    fetch(db.tbl_districts(q_w_id).lookup_address(district_key(q_w_id, in.q_d_id), step));
+    fetch(db.tbl_customers(q_w_id).lookup_address(customer_key(q_w_id, in.q_d_id, in.q_c_id), step));
+#endif
+    for (uint64_t i = 0; i < in.num_items; ++i) {
+        uint64_t iid = in.ol_i_ids[i];
+        uint64_t wid = in.ol_supply_w_ids[i];
+        fetch(db.tbl_items().lookup_address(item_key(iid), step));
+#if TPCC_SPLIT_TABLE
+        fetch(db.tbl_stocks_const(wid).lookup_address(stock_key(wid, iid), step));
+        fetch(db.tbl_stocks_comm(wid).lookup_address(stock_key(wid, iid), step));
+#else
+        fetch(db.tbl_stocks(wid).lookup_address(stock_key(wid, iid), step));
+#endif
+    }
+    return any;
+}
+
+template <typename DBParams>
+TCoroutine::task tpcc_runner<DBParams>::run_txn_coro(txn_type type, uint64_t delivery_w_id) {
+    switch (type) {
+        case txn_type::new_order: {
+            neworder_input in;
+            gen_neworder_input(in);
+            // fetch the index entries of every row the order looks up, a
+            // level at a time, while other transactions run
+            for (int step = 0; prefetch_neworder(in, step); ++step)
+                co_await TCoroutine::yield();
+            run_txn_neworder(in);
+            break;
+        }
+        case txn_type::payment:
+            run_txn_payment();
+            break;
+        case txn_type::order_status:
+            run_txn_orderstatus();
+            break;
+        case txn_type::delivery:
+            run_txn_delivery(delivery_w_id);
+            break;
+        case txn_type::stock_level:
+            run_txn_stocklevel();
+            break;
+    }
+}
+#endif
+
 }; // namespace tpcc
@@ -18,7 +18,7 @@ using db_params::parse_dbid;
 
 // @section: clp parser definitions
 enum {
-    opt_dbid = 1, opt_nthrs, opt_time, opt_perf, opt_pfcnt
+    opt_dbid = 1, opt_nthrs, opt_time, opt_perf, opt_pfcnt, opt_det
 };
 
 static const Clp_Option options[] = {
@@ -26,7 +26,8 @@ static const Clp_Option options[] = {
         { "nthreads",     't', opt_nthrs, Clp_ValInt,    Clp_Optional },
         { "time",         'l', opt_time,  Clp_ValDouble, Clp_Optional },
         { "perf",         'p', opt_perf,  Clp_NoVal,     Clp_Optional },
-        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate| Clp_Optional }
+        { "perf-counter", 'c', opt_pfcnt, Clp_NoVal,     Clp_Negate| Clp_Optional },
+        { "deterministic", 0,  opt_det,   Clp_ValInt,    Clp_Optional }
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -42,7 +43,10 @@ static inline void print_usage(const char *argv_0) {
        << "  --perf (or -p)" << std::endl
        << "    Spawns perf profiler in record mode for the duration of the benchmark run." << std::endl
        << "  --perf-counter (or -c)" << std::endl
-       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl;
+       << "    Spawns perf profiler in counter mode for the duration of the benchmark run." << std::endl
+       << "  --deterministic=<NUM>" << std::endl
+       << "    Run votes in deterministic batches of NUM per thread, each scheduled by the phone" << std::endl
+       << "    number and contestant it updates so that none abort (default 0, off)." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
@@ -52,11 +56,12 @@ struct cmd_params {
     double time;
     bool spwan_perf;
     bool perf_counter_mode;
+    int det_batch;
 
     explicit cmd_params()
             : db_id(db_params::db_params_id::Default),
               num_threads(1), time(10.0),
-              spwan_perf(false), perf_counter_mode(false) {}
+              spwan_perf(false), perf_counter_mode(false), det_batch(0) {}
 };
 
 // @endsection: clp parser definitions
@@ -69,8 +74,11 @@ public:
     using runner_type = voter::voter_runner<DBParams>;
     using profiler_type = bench::db_profiler;
 
-    static void runner_thread(runner_type& r, size_t& txn_cnt) {
-        r.run();
+    static void runner_thread(runner_type& r, typename runner_type::det_executor_type* det, size_t& txn_cnt) {
+        if (det)
+            r.run_deterministic(*det);
+        else
+            r.run();
         txn_cnt = r.committed_txns();
     }
 
@@ -89,13 +97,16 @@ public:
 
         for (int id = 0; id < p.num_threads; ++id)
             runners.push_back(runner_type(id, db, p.time));
+        std::unique_ptr<typename runner_type::det_executor_type> det;
+        if (p.det_batch > 0)
+            det.reset(new typename runner_type::det_executor_type(p.num_threads, p.det_batch));
 
         profiler_type profiler(p.spwan_perf);
         profiler.start(p.perf_counter_mode ? Profiler::perf_mode::counters : Profiler::perf_mode::record);
 
         for (int t = 0; t < p.num_threads; ++t)
             runner_threads.push_back(
-                    std::thread(runner_thread, std::ref(runners[t]), std::ref(committed_txn_cnts[t]))
+                    std::thread(runner_thread, std::ref(runners[t]), det.get(), std::ref(committed_txn_cnts[t]))
             );
         for (auto& t : runner_threads)
             t.join();
@@ -149,6 +160,9 @@ int main(int argc, const char * const *argv) {
             case opt_pfcnt:
                 params.perf_counter_mode = !clp->negated;
                 break;
+            case opt_det:
+                params.det_batch = clp->val.i;
+                break;
             default:
                 print_usage(argv[0]);
                 ret_code = 1;
@@ -6,6 +6,7 @@
 #include "Voter_structs.hh"
 #include "DB_index.hh"
 #include "DB_params.hh"
+#include "DB_deterministic.hh"
 
 namespace voter {
 
@@ -134,6 +135,12 @@ class voter_runner {
 public:
     typedef voter_db<DBParams> db_type;
 
+    struct phone_call {
+        phone_number_str tel;
+        int32_t contestant_number;
+    };
+    typedef bench::det_executor<phone_call> det_executor_type;
+
     explicit voter_runner(int rid, db_type& database, double time_limit)
         : id(rid), db(database), ig(rid+1040), tsc_elapse_limit(),
           stat_committed_txns() {
@@ -143,6 +150,9 @@ public:
     }
 
     void run();
+    // Vote in deterministic batches. A vote writes its phone number's row
+    // and its contestant's per-state counts.
+    void run_deterministic(det_executor_type& det);
 
     size_t committed_txns() const {
         return stat_committed_txns;
@@ -214,4 +224,24 @@ void voter_runner<DBParams>::run() {
     stat_committed_txns = cnt;
 }
 
+template <typename DBParams>
+void voter_runner<DBParams>::run_deterministic(det_executor_type& det) {
+    ::TThread::set_id(id);
+    set_affinity(id);
+    db.thread_init_all();
+
+    auto begin_tsc = read_tsc();
+
+    stat_committed_txns = det.run(id, [this] (phone_call& c, bench::det_locks& locks) {
+        std::tie(c.contestant_number, c.tel) = ig.generate_phone_call();
+        // hash collisions only order more votes than needed
+        locks.write(bench::det_locks::key(1, std::hash<std::string>()(c.tel.area_code + c.tel.number)));
+        locks.write(bench::det_locks::key(2, uint32_t(c.contestant_number)));
+    }, [this] (const phone_call& c) {
+        run_txn_vote(c.tel, c.contestant_number);
+    }, [this, begin_tsc] () {
+        return (read_tsc() - begin_tsc) >= tsc_elapse_limit;
+    });
+}
+
 }; // namespace voter
@@ -6,6 +6,7 @@
 #include "YCSB_txns.hh"
 #include "PlatformFeatures.hh"
 #include "DB_profiler.hh"
+#include "DB_deterministic.hh"
 
 namespace ycsb {
 
@@ -14,7 +15,8 @@ using bench::db_profiler;
 
 enum {
     opt_dbid = 1, opt_nthrs, opt_mode, opt_time, opt_perf, opt_pfcnt, opt_gc,
-    opt_node, opt_comm
+    opt_node, opt_comm, opt_rdonly, opt_rtidr, opt_rtidp, opt_logdir, opt_nloggers,
+    opt_coro, opt_det, opt_shift
 };
 
 static const Clp_Option options[] = {
@@ -27,6 +29,14 @@ static const Clp_Option options[] = {
     { "gc",           'g', opt_gc,    Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "node",         'n', opt_node,  Clp_NoVal,     Clp_Negate| Clp_Optional },
     { "commute",      'x', opt_comm,  Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "read-only",    'r', opt_rdonly, Clp_NoVal,    Clp_Negate| Clp_Optional },
+    { "rtid-refresh",  0,  opt_rtidr, Clp_ValDouble, Clp_Optional },
+    { "rtid-publisher", 0, opt_rtidp, Clp_NoVal,     Clp_Negate| Clp_Optional },
+    { "log-dir",      'd', opt_logdir, Clp_ValString, Clp_Optional },
+    { "loggers",      'k', opt_nloggers, Clp_ValInt,  Clp_Optional },
+    { "coroutines",    0,  opt_coro,  Clp_ValInt,    Clp_Optional },
+    { "deterministic", 0,  opt_det,   Clp_ValInt,    Clp_Optional },
+    { "shift",         0,  opt_shift, Clp_ValString, Clp_Optional },
 };
 
 static inline void print_usage(const char *argv_0) {
@@ -34,7 +44,7 @@ static inline void print_usage(const char *argv_0) {
     ss << "Usage of " << std::string(argv_0) << ":" << std::endl
        << "  --dbid=<STRING> (or -i<STRING>)" << std::endl
        << "    Specify the type of DB concurrency control used. Can be one of the followings:" << std::endl
-       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode" << std::endl
+       << "      default, opaque, 2pl, adaptive, swiss, tictoc, defaultnode, mvcc, mvccnode, runtime" << std::endl
        << "  --nthreads=<NUM> (or -t<NUM>)" << std::endl
        << "    Specify the number of threads (or TPCC workers/terminals, default 1)." << std::endl
        << "  --mode=<CHAR> (or -m<CHAR>)" << std::endl
@@ -50,7 +60,30 @@ static inline void print_usage(const char *argv_0) {
        << "  --node (or -n)" << std::endl
        << "    Enable node tracking (default false)." << std::endl
        << "  --commute (or -x)" << std::endl
-       << "    Enable commutative updates in MVCC (default false)." << std::endl;
+       << "    Enable commutative updates in MVCC (default false)." << std::endl
+       << "  --read-only (or -r)" << std::endl
+       << "    Declare transactions without writes read-only, so that MVCC tables serve" << std::endl
+       << "    them from a snapshot without tracking reads (default false)." << std::endl
+       << "  --rtid-refresh=<NUM>" << std::endl
+       << "    Let the MVCC read timestamp lag by up to NUM microseconds instead of" << std::endl
+       << "    recomputing it at every transaction start (default 0)." << std::endl
+       << "  --rtid-publisher" << std::endl
+       << "    Recompute the MVCC read timestamp in a background thread (default false)." << std::endl
+       << "  --log-dir=<DIR> (or -d<DIR>)" << std::endl
+       << "    Write a redo log of every committed transaction to DIR (default off)." << std::endl
+       << "    Implies --gc, since commits become durable as epochs advance." << std::endl
+       << "  --loggers=<NUM> (or -k<NUM>)" << std::endl
+       << "    Number of logger threads, and log files, when logging (default 1)." << std::endl
+       << "  --coroutines=<NUM>" << std::endl
+       << "    Run NUM interleaved transactions per thread as coroutines, which prefetch" << std::endl
+       << "    index entries and let the others run while they arrive (default 0, off)." << std::endl
+       << "    Each thread uses NUM TThread ids. Requires a build with COROUTINES=1." << std::endl
+       << "  --deterministic=<NUM>" << std::endl
+       << "    Run transactions in deterministic batches of NUM per thread, each scheduled by its" << std::endl
+       << "    keys and write flags so that none abort (default 0, off). Works with any --dbid." << std::endl
+       << "  --shift=<CHAR>" << std::endl
+       << "    Switch to YCSB variant CHAR halfway through the run, to see how the runtime" << std::endl
+       << "    concurrency control policy (--dbid=runtime) follows the change (default off)." << std::endl;
     std::cout << ss.str() << std::flush;
 }
 
@@ -93,7 +126,8 @@ void ycsb_db<DBParams>::prepopulate() {
 template <typename DBParams>
 class ycsb_access {
 public:
-    static void ycsb_runner_thread(ycsb_db<DBParams>& db, db_profiler& prof, ycsb_runner<DBParams>& runner, double time_limit, uint64_t& txn_cnt) {
+    static void ycsb_runner_thread(ycsb_db<DBParams>& db, db_profiler& prof, ycsb_runner<DBParams>& runner, double time_limit,
+                                   uint64_t& txn_cnt, uint64_t& shifted_txn_cnt) {
         uint64_t local_cnt = 0;
         db.table_thread_init();
 
@@ -103,51 +137,152 @@ public:
         uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
         auto start_t = prof.start_timestamp();
 
-        auto it = runner.workload.begin();
+        // with --shift, the second half of the run draws from shifted_workload
+        auto* workload = &runner.workload;
+        bool shifted = runner.shifted_workload.empty();
+        uint64_t shift_cnt = 0;
+        auto it = workload->begin();
 
         while (true) {
             auto curr_t = read_tsc();
             if ((curr_t - start_t) >= tsc_diff)
                 break;
+            if (!shifted && (curr_t - start_t) >= tsc_diff / 2) {
+                shifted = true;
+                shift_cnt = local_cnt;
+                workload = &runner.shifted_workload;
+                it = workload->begin();
+            }
 
             runner.run_txn(*it);
             ++it;
-            if (it == runner.workload.end())
-                it = runner.workload.begin();
+            if (it == workload->end())
+                it = workload->begin();
 
             ++local_cnt;
         }
 
         txn_cnt = local_cnt;
+        shifted_txn_cnt = runner.shifted_workload.empty() ? 0 : local_cnt - shift_cnt;
+    }
+
+#if STO_COROUTINES
+    // Like ycsb_runner_thread, with @nslots transactions in flight
+    static void ycsb_coroutine_runner_thread(ycsb_db<DBParams>& db, db_profiler& prof, ycsb_runner<DBParams>& runner,
+                                             double time_limit, int nslots, uint64_t& txn_cnt) {
+        db.table_thread_init();
+
+        ::TThread::set_id(runner.id() * nslots);
+        set_affinity(runner.id());
+
+        uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
+        auto start_t = prof.start_timestamp();
+
+        auto it = runner.workload.begin();
+        TCoroutine::scheduler sched(runner.id() * nslots, nslots);
+        txn_cnt = sched.run([&] (int) -> TCoroutine::task {
+            if ((read_tsc() - start_t) >= tsc_diff)
+                return {};
+            auto& txn = *it;
+            ++it;
+            if (it == runner.workload.end())
+                it = runner.workload.begin();
+            return runner.run_txn_coro(txn);
+        });
+    }
+#endif
+
+    typedef bench::det_executor<const ycsb_txn_t*> det_executor_type;
+
+    // Like ycsb_runner_thread, in deterministic batches. The keys of a
+    // transaction's operations are its locks.
+    static void ycsb_deterministic_runner_thread(ycsb_db<DBParams>& db, db_profiler& prof, ycsb_runner<DBParams>& runner,
+                                                 double time_limit, det_executor_type& det, uint64_t& txn_cnt) {
+        db.table_thread_init();
+
+        ::TThread::set_id(runner.id());
+        set_affinity(runner.id());
+
+        uint64_t tsc_diff = (uint64_t)(time_limit * constants::processor_tsc_frequency * constants::billion);
+        auto start_t = prof.start_timestamp();
+
+        auto it = runner.workload.begin();
+        txn_cnt = det.run(runner.id(), [&] (const ycsb_txn_t*& txn, bench::det_locks& locks) {
+            txn = &*it;
+            ++it;
+            if (it == runner.workload.end())
+                it = runner.workload.begin();
+            for (auto& op : txn->ops) {
+                if (op.is_write)
+                    locks.write(op.key);
+                else
+                    locks.read(op.key);
+            }
+        }, [&runner] (const ycsb_txn_t* txn) {
+            runner.run_txn(*txn);
+        }, [start_t, tsc_diff] () {
+            return (read_tsc() - start_t) >= tsc_diff;
+        });
     }
 
-    static void workload_generation(std::vector<ycsb_runner<DBParams>>& runners, mode_id mode) {
+    static int txn_size(mode_id mode) {
+        return (mode == mode_id::ReadOnly) ? 2 : ycsb_max_txn_size;
+    }
+
+    static void workload_generation(std::vector<ycsb_runner<DBParams>>& runners, mode_id mode,
+                                    bool shift, mode_id shift_mode) {
         std::vector<std::thread> thrs;
-        int tsize = (mode == mode_id::ReadOnly) ? 2 : 16;
         for (auto& r : runners) {
-            thrs.emplace_back(&ycsb_runner<DBParams>::gen_workload, &r, tsize);
+            thrs.emplace_back([&r, mode, shift, shift_mode] () {
+                r.gen_workload(txn_size(mode));
+                if (shift)
+                    r.gen_shifted_workload(shift_mode, txn_size(shift_mode));
+            });
         }
         for (auto& t : thrs)
             t.join();
     }
 
-    static uint64_t run_benchmark(ycsb_db<DBParams>& db, db_profiler& prof, std::vector<ycsb_runner<DBParams>>& runners, double time_limit) {
+    static uint64_t run_benchmark(ycsb_db<DBParams>& db, db_profiler& prof, std::vector<ycsb_runner<DBParams>>& runners,
+                                  double time_limit, int nslots, unsigned det_batch) {
         int num_runners = runners.size();
         std::vector<std::thread> runner_thrs;
         std::vector<uint64_t> txn_cnts(size_t(num_runners), 0);
+        std::vector<uint64_t> shifted_txn_cnts(size_t(num_runners), 0);
+        std::unique_ptr<det_executor_type> det;
+        if (det_batch > 0)
+            det.reset(new det_executor_type(num_runners, det_batch));
 
         for (int i = 0; i < num_runners; ++i) {
             fprintf(stdout, "runner %d created\n", i);
+#if STO_COROUTINES
+            if (nslots > 0) {
+                runner_thrs.emplace_back(ycsb_coroutine_runner_thread, std::ref(db), std::ref(prof),
+                                         std::ref(runners[i]), time_limit, nslots, std::ref(txn_cnts[i]));
+                continue;
+            }
+#endif
+            if (det) {
+                runner_thrs.emplace_back(ycsb_deterministic_runner_thread, std::ref(db), std::ref(prof),
+                                         std::ref(runners[i]), time_limit, std::ref(*det), std::ref(txn_cnts[i]));
+                continue;
+            }
             runner_thrs.emplace_back(ycsb_runner_thread, std::ref(db), std::ref(prof),
-                                     std::ref(runners[i]), time_limit, std::ref(txn_cnts[i]));
+                                     std::ref(runners[i]), time_limit, std::ref(txn_cnts[i]),
+                                     std::ref(shifted_txn_cnts[i]));
         }
 
         for (auto &t : runner_thrs)
             t.join();
 
-        uint64_t total_txn_cnt = 0;
+        uint64_t total_txn_cnt = 0, total_shifted_cnt = 0;
         for (auto& cnt : txn_cnts)
             total_txn_cnt += cnt;
+        for (auto& cnt : shifted_txn_cnts)
+            total_shifted_cnt += cnt;
+        if (total_shifted_cnt != 0)
+            std::cout << "Before shift: " << (total_txn_cnt - total_shifted_cnt) << " txns, after shift: "
+                      << total_shifted_cnt << " txns" << std::endl;
         return total_txn_cnt;
     }
 
@@ -161,6 +296,15 @@ public:
         mode_id mode = mode_id::ReadOnly;
         double time_limit = 10.0;
         bool enable_gc = false;
+        bool declare_ro = false;
+        double rtid_refresh_us = 0.0;
+        bool rtid_publisher = false;
+        const char *log_dir = nullptr;
+        int num_loggers = 1;
+        int num_coroutines = 0;
+        int det_batch = 0;
+        bool shift = false;
+        mode_id shift_mode = mode_id::ReadOnly;
 
         Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
 
@@ -173,16 +317,18 @@ public:
             case opt_nthrs:
                 num_threads = clp->val.i;
                 break;
-            case opt_mode: {
+            case opt_mode:
+            case opt_shift: {
+                mode_id m = mode_id::ReadOnly;
                 switch (*clp->val.s) {
                 case 'A':
-                    mode = mode_id::HighContention;
+                    m = mode_id::HighContention;
                     break;
                 case 'B':
-                    mode = mode_id::MediumContention;
+                    m = mode_id::MediumContention;
                     break;
                 case 'C':
-                    mode = mode_id::ReadOnly;
+                    m = mode_id::ReadOnly;
                     break;
                 default:
                     print_usage(argv[0]);
@@ -190,6 +336,12 @@ public:
                     clp_stop = true;
                     break;
                 }
+                if (opt == opt_mode)
+                    mode = m;
+                else {
+                    shift = true;
+                    shift_mode = m;
+                }
                 break;
             }
             case opt_time:
@@ -208,6 +360,27 @@ public:
                 break;
             case opt_comm:
                 break;
+            case opt_rdonly:
+                declare_ro = !clp->negated;
+                break;
+            case opt_rtidr:
+                rtid_refresh_us = clp->val.d;
+                break;
+            case opt_rtidp:
+                rtid_publisher = !clp->negated;
+                break;
+            case opt_logdir:
+                log_dir = clp->val.s;
+                break;
+            case opt_nloggers:
+                num_loggers = clp->val.i;
+                break;
+            case opt_coro:
+                num_coroutines = clp->val.i;
+                break;
+            case opt_det:
+                det_batch = clp->val.i;
+                break;
             default:
                 print_usage(argv[0]);
                 ret = 1;
@@ -220,6 +393,28 @@ public:
         if (ret != 0)
             return ret;
 
+        if (num_coroutines > 0) {
+#if STO_COROUTINES
+            if (num_threads * num_coroutines > MAX_THREADS) {
+                std::cerr << "--nthreads times --coroutines exceeds MAX_THREADS (" << MAX_THREADS << ")" << std::endl;
+                return 1;
+            }
+#else
+            std::cerr << "--coroutines requires a build with COROUTINES=1" << std::endl;
+            return 1;
+#endif
+        }
+
+        if (det_batch > 0 && num_coroutines > 0) {
+            std::cerr << "--deterministic and --coroutines are exclusive" << std::endl;
+            return 1;
+        }
+
+        if (shift && (det_batch > 0 || num_coroutines > 0)) {
+            std::cerr << "--shift does not work with --deterministic or --coroutines" << std::endl;
+            return 1;
+        }
+
         auto profiler_mode = counter_mode ?
                              Profiler::perf_mode::counters : Profiler::perf_mode::record;
 
@@ -242,22 +437,49 @@ public:
 
         std::vector<ycsb_runner<DBParams>> runners;
         for (int i = 0; i < num_threads; ++i) {
-            runners.emplace_back(i, db, mode);
+            runners.emplace_back(i, db, mode, declare_ro);
         }
 
         std::thread advancer;
         std::cout << "Generating workload..." << std::endl;
-        workload_generation(runners, mode);
+        workload_generation(runners, mode, shift, shift_mode);
         std::cout << "Done." << std::endl;
+        if (log_dir) {
+            // log epochs become durable only as the global epoch advances
+            db.set_log_ids();
+            enable_gc = true;
+        }
         if (enable_gc) {
             Transaction::set_epoch_cycle(1000);
             advancer = std::thread(&Transaction::epoch_advancer, nullptr);
             advancer.detach();
         }
+        if (rtid_refresh_us > 0.0) {
+            Transaction::set_rtid_refresh_cycles(
+                (uint64_t)(rtid_refresh_us * constants::processor_tsc_frequency * 1000.0));
+        }
+        if (rtid_publisher) {
+            std::thread publisher(&Transaction::rtid_publisher, nullptr);
+            publisher.detach();
+        }
 
+        if (log_dir) {
+            std::cout << "Logging to " << log_dir << " with " << num_loggers << " logger(s)" << std::endl;
+            if (!TLog::start(log_dir, num_loggers))
+                return 1;
+        }
+
+        db.reset_runtime_cc_stats();
         prof.start(profiler_mode);
-        auto num_trans = run_benchmark(db, prof, runners, time_limit);
+        auto num_trans = run_benchmark(db, prof, runners, time_limit, num_coroutines,
+                                       std::max(det_batch, 0));
         prof.finish(num_trans);
+        db.print_runtime_cc_stats(std::cout);
+
+        if (log_dir) {
+            TLog::stop();
+            TLog::print_stats(std::cout);
+        }
 
         return 0;
     }
@@ -341,6 +563,12 @@ int main(int argc, const char *const *argv) {
         ret_code = ycsb_access<db_swiss_params>::execute(argc, argv);
         break;
     */
+    case db_params_id::Runtime:
+        if (node_tracking || enable_commute) {
+            std::cerr << "Warning: node tracking and commute options ignored." << std::endl;
+        }
+        ret_code = ycsb_access<db_runtime_params>::execute(argc, argv);
+        break;
     case db_params_id::TicToc:
         if (node_tracking || enable_commute) {
             std::cerr << "Warning: node tracking and commute options ignored." << std::endl;
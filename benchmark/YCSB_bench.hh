@@ -14,6 +14,7 @@
 #endif
 #include "DB_index.hh"
 #include "DB_params.hh"
+#include "TCoroutine.hh"
 
 namespace ycsb {
 
@@ -23,6 +24,7 @@ using bench::mvcc_unordered_index;
 using bench::unordered_index;
 
 static constexpr uint64_t ycsb_table_size = 10000000;
+static constexpr size_t ycsb_max_txn_size = 16;
 
 template <typename DBParams>
 class ycsb_db {
@@ -64,6 +66,33 @@ public:
 #endif
     }
 
+    void set_log_ids() {
+#if TPCC_SPLIT_TABLE
+        ycsb_odd_table_.set_log_id(1);
+        ycsb_even_table_.set_log_id(2);
+#else
+        ycsb_table_.set_log_id(1);
+#endif
+    }
+
+    // Runtime concurrency control policies (DBParams::RuntimeCC)
+    void reset_runtime_cc_stats() {
+#if TPCC_SPLIT_TABLE
+        ycsb_odd_table_.runtime_cc().reset_stats();
+        ycsb_even_table_.runtime_cc().reset_stats();
+#else
+        ycsb_table_.runtime_cc().reset_stats();
+#endif
+    }
+    void print_runtime_cc_stats(std::ostream& w) {
+#if TPCC_SPLIT_TABLE
+        ycsb_odd_table_.runtime_cc().print_stats(w, "ycsb_odd");
+        ycsb_even_table_.runtime_cc().print_stats(w, "ycsb_even");
+#else
+        ycsb_table_.runtime_cc().print_stats(w, "ycsb");
+#endif
+    }
+
     void prepopulate();
 
 private:
@@ -96,8 +125,8 @@ template <typename DBParams>
 class ycsb_runner {
 public:
     static constexpr bool Commute = DBParams::Commute;
-    ycsb_runner(int tid, ycsb_db<DBParams>& database, mode_id mid)
-        : db(database), ig(tid), runner_id(tid), mode(mid),
+    ycsb_runner(int tid, ycsb_db<DBParams>& database, mode_id mid, bool ro = false)
+        : db(database), ig(tid), runner_id(tid), mode(mid), declare_ro(ro),
           ud(), dd(), write_threshold() {}
 
     inline void dist_init() {
@@ -121,25 +150,36 @@ public:
     }
 
     inline void gen_workload(int txn_size);
+    // Generate shifted_workload from YCSB variant @m
+    inline void gen_shifted_workload(mode_id m, int txn_size);
 
     int id() const {
         return runner_id;
     }
 
     inline void run_txn(const ycsb_txn_t& txn);
+#if STO_COROUTINES
+    // run_txn as a coroutine: before each row lookup it prefetches the
+    // row's index entries and suspends while they arrive
+    inline TCoroutine::task run_txn_coro(const ycsb_txn_t& txn);
+#endif
 
     std::vector<ycsb_txn_t> workload;
+    std::vector<ycsb_txn_t> shifted_workload;
 
 private:
     ycsb_db<DBParams>& db;
     ycsb_input_generator ig;
     int runner_id;
     mode_id mode;
+    bool declare_ro;
 
     sampling::StoUniformDistribution<> *ud;
     sampling::StoRandomDistribution<> *dd;
 
     uint32_t write_threshold;
+
+    inline void fill_workload(int txn_size, std::vector<ycsb_txn_t>& txns);
 };
 
 }; // namespace ycsb
@@ -17,6 +17,7 @@ using bench::version_adapter;
 enum class mode_id : int { ReadOnly = 0, MediumContention, HighContention };
 
 struct ycsb_key {
+    ycsb_key() = default;
     ycsb_key(uint64_t id) {
         // no scan operations for ycsb,
         // so byte swap is not required.
@@ -11,6 +11,20 @@ static constexpr uint64_t max_txns = 200000;
 template <typename DBParams>
 void ycsb_runner<DBParams>::gen_workload(int txn_size) {
     dist_init();
+    fill_workload(txn_size, workload);
+}
+
+template <typename DBParams>
+void ycsb_runner<DBParams>::gen_shifted_workload(mode_id m, int txn_size) {
+    delete ud;
+    delete dd;
+    mode = m;
+    dist_init();
+    fill_workload(txn_size, shifted_workload);
+}
+
+template <typename DBParams>
+void ycsb_runner<DBParams>::fill_workload(int txn_size, std::vector<ycsb_txn_t>& txns) {
     for (uint64_t i = 0; i < max_txns; ++i) {
         ycsb_txn_t txn {};
         txn.ops.reserve(txn_size);
@@ -36,7 +50,7 @@ void ycsb_runner<DBParams>::gen_workload(int txn_size) {
             txn.ops.push_back(std::move(op));
         }
         txn.rw_txn = any_write;
-        workload.push_back(std::move(txn));
+        txns.push_back(std::move(txn));
     }
 }
 
@@ -53,7 +67,22 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
         const void* value;
         if (DBParams::MVCC && txn.rw_txn) {
             Sto::mvcc_rw_upgrade();
+        } else if (declare_ro && !txn.rw_txn) {
+            Sto::declare_read_only();
         }
+#if BENCH_MULTIGET && !TPCC_SPLIT_TABLE && !TABLE_FINE_GRINED
+        // without commute all operations observe the row, so look them up at once
+        typename ycsb_db<DBParams>::ycsb_table_type::sel_return_type rows[ycsb_max_txn_size];
+        if (!Commute) {
+            ycsb_key keys[ycsb_max_txn_size];
+            size_t nkeys = 0;
+            assert(txn.ops.size() <= ycsb_max_txn_size);
+            for (auto& op : txn.ops)
+                keys[nkeys++] = ycsb_key(op.key);
+            TXN_DO(db.ycsb_table().select_rows(keys, nkeys, RowAccess::ObserveValue, rows));
+        }
+        size_t op_idx = 0;
+#endif
         for (auto& op : txn.ops) {
             bool col_parity = op.col_n % 2;
             auto col_group = col_parity ? nm::odd_columns : nm::even_columns;
@@ -77,6 +106,11 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
                     db.ycsb_half_tables(col_parity).update_row(row, new_val);
                 }
 #else
+#if BENCH_MULTIGET && !TABLE_FINE_GRINED
+                if (!Commute)
+                    std::tie(success, result, row, value) = rows[op_idx];
+                else
+#endif
                 std::tie(success, result, row, value)
                     = db.ycsb_table().select_row(key,
 #if TABLE_FINE_GRINED
@@ -109,6 +143,11 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
 
                 output = reinterpret_cast<const ycsb_half_value*>(value)->cols[op.col_n/2];
 #else
+#if BENCH_MULTIGET && !TABLE_FINE_GRINED
+                if (!Commute)
+                    std::tie(success, result, row, value) = rows[op_idx];
+                else
+#endif
                 std::tie(success, result, row, value)
                     = db.ycsb_table().select_row(key,
 #if TABLE_FINE_GRINED
@@ -124,8 +163,70 @@ void ycsb_runner<DBParams>::run_txn(const ycsb_txn_t& txn) {
 #endif
                 (void)output;
             }
+#if BENCH_MULTIGET && !TPCC_SPLIT_TABLE && !TABLE_FINE_GRINED
+            ++op_idx;
+#endif
+        }
+    } RETRY(true);
+}
+
+#if STO_COROUTINES
+template <typename DBParams>
+TCoroutine::task ycsb_runner<DBParams>::run_txn_coro(const ycsb_txn_t& txn) {
+    volatile ycsb_value::col_type output;
+#if TPCC_SPLIT_TABLE
+    typedef ycsb_half_value row_type;
+#else
+    typedef ycsb_value row_type;
+#endif
+
+    TRANSACTION {
+        bool success, result;
+        uintptr_t row;
+        const void* value;
+        if (DBParams::MVCC && txn.rw_txn) {
+            Sto::mvcc_rw_upgrade();
+        } else if (declare_ro && !txn.rw_txn) {
+            Sto::declare_read_only();
+        }
+        for (auto& op : txn.ops) {
+            ycsb_key key(op.key);
+#if TPCC_SPLIT_TABLE
+            auto& table = db.ycsb_half_tables(op.col_n % 2);
+            int col = op.col_n / 2;
+#else
+            auto& table = db.ycsb_table();
+            int col = op.col_n;
+#endif
+            for (int step = 0; const void* p = table.lookup_address(key, step); ++step)
+                co_await TCoroutine::prefetch(p);
+
+            if (op.is_write) {
+                std::tie(success, result, row, value)
+                    = table.select_row(key, Commute ? RowAccess::None : RowAccess::ObserveValue);
+                TXN_DO(success);
+                assert(result);
+
+                if (Commute) {
+                    commutators::Commutator<row_type> comm(col, op.write_value);
+                    table.update_row(row, comm);
+                } else {
+                    auto new_val = Sto::tx_alloc(reinterpret_cast<const row_type*>(value));
+                    new_val->cols[col] = op.write_value;
+                    table.update_row(row, new_val);
+                }
+            } else {
+                std::tie(success, result, row, value)
+                    = table.select_row(key, RowAccess::ObserveValue);
+                TXN_DO(success);
+                assert(result);
+
+                output = reinterpret_cast<const row_type*>(value)->cols[col];
+                (void)output;
+            }
         }
     } RETRY(true);
 }
+#endif
 
 };
@@ -0,0 +1,8 @@
+#include "TPCC_bench.hh"
+#include "TPCC_txns.hh"
+
+using namespace tpcc;
+
+int tpcc_h(int argc, char const* const* argv) {
+    return tpcc_access<db_hybrid_params>::execute(argc, argv);
+}
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <utility>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Concurrent skiplist used by the skiplist-based transactional containers.
+// Structure follows the lazy skiplist of Herlihy et al.: searches are
+// lock-free, inserts and removals lock only the predecessors they modify.
+//
+// Every node (including the head sentinel) carries a "gap version" of type V
+// that covers the keys strictly between the node and its level-0 successor.
+// The version word doubles as the node's structural lock. Linking a new node
+// into a gap bumps that gap's version, and unlinking a node bumps the node's
+// own gap version, so a transaction that observed a gap version can detect
+// any later change to the set of keys in that gap.
+//
+// Containers that link nodes at execution time use insert()/erase(), which
+// wait for the locks they need. Containers that change the structure while
+// holding commit locks use link_locked()/try_erase(), which never wait and
+// reuse gap locks the calling thread already holds.
+
+template <typename K, typename P, typename V>
+class skipnode {
+public:
+    typedef V version_type;
+
+    template <typename... Args>
+    skipnode(const K& key, int height, Args&&... args)
+        : key_(key), payload_(std::forward<Args>(args)...), gapvers_(),
+          height_(height), marked_(false), fully_linked_(false) {
+        for (int i = 0; i < height; ++i)
+            next_[i] = nullptr;
+    }
+
+    template <typename... Args>
+    static skipnode* make(int height, const K& key, Args&&... args) {
+        void* p = malloc(sizeof(skipnode) + (height - 1) * sizeof(skipnode*));
+        return new (p) skipnode(key, height, std::forward<Args>(args)...);
+    }
+    static void destroy(void* p) {
+        reinterpret_cast<skipnode*>(p)->~skipnode();
+        free(p);
+    }
+
+    const K& key() const {
+        return key_;
+    }
+    P& payload() {
+        return payload_;
+    }
+    const P& payload() const {
+        return payload_;
+    }
+    version_type& gapversion() {
+        return gapvers_;
+    }
+    int height() const {
+        return height_;
+    }
+    bool marked() const {
+        return marked_;
+    }
+    bool fully_linked() const {
+        return fully_linked_;
+    }
+    skipnode* next(int level) const {
+        skipnode* n = next_[level];
+        acquire_fence();
+        return n;
+    }
+
+private:
+    const K key_;
+    P payload_;
+    version_type gapvers_;
+    int height_;            // only lowered before fully_linked_ is set
+    volatile bool marked_;
+    volatile bool fully_linked_;
+    skipnode* volatile next_[1];
+
+    template <typename, typename, typename, typename> friend class skiplist;
+};
+
+template <typename K, typename P, typename V, typename Compare = std::less<K>>
+class skiplist {
+public:
+    typedef skipnode<K, P, V> node_type;
+    typedef V version_type;
+    static constexpr int max_height = 24;
+
+    struct insert_result {
+        node_type* node;
+        bool inserted;
+        // level-0 predecessor and its gap version around the insertion
+        // (only valid if @inserted)
+        node_type* pred;
+        version_type pred_before;
+        version_type pred_after;
+    };
+
+    struct erase_result {
+        bool erased;
+        // level-0 predecessor and its gap version right after the unlink,
+        // and the victim's gap version right before it was bumped
+        // (only valid if @erased)
+        node_type* pred;
+        version_type pred_gapvers;
+        version_type victim_gapvers;
+    };
+
+    explicit skiplist(Compare comp = Compare())
+        : comp_(comp), top_(1) {
+        head_ = node_type::make(max_height, K());
+        head_->fully_linked_ = true;
+    }
+    ~skiplist() {
+        node_type* n = head_;
+        while (n) {
+            node_type* next = n->next_[0];
+            node_type::destroy(n);
+            n = next;
+        }
+    }
+
+    node_type* head() const {
+        return head_;
+    }
+    static node_type* next(node_type* n) {
+        return n->next(0);
+    }
+
+    // Lock-free search. Fills @preds and @succs for every level and returns
+    // the highest level at which a node with @key was found, or -1.
+    int find(const K& key, node_type** preds, node_type** succs) const {
+        int found = -1;
+        int top = top_;
+        acquire_fence();
+        node_type* pred = head_;
+        for (int l = max_height - 1; l >= top; --l) {
+            preds[l] = head_;
+            succs[l] = nullptr;
+        }
+        for (int l = top - 1; l >= 0; --l) {
+            node_type* curr = pred->next(l);
+            while (curr && comp_(curr->key_, key)) {
+                pred = curr;
+                curr = pred->next(l);
+            }
+            if (found == -1 && curr && !comp_(key, curr->key_))
+                found = l;
+            preds[l] = pred;
+            succs[l] = curr;
+        }
+        return found;
+    }
+
+    // Level-0 lookup for transactional readers. Returns the node holding
+    // @key if there is one that is not being unlinked. Otherwise returns nullptr
+    // and sets @pred and @gapvers to a consistent snapshot of the gap that
+    // would hold @key: no node was linked after @pred while @gapvers was
+    // current.
+    node_type* lookup(const K& key, node_type*& pred, version_type& gapvers) const {
+        node_type* preds[max_height];
+        node_type* succs[max_height];
+        while (true) {
+            int lfound = find(key, preds, succs);
+            if (lfound >= 0) {
+                if (!succs[lfound]->marked_)
+                    return succs[lfound];
+                relax_fence();
+                continue;
+            }
+            pred = preds[0];
+            gapvers = pred->gapvers_;
+            acquire_fence();
+            if (!gapvers.is_locked() && !pred->marked_
+                && pred->next_[0] == succs[0])
+                return nullptr;
+            relax_fence();
+        }
+    }
+
+    // Nontransactional point lookup; ignores nodes being unlinked.
+    node_type* find_node(const K& key) const {
+        node_type* preds[max_height];
+        node_type* succs[max_height];
+        int lfound = find(key, preds, succs);
+        if (lfound < 0)
+            return nullptr;
+        node_type* n = succs[lfound];
+        return (n->fully_linked_ && !n->marked_) ? n : nullptr;
+    }
+
+    // Level-0 predecessor of @key, and through @succ its successor at the
+    // time of the search. Returns nullptr if a node with @key is linked.
+    node_type* find_pred(const K& key, node_type*& succ) const {
+        node_type* preds[max_height];
+        node_type* succs[max_height];
+        if (find(key, preds, succs) >= 0)
+            return nullptr;
+        succ = succs[0];
+        return preds[0];
+    }
+
+    // Insert a node for @key (payload constructed from @args) unless one is
+    // already linked. Only the predecessors at the new node's levels are
+    // locked; the level-0 predecessor's gap version is bumped.
+    template <typename... Args>
+    insert_result insert(const K& key, Args&&... args) {
+        node_type* preds[max_height];
+        node_type* succs[max_height];
+        int height = random_height();
+        while (true) {
+            int lfound = find(key, preds, succs);
+            if (lfound >= 0) {
+                node_type* found = succs[lfound];
+                if (!found->marked_) {
+                    while (!found->fully_linked_)
+                        relax_fence();
+                    return {found, false, nullptr, version_type(), version_type()};
+                }
+                // being unlinked; wait until it is gone
+                relax_fence();
+                continue;
+            }
+
+            int highest_locked = -1;
+            bool valid = true;
+            for (int l = 0; valid && l < height; ++l) {
+                node_type* pred = preds[l];
+                node_type* succ = succs[l];
+                if (l == 0 || pred != preds[l - 1]) {
+                    pred->gapvers_.lock_exclusive();
+                    highest_locked = l;
+                }
+                valid = !pred->marked_ && (!succ || !succ->marked_)
+                    && pred->next_[l] == succ;
+            }
+            if (!valid) {
+                unlock_preds(preds, highest_locked);
+                relax_fence();
+                continue;
+            }
+
+            node_type* n = node_type::make(height, key, std::forward<Args>(args)...);
+            for (int l = 0; l < height; ++l)
+                n->next_[l] = succs[l];
+            release_fence();
+            for (int l = 0; l < height; ++l)
+                preds[l]->next_[l] = n;
+
+            version_type before(preds[0]->gapvers_.unlocked_value());
+            preds[0]->gapvers_.inc_nonopaque();
+            version_type after(preds[0]->gapvers_.unlocked_value());
+            release_fence();
+            n->fully_linked_ = true;
+            unlock_preds(preds, highest_locked);
+            raise_top(height);
+            return {n, true, preds[0], before, after};
+        }
+    }
+
+    // Unlink @victim. Fails if another thread is already doing so. The
+    // caller is responsible for reclaiming the node (after an RCU grace
+    // period if other threads may still be traversing it).
+    erase_result erase(node_type* victim) {
+        node_type* preds[max_height];
+        node_type* succs[max_height];
+        while (!victim->fully_linked_)
+            relax_fence();
+        victim->gapvers_.lock_exclusive();
+        if (victim->marked_) {
+            victim->gapvers_.unlock_exclusive();
+            return {false, nullptr, version_type(), version_type()};
+        }
+        victim->marked_ = true;
+        fence();
+
+        while (true) {
+            find(victim->key_, preds, succs);
+            int highest_locked = -1;
+            bool valid = true;
+            for (int l = 0; valid && l < victim->height_; ++l) {
+                node_type* pred = preds[l];
+                if (l == 0 || pred != preds[l - 1]) {
+                    pred->gapvers_.lock_exclusive();
+                    highest_locked = l;
+                }
+                valid = !pred->marked_ && pred->next_[l] == victim;
+            }
+            if (!valid) {
+                unlock_preds(preds, highest_locked);
+                relax_fence();
+                continue;
+            }
+
+            for (int l = victim->height_ - 1; l >= 0; --l)
+                preds[l]->next_[l] = victim->next_[l];
+            // readers of the victim's gap must not miss keys that are now
+            // inserted under its predecessor
+            version_type pred_gapvers(preds[0]->gapvers_.unlocked_value());
+            version_type victim_gapvers(victim->gapvers_.unlocked_value());
+            victim->gapvers_.inc_nonopaque();
+            release_fence();
+            victim->gapvers_.unlock_exclusive();
+            unlock_preds(preds, highest_locked);
+            return {true, preds[0], pred_gapvers, victim_gapvers};
+        }
+    }
+
+    // Link @n, made with node_type::make() and not yet published, right
+    // after @pred. The calling thread must hold @pred's gap lock, and @n's key
+    // must belong in @pred's gap. @n is linked at level 0 with its own gap
+    // lock held (the caller releases it with unlock_exclusive()); upper
+    // levels are linked only while their predecessors can be locked without
+    // waiting, so the tower may end up shorter than planned. Bumps @pred's
+    // gap version.
+    void link_locked(node_type* n, node_type* pred) {
+        node_type* preds[max_height];
+        node_type* succs[max_height];
+        assert(pred->gapvers_.is_locked_here() && !pred->marked_);
+        n->gapvers_.lock_exclusive();
+        n->next_[0] = pred->next_[0];
+        release_fence();
+        pred->next_[0] = n;
+        pred->gapvers_.inc_nonopaque();
+
+        int height = 1;
+        if (n->height_ > 1) {
+            find(n->key_, preds, succs);
+            for (; height < n->height_; ++height) {
+                node_type* p = preds[height];
+                node_type* succ = succs[height];
+                bool owned = p->gapvers_.is_locked_here();
+                if (!owned && !try_lock_gap(p))
+                    break;
+                bool valid = !p->marked_ && (!succ || !succ->marked_)
+                    && p->next_[height] == succ;
+                if (valid) {
+                    n->next_[height] = succ;
+                    release_fence();
+                    p->next_[height] = n;
+                }
+                if (!owned)
+                    p->gapvers_.unlock_exclusive();
+                if (!valid)
+                    break;
+            }
+        }
+        n->height_ = height;
+        release_fence();
+        n->fully_linked_ = true;
+        raise_top(height);
+    }
+
+    // Non-blocking erase(): fails instead of waiting for a lock. Gap locks
+    // the calling thread already holds are used as they are.
+    erase_result try_erase(node_type* victim) {
+        node_type* preds[max_height];
+        node_type* succs[max_height];
+        bool owned[max_height];
+        erase_result fail = {false, nullptr, version_type(), version_type()};
+        if (!victim->fully_linked_ || victim->marked_)
+            return fail;
+        bool victim_owned = victim->gapvers_.is_locked_here();
+        if (!victim_owned && !try_lock_gap(victim))
+            return fail;
+
+        find(victim->key_, preds, succs);
+        int highest_locked = -1;
+        bool valid = !victim->marked_;
+        for (int l = 0; valid && l < victim->height_; ++l) {
+            node_type* pred = preds[l];
+            if (l == 0 || pred != preds[l - 1]) {
+                owned[l] = pred->gapvers_.is_locked_here();
+                if (!owned[l] && !try_lock_gap(pred)) {
+                    valid = false;
+                    break;
+                }
+                highest_locked = l;
+            }
+            valid = !pred->marked_ && pred->next_[l] == victim;
+        }
+        if (valid) {
+            victim->marked_ = true;
+            fence();
+            for (int l = victim->height_ - 1; l >= 0; --l)
+                preds[l]->next_[l] = victim->next_[l];
+        }
+        erase_result r = fail;
+        if (valid) {
+            r = {true, preds[0], version_type(preds[0]->gapvers_.unlocked_value()),
+                 version_type(victim->gapvers_.unlocked_value())};
+            victim->gapvers_.inc_nonopaque();
+            release_fence();
+        }
+        for (int l = 0; l <= highest_locked; ++l)
+            if ((l == 0 || preds[l] != preds[l - 1]) && !owned[l])
+                preds[l]->gapvers_.unlock_exclusive();
+        if (!victim_owned)
+            victim->gapvers_.unlock_exclusive();
+        return r;
+    }
+
+    // Geometric tower heights with p = 1/4
+    static int random_height() {
+        static __thread uint64_t seed;
+        if (!seed)
+            seed = (uint64_t(TThread::id()) + 1) * 0x9E3779B97F4A7C15ULL;
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        uint64_t r = seed;
+        int height = 1;
+        while ((r & 3) == 0 && height < max_height) {
+            ++height;
+            r >>= 2;
+        }
+        return height;
+    }
+
+    // Number of linked, unmarked nodes. Not linearizable.
+    size_t nontrans_size() const {
+        size_t n = 0;
+        for (node_type* x = next(head_); x; x = next(x))
+            if (!x->marked_)
+                ++n;
+        return n;
+    }
+
+private:
+    node_type* head_;
+    Compare comp_;
+    int top_;
+
+    static void unlock_preds(node_type** preds, int highest_locked) {
+        for (int l = 0; l <= highest_locked; ++l)
+            if (l == 0 || preds[l] != preds[l - 1])
+                preds[l]->gapvers_.unlock_exclusive();
+    }
+
+    static bool try_lock_gap(node_type* n) {
+        version_type v = n->gapvers_;
+        return !v.is_locked()
+            && n->gapvers_.bool_cmpxchg(v, version_type(v.value() | TransactionTid::lock_bit | TThread::id()));
+    }
+
+    void raise_top(int height) {
+        int top = top_;
+        while (top < height && !bool_cmpxchg(&top_, top, height)) {
+            acquire_fence();
+            top = top_;
+        }
+    }
+};
@@ -0,0 +1,337 @@
+#pragma once
+
+#include <functional>
+#include <utility>
+#include "Sto.hh"
+#include "SkipListInternal.hh"
+
+template <typename K, typename T, bool GlobalSize, typename Compare> class SkipMapProxy;
+
+// Ordered transactional map with the same interface as RBTree, built on a
+// concurrent skiplist instead of a tree behind a global lock. Readers never
+// lock; structural changes only lock the nodes whose links they modify.
+//
+// Every node carries a value version and a gap version (see
+// SkipListInternal.hh). Present keys are validated with the value version;
+// absent keys with the gap version of their predecessor. Inserts are linked
+// into the skiplist at execution time, marked with invalid_bit until commit.
+// Deletes set invalid_bit at commit and are unlinked in cleanup.
+// K must be default-constructible (the head sentinel holds a K()).
+template <typename K, typename T, bool GlobalSize = false, typename Compare = std::less<K>>
+class SkipMap : public TObject {
+    friend class SkipMapProxy<K, T, GlobalSize, Compare>;
+public:
+    typedef K key_type;
+    typedef T value_type;
+    typedef TOpaqueWrapped<T> wrapped_type;
+    typedef typename wrapped_type::version_type version_type;
+    typedef SkipMapProxy<K, T, GlobalSize, Compare> proxy_type;
+
+    static constexpr TransItem::flags_type insert_tag = TransItem::user0_bit;
+    static constexpr TransItem::flags_type delete_tag = TransItem::user0_bit<<1;
+    static constexpr TransactionTid::type invalid_bit = TransactionTid::user_bit;
+
+    struct entry {
+        entry()
+            : vers_(), val_() {}
+        entry(bool valid, const T& value)
+            : vers_(valid ? Sto::initialized_tid() : (Sto::initialized_tid() | invalid_bit)),
+              val_(value) {}
+
+        version_type vers_;
+        wrapped_type val_;
+    };
+
+    // gap versions are bumped at execution time, outside of any commit
+    typedef TNonopaqueVersion gap_version_type;
+    typedef skiplist<K, entry, gap_version_type, Compare> list_type;
+    typedef typename list_type::node_type node_type;
+
+    SkipMap()
+        : size_(0) {
+    }
+
+    // capacity
+    size_t size() const {
+        always_assert(GlobalSize);
+        auto size_item = Sto::item(const_cast<SkipMap*>(this), size_key_);
+        if (!size_item.has_read() && !size_item.observe(const_cast<version_type&>(sizeversion_)))
+            Sto::abort();
+        ssize_t offset = size_item.has_write() ? size_item.template write_value<ssize_t>() : 0;
+        return size_ + offset;
+    }
+
+    // lookup
+    size_t count(const K& key) const {
+        return visible_node(key) ? 1 : 0;
+    }
+    bool find(const K& key, T& value) const {
+        node_type* n = visible_node(key);
+        if (!n)
+            return false;
+        auto item = Sto::item(const_cast<SkipMap*>(this), n);
+        value = read_value(item, n);
+        return true;
+    }
+
+    // element access
+    proxy_type operator[](const K& key) {
+        return proxy_type(*this, insert_node(key, T()).first);
+    }
+
+    // modifiers
+    bool insert(const K& key, const T& value) {
+        return insert_node(key, value).second;
+    }
+    size_t erase(const K& key) {
+        node_type* n = visible_node(key);
+        if (!n)
+            return 0;
+        auto item = Sto::item(this, n);
+        if (has_insert(item)) {
+            // erasing something we inserted: unlink it now
+            auto r = list_.erase(n);
+            always_assert(r.erased);
+            Transaction::rcu_call(node_type::destroy, n);
+            item.remove_read().remove_write().clear_flags(insert_tag | delete_tag);
+            // the keys in @n's gap now belong to its predecessor's gap
+            auto gap_item = Sto::item(this, gap_key(n));
+            if (gap_item.has_read()) {
+                if (gap_item.template read_value<gap_version_type>() != r.victim_gapvers)
+                    Sto::abort();
+                gap_item.remove_read();
+            }
+            if (!Sto::item(this, gap_key(r.pred)).observe(r.pred_gapvers))
+                Sto::abort();
+            change_size_offset(-1);
+            return 1;
+        }
+        item.add_write().add_flags(delete_tag);
+        change_size_offset(-1);
+        return 1;
+    }
+
+    // nontransactional methods; not safe against concurrent transactions
+    bool nontrans_insert(const K& key, const T& value) {
+        auto r = list_.insert(key, true, value);
+        if (r.inserted)
+            ++size_;
+        return r.inserted;
+    }
+    bool nontrans_contains(const K& key) const {
+        return list_.find_node(key) != nullptr;
+    }
+    bool nontrans_find(const K& key, T& value) const {
+        node_type* n = list_.find_node(key);
+        if (n)
+            value = n->payload().val_.access();
+        return n != nullptr;
+    }
+    T nontrans_find(const K& key) const {
+        T value = T();
+        nontrans_find(key, value);
+        return value;
+    }
+    bool nontrans_remove(const K& key) {
+        node_type* n = list_.find_node(key);
+        if (!n || !list_.erase(n).erased)
+            return false;
+        node_type::destroy(n);
+        --size_;
+        return true;
+    }
+    size_t nontrans_size() const {
+        return list_.nontrans_size();
+    }
+
+    // TObject interface
+    bool lock(TransItem& item, Transaction& txn) override {
+        if (item.key<uintptr_t>() == size_key_)
+            return txn.try_lock(item, sizeversion_);
+        return txn.try_lock(item, item.key<node_type*>()->payload().vers_);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        uintptr_t k = item.key<uintptr_t>();
+        if (k == size_key_)
+            return sizeversion_.cp_check_version(txn, item);
+        else if (k & gap_bit)
+            return gap_node(item)->gapversion().cp_check_version(txn, item);
+        else
+            return item.key<node_type*>()->payload().vers_.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        if (item.key<uintptr_t>() == size_key_) {
+            always_assert(GlobalSize);
+            size_ += item.template write_value<ssize_t>();
+            txn.set_version_unlock(sizeversion_, item);
+            return;
+        }
+        entry& e = item.key<node_type*>()->payload();
+        if (has_delete(item)) {
+            // stays locked; the node is unlinked in cleanup
+            txn.set_version(e.vers_, invalid_bit);
+            return;
+        }
+        e.val_.write(item.template write_value<T>());
+        txn.set_version_unlock(e.vers_, item);
+    }
+    void unlock(TransItem& item) override {
+        if (item.key<uintptr_t>() == size_key_)
+            sizeversion_.cp_unlock(item);
+        else
+            item.key<node_type*>()->payload().vers_.cp_unlock(item);
+    }
+    void cleanup(TransItem& item, bool committed) override {
+        if (committed ? has_delete(item) : has_insert(item)) {
+            node_type* n = item.key<node_type*>();
+            if (list_.erase(n).erased)
+                Transaction::rcu_call(node_type::destroy, n);
+            item.clear_needs_unlock();
+        }
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        w << "{SkipMap<" << typeid(K).name() << "," << typeid(T).name() << "> " << (void*) this;
+        uintptr_t k = item.key<uintptr_t>();
+        if (k == size_key_)
+            w << ".size";
+        else if (k & gap_bit)
+            w << "." << (void*) gap_node(item) << "G";
+        else
+            w << "." << (void*) k;
+        if (item.has_read() && (k & gap_bit))
+            w << " R" << item.read_value<gap_version_type>();
+        else if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        if (item.has_write()) {
+            if (k == size_key_)
+                w << " Δ" << item.write_value<ssize_t>();
+            else if (has_delete(item))
+                w << " D";
+            else
+                w << " =" << item.write_value<T>();
+        }
+        w << "}";
+    }
+
+private:
+    list_type list_;
+    version_type sizeversion_;
+    size_t size_;
+
+    static constexpr uintptr_t gap_bit = 1;
+    static constexpr uintptr_t size_key_ = 2;
+
+    static uintptr_t gap_key(node_type* n) {
+        return reinterpret_cast<uintptr_t>(n) | gap_bit;
+    }
+    static node_type* gap_node(const TransItem& item) {
+        return reinterpret_cast<node_type*>(item.key<uintptr_t>() & ~gap_bit);
+    }
+    static bool has_insert(const TransItem& item) {
+        return item.flags() & insert_tag;
+    }
+    static bool has_delete(const TransItem& item) {
+        return item.flags() & delete_tag;
+    }
+
+    // Abort unless the observed version of the node says it is committed
+    // and present (or it is our own insert).
+    static void check_visible(TransProxy& item) {
+        if (!has_insert(item.item())
+            && (item.template read_value<version_type>() & invalid_bit))
+            Sto::abort();
+    }
+
+    // Returns the node for @key as this transaction sees it, observing its
+    // version; or nullptr, observing the gap that would hold @key.
+    node_type* visible_node(const K& key) const {
+        SkipMap* self = const_cast<SkipMap*>(this);
+        node_type* pred;
+        gap_version_type gapvers;
+        node_type* n = list_.lookup(key, pred, gapvers);
+        if (!n) {
+            if (!Sto::item(self, gap_key(pred)).observe(gapvers))
+                Sto::abort();
+            return nullptr;
+        }
+        auto item = Sto::item(self, n);
+        if (has_delete(item))
+            return nullptr;
+        if (!has_insert(item)) {
+            if (!item.observe(n->payload().vers_))
+                Sto::abort();
+            check_visible(item);
+        }
+        return n;
+    }
+
+    T read_value(TransProxy& item, node_type* n) const {
+        if (item.has_write())
+            return item.template write_value<T>();
+        auto result = n->payload().val_.read(item, n->payload().vers_);
+        if (!result.first)
+            Sto::abort();
+        check_visible(item);
+        return result.second;
+    }
+
+    // Returns the node for @key and whether it was absent before.
+    std::pair<node_type*, bool> insert_node(const K& key, const T& value) {
+        auto r = list_.insert(key, false, value);
+        auto item = Sto::item(this, r.node);
+        if (r.inserted) {
+            // we split the predecessor's gap ourselves
+            Sto::item(this, gap_key(r.pred)).update_read(r.pred_before, r.pred_after);
+            item.add_write(value).add_flags(insert_tag);
+            change_size_offset(1);
+            return {r.node, true};
+        }
+        if (has_delete(item)) {
+            item.clear_flags(delete_tag).add_write(value);
+            change_size_offset(1);
+            return {r.node, true};
+        }
+        if (!has_insert(item)) {
+            if (!item.observe(r.node->payload().vers_))
+                Sto::abort();
+            check_visible(item);
+        }
+        return {r.node, false};
+    }
+
+    void change_size_offset(ssize_t delta) {
+        if (!GlobalSize)
+            return;
+        auto size_item = Sto::item(this, size_key_);
+        ssize_t offset = size_item.has_write() ? size_item.template write_value<ssize_t>() : 0;
+        size_item.add_write(offset + delta);
+    }
+};
+
+// STL-ish interface wrapper returned by SkipMap::operator[]
+template <typename K, typename T, bool GlobalSize, typename Compare>
+class SkipMapProxy {
+public:
+    typedef SkipMap<K, T, GlobalSize, Compare> map_type;
+    typedef typename map_type::node_type node_type;
+
+    SkipMapProxy(map_type& map, node_type* node)
+        : map_(map), node_(node) {}
+
+    operator T() {
+        auto item = Sto::item(&map_, node_);
+        return map_.read_value(item, node_);
+    }
+    SkipMapProxy& operator=(const T& value) {
+        Sto::item(&map_, node_).add_write(value);
+        return *this;
+    }
+    SkipMapProxy& operator=(SkipMapProxy& other) {
+        Sto::item(&map_, node_).add_write((T) other);
+        return *this;
+    }
+
+private:
+    map_type& map_;
+    node_type* node_;
+};
@@ -1,6 +1,7 @@
 #pragma once
 #include "TWrapped.hh"
 #include "TArrayProxy.hh"
+#include "TArrayLayout.hh"
 #include "Transaction.hh"
 #include <climits>
 #include <pthread.h>
@@ -9,7 +10,8 @@
 #include <sstream>
 #include <cstdlib>
 
-template <typename T, unsigned N, template <typename> class W = TSwissNonopaqueWrapped>
+template <typename T, unsigned N, template <typename> class W = TSwissNonopaqueWrapped,
+          typename L = array_layout::dense>
 class SwissTArray : public TObject {
 public:
     class iterator;
@@ -19,8 +21,8 @@ public:
     typedef typename W<T>::version_type version_type;
     typedef unsigned size_type;
     typedef int difference_type;
-    typedef TConstArrayProxy<SwissTArray<T, N, W> > const_proxy_type;
-    typedef TArrayProxy<SwissTArray<T, N, W> > proxy_type;
+    typedef TConstArrayProxy<SwissTArray<T, N, W, L> > const_proxy_type;
+    typedef TArrayProxy<SwissTArray<T, N, W, L> > proxy_type;
 
     size_type size() const {
         return N;
@@ -51,13 +53,13 @@ public:
             return true;
         } else {
             bool ok;
-            std::tie(ok, ret) = data_[i].v.read(item, data_[i].version);
+            std::tie(ok, ret) = data_.value(i).read(item, data_.version(i));
             return ok;
         }
     }
     bool transPut(size_type i, T x) {
         assert(i < N);
-        return Sto::item(this, i).acquire_write(data_[i].version, x);
+        return Sto::item(this, i).acquire_write(data_.version(i), x);
     }
     // the throw versions
     get_type transGet_throws(size_type i) const {
@@ -74,57 +76,53 @@ public:
     }
     get_type nontrans_get(size_type i) const {
         assert(i < N);
-        return data_[i].v.access();
+        return data_.value(i).access();
     }
     void nontrans_put(size_type i, const T& x) {
         assert(i < N);
-        data_[i].v.access() = x;
+        data_.value(i).access() = x;
     }
     void nontrans_put(size_type i, T&& x) {
         assert(i < N);
-        data_[i].v.access() = std::move(x);
+        data_.value(i).access() = std::move(x);
     }
 
     // transactional methods
     bool lock(TransItem& item, Transaction& txn) override {
         // read lock is always set successfully if we ever make it to commit
-        auto ok = txn.try_lock(item, data_[item.key<size_type>()].version);
+        auto ok = txn.try_lock(item, data_.version(item.key<size_type>()));
         assert(ok);
         return true;
     }
     bool check(TransItem& item, Transaction& txn) override {
-        return data_[item.key<size_type>()].version.cp_check_version(txn, item);
-        //return item.check_version(data_[item.key<size_type>()].version);
+        return data_.version(item.key<size_type>()).cp_check_version(txn, item);
+        //return item.check_version(data_.version(item.key<size_type>()));
     }
     void install(TransItem& item, Transaction& txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
-        txn.set_version_unlock(data_[i].version, item);
+        data_.value(i).write(item.write_value<T>());
+        txn.set_version_unlock(data_.version(i), item);
     }
     void unlock(TransItem& item) override {
-        data_[item.key<size_type>()].version.cp_unlock(item);
+        data_.version(item.key<size_type>()).cp_unlock(item);
     }
 
 private:
-    struct elem {
-        mutable version_type version;
-        W<T> v;
-    };
-    elem data_[N];
+    TArrayStorage<version_type, W<T>, N, L> data_;
 
     friend class iterator;
     friend class const_iterator;
 };
 
 
-template <typename T, unsigned N, template <typename> class W>
-class SwissTArray<T, N, W>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
+template <typename T, unsigned N, template <typename> class W, typename L>
+class SwissTArray<T, N, W, L>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
 public:
-    typedef SwissTArray<T, N, W> array_type;
+    typedef SwissTArray<T, N, W, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    const_iterator(const SwissTArray<T, N, W>* a, size_type i)
+    const_iterator(const SwissTArray<T, N, W, L>* a, size_type i)
         : a_(const_cast<array_type*>(a)), i_(i) {
     }
 
@@ -196,14 +194,14 @@ protected:
     size_type i_;
 };
 
-template <typename T, unsigned N, template <typename> class W>
-class SwissTArray<T, N, W>::iterator : public const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+class SwissTArray<T, N, W, L>::iterator : public const_iterator {
 public:
-    typedef SwissTArray<T, N, W> array_type;
+    typedef SwissTArray<T, N, W, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    iterator(const SwissTArray<T, N, W>* a, size_type i)
+    iterator(const SwissTArray<T, N, W, L>* a, size_type i)
         : const_iterator(a, i) {
     }
 
@@ -243,32 +241,32 @@ public:
     }
 };
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto SwissTArray<T, N, W>::begin() -> iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto SwissTArray<T, N, W, L>::begin() -> iterator {
     return iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto SwissTArray<T, N, W>::end() -> iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto SwissTArray<T, N, W, L>::end() -> iterator {
     return iterator(this, N);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto SwissTArray<T, N, W>::cbegin() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto SwissTArray<T, N, W, L>::cbegin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto SwissTArray<T, N, W>::cend() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto SwissTArray<T, N, W, L>::cend() const -> const_iterator {
     return const_iterator(this, N);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto SwissTArray<T, N, W>::begin() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto SwissTArray<T, N, W, L>::begin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto SwissTArray<T, N, W>::end() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto SwissTArray<T, N, W, L>::end() const -> const_iterator {
     return const_iterator(this, N);
 }
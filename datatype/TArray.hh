@@ -2,8 +2,10 @@
 
 #include "Sto.hh"
 #include "TArrayProxy.hh"
+#include "TArrayLayout.hh"
 
-template <typename T, unsigned N, template <typename> class W = TOpaqueWrapped>
+template <typename T, unsigned N, template <typename> class W = TOpaqueWrapped,
+          typename L = array_layout::dense>
 class TArray : public TObject {
 public:
     class iterator;
@@ -13,8 +15,8 @@ public:
     typedef typename W<T>::version_type version_type;
     typedef unsigned size_type;
     typedef int difference_type;
-    typedef TConstArrayProxy<TArray<T, N, W> > const_proxy_type;
-    typedef TArrayProxy<TArray<T, N, W> > proxy_type;
+    typedef TConstArrayProxy<TArray<T, N, W, L> > const_proxy_type;
+    typedef TArrayProxy<TArray<T, N, W, L> > proxy_type;
 
     size_type size() const {
         return N;
@@ -45,7 +47,7 @@ public:
             return true;
         }
         else {
-            auto result = data_[i].v.read(item, data_[i].vers);
+            auto result = data_.value(i).read(item, data_.version(i));
             ret = result.second;
             return result.first;
         }
@@ -57,7 +59,7 @@ public:
             return item.template write_value<T>();
         }
         else {
-            auto result = data_[i].v.read(item, data_[i].vers);
+            auto result = data_.value(i).read(item, data_.version(i));
             if (!result.first)
                 throw Transaction::Abort();
             return result.second;
@@ -74,53 +76,50 @@ public:
 
     get_type nontrans_get(size_type i) const {
         assert(i < N);
-        return data_[i].v.access();
+        return data_.value(i).access();
     }
     void nontrans_put(size_type i, const T& x) {
         assert(i < N);
-        data_[i].v.access() = x;
+        data_.value(i).access() = x;
     }
     void nontrans_put(size_type i, T&& x) {
         assert(i < N);
-        data_[i].v.access() = std::move(x);
+        data_.value(i).access() = std::move(x);
     }
 
     // transactional methods
     bool lock(TransItem& item, Transaction& txn) override {
-        return txn.try_lock(item, data_[item.key<size_type>()].vers);
+        return version_policy::lock(item, txn, data_.version(item.key<size_type>()));
     }
     bool check(TransItem& item, Transaction& txn) override {
-        return data_[item.key<size_type>()].vers.cp_check_version(txn, item);
+        return version_policy::check(item, txn, data_.version(item.key<size_type>()));
     }
     void install(TransItem& item, Transaction& txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
-        txn.set_version_unlock(data_[i].vers, item);
+        data_.value(i).write(item.write_value<T>());
+        version_policy::install(item, txn, data_.version(i));
     }
     void unlock(TransItem& item) override {
-        data_[item.key<size_type>()].vers.cp_unlock(item);
+        version_policy::unlock(item, data_.version(item.key<size_type>()));
     }
 
 private:
-    struct elem {
-        version_type vers;
-        W<T> v;
-    };
-    elem data_[N];
+    typedef TArrayVersionPolicy<L> version_policy;
+    TArrayStorage<version_type, W<T>, N, L> data_;
 
     friend class iterator;
     friend class const_iterator;
 };
 
 
-template <typename T, unsigned N, template <typename> class W>
-class TArray<T, N, W>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
+template <typename T, unsigned N, template <typename> class W, typename L>
+class TArray<T, N, W, L>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
 public:
-    typedef TArray<T, N, W> array_type;
+    typedef TArray<T, N, W, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    const_iterator(const TArray<T, N, W>* a, size_type i)
+    const_iterator(const TArray<T, N, W, L>* a, size_type i)
         : a_(const_cast<array_type*>(a)), i_(i) {
     }
 
@@ -192,14 +191,14 @@ protected:
     size_type i_;
 };
 
-template <typename T, unsigned N, template <typename> class W>
-class TArray<T, N, W>::iterator : public const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+class TArray<T, N, W, L>::iterator : public const_iterator {
 public:
-    typedef TArray<T, N, W> array_type;
+    typedef TArray<T, N, W, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    iterator(const TArray<T, N, W>* a, size_type i)
+    iterator(const TArray<T, N, W, L>* a, size_type i)
         : const_iterator(a, i) {
     }
 
@@ -239,32 +238,32 @@ public:
     }
 };
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArray<T, N, W>::begin() -> iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArray<T, N, W, L>::begin() -> iterator {
     return iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArray<T, N, W>::end() -> iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArray<T, N, W, L>::end() -> iterator {
     return iterator(this, N);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArray<T, N, W>::cbegin() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArray<T, N, W, L>::cbegin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArray<T, N, W>::cend() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArray<T, N, W, L>::cend() const -> const_iterator {
     return const_iterator(this, N);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArray<T, N, W>::begin() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArray<T, N, W, L>::begin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArray<T, N, W>::end() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArray<T, N, W, L>::end() const -> const_iterator {
     return const_iterator(this, N);
 }
@@ -2,8 +2,10 @@
 
 #include "Sto.hh"
 #include "TArrayProxy.hh"
+#include "TArrayLayout.hh"
 
-template <typename T, unsigned N, template <typename> class W = TAdaptiveNonopaqueWrapped>
+template <typename T, unsigned N, template <typename> class W = TAdaptiveNonopaqueWrapped,
+          typename L = array_layout::dense>
 class TArrayAdaptive : public TObject {
 public:
     class iterator;
@@ -13,8 +15,8 @@ public:
     typedef typename W<T>::version_type version_type;
     typedef unsigned size_type;
     typedef int difference_type;
-    typedef TConstArrayProxy<TArrayAdaptive<T, N, W> > const_proxy_type;
-    typedef TArrayProxy<TArrayAdaptive<T, N, W> > proxy_type;
+    typedef TConstArrayProxy<TArrayAdaptive<T, N, W, L> > const_proxy_type;
+    typedef TArrayProxy<TArrayAdaptive<T, N, W, L> > proxy_type;
 
     size_type size() const {
         return N;
@@ -46,7 +48,7 @@ public:
             return true;
         }
         else {
-            auto result = data_[i].v.read(item, data_[i].vers);
+            auto result = data_.value(i).read(item, data_.version(i));
             ret = result.second;
             return result.first;
         }
@@ -61,7 +63,7 @@ public:
     bool transPut(size_type i, T x) {
         assert(i < N);
         //printf("write [%lu] = %lu\n", i, x);
-        return Sto::item(this, i).acquire_write(data_[i].vers, x);
+        return Sto::item(this, i).acquire_write(data_.version(i), x);
     }
     void transPut_throws(size_type i, T x) {
         bool ok = transPut(i, x);
@@ -71,53 +73,49 @@ public:
 
     get_type nontrans_get(size_type i) const {
         assert(i < N);
-        return data_[i].v.access();
+        return data_.value(i).access();
     }
     void nontrans_put(size_type i, const T& x) {
         assert(i < N);
-        data_[i].v.access() = x;
+        data_.value(i).access() = x;
     }
     void nontrans_put(size_type i, T&& x) {
         assert(i < N);
-        data_[i].v.access() = std::move(x);
+        data_.value(i).access() = std::move(x);
     }
 
     // transactional methods
     bool lock(TransItem& item, Transaction& txn) override {
-        return txn.try_lock(item, data_[item.key<size_type>()].vers);
+        return txn.try_lock(item, data_.version(item.key<size_type>()));
     }
     bool check(TransItem& item, Transaction& txn) override {
-        return data_[item.key<size_type>()].vers.cp_check_version(txn, item);
+        return data_.version(item.key<size_type>()).cp_check_version(txn, item);
     }
     void install(TransItem& item, Transaction& txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
-        txn.set_version_unlock(data_[i].vers, item);
+        data_.value(i).write(item.write_value<T>());
+        txn.set_version_unlock(data_.version(i), item);
     }
     void unlock(TransItem& item) override {
-        data_[item.key<size_type>()].vers.cp_unlock(item);
+        data_.version(item.key<size_type>()).cp_unlock(item);
     }
 
 private:
-    struct elem {
-        mutable version_type vers;
-        W<T> v;
-    };
-    elem data_[N];
+    TArrayStorage<version_type, W<T>, N, L> data_;
 
     friend class iterator;
     friend class const_iterator;
 };
 
 
-template <typename T, unsigned N, template <typename> class W>
-class TArrayAdaptive<T, N, W>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
+template <typename T, unsigned N, template <typename> class W, typename L>
+class TArrayAdaptive<T, N, W, L>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
 public:
-    typedef TArrayAdaptive<T, N, W> array_type;
+    typedef TArrayAdaptive<T, N, W, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    const_iterator(const TArrayAdaptive<T, N, W>* a, size_type i)
+    const_iterator(const TArrayAdaptive<T, N, W, L>* a, size_type i)
         : a_(const_cast<array_type*>(a)), i_(i) {
     }
 
@@ -189,14 +187,14 @@ protected:
     size_type i_;
 };
 
-template <typename T, unsigned N, template <typename> class W>
-class TArrayAdaptive<T, N, W>::iterator : public const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+class TArrayAdaptive<T, N, W, L>::iterator : public const_iterator {
 public:
-    typedef TArrayAdaptive<T, N, W> array_type;
+    typedef TArrayAdaptive<T, N, W, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    iterator(const TArrayAdaptive<T, N, W>* a, size_type i)
+    iterator(const TArrayAdaptive<T, N, W, L>* a, size_type i)
         : const_iterator(a, i) {
     }
 
@@ -236,32 +234,32 @@ public:
     }
 };
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArrayAdaptive<T, N, W>::begin() -> iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArrayAdaptive<T, N, W, L>::begin() -> iterator {
     return iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArrayAdaptive<T, N, W>::end() -> iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArrayAdaptive<T, N, W, L>::end() -> iterator {
     return iterator(this, N);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArrayAdaptive<T, N, W>::cbegin() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArrayAdaptive<T, N, W, L>::cbegin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArrayAdaptive<T, N, W>::cend() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArrayAdaptive<T, N, W, L>::cend() const -> const_iterator {
     return const_iterator(this, N);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArrayAdaptive<T, N, W>::begin() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArrayAdaptive<T, N, W, L>::begin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N, template <typename> class W>
-inline auto TArrayAdaptive<T, N, W>::end() const -> const_iterator {
+template <typename T, unsigned N, template <typename> class W, typename L>
+inline auto TArrayAdaptive<T, N, W, L>::end() const -> const_iterator {
     return const_iterator(this, N);
 }
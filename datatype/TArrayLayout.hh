@@ -0,0 +1,210 @@
+#pragma once
+
+#include <type_traits>
+#include "Sto.hh"
+
+// Element layouts for the fixed-size transactional arrays (TArray,
+// TFlexArray, TArrayAdaptive, SwissTArray, TMvArray). A layout decides where
+// each element's version word and value live:
+//
+//  - dense:      {version, value} pairs back to back (the default). With
+//                small values several elements share a cache line, so
+//                writers of neighbouring indices false-share.
+//  - padded:     every pair on its own cache line. No false sharing, at the
+//                cost of a line per element.
+//  - split:      all versions in one array and all values in another. Scans
+//                touch fewer lines and installs do not dirty the lines
+//                readers take values from.
+//  - grouped<K>: one version per K consecutive elements, stored in front of
+//                them. Fewer version words to fetch and validate when
+//                neighbours are accessed together, but a write to one element
+//                conflicts with reads of the whole group. Only supported for
+//                versions that are locked at commit time (TVersion,
+//                TNonopaqueVersion).
+namespace array_layout {
+struct dense {
+    static constexpr unsigned group_size = 1;
+};
+struct padded {
+    static constexpr unsigned group_size = 1;
+};
+struct split {
+    static constexpr unsigned group_size = 1;
+};
+template <unsigned K>
+struct grouped {
+    static_assert(K > 0, "empty version group");
+    static constexpr unsigned group_size = K;
+};
+
+template <typename V> struct groupable : public std::false_type {};
+template <> struct groupable<TVersion> : public std::true_type {};
+template <> struct groupable<TNonopaqueVersion> : public std::true_type {};
+}
+
+template <typename V, typename E, unsigned N, typename Layout>
+class TArrayStorage;
+
+template <typename V, typename E, unsigned N>
+class TArrayStorage<V, E, N, array_layout::dense> {
+public:
+    V& version(unsigned i) const {
+        return data_[i].vers;
+    }
+    E& value(unsigned i) {
+        return data_[i].v;
+    }
+    const E& value(unsigned i) const {
+        return data_[i].v;
+    }
+
+private:
+    struct elem {
+        mutable V vers;
+        E v;
+    };
+    elem data_[N];
+};
+
+template <typename V, typename E, unsigned N>
+class TArrayStorage<V, E, N, array_layout::padded> {
+public:
+    V& version(unsigned i) const {
+        return data_[i].vers;
+    }
+    E& value(unsigned i) {
+        return data_[i].v;
+    }
+    const E& value(unsigned i) const {
+        return data_[i].v;
+    }
+
+private:
+    struct alignas(CACHE_LINE_SIZE) elem {
+        mutable V vers;
+        E v;
+    };
+    elem data_[N];
+};
+
+template <typename V, typename E, unsigned N>
+class TArrayStorage<V, E, N, array_layout::split> {
+public:
+    V& version(unsigned i) const {
+        return vers_[i];
+    }
+    E& value(unsigned i) {
+        return v_[i];
+    }
+    const E& value(unsigned i) const {
+        return v_[i];
+    }
+
+private:
+    mutable V vers_[N];
+    alignas(CACHE_LINE_SIZE) E v_[N];
+};
+
+template <typename V, typename E, unsigned N, unsigned K>
+class TArrayStorage<V, E, N, array_layout::grouped<K>> {
+public:
+    static_assert(K == 1 || array_layout::groupable<V>::value,
+                  "grouped layout needs a commit-time locked version type");
+
+    V& version(unsigned i) const {
+        return data_[i / K].vers;
+    }
+    E& value(unsigned i) {
+        return data_[i / K].v[i % K];
+    }
+    const E& value(unsigned i) const {
+        return data_[i / K].v[i % K];
+    }
+
+private:
+    struct group {
+        mutable V vers;
+        E v[K];
+    };
+    group data_[(N + K - 1) / K];
+};
+
+// Commit protocol for the array's version words. With one version per
+// element this is the usual lock/validate/install sequence.
+template <typename Layout, bool Shared = (Layout::group_size > 1)>
+struct TArrayVersionPolicy {
+    template <typename V>
+    static bool lock(TransItem& item, Transaction& txn, V& vers) {
+        return txn.try_lock(item, vers);
+    }
+    template <typename V>
+    static bool check(TransItem& item, Transaction& txn, V& vers) {
+        return vers.cp_check_version(txn, item);
+    }
+    template <typename V>
+    static void install(TransItem& item, Transaction& txn, V& vers) {
+        txn.set_version_unlock(vers, item);
+    }
+    template <typename V>
+    static void unlock(TransItem& item, V& vers) {
+        vers.cp_unlock(item);
+    }
+};
+
+// Elements share a version. The first item of a group to lock the shared
+// version owns the lock; other items of the same transaction are tagged as
+// followers and never release it. Installs keep the version locked until the
+// owner's unlock, so that every member's value is written before any reader
+// can validate against the new version.
+template <typename Layout>
+struct TArrayVersionPolicy<Layout, true> {
+    static constexpr TransItem::flags_type follower_bit = TransItem::user0_bit;
+
+    template <typename V>
+    static bool lock(TransItem& item, Transaction& txn, V& vers) {
+        if (vers.is_locked_here()) {
+            item.add_flags(follower_bit);
+            return true;
+        }
+        return txn.try_lock(item, vers);
+    }
+    template <typename V>
+    static bool check(TransItem& item, Transaction& txn, V& vers) {
+        // our own writes to other group members may hold the lock
+        if (vers.is_locked_here())
+            return vers.check_version(item.read_value<V>());
+        return vers.cp_check_version(txn, item);
+    }
+    template <typename V>
+    static void install(TransItem&, Transaction& txn, V& vers) {
+        txn.set_version(vers);
+    }
+    template <typename V>
+    static void unlock(TransItem& item, V& vers) {
+        if (!(item.flags() & follower_bit))
+            vers.cp_unlock(item);
+    }
+};
+
+// Storage for arrays whose elements carry no separate version word (the
+// multi-versioned TMvArray), where only dense and padded layouts apply.
+template <typename E, unsigned N, typename Layout>
+class TArrayValueStorage {
+    static_assert(std::is_same<Layout, array_layout::dense>::value
+                  || std::is_same<Layout, array_layout::padded>::value,
+                  "layout needs a separate version word");
+public:
+    E& value(unsigned i) const {
+        return data_[i].v;
+    }
+
+private:
+    struct elem {
+        mutable E v;
+    };
+    struct alignas(CACHE_LINE_SIZE) padded_elem {
+        mutable E v;
+    };
+    typename std::conditional<std::is_same<Layout, array_layout::padded>::value,
+                              padded_elem, elem>::type data_[N];
+};
@@ -1,8 +1,10 @@
 #pragma once
 
 #include "Sto.hh"
+#include "TArrayLayout.hh"
 
-template <typename T, unsigned N, template <typename> class W>
+template <typename T, unsigned N, template <typename> class W,
+          typename L = array_layout::dense>
 class TFlexArray : public TObject {
 public:
     typedef T value_type;
@@ -10,9 +12,8 @@ public:
     typedef typename W<T>::version_type version_type;
     typedef unsigned size_type;
 
-    TFlexArray() {
-        for (unsigned i = 0; i < N; ++i)
-            new (data_ + i) elem();
+    TFlexArray()
+        : data_() {
     }
 
     size_type size() const {
@@ -26,7 +27,7 @@ public:
             ret = item.template write_value<T>();
             return true;
         } else {
-            auto result = data_[i].v.read(item, data_[i].vers);
+            auto result = data_.value(i).read(item, data_.version(i));
             ret = result.second;
             return result.first;
         }
@@ -34,50 +35,46 @@ public:
 
     bool transPut(size_type i, T x) const {
         assert(i < N);
-        return Sto::item(this, i).acquire_write(data_[i].vers, x);
+        return Sto::item(this, i).acquire_write(data_.version(i), x);
     }
 
     get_type nontrans_get(size_type i) const {
         assert(i < N);
-        return data_[i].v.access();
+        return data_.value(i).access();
     }
 
     void nontrans_put(size_type i, const T &x) {
         assert(i < N);
-        data_[i].v.access() = x;
+        data_.value(i).access() = x;
     }
 
     void nontrans_put(size_type i, T &&x) {
         assert(i < N);
-        data_[i].v.access() = std::move(x);
+        data_.value(i).access() = std::move(x);
     }
 
     // TObject interface
     bool lock(TransItem &item, Transaction &txn) override {
-        return txn.try_lock(item, data_[item.key<size_type>()].vers);
+        return version_policy::lock(item, txn, data_.version(item.key<size_type>()));
     }
 
     bool check(TransItem &item, Transaction &txn) override {
-        return data_[item.key<size_type>()].vers.cp_check_version(txn, item);
+        return version_policy::check(item, txn, data_.version(item.key<size_type>()));
     }
 
     void install(TransItem &item, Transaction &txn) override {
         size_type i = item.key<size_type>();
-        data_[i].v.write(item.write_value<T>());
-        txn.set_version_unlock(data_[i].vers, item);
+        data_.value(i).write(item.write_value<T>());
+        version_policy::install(item, txn, data_.version(i));
     }
 
     void unlock(TransItem &item) override {
-        data_[item.key<size_type>()].vers.cp_unlock(item);
+        version_policy::unlock(item, data_.version(item.key<size_type>()));
     }
 
 private:
-    struct elem {
-        elem() = default;
-        mutable version_type vers;
-        W<T> v;
-    };
-    elem data_[N];
+    typedef TArrayVersionPolicy<L> version_policy;
+    TArrayStorage<version_type, W<T>, N, L> data_;
 };
 
 template <typename T, unsigned N>
@@ -2,9 +2,10 @@
 
 #include "Sto.hh"
 #include "TArrayProxy.hh"
+#include "TArrayLayout.hh"
 #include "MVCC.hh"
 
-template <typename T, unsigned N>
+template <typename T, unsigned N, typename L = array_layout::dense>
 class TMvArray : public TObject {
 public:
     class iterator;
@@ -13,8 +14,8 @@ public:
     typedef T get_type;
     typedef unsigned size_type;
     typedef int difference_type;
-    typedef TConstArrayProxy<TMvArray<T, N> > const_proxy_type;
-    typedef TArrayProxy<TMvArray<T, N> > proxy_type;
+    typedef TConstArrayProxy<TMvArray<T, N, L> > const_proxy_type;
+    typedef TArrayProxy<TMvArray<T, N, L> > proxy_type;
     typedef typename commutators::Commutator<T> comm_type;
 
     size_type size() const {
@@ -40,13 +41,18 @@ public:
     // transGet and friends
     bool transGet(size_type i, value_type& ret) const {
         assert(i < N);
+        // read-only transactions read the snapshot without a tset entry
+        if (Sto::read_only()) {
+            ret = data_.value(i).find(Sto::read_tid<false/*!commute*/>())->v();
+            return true;
+        }
         auto item = Sto::item(this, i);
         if (item.has_write()) {
             ret = item.template write_value<T>();
             return true;
         }
         else {
-            history_type *h = data_[i].v.find(Sto::read_tid<false/*!commute*/>());
+            history_type *h = data_.value(i).find(Sto::read_tid<false/*!commute*/>());
             MvAccess::template read<T>(item, h);
             ret = h->v();
             return true;
@@ -54,12 +60,14 @@ public:
     }
     value_type transGet_throws(size_type i) const {
         assert(i < N);
+        if (Sto::read_only())
+            return data_.value(i).find(Sto::read_tid<false/*!commute*/>())->v();
         auto item = Sto::item(this, i);
         if (item.has_write()) {
             return item.template write_value<T>();
         }
         else {
-            history_type *h = data_[i].v.find(Sto::read_tid<false/*!commute*/>());
+            history_type *h = data_.value(i).find(Sto::read_tid<false/*!commute*/>());
             if (!h) {
                 throw Transaction::Abort();
             }
@@ -78,24 +86,24 @@ public:
 
     get_type& nontrans_access(size_type i) {
         assert(i < N);
-        return data_[i].v.nontrans_access();
+        return data_.value(i).nontrans_access();
     }
     get_type nontrans_get(size_type i) const {
         assert(i < N);
-        return data_[i].v.nontrans_access();
+        return data_.value(i).nontrans_access();
     }
     void nontrans_put(size_type i, const T& x) {
         assert(i < N);
-        data_[i].v.nontrans_access() = x;
+        data_.value(i).nontrans_access() = x;
     }
     void nontrans_put(size_type i, T&& x) {
         assert(i < N);
-        data_[i].v.nontrans_access() = std::move(x);
+        data_.value(i).nontrans_access() = std::move(x);
     }
 
     // transactional methods
     bool lock(TransItem& item, Transaction& txn) override {
-        object_type &v = data_[item.key<size_type>()].v;
+        object_type &v = data_.value(item.key<size_type>());
         history_type *hprev = nullptr;
         if (item.has_read()) {
             hprev = item.read_value<history_type*>();
@@ -128,11 +136,11 @@ public:
         assert(item.has_read());
         fence();
         history_type *hprev = item.read_value<history_type*>();
-        return data_[item.key<size_type>()].v.cp_check(Sto::commit_tid(), hprev);
+        return data_.value(item.key<size_type>()).cp_check(Sto::commit_tid(), hprev);
     }
     void install(TransItem& item, Transaction&) override {
         auto h = item.template write_value<history_type*>();
-        data_[item.key<size_type>()].v.cp_install(h);
+        data_.value(item.key<size_type>()).cp_install(h);
     }
     void unlock(TransItem&) override {
         // no-op
@@ -142,7 +150,7 @@ public:
             if (item.has_write()) {
                 auto h = item.template write_value<history_type*>();
                 if (h && !item.has_commute()) {
-                    data_[item.key<size_type>()].v.abort(h);
+                    data_.value(item.key<size_type>()).abort(h);
                 }
             }
         }
@@ -152,24 +160,21 @@ private:
     typedef MvObject<T> object_type;
     typedef typename object_type::history_type history_type;
 
-    struct elem {
-        object_type v;
-    };
-    elem data_[N];
+    TArrayValueStorage<object_type, N, L> data_;
 
     friend class iterator;
     friend class const_iterator;
 };
 
 
-template <typename T, unsigned N>
-class TMvArray<T, N>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
+template <typename T, unsigned N, typename L>
+class TMvArray<T, N, L>::const_iterator : public std::iterator<std::random_access_iterator_tag, T> {
 public:
-    typedef TMvArray<T, N> array_type;
+    typedef TMvArray<T, N, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    const_iterator(const TMvArray<T, N>* a, size_type i)
+    const_iterator(const TMvArray<T, N, L>* a, size_type i)
         : a_(const_cast<array_type*>(a)), i_(i) {
     }
 
@@ -241,14 +246,14 @@ protected:
     size_type i_;
 };
 
-template <typename T, unsigned N>
-class TMvArray<T, N>::iterator : public const_iterator {
+template <typename T, unsigned N, typename L>
+class TMvArray<T, N, L>::iterator : public const_iterator {
 public:
-    typedef TMvArray<T, N> array_type;
+    typedef TMvArray<T, N, L> array_type;
     typedef typename array_type::size_type size_type;
     typedef typename array_type::difference_type difference_type;
 
-    iterator(const TMvArray<T, N>* a, size_type i)
+    iterator(const TMvArray<T, N, L>* a, size_type i)
         : const_iterator(a, i) {
     }
 
@@ -288,32 +293,32 @@ public:
     }
 };
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::begin() -> iterator {
+template <typename T, unsigned N, typename L>
+inline auto TMvArray<T, N, L>::begin() -> iterator {
     return iterator(this, 0);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::end() -> iterator {
+template <typename T, unsigned N, typename L>
+inline auto TMvArray<T, N, L>::end() -> iterator {
     return iterator(this, N);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::cbegin() const -> const_iterator {
+template <typename T, unsigned N, typename L>
+inline auto TMvArray<T, N, L>::cbegin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::cend() const -> const_iterator {
+template <typename T, unsigned N, typename L>
+inline auto TMvArray<T, N, L>::cend() const -> const_iterator {
     return const_iterator(this, N);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::begin() const -> const_iterator {
+template <typename T, unsigned N, typename L>
+inline auto TMvArray<T, N, L>::begin() const -> const_iterator {
     return const_iterator(this, 0);
 }
 
-template <typename T, unsigned N>
-inline auto TMvArray<T, N>::end() const -> const_iterator {
+template <typename T, unsigned N, typename L>
+inline auto TMvArray<T, N, L>::end() const -> const_iterator {
     return const_iterator(this, N);
 }
@@ -19,6 +19,9 @@ public:
     }
 
     std::pair<bool, read_type> read_nothrow() const {
+        // read-only transactions read the snapshot without a tset entry
+        if (Sto::read_only())
+            return {true, v_.find(Sto::read_tid<false/*!commute*/>())->v()};
         auto item = Sto::item(this, 0);
         if (item.has_write())
             return {true, item.template write_value<T>()};
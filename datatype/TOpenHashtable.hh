@@ -0,0 +1,620 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "Sto.hh"
+#include "print_value.hh"
+
+// Transactional hashtable with open addressing and online growth. It has
+// Hashtable's interface (transGet/transPut/transInsert/transUpdate/
+// transDelete and the nontrans_ methods) and can replace it directly.
+//
+// The table is an array of cache-line sized groups. Each group has a
+// version, six element pointers, and a one-byte hash tag per slot. Lookups
+// probe whole groups linearly from the key's home group and compare keys
+// only on tag matches, so a hit usually touches one group line and the
+// element. A key lives in the first group on its probe sequence that had a
+// free slot when it was inserted. Deletes leave tombstones, so a probe can
+// stop at the first group with an empty slot.
+//
+// Elements are allocated separately and never move; transactions read and
+// write them through their own versions, as in Hashtable. A miss observes
+// the version of every group it probed. Inserts bump the version of the
+// group they land in, so a later insert of the key aborts the reader.
+// Inserts of keys with the same home group are serialized by that group's
+// lock.
+//
+// Growth allocates a new table when 3/4 of the slots are used, counting
+// tombstones. It locks every group and copies the live element pointers.
+// It then publishes the new table and marks the old groups as moved, which
+// also bumps their versions. Transactions holding element items are not
+// affected. A transaction that observed a miss in the old table aborts.
+// The old table is freed through RCU.
+template <typename K, typename V, bool Opacity = true, unsigned Init_size = 129, typename W = V, typename Hash = std::hash<K>, typename Pred = std::equal_to<K>>
+class TOpenHashtable : public TObject {
+public:
+    typedef K Key;
+    typedef K key_type;
+    typedef V Value;
+    typedef W Value_type;
+    typedef V write_value_type;
+
+    typedef typename std::conditional<Opacity, TVersion, TNonopaqueVersion>::type version_type;
+    typedef typename std::conditional<Opacity, TWrapped<Value>, TNonopaqueWrapped<Value>>::type wrapped_type;
+
+    static constexpr unsigned group_width = 6;
+    static constexpr TransactionTid::type invalid_bit = TransactionTid::user_bit;
+    static constexpr TransItem::flags_type insert_bit = TransItem::user0_bit;
+    static constexpr TransItem::flags_type delete_bit = TransItem::user0_bit<<1;
+
+private:
+    struct internal_elem {
+        Key key;
+        version_type version;
+        wrapped_type value;
+        internal_elem(const Key& k, const Value* v)
+            : key(k), version(v ? initialized_tid : initialized_tid | invalid_bit),
+              value(v ? *v : Value()) {
+        }
+        bool valid() const {
+            return !(version.value() & invalid_bit);
+        }
+    };
+
+    struct __attribute__((aligned(CACHE_LINE_SIZE))) group {
+        version_type version;
+        uint8_t tags[group_width];
+        internal_elem* slots[group_width];
+        group()
+            : version(), tags(), slots() {
+        }
+    };
+
+    struct table {
+        std::vector<group> groups;
+        size_t mask;
+        unsigned shift;
+        size_t limit;
+        std::atomic<size_t> used;  // slots ever filled, including tombstones
+
+        explicit table(size_t ngroups)
+            : groups(ngroups), mask(ngroups - 1), shift(64), limit(ngroups * group_width * 3 / 4), used(0) {
+            for (size_t n = ngroups; n > 1; n >>= 1)
+                --shift;
+        }
+        size_t home(size_t h) const {
+            return h >> shift;
+        }
+        uint8_t tag(size_t h) const {
+            return uint8_t(h >> (shift - 8));
+        }
+    };
+
+    // set on the versions of groups that were copied into a newer table
+    static constexpr TransactionTid::type moved_bit = TransactionTid::user_bit;
+    // group items are keyed by the group's address with this bit set
+    static constexpr uintptr_t group_bit = 1;
+
+    std::atomic<table*> table_;
+    std::mutex grow_mutex_;
+    Hash hasher_;
+    Pred pred_;
+
+public:
+    TOpenHashtable(unsigned size = Init_size, Hash h = Hash(), Pred p = Pred())
+        : hasher_(h), pred_(p) {
+        size_t ngroups = 2;
+        while (ngroups * group_width * 3 / 4 <= size)
+            ngroups <<= 1;
+        table_.store(new table(ngroups), std::memory_order_relaxed);
+    }
+    ~TOpenHashtable() {
+        table* t = table_.load(std::memory_order_relaxed);
+        for (auto& g : t->groups)
+            for (internal_elem* e : g.slots)
+                if (is_live(e))
+                    delete e;
+        delete t;
+    }
+
+    // returns true if found false if not
+    template <typename KT, typename VT>
+    bool transGet(const KT& k, VT& retval) {
+        internal_elem* e = lookup(k, true);
+        if (!e)
+            return false;
+        auto item = Sto::read_item(this, e);
+        if (!validity_check(item, e))
+            Sto::abort();
+        if (has_delete(item))
+            return false;
+        if (item.has_write()) {
+            retval = item.template write_value<write_value_type>();
+            return true;
+        }
+        auto result = e->value.read(item, e->version);
+        if (!result.first)
+            Sto::abort();
+        retval = result.second;
+        return true;
+    }
+
+    // returns true if successful
+    bool transDelete(const Key& k) {
+        internal_elem* e = lookup(k, true);
+        if (!e)
+            return false;
+        auto item = Sto::item(this, e);
+        if (has_insert(item)) {
+            // deleting our own insert: drop the element, then check that
+            // the key is still absent at commit
+            item.remove_write().clear_flags(insert_bit);
+            unlink(e);
+            Transaction::rcu_delete(e);
+            if (lookup(k, true))
+                Sto::abort();
+            return true;
+        }
+        if (!e->valid())
+            Sto::abort();
+        if (has_delete(item))
+            return false;
+        if (!item.has_read() && !item.observe(e->version))
+            Sto::abort();
+        item.add_write().add_flags(delete_bit);
+        return true;
+    }
+
+    template <typename KT, typename VT>
+    bool transPut(const KT& k, const VT& v) {
+        return trans_write</*insert*/true, /*set*/true>(k, v);
+    }
+
+    // returns true if successful
+    template <typename KT, typename VT>
+    bool transInsert(const KT& k, const VT& v) {
+        return !trans_write</*insert*/true, /*set*/false>(k, v);
+    }
+
+    template <typename KT, typename VT>
+    bool transUpdate(const KT& k, const VT& v) {
+        return trans_write</*insert*/false, /*set*/true>(k, v);
+    }
+
+    Value transGet(Key k) {
+        Value v = Value();
+        transGet(k, v);
+        return v;
+    }
+
+    // nontransactional methods; not safe against concurrent transactions
+    bool nontrans_insert(const Key& k, const Value& v) {
+        group* g;
+        version_type oldv, newv;
+        find_or_insert(k, &v, g, oldv, newv);
+        return g;
+    }
+    bool nontrans_find(const Key& k, Value& v) {
+        internal_elem* e = lookup(k, false);
+        if (!e || !e->valid())
+            return false;
+        v = e->value.access();
+        return true;
+    }
+    bool nontrans_remove(const Key& k) {
+        internal_elem* e = lookup(k, false);
+        if (!e || !e->valid())
+            return false;
+        unlink(e);
+        delete e;
+        return true;
+    }
+    Value unsafe_get(Key k) {
+        Value v = Value();
+        nontrans_find(k, v);
+        return v;
+    }
+    size_t nontrans_size() const {
+        size_t n = 0;
+        for (auto& g : table_.load(std::memory_order_acquire)->groups)
+            for (internal_elem* e : g.slots)
+                n += is_live(e) && e->valid();
+        return n;
+    }
+    size_t nslots() const {
+        return table_.load(std::memory_order_acquire)->groups.size() * group_width;
+    }
+
+    void print_stats() const {
+        table* t = table_.load(std::memory_order_acquire);
+        size_t live = 0, tombstones = 0, probes = 0;
+        for (size_t gi = 0; gi != t->groups.size(); ++gi)
+            for (internal_elem* e : t->groups[gi].slots)
+                if (is_live(e)) {
+                    ++live;
+                    probes += ((gi - t->home(mix(e->key))) & t->mask) + 1;
+                } else if (e)
+                    ++tombstones;
+        printf("Groups: %zu, Elements: %zu, Tombstones: %zu, Avg groups probed: %f\n",
+               t->groups.size(), live, tombstones, live ? (double) probes / live : 0.0);
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        assert(!is_group(item));
+        return txn.try_lock(item, item.key<internal_elem*>()->version);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        if (is_group(item))
+            return group_of(item)->version.check_version(item.template read_value<version_type>());
+        return item.key<internal_elem*>()->version.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        assert(!is_group(item));
+        auto el = item.key<internal_elem*>();
+        if (has_delete(item)) {
+            // stays locked; the element is unlinked in cleanup
+            txn.set_version(el->version, invalid_bit);
+            return;
+        }
+        el->value.write(item.template write_value<write_value_type>());
+        txn.set_version_unlock(el->version, item);
+        // Convert the nonopaque version the insert left on its group into
+        // a commit tid, so later misses there can skip the full opacity
+        // check. Someone with a higher tid may have converted it already,
+        // and later inserts may have bumped it past our tid; the version
+        // must not move backwards, so then the bump stays.
+        if (Opacity && has_insert(item)) {
+            group* g = lock_group_of(el);
+            auto gv = g->version.value();
+            if ((gv & TransactionTid::nonopaque_bit)
+                && txn.commit_tid() > (gv & TransactionTid::max_value))
+                txn.set_version(g->version);
+            g->version.unlock_exclusive();
+        }
+    }
+    void unlock(TransItem& item) override {
+        assert(!is_group(item));
+        item.key<internal_elem*>()->version.cp_unlock(item);
+    }
+    void cleanup(TransItem& item, bool committed) override {
+        if (committed ? has_delete(item) : has_insert(item)) {
+            auto el = item.key<internal_elem*>();
+            assert(!el->valid());
+            unlink(el);
+            Transaction::rcu_delete(el);
+            // the dead element stays locked
+            item.clear_needs_unlock();
+        }
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        w << "{TOpenHashtable<" << typeid(K).name() << "," << typeid(V).name() << "> " << (void*) this;
+        if (is_group(item)) {
+            w << ".g" << (void*) group_of(item);
+            if (item.has_read())
+                w << " R" << item.read_value<version_type>();
+        } else {
+            auto el = item.key<internal_elem*>();
+            w << "[" << mass::print_value(el->key) << "]";
+            if (item.has_read())
+                w << " R" << item.read_value<version_type>();
+            if (has_delete(item))
+                w << " D";
+            else if (item.has_write())
+                w << (has_insert(item) ? " I" : " =") << mass::print_value(item.write_value<write_value_type>());
+        }
+        w << "}";
+    }
+
+private:
+    // returns true if item already existed, false if it did not
+    template <bool INSERT, bool SET, typename KT, typename VT>
+    bool trans_write(const KT& k, const VT& v) {
+        internal_elem* e;
+        if (INSERT) {
+            group* g;
+            version_type oldv, newv;
+            e = find_or_insert(k, nullptr, g, oldv, newv);
+            if (g) {
+                // our own insert must not invalidate our earlier miss
+                if (auto gitem = Sto::check_item(this, group_key(g)))
+                    gitem->update_read(oldv, newv);
+                // use new_item because we know there are no collisions
+                Sto::new_item(this, e).template add_write<write_value_type>(v).add_flags(insert_bit);
+                return false;
+            }
+        } else if (!(e = lookup(k, true)))
+            return false;
+
+        auto item = Sto::item(this, e);
+        if (!validity_check(item, e))
+            Sto::abort();
+        if (has_delete(item)) {
+            // delete-then-insert == update; delete-then-update == not found
+            if (INSERT)
+                item.clear_flags(delete_bit).clear_write().template add_write<write_value_type>(v);
+            return false;
+        }
+        // make sure the element doesn't get deleted before us
+        if (!has_insert(item) && !item.has_read() && !item.observe(e->version))
+            Sto::abort();
+        if (SET)
+            item.template add_write<write_value_type>(v);
+        return true;
+    }
+
+    size_t mix(const Key& k) const {
+        return hasher_(k) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    static internal_elem* tombstone() {
+        return reinterpret_cast<internal_elem*>(uintptr_t(1));
+    }
+    static bool is_live(const internal_elem* e) {
+        return reinterpret_cast<uintptr_t>(e) > 1;
+    }
+    static bool is_moved(const version_type& v) {
+        return v.value() & moved_bit;
+    }
+    static bool try_lock_group(group& g) {
+        version_type v = g.version;
+        return !v.is_locked()
+            && g.version.bool_cmpxchg(v, version_type(v.value() | TransactionTid::lock_bit | TThread::id()));
+    }
+
+    // Scans @g for @k. Sets @open if @g has an empty slot, which ends the
+    // probe; sets @free to the first empty or tombstone slot.
+    internal_elem* scan(const group& g, const Key& k, uint8_t tag, bool& open, int& free) const {
+        open = false;
+        free = -1;
+        for (unsigned i = 0; i != group_width; ++i) {
+            internal_elem* e = g.slots[i];
+            if (!is_live(e)) {
+                if (free < 0)
+                    free = i;
+                open = open || !e;
+            } else if (g.tags[i] == tag && pred_(e->key, k))
+                return e;
+        }
+        return nullptr;
+    }
+
+    // Returns @k's element, which may be invalid, or nullptr. On a miss,
+    // observes the version of every group probed if @observe_absent.
+    internal_elem* lookup(const Key& k, bool observe_absent) {
+        size_t h = mix(k);
+        bool observed = false;
+        while (true) {
+            table* t = table_.load(std::memory_order_acquire);
+            size_t gi = t->home(h);
+            uint8_t tag = t->tag(h);
+            while (true) {
+                group& g = t->groups[gi];
+                version_type v = g.version;
+                if (v.is_locked()) {
+                    relax_fence();
+                    continue;
+                }
+                fence();
+                bool open;
+                int free;
+                internal_elem* e = scan(g, k, tag, open, free);
+                fence();
+                if (g.version != v)
+                    continue;
+                // elements keep their identity across growth
+                if (e)
+                    return e;
+                if (is_moved(v))
+                    break;
+                if (observe_absent) {
+                    if (!Sto::item(this, group_key(&g)).observe(v))
+                        Sto::abort();
+                    observed = true;
+                }
+                if (open)
+                    return nullptr;
+                gi = (gi + 1) & t->mask;
+            }
+            // the table grew under us; misses observed in the old table
+            // can never validate
+            if (observed)
+                Sto::abort();
+        }
+    }
+
+    // Returns @k's element if present. Otherwise inserts a new element,
+    // valid with value *@v if @v is nonnull, and sets @ig to the group it
+    // went into and @oldv/@newv to that group's versions around the insert.
+    internal_elem* find_or_insert(const Key& k, const Value* v, group*& ig,
+                                  version_type& oldv, version_type& newv) {
+        size_t h = mix(k);
+        ig = nullptr;
+        while (true) {
+            table* t = table_.load(std::memory_order_acquire);
+            if (t->used.load(std::memory_order_relaxed) >= t->limit) {
+                grow(t);
+                continue;
+            }
+            size_t gi = t->home(h);
+            uint8_t tag = t->tag(h);
+            group& home = t->groups[gi];
+            home.version.lock_exclusive();
+            if (is_moved(home.version)) {
+                home.version.unlock_exclusive();
+                continue;
+            }
+
+            // Holding the home lock excludes inserts of @k and growth, so
+            // the probe only races with inserts of other keys and unlinks.
+            // Never wait on another group while holding it.
+            internal_elem* e = nullptr;
+            group* fg = nullptr;
+            int fslot = -1;
+            bool retry = false;
+            while (true) {
+                group& g = t->groups[gi];
+                version_type gv = g.version;
+                if (&g != &home && gv.is_locked()) {
+                    retry = true;
+                    break;
+                }
+                fence();
+                bool open;
+                int free;
+                e = scan(g, k, tag, open, free);
+                fence();
+                if (&g != &home && g.version != gv) {
+                    retry = true;
+                    break;
+                }
+                if (!fg && free >= 0) {
+                    fg = &g;
+                    fslot = free;
+                }
+                if (e || open)
+                    break;
+                gi = (gi + 1) & t->mask;
+            }
+            if (!retry && !e && fg != &home) {
+                if (!try_lock_group(*fg))
+                    retry = true;
+                else if (is_live(fg->slots[fslot])) {
+                    fg->version.unlock_exclusive();
+                    retry = true;
+                }
+            }
+            if (retry || e) {
+                home.version.unlock_exclusive();
+                if (e)
+                    return e;
+                relax_fence();
+                continue;
+            }
+
+            e = new internal_elem(k, v);
+            bool was_empty = !fg->slots[fslot];
+            fg->tags[fslot] = tag;
+            release_fence();
+            fg->slots[fslot] = e;
+            oldv = version_type(fg->version.unlocked_value());
+            fg->version.inc_nonopaque();
+            newv = version_type(fg->version.unlocked_value());
+            if (was_empty)
+                t->used.fetch_add(1, std::memory_order_relaxed);
+            if (fg != &home)
+                fg->version.unlock_exclusive();
+            home.version.unlock_exclusive();
+            ig = fg;
+            return e;
+        }
+    }
+
+    // Returns @e's group, locked, in the current table. @e must be present.
+    group* lock_group_of(internal_elem* e, unsigned* slot = nullptr) {
+        size_t h = mix(e->key);
+        while (true) {
+            table* t = table_.load(std::memory_order_acquire);
+            for (size_t gi = t->home(h); ; gi = (gi + 1) & t->mask) {
+                group& g = t->groups[gi];
+                unsigned i = 0;
+                bool open = false;
+                for (; i != group_width && g.slots[i] != e; ++i)
+                    open = open || !g.slots[i];
+                if (i == group_width && !open)
+                    continue;
+                if (i == group_width) {
+                    // raced with growth or an insert; start over
+                    relax_fence();
+                    break;
+                }
+                g.version.lock_exclusive();
+                if (!is_moved(g.version) && g.slots[i] == e) {
+                    if (slot)
+                        *slot = i;
+                    return &g;
+                }
+                g.version.unlock_exclusive();
+                break;
+            }
+        }
+    }
+
+    // Replaces @e's slot with a tombstone. Removal doesn't change the
+    // group version: it makes no absent key present.
+    void unlink(internal_elem* e) {
+        unsigned i;
+        group* g = lock_group_of(e, &i);
+        g->slots[i] = tombstone();
+        g->version.unlock_exclusive();
+    }
+
+    void grow(table* t) {
+        std::lock_guard<std::mutex> guard(grow_mutex_);
+        if (table_.load(std::memory_order_relaxed) != t)
+            return;
+        for (auto& g : t->groups)
+            g.version.lock_exclusive();
+
+        // size the new table so that live elements fill at most 3/8 of it;
+        // if tombstones caused the growth, it may keep the old size
+        size_t live = 0;
+        for (auto& g : t->groups)
+            for (internal_elem* e : g.slots)
+                live += is_live(e);
+        size_t ngroups = t->groups.size();
+        while (live * 8 > ngroups * group_width * 3)
+            ngroups <<= 1;
+
+        table* nt = new table(ngroups);
+        for (auto& g : t->groups)
+            for (internal_elem* e : g.slots)
+                if (is_live(e))
+                    place(nt, e);
+        nt->used.store(live, std::memory_order_relaxed);
+        table_.store(nt, std::memory_order_release);
+
+        for (auto& g : t->groups) {
+            g.version.inc_nonopaque();
+            g.version.value() = g.version.value() | moved_bit;
+            g.version.unlock_exclusive();
+        }
+        Transaction::rcu_delete(t);
+    }
+
+    // inserts @e into the unpublished table @t
+    void place(table* t, internal_elem* e) {
+        size_t h = mix(e->key);
+        for (size_t gi = t->home(h); ; gi = (gi + 1) & t->mask) {
+            group& g = t->groups[gi];
+            for (unsigned i = 0; i != group_width; ++i)
+                if (!g.slots[i]) {
+                    g.tags[i] = t->tag(h);
+                    g.slots[i] = e;
+                    return;
+                }
+        }
+    }
+
+    static bool has_delete(const TransItem& item) {
+        return item.flags() & delete_bit;
+    }
+    static bool has_insert(const TransItem& item) {
+        return item.flags() & insert_bit;
+    }
+    static bool validity_check(const TransItem& item, internal_elem* e) {
+        return has_insert(item) || e->valid();
+    }
+
+    static uintptr_t group_key(group* g) {
+        return reinterpret_cast<uintptr_t>(g) | group_bit;
+    }
+    static bool is_group(const TransItem& item) {
+        return item.key<uintptr_t>() & group_bit;
+    }
+    static group* group_of(const TransItem& item) {
+        return reinterpret_cast<group*>(item.key<uintptr_t>() & ~group_bit);
+    }
+};
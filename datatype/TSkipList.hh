@@ -0,0 +1,334 @@
+#pragma once
+
+#include <functional>
+#include "Sto.hh"
+#include "SkipListInternal.hh"
+
+// Ordered transactional set on a concurrent skiplist, meant as a replacement
+// for the sorted List: searches are O(log n) and never lock, and commits
+// only lock the nodes and gaps they touch instead of the whole list.
+//
+// Every node carries a version for reads of that element and a gap version
+// covering the range up to its level-0 successor (see SkipListInternal.hh).
+// A present element is validated with its node version; an absent one with
+// the gap version of its predecessor, so inserts into the range abort the
+// reader. Unlike SkipMap, new elements are not linked at execution time: a
+// transaction keeps its inserts in a private sorted list and links their
+// towers during install, while holding the predecessor's gap lock.
+// Deletes turn the node into a tombstone at commit and unlink it in cleanup
+// when that is possible without waiting; tombstones left behind are treated
+// as absent, revived by a later insert of the same element, or reclaimed by
+// later lookups.
+// T must be default-constructible (the head sentinel holds a T()).
+template <typename T, typename Compare = std::less<T>>
+class TSkipList : public TObject {
+public:
+    typedef T value_type;
+    typedef TVersion version_type;
+    typedef TNonopaqueVersion gap_version_type;
+
+    static constexpr TransItem::flags_type insert_tag = TransItem::user0_bit;
+    static constexpr TransItem::flags_type delete_tag = TransItem::user0_bit<<1;
+    static constexpr TransactionTid::type invalid_bit = TransactionTid::user_bit;
+
+    struct entry {
+        entry()
+            : vers_(), pred_(nullptr), pending_next_(nullptr), owns_pred_(false) {}
+
+        version_type vers_;
+        // commit-time insertion state of a node that is not linked yet
+        skipnode<T, entry, gap_version_type>* pred_;
+        skipnode<T, entry, gap_version_type>* pending_next_;
+        bool owns_pred_;
+    };
+
+    typedef skiplist<T, entry, gap_version_type, Compare> list_type;
+    typedef typename list_type::node_type node_type;
+
+    explicit TSkipList(Compare comp = Compare())
+        : list_(comp), comp_(comp) {
+    }
+
+    // Returns a pointer to the stored element equal to @elem, or nullptr.
+    const T* transFind(const T& elem) const {
+        TSkipList* self = const_cast<TSkipList*>(this);
+        if (node_type* p = find_pending(elem))
+            return &p->key();
+        node_type* n = self->lookup(elem);
+        if (!n)
+            return nullptr;
+        auto item = Sto::item(self, n);
+        if (has_delete(item))
+            return nullptr;
+        if (!item.has_write() && !observe_present(item, n))
+            return nullptr;
+        return &n->key();
+    }
+    bool transContains(const T& elem) const {
+        return transFind(elem) != nullptr;
+    }
+
+    // Returns true if @elem was absent.
+    bool transInsert(const T& elem) {
+        if (find_pending(elem))
+            return false;
+        // lock() checks that @elem is still absent, so inserts need no
+        // range read
+        node_type* n = lookup(elem, false);
+        if (!n) {
+            add_pending(elem);
+            return true;
+        }
+        auto item = Sto::item(this, n);
+        if (has_delete(item)) {
+            item.remove_write().clear_flags(delete_tag);
+            return true;
+        }
+        if (item.has_write() || observe_present(item, n))
+            return false;
+        // revive the tombstone
+        item.add_write();
+        return true;
+    }
+
+    // Returns true if @elem was present.
+    bool transDelete(const T& elem) {
+        if (node_type* p = find_pending(elem)) {
+            remove_pending(p);
+            Sto::item(this, p).remove_write().clear_flags(insert_tag);
+            Transaction::rcu_call(node_type::destroy, p);
+            return true;
+        }
+        node_type* n = lookup(elem);
+        if (!n)
+            return false;
+        auto item = Sto::item(this, n);
+        if (has_delete(item))
+            return false;
+        if (item.has_write()) {
+            // undo our revival; the tombstone read remains
+            item.remove_write();
+            return true;
+        }
+        if (!observe_present(item, n))
+            return false;
+        item.add_write().add_flags(delete_tag);
+        return true;
+    }
+
+    // nontransactional methods; not safe against concurrent transactions
+    bool nontrans_insert(const T& elem) {
+        return list_.insert(elem).inserted;
+    }
+    bool nontrans_find(const T& elem) const {
+        node_type* n = list_.find_node(elem);
+        return n && !(n->payload().vers_ & invalid_bit);
+    }
+    bool nontrans_remove(const T& elem) {
+        node_type* n = list_.find_node(elem);
+        if (!n || !list_.erase(n).erased)
+            return false;
+        bool present = !(n->payload().vers_ & invalid_bit);
+        node_type::destroy(n);
+        return present;
+    }
+    size_t nontrans_size() const {
+        size_t size = 0;
+        for (node_type* n = list_type::next(list_.head()); n; n = list_type::next(n))
+            if (!n->marked() && !(n->payload().vers_ & invalid_bit))
+                ++size;
+        return size;
+    }
+
+    // TObject interface
+    bool lock(TransItem& item, Transaction& txn) override {
+        node_type* n = item.key<node_type*>();
+        entry& e = n->payload();
+        if (!has_insert(item))
+            return txn.try_lock(item, e.vers_);
+        // Lock the gap the new node goes into. Our other inserts may already
+        // hold it.
+        while (true) {
+            node_type* succ;
+            node_type* pred = list_.find_pred(n->key(), succ);
+            if (!pred)
+                return false;
+            bool acquire = !pred->gapversion().is_locked_here();
+            if (acquire && !txn.try_lock(item, pred->gapversion()))
+                return false;
+            if (!pred->marked() && list_type::next(pred) == succ) {
+                e.pred_ = pred;
+                e.owns_pred_ = acquire;
+                return true;
+            }
+            if (acquire)
+                pred->gapversion().cp_unlock(item);
+        }
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        if (item.key<uintptr_t>() & gap_bit) {
+            // our own commit-time inserts may hold the gap lock
+            gap_version_type& gapvers = gap_node(item)->gapversion();
+            gap_version_type v = gapvers;
+            return (!v.is_locked() || v.is_locked_here())
+                && v.check_version(item.read_value<gap_version_type>());
+        }
+        return item.key<node_type*>()->payload().vers_.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        node_type* n = item.key<node_type*>();
+        entry& e = n->payload();
+        if (has_insert(item)) {
+            // Earlier installs may have linked our own nodes into the gap;
+            // their gaps are locked by us as well.
+            node_type* succ;
+            node_type* pred = list_.find_pred(n->key(), succ);
+            always_assert(pred && pred->gapversion().is_locked_here());
+            e.vers_.lock_exclusive();
+            txn.set_version(e.vers_);
+            list_.link_locked(n, pred);
+        } else if (has_delete(item)) {
+            // stays locked; the node is unlinked in cleanup
+            txn.set_version(e.vers_, invalid_bit);
+        } else
+            txn.set_version_unlock(e.vers_, item);
+    }
+    void unlock(TransItem& item) override {
+        node_type* n = item.key<node_type*>();
+        entry& e = n->payload();
+        if (!has_insert(item)) {
+            e.vers_.cp_unlock(item);
+            return;
+        }
+        if (n->fully_linked()) {
+            e.vers_.cp_unlock(item);
+            n->gapversion().unlock_exclusive();
+        }
+        if (e.owns_pred_)
+            e.pred_->gapversion().cp_unlock(item);
+    }
+    void cleanup(TransItem& item, bool committed) override {
+        node_type* n = item.key<node_type*>();
+        if (!committed && has_insert(item))
+            Transaction::rcu_call(node_type::destroy, n);
+        else if (committed && has_delete(item) && list_.try_erase(n).erased) {
+            // the dead node stays locked
+            Transaction::rcu_call(node_type::destroy, n);
+            item.clear_needs_unlock();
+        }
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        w << "{TSkipList<" << typeid(T).name() << "> " << (void*) this;
+        uintptr_t k = item.key<uintptr_t>();
+        if (k == pending_key_)
+            w << ".pending";
+        else if (k & gap_bit)
+            w << "." << (void*) gap_node(item) << "G";
+        else
+            w << "." << (void*) k;
+        if (item.has_read() && (k & gap_bit))
+            w << " R" << item.read_value<gap_version_type>();
+        else if (item.has_read())
+            w << " R" << item.read_value<version_type>();
+        if (item.has_write())
+            w << (has_insert(item) ? " I" : (has_delete(item) ? " D" : " V"));
+        w << "}";
+    }
+
+private:
+    list_type list_;
+    Compare comp_;
+
+    static constexpr uintptr_t gap_bit = 1;
+    // stash item holding the head of this transaction's pending inserts
+    static constexpr uintptr_t pending_key_ = 2;
+
+    static uintptr_t gap_key(node_type* n) {
+        return reinterpret_cast<uintptr_t>(n) | gap_bit;
+    }
+    static node_type* gap_node(const TransItem& item) {
+        return reinterpret_cast<node_type*>(item.key<uintptr_t>() & ~gap_bit);
+    }
+    static bool has_insert(const TransItem& item) {
+        return item.flags() & insert_tag;
+    }
+    static bool has_delete(const TransItem& item) {
+        return item.flags() & delete_tag;
+    }
+
+    // Observes @n's version and returns whether it holds a committed element
+    // (rather than a tombstone).
+    static bool observe_present(TransProxy& item, node_type* n) {
+        if (!item.observe(n->payload().vers_))
+            Sto::abort();
+        return !(item.template read_value<version_type>() & invalid_bit);
+    }
+
+    // Returns the linked node for @elem, which may be a tombstone, or nullptr
+    // (after observing the gap that would hold it, if @observe_gap).
+    node_type* lookup(const T& elem, bool observe_gap = true) {
+        node_type* pred;
+        gap_version_type gapvers;
+        while (true) {
+            node_type* n = list_.lookup(elem, pred, gapvers);
+            if (!n) {
+                if (observe_gap && !Sto::item(this, gap_key(pred)).observe(gapvers))
+                    Sto::abort();
+                return nullptr;
+            }
+            if (!reap(n))
+                return n;
+        }
+    }
+
+    // Unlink @n if it is a tombstone nobody is committing and this
+    // transaction has not looked at. Its version stays locked, so readers of
+    // the tombstone abort.
+    bool reap(node_type* n) {
+        version_type& vers = n->payload().vers_;
+        version_type v = vers;
+        if (!(v & invalid_bit) || v.is_locked() || Sto::check_item(this, n))
+            return false;
+        if (!vers.bool_cmpxchg(v, version_type(v.value() | TransactionTid::lock_bit | TThread::id())))
+            return false;
+        if (list_.try_erase(n).erased) {
+            Transaction::rcu_call(node_type::destroy, n);
+            return true;
+        }
+        vers.unlock_exclusive();
+        return false;
+    }
+
+    // This transaction's inserts, sorted, not linked into the skiplist yet.
+    node_type* find_pending(const T& elem) const {
+        auto item = Sto::check_item(this, pending_key_);
+        if (!item || !item->has_stash())
+            return nullptr;
+        for (node_type* p = item->template stash_value<node_type*>(); p; p = p->payload().pending_next_) {
+            if (!comp_(p->key(), elem))
+                return comp_(elem, p->key()) ? nullptr : p;
+        }
+        return nullptr;
+    }
+    void add_pending(const T& elem) {
+        node_type* n = node_type::make(list_type::random_height(), elem);
+        auto item = Sto::item(this, pending_key_);
+        node_type* head = item.template stash_value<node_type*>(nullptr);
+        node_type** pp = &head;
+        while (*pp && comp_((*pp)->key(), elem))
+            pp = &(*pp)->payload().pending_next_;
+        n->payload().pending_next_ = *pp;
+        *pp = n;
+        item.set_stash(head);
+        Sto::item(this, n).add_write().add_flags(insert_tag);
+    }
+    void remove_pending(node_type* n) {
+        auto item = Sto::item(this, pending_key_);
+        node_type* head = item.template stash_value<node_type*>();
+        node_type** pp = &head;
+        while (*pp != n)
+            pp = &(*pp)->payload().pending_next_;
+        *pp = n->payload().pending_next_;
+        item.set_stash(head);
+    }
+};
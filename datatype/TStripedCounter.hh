@@ -0,0 +1,271 @@
+#pragma once
+#include "TIntPredicate.hh"
+
+// A counter for write-heavy blind increments. The value is the sum of S
+// cache-line sized stripes, each with its own version. Deltas from a
+// transaction running on thread i go to stripe i % S, so concurrent
+// incrementers on different threads lock and install into different
+// stripes instead of serializing on one version word.
+//
+// Reads and comparisons never add per-stripe reads. They compute the sum
+// from a snapshot in which no stripe changed (or was locked by another
+// thread) while the values were read, and record a predicate on that sum
+// (as TCounter does), which is checked at commit against a fresh snapshot.
+// That commit-time snapshot adds a read of every stripe version it saw, so
+// a delta installed into any stripe after the check fails validation.
+// Assignment writes every stripe.
+template <typename T, unsigned S = 16>
+class TStripedCounter : public TObject {
+    typedef TIntPredicate<T> ip_type;
+    typedef typename ip_type::pred_type pred_type;
+public:
+    typedef TVersion version_type;
+    static constexpr unsigned nstripes = S;
+    static constexpr TransItem::flags_type delta_bit = TransItem::user0_bit;
+    static constexpr TransItem::flags_type assigned_bit = TransItem::user0_bit << 1;
+
+    TStripedCounter() {
+    }
+    explicit TStripedCounter(T x) {
+        stripes_[0].v = x;
+    }
+
+    operator T() const {
+        auto item = Sto::item(this, sum_key);
+        if (item.has_flag(assigned_bit))
+            return assigned_sum();
+        T result = wait_sum(item);
+        get(item).observe(result);
+        return result + delta();
+    }
+
+    TStripedCounter<T, S>& operator=(T x) {
+        unsigned mine = my_stripe();
+        for (unsigned s = 0; s != S; ++s)
+            Sto::item(this, s).add_write(s == mine ? x : T()).assign_flags(assigned_bit);
+        Sto::item(this, sum_key).add_flags(assigned_bit);
+        return *this;
+    }
+    TStripedCounter<T, S>& operator=(const TStripedCounter<T, S>& x) {
+        return *this = x.operator T();
+    }
+
+    T nontrans_read() const {
+        T sum = T();
+        for (unsigned s = 0; s != S; ++s)
+            sum += stripes_[s].v;
+        return sum;
+    }
+    void nontrans_write(T x) {
+        for (unsigned s = 0; s != S; ++s)
+            stripes_[s].v = s ? T() : x;
+    }
+
+    bool operator==(T x) const {
+        return observe_eq(Sto::item(this, sum_key), x);
+    }
+    bool operator!=(T x) const {
+        return !observe_eq(Sto::item(this, sum_key), x);
+    }
+    bool operator<(T x) const {
+        return observe_lt(Sto::item(this, sum_key), x);
+    }
+    bool operator<=(T x) const {
+        return observe_le(Sto::item(this, sum_key), x);
+    }
+    bool operator>=(T x) const {
+        return !observe_lt(Sto::item(this, sum_key), x);
+    }
+    bool operator>(T x) const {
+        return !observe_le(Sto::item(this, sum_key), x);
+    }
+
+    TStripedCounter<T, S>& operator+=(T delta) {
+        auto item = Sto::item(this, my_stripe());
+        item.add_write(item.template write_value<T>(T()) + delta);
+        if (!item.has_flag(assigned_bit))
+            item.add_flags(delta_bit);
+        return *this;
+    }
+    TStripedCounter<T, S>& operator-=(T delta) {
+        return *this += -delta;
+    }
+    TStripedCounter<T, S>& operator++() {
+        return *this += 1;
+    }
+    void operator++(int) {
+        *this += 1;
+    }
+    TStripedCounter<T, S>& operator--() {
+        return *this -= 1;
+    }
+    void operator--(int) {
+        *this -= 1;
+    }
+
+    // transactional methods
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, stripes_[item.key<unsigned>()].vers);
+    }
+    bool check_predicate(TransItem& item, Transaction& txn, bool committing) override {
+        TransProxy p(txn, item);
+        pred_type pred = item.template predicate_value<pred_type>();
+        T value;
+        return snapshot_sum(value, p, committing ? &txn : nullptr) && pred.verify(value);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        // stripe versions read by a commit-time predicate check
+        return stripes_[item.key<unsigned>()].vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        stripe& st = stripes_[item.key<unsigned>()];
+        T result = item.template write_value<T>();
+        if (item.has_flag(delta_bit))
+            result += st.v;
+        st.v = result;
+        txn.set_version_unlock(st.vers, item);
+    }
+    void unlock(TransItem& item) override {
+        stripes_[item.key<unsigned>()].vers.cp_unlock(item);
+    }
+    void print(std::ostream& w, const TransItem& item) const override {
+        unsigned s = item.key<unsigned>();
+        w << "{StripedCounter " << (void*) this;
+        if (s == sum_key) {
+            w << ".sum=" << nontrans_read();
+            if (item.has_predicate()) {
+                auto& p = item.predicate_value<pred_type>();
+                w << " P[" << p.first << "," << p.second << "]";
+            }
+        } else {
+            w << "." << s << "=" << stripes_[s].v << ".v" << stripes_[s].vers.value();
+            if (item.has_write() && item.has_flag(delta_bit))
+                w << " Δ" << item.template write_value<T>();
+            else if (item.has_write())
+                w << " =" << item.template write_value<T>();
+        }
+        w << "}";
+    }
+
+private:
+    struct __attribute__((aligned(CACHE_LINE_SIZE))) stripe {
+        mutable version_type vers;
+        T v;
+        stripe()
+            : v() {
+        }
+    };
+    stripe stripes_[S];
+
+    static constexpr unsigned sum_key = S;
+
+    static unsigned my_stripe() {
+        return Sto::transaction()->threadid() % S;
+    }
+    static pred_type& get(TransProxy& item) {
+        return item.predicate_value<pred_type>(pred_type::unconstrained());
+    }
+
+    // Sums the stripes at a point in time: no stripe changed, or was locked
+    // by another transaction, while their values were read. At commit
+    // (@committing is the committing transaction) the stripe versions are
+    // added as reads; otherwise they are checked for opacity.
+    bool snapshot_sum(T& sum, TransProxy item, Transaction* committing) const {
+        version_type vers[S];
+        unsigned n = 0;
+        while (true) {
+            bool clean = true;
+            for (unsigned s = 0; s != S; ++s) {
+                vers[s] = stripes_[s].vers;
+                clean = clean && !vers[s].is_locked_elsewhere();
+            }
+            fence();
+            sum = T();
+            for (unsigned s = 0; s != S; ++s)
+                sum += stripes_[s].v;
+            fence();
+            for (unsigned s = 0; clean && s != S; ++s)
+                clean = stripes_[s].vers == vers[s];
+            if (clean)
+                break;
+            if (++n > (1 << STO_SPIN_BOUND_WAIT))
+                return false;
+            relax_fence();
+        }
+        for (unsigned s = 0; s != S; ++s)
+            if (committing)
+                committing->item(this, s).add_read(vers[s]);
+            else if (!item.observe(vers[s], false))
+                return false;
+        return true;
+    }
+    T wait_sum(TransProxy item) const {
+        T sum;
+        if (!snapshot_sum(sum, item, nullptr))
+            Sto::abort();
+        return sum;
+    }
+    T assigned_sum() const {
+        T sum = T();
+        for (unsigned s = 0; s != S; ++s)
+            sum += Sto::item(this, s).template write_value<T>();
+        return sum;
+    }
+    T delta() const {
+        auto item = Sto::check_item(this, my_stripe());
+        return item && item->has_flag(delta_bit) ? item->template write_value<T>() : T();
+    }
+    T snapshot(TransProxy item) const {
+        if (item.has_flag(assigned_bit))
+            return assigned_sum();
+        else
+            return wait_sum(item);
+    }
+    bool observe_eq(TransProxy item, T value) const {
+        value -= delta();
+        T s = snapshot(item);
+        if (!item.has_flag(assigned_bit))
+            get(item).observe_test_eq(s, value);
+        return s == value;
+    }
+    bool observe_lt(TransProxy item, T value) const {
+        value -= delta();
+        bool result = snapshot(item) < value;
+        if (!item.has_flag(assigned_bit))
+            get(item).observe_lt(value, result);
+        return result;
+    }
+    bool observe_le(TransProxy item, T value) const {
+        value -= delta();
+        bool result = snapshot(item) <= value;
+        if (!item.has_flag(assigned_bit))
+            get(item).observe_le(value, result);
+        return result;
+    }
+};
+
+
+template <typename T, unsigned S>
+bool operator==(T a, const TStripedCounter<T, S>& b) {
+    return b == a;
+}
+template <typename T, unsigned S>
+bool operator!=(T a, const TStripedCounter<T, S>& b) {
+    return b != a;
+}
+template <typename T, unsigned S>
+bool operator<(T a, const TStripedCounter<T, S>& b) {
+    return b > a;
+}
+template <typename T, unsigned S>
+bool operator<=(T a, const TStripedCounter<T, S>& b) {
+    return b >= a;
+}
+template <typename T, unsigned S>
+bool operator>=(T a, const TStripedCounter<T, S>& b) {
+    return b <= a;
+}
+template <typename T, unsigned S>
+bool operator>(T a, const TStripedCounter<T, S>& b) {
+    return b < a;
+}
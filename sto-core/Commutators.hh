@@ -2,9 +2,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <type_traits>
+
 #include "MVCCTypes.hh"
 
-namespace commutators { 
+namespace commutators {
 
 template <typename T>
 class Commutator {
@@ -20,23 +23,343 @@ public:
 
 //////////////////////////////////////////////
 //
-// Commutator type for integral +/- operations
+// Coalescing
+//
+// A commutator may define
+//     bool coalesce(const C& next);
+// which folds @next, applied after this one, into this one, so that
+// operate() then has the effect of both. It returns false if the pair
+// cannot be expressed as one commutator, and leaves this one unchanged.
+// Pending commutators on the same TransItem and committed deltas in an
+// MvHistory chain are merged this way when their type allows it.
 //
 //////////////////////////////////////////////
 
-template <>
-class Commutator<int64_t> {
+template <typename C>
+class can_coalesce {
+    template <typename U>
+    static auto test(int) -> decltype(std::declval<U&>().coalesce(std::declval<const U&>()),
+                                      std::true_type());
+    template <typename U>
+    static std::false_type test(...);
 public:
-    Commutator() = default;
-    explicit Commutator(int64_t delta) : delta(delta) {}
+    static constexpr bool value = decltype(test<C>(0))::value;
+};
+
+template <typename C>
+inline typename std::enable_if<can_coalesce<C>::value, bool>::type
+coalesce(C& c, const C& next) {
+    return c.coalesce(next);
+}
+
+template <typename C>
+inline typename std::enable_if<!can_coalesce<C>::value, bool>::type
+coalesce(C&, const C&) {
+    return false;
+}
+
+//////////////////////////////////////////////
+//
+// Operations on one value, for building commutators
+//
+//////////////////////////////////////////////
+
+// v += delta; a subtraction is an add of the negated delta
+template <typename V>
+class add {
+public:
+    add() = default;
+    explicit add(V delta) : delta(delta) {}
 
-    int64_t& operate(int64_t& v) const {
+    V& operate(V& v) const {
         v += delta;
         return v;
     }
+    bool coalesce(const add& next) {
+        delta += next.delta;
+        return true;
+    }
+
+protected:
+    V delta;
+};
+
+template <typename V>
+class sub : public add<V> {
+public:
+    sub() = default;
+    explicit sub(V delta) : add<V>(V(-delta)) {}
+};
+
+// v = min(v, x)
+template <typename V>
+class min {
+public:
+    min() = default;
+    explicit min(V x) : x(x) {}
+
+    V& operate(V& v) const {
+        if (x < v)
+            v = x;
+        return v;
+    }
+    bool coalesce(const min& next) {
+        x = std::min(x, next.x);
+        return true;
+    }
+
+private:
+    V x;
+};
+
+// v = max(v, x)
+template <typename V>
+class max {
+public:
+    max() = default;
+    explicit max(V x) : x(x) {}
+
+    V& operate(V& v) const {
+        if (v < x)
+            v = x;
+        return v;
+    }
+    bool coalesce(const max& next) {
+        x = std::max(x, next.x);
+        return true;
+    }
+
+private:
+    V x;
+};
+
+// v |= bits
+template <typename V>
+class bit_or {
+public:
+    bit_or() = default;
+    explicit bit_or(V bits) : bits(bits) {}
+
+    V& operate(V& v) const {
+        v |= bits;
+        return v;
+    }
+    bool coalesce(const bit_or& next) {
+        bits |= next.bits;
+        return true;
+    }
+
+private:
+    V bits;
+};
+
+// v &= bits
+template <typename V>
+class bit_and {
+public:
+    bit_and() = default;
+    explicit bit_and(V bits) : bits(bits) {}
+
+    V& operate(V& v) const {
+        v &= bits;
+        return v;
+    }
+    bool coalesce(const bit_and& next) {
+        bits &= next.bits;
+        return true;
+    }
+
+private:
+    V bits;
+};
+
+// v += delta, saturating at [lo, hi]. Kept as the clamp function
+// v -> min(max(v + delta, lo), hi), which is closed under composition, so a
+// run of bounded adds (even with different bounds) coalesces exactly. V
+// should be signed and wide enough for the summed deltas.
+template <typename V>
+class bounded_counter {
+public:
+    bounded_counter() = default;
+    bounded_counter(V delta, V lo, V hi) : delta(delta), lo(lo), hi(hi) {
+        assert(lo <= hi);
+    }
+
+    V& operate(V& v) const {
+        v = std::min(std::max(V(v + delta), lo), hi);
+        return v;
+    }
+    bool coalesce(const bounded_counter& next) {
+        // clamp(clamp(v + d, lo, hi) + d', lo', hi')
+        //   = clamp(clamp(v + d + d', lo + d', hi + d'), lo', hi')
+        V nlo = lo + next.delta, nhi = hi + next.delta;
+        lo = std::min(std::max(nlo, next.lo), next.hi);
+        hi = std::max(std::min(nhi, next.hi), next.lo);
+        delta += next.delta;
+        return true;
+    }
+
+private:
+    V delta;
+    V lo;
+    V hi;
+};
+
+// The last N values appended, oldest first
+template <typename V, unsigned N>
+class bounded_list {
+public:
+    static constexpr unsigned capacity = N;
+
+    bounded_list() : n_(0), head_(0) {}
+
+    unsigned size() const {
+        return n_;
+    }
+    // The @i-th oldest value
+    const V& operator[](unsigned i) const {
+        assert(i < n_);
+        return v_[(head_ + i) % N];
+    }
+    void push_back(const V& x) {
+        if (n_ == N) {
+            v_[head_] = x;
+            head_ = (head_ + 1) % N;
+        } else
+            v_[(head_ + n_++) % N] = x;
+    }
+
+private:
+    unsigned n_;
+    unsigned head_;
+    V v_[N];
+};
+
+// Append to a bounded_list<V, N>. Coalesced appends keep only the values
+// that could survive in the list.
+template <typename V, unsigned N>
+class bounded_list_append {
+public:
+    typedef bounded_list<V, N> list_type;
+
+    bounded_list_append() = default;
+    explicit bounded_list_append(const V& x) {
+        xs.push_back(x);
+    }
+
+    list_type& operate(list_type& l) const {
+        for (unsigned i = 0; i != xs.size(); ++i)
+            l.push_back(xs[i]);
+        return l;
+    }
+    bool coalesce(const bounded_list_append& next) {
+        for (unsigned i = 0; i != next.xs.size(); ++i)
+            xs.push_back(next.xs[i]);
+        return true;
+    }
 
 private:
-    int64_t delta;
+    list_type xs;
+};
+
+// A set of at most N values. When full, it keeps the N smallest, so the
+// contents do not depend on the order of inserts.
+template <typename V, unsigned N>
+class bounded_set {
+public:
+    static constexpr unsigned capacity = N;
+
+    bounded_set() : n_(0) {}
+
+    unsigned size() const {
+        return n_;
+    }
+    // Values in increasing order
+    const V* begin() const {
+        return v_;
+    }
+    const V* end() const {
+        return v_ + n_;
+    }
+    bool contains(const V& x) const {
+        return std::binary_search(begin(), end(), x);
+    }
+    void insert(const V& x) {
+        V* p = std::lower_bound(v_, v_ + n_, x);
+        if ((p != v_ + n_ && !(x < *p)) || p == v_ + N)
+            return;
+        if (n_ < N)
+            ++n_;
+        std::move_backward(p, v_ + n_ - 1, v_ + n_);
+        *p = x;
+    }
+
+private:
+    unsigned n_;
+    V v_[N];
+};
+
+// Insert into a bounded_set<V, N>
+template <typename V, unsigned N>
+class set_insert {
+public:
+    typedef bounded_set<V, N> set_type;
+
+    set_insert() = default;
+    explicit set_insert(const V& x) {
+        xs.insert(x);
+    }
+
+    set_type& operate(set_type& s) const {
+        for (auto& x : xs)
+            s.insert(x);
+        return s;
+    }
+    bool coalesce(const set_insert& next) {
+        for (auto& x : next.xs)
+            xs.insert(x);
+        return true;
+    }
+
+private:
+    set_type xs;
+};
+
+// Apply operation Op to one member of a row. A row's commutator can derive
+// from this instead of being written by hand:
+//     template <>
+//     class Commutator<my_row> : public on_field<my_row, int64_t, &my_row::balance, add<int64_t>> {
+//         ...
+//     };
+template <typename Row, typename V, V Row::*Member, typename Op>
+class on_field {
+public:
+    on_field() = default;
+    explicit on_field(const Op& op) : op(op) {}
+
+    Row& operate(Row& r) const {
+        op.operate(r.*Member);
+        return r;
+    }
+    bool coalesce(const on_field& next) {
+        return op.coalesce(next.op);
+    }
+
+protected:
+    Op op;
+};
+
+//////////////////////////////////////////////
+//
+// Commutator type for integral +/- operations
+//
+//////////////////////////////////////////////
+
+template <>
+class Commutator<int64_t> : public add<int64_t> {
+public:
+    Commutator() = default;
+    explicit Commutator(int64_t delta) : add<int64_t>(delta) {}
 };
 
 }
@@ -6,6 +6,7 @@
 #include "EagerVersions.hh"
 #include "OCCVersions.hh"
 #include "TicTocVersions.hh"
+#include "Commutators.hh"
 
 class VersionDelegate {
     friend class TVersion;
@@ -46,9 +47,14 @@ class VersionDelegate {
     }
 };
 
-// Registering commutes without passing the version (handled internally by TItem)
+// Registering commutes without passing the version (handled internally by TItem).
+// A commute on an item that already has one is merged into it if the
+// commutator type supports coalescing, and otherwise replaces it.
 template <typename T>
 inline TransProxy& TransProxy::add_commute(const T& comm) {
+    if (has_commute() && commutators::coalesce(write_value<T>(), comm)) {
+        return *this;
+    }
     if (has_write() && !has_commute()) {
         clear_write();
     }
@@ -153,7 +159,7 @@ inline bool TVersion::observe_read_impl(TransItem &item, bool add_read){
     if (!t().check_opacity(item, version.value()))
         return false;
     if (add_read && !item.has_read()) {
-        VersionDelegate::item_or_flags(item, TransItem::read_bit);
+        VersionDelegate::item_or_flags(item, TransItem::read_bit | TransItem::opaque_read_bit);
         VersionDelegate::item_access_rdata(item).v = Packer<TVersion>::pack(t().buf_, std::move(version));
         //item().__or_flags(TransItem::read_bit);
         //item().rdata_ = Packer<TVersion>::pack(t()->buf_, std::move(version));
@@ -322,6 +328,9 @@ inline bool TLockVersion<Adaptive>::observe_read_impl(TransItem& item, bool add_
         } else if (response.first == LockResponse::locked) {
             VersionDelegate::item_or_flags(item, TransItem::lock_bit);
             VersionDelegate::item_or_flags(item, TransItem::read_bit);
+            // the version cannot change while we hold the read lock; record
+            // it so that the commit check passes if the lock is upgraded
+            VersionDelegate::item_access_rdata(item).v = Packer<TLockVersion>::pack(t().buf_, TLockVersion(v_));
             // XXX hack to prevent the commit protocol from skipping unlocks
             VersionDelegate::txn_set_any_nonopaque(t(), true);
         } else {
@@ -554,7 +563,7 @@ inline bool TicTocCompressedVersion<Opaque, Extend>::acquire_write_impl(TransIte
 template <bool Opaque, bool Extend> template <typename T>
 inline bool TicTocCompressedVersion<Opaque, Extend>::acquire_write_impl(TransItem& item, T&& wdata) {
     typedef typename std::decay<T>::type V;
-    return acquire_write_impl<V, V&&>(item, wdata);
+    return acquire_write_impl<V, V&&>(item, std::move(wdata));
 }
 
 template <bool Opaque, bool Extend> template <typename T, typename... Args>
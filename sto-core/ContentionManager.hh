@@ -10,7 +10,9 @@
 #define WAIT_CYCLES_MULTIPLICATOR 10000
 #define INIT_BACKOFF_CYCLES 3072
 
+#ifndef MAX_THREADS
 #define MAX_THREADS 128
+#endif
 
 class Transaction;
 
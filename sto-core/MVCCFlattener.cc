@@ -0,0 +1,97 @@
+#include "MVCCFlattener.hh"
+#include "Transaction.hh"
+#include <cstdio>
+#include <ostream>
+#include <unistd.h>
+
+std::atomic<unsigned> MvFlattener::depth_(0);
+std::atomic<bool> MvFlattener::running_(false);
+std::thread MvFlattener::thread_;
+MvFlattener::queue MvFlattener::queues_[MAX_THREADS];
+std::atomic<uint64_t> MvFlattener::nqueued_(0);
+std::atomic<uint64_t> MvFlattener::nflattened_(0);
+std::atomic<uint64_t> MvFlattener::ndropped_(0);
+
+void MvFlattener::start(int thread_id, unsigned us_period) {
+    always_assert(!running_, "MvFlattener::start");
+    always_assert(depth() > 0, "MvFlattener::start needs a depth");
+    running_ = true;
+    thread_ = std::thread(run, thread_id, us_period);
+}
+
+void MvFlattener::stop() {
+    if (!running_)
+        return;
+    running_ = false;
+    thread_.join();
+}
+
+void MvFlattener::run(int thread_id, unsigned us_period) {
+    TThread::set_id(thread_id);
+    while (running_) {
+        flatten_once();
+        usleep(us_period);
+    }
+    flatten_once();
+}
+
+void MvFlattener::enqueue(void* object, flatten_function f) {
+    auto& thr = Transaction::tinfo[TThread::id()];
+    auto& q = queues_[TThread::id()];
+    std::lock_guard<std::mutex> lk(q.mutex);
+    q.entries.push_back({object, f, thr.epoch.load(std::memory_order_relaxed)});
+    nqueued_.fetch_add(1, std::memory_order_relaxed);
+}
+
+// An object queued by a transaction with epoch E was reachable during E, so
+// it is retired at an epoch >= E. Holding epoch F <= E keeps it alive; and
+// it cannot have been freed before we took F, since the active epoch had
+// not yet passed F.
+void MvFlattener::flatten_once() {
+    auto& thr = Transaction::tinfo[TThread::id()];
+    assert(!TThread::txn || !TThread::txn->in_progress());
+    epoch_type pin = Transaction::global_epochs.read_epoch.load();
+    thr.epoch = pin;
+    fence();
+
+    std::vector<entry> batch;
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+        auto& q = queues_[i];
+        std::lock_guard<std::mutex> lk(q.mutex);
+        batch.insert(batch.end(), q.entries.begin(), q.entries.end());
+        q.entries.clear();
+    }
+
+    // every write below safe_tid has committed or aborted
+    tid_type safe_tid = Transaction::resolved_tid();
+    uint64_t nflattened = 0, ndropped = 0;
+    for (auto& e : batch) {
+        if (e.epoch == 0 || signed_epoch_type(e.epoch - pin) < 0) {
+            ++ndropped;
+            continue;
+        }
+        e.f(e.object, safe_tid);
+        ++nflattened;
+    }
+    nflattened_.fetch_add(nflattened, std::memory_order_relaxed);
+    ndropped_.fetch_add(ndropped, std::memory_order_relaxed);
+
+    thr.epoch = 0;
+    thr.rcu_set.clean_until(Transaction::global_epochs.active_epoch.load());
+}
+
+void MvFlattener::reset_stats() {
+    nqueued_ = 0;
+    nflattened_ = 0;
+    ndropped_ = 0;
+}
+
+void MvFlattener::print_stats(std::ostream& w) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "flattener: %llu objects queued, %llu flattened, %llu dropped\n",
+             (unsigned long long) nqueued_.load(),
+             (unsigned long long) nflattened_.load(),
+             (unsigned long long) ndropped_.load());
+    w << buf;
+}
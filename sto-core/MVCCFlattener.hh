@@ -0,0 +1,79 @@
+// Background flattening of MVCC delta chains
+
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Commutative writes leave COMMITTED_DELTA versions that readers fold into a
+// value in MvHistory::flatten. On a hot counter that can mean hundreds of
+// deltas per read. While the flattener is running, an MvObject queues itself
+// here every depth() deltas it commits, and the flattener thread turns the
+// newest delta older than every in-flight write into a full version, so
+// readers walk short chains.
+//
+// The flattener thread has its own TThread id and takes part in RCU: it
+// holds an epoch while it flattens, and the versions that flattening
+// retires are freed through its RCU set. An object is only reached through
+// the queue while the epoch of the transaction that queued it is still
+// protected; older entries are dropped, and the object is queued again after
+// another depth() deltas. Like MvHistory's delete callbacks, this assumes
+// objects are freed through RCU.
+class MvFlattener {
+public:
+    typedef uint64_t tid_type;
+    typedef uint64_t epoch_type;
+    typedef int64_t signed_epoch_type;
+    // Flatten @object below @safe_tid
+    typedef void (*flatten_function)(void* object, tid_type safe_tid);
+
+    // Queue an object every @depth deltas; 0 (the default) disables
+    static void set_depth(unsigned depth) {
+        depth_.store(depth, std::memory_order_relaxed);
+    }
+    static unsigned depth() {
+        return depth_.load(std::memory_order_relaxed);
+    }
+
+    // Start a flattener thread with TThread id @thread_id, waking every
+    // @us_period microseconds
+    static void start(int thread_id, unsigned us_period = 1000);
+    static void stop();
+
+    // Called by MvObject from the install phase of a committing transaction
+    static void enqueue(void* object, flatten_function f);
+
+    // Flatten everything queued so far. Run by the flattener thread, or by
+    // any thread outside a transaction (for tests).
+    static void flatten_once();
+
+    static void reset_stats();
+    static void print_stats(std::ostream& w);
+
+private:
+    struct entry {
+        void* object;
+        flatten_function f;
+        epoch_type epoch;  // of the queueing transaction
+    };
+
+    struct __attribute__((aligned(CACHE_LINE_SIZE))) queue {
+        std::mutex mutex;
+        std::vector<entry> entries;
+    };
+
+    static std::atomic<unsigned> depth_;
+    static std::atomic<bool> running_;
+    static std::thread thread_;
+    static queue queues_[MAX_THREADS];
+    static std::atomic<uint64_t> nqueued_;
+    static std::atomic<uint64_t> nflattened_;
+    static std::atomic<uint64_t> ndropped_;
+
+    static void run(int thread_id, unsigned us_period);
+};
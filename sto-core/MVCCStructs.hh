@@ -2,10 +2,11 @@
 
 #pragma once
 
-#include <stack>
+#include <vector>
 
 #include "MVCCTypes.hh"
 #include "TRcu.hh"
+#include "MVCCFlattener.hh"
 
 // Status types of MvHistory elements
 enum MvStatus {
@@ -264,6 +265,11 @@ public:
         return wtid_;
     }
 
+    // The commutative update of a DELTA version
+    inline const comm_type& commutator() const {
+        return c_;
+    }
+
 private:
     static void delete_prep_cb(void *ptr) {
         history_type *hd = static_cast<history_type*>(ptr);  // DELETED version
@@ -303,19 +309,75 @@ private:
     }
 
     void flatten(T &v) {
-        std::stack<history_type*> trace;
+        flatten(v, std::integral_constant<bool, commutators::can_coalesce<comm_type>::value>());
+    }
+
+    // One pass back to the last full version, merging the committed deltas
+    // after it into one commutator that is applied to it
+    void flatten(T &v, std::true_type) {
+        history_type *curr = this;
+        history_type *base = nullptr;
+        comm_type c{};
+        bool any = false;
+        TXP_INCREMENT(txp_mvcc_flat_versions);
+        while (true) {
+            if (!base && curr->status_is(COMMITTED)) {
+                if (!curr->status_is(DELTA)) {
+                    base = curr;
+                } else if (!any) {
+                    c = curr->c_;
+                    any = true;
+                } else {
+                    comm_type older = curr->c_;
+                    if (!commutators::coalesce(older, c)) {
+                        // replay the deltas one by one instead
+                        flatten(v, std::false_type());
+                        return;
+                    }
+                    c = std::move(older);
+                }
+            }
+            if (curr->status() == COMMITTED) {
+                break;
+            }
+            curr = curr->prev();
+            TXP_INCREMENT(txp_mvcc_flat_versions);
+            curr->gc_push(object()->is_inlined(curr));
+        }
+        v = base->v_;
+        if (any) {
+            v = c.operate(v);
+        }
+    }
+
+    // Replay the chain from the last full version. Chains are usually short
+    // (shorter still with the background flattener running), so the trace
+    // only goes to the heap past flatten_trace_inline versions.
+    void flatten(T &v, std::false_type) {
+        history_type *trace_inline[flatten_trace_inline];
+        std::vector<history_type*> trace_deep;
+        unsigned n = 0;
+        auto push = [&](history_type *h) {
+            if (n < flatten_trace_inline) {
+                trace_inline[n] = h;
+            } else {
+                trace_deep.push_back(h);
+            }
+            ++n;
+        };
         history_type *curr = this;
-        trace.push(curr);
+        push(curr);
         TXP_INCREMENT(txp_mvcc_flat_versions);
         while (curr->status() != COMMITTED) {
             curr = curr->prev();
-            trace.push(curr);
+            push(curr);
             TXP_INCREMENT(txp_mvcc_flat_versions);
             curr->gc_push(object()->is_inlined(curr));
         }
-        while (!trace.empty()) {
-            auto h = trace.top();
-            trace.pop();
+        while (n) {
+            --n;
+            auto h = n < flatten_trace_inline ? trace_inline[n]
+                                              : trace_deep[n - flatten_trace_inline];
 
             if (h->status_is(COMMITTED)) {
                 if (h->status_is(DELTA)) {
@@ -354,6 +416,8 @@ private:
         return ele;
     }
 
+    static constexpr unsigned flatten_trace_inline = 32;
+
     object_type * const obj_;  // Parent object
     comm_type c_;
     T v_;
@@ -378,7 +442,7 @@ public:
     typedef TransactionTid::type type;
 
 #if MVCC_INLINING
-    MvObject() : h_(&ih_), ih_(this) {
+    MvObject() : h_(&ih_), ndeltas_(0), ih_(this) {
         if (std::is_trivial<T>::value) {
             ih_.v_ = T();
             ih_.status_delete();
@@ -389,23 +453,23 @@ public:
         itid_.store(ih_.rtid(), std::memory_order_relaxed);
     }
     explicit MvObject(const T& value)
-            : h_(&ih_), ih_(0, this, value) {
+            : h_(&ih_), ndeltas_(0), ih_(0, this, value) {
         ih_.status_commit();
         itid_.store(ih_.rtid(), std::memory_order_relaxed);
     }
     explicit MvObject(T&& value)
-            : h_(&ih_), ih_(0, this, value) {
+            : h_(&ih_), ndeltas_(0), ih_(0, this, value) {
         ih_.status_commit();
         itid_.store(ih_.rtid(), std::memory_order_relaxed);
     }
     template <typename... Args>
     explicit MvObject(Args&&... args)
-            : h_(&ih_), ih_(0, this, T(std::forward<Args>(args)...)) {
+            : h_(&ih_), ndeltas_(0), ih_(0, this, T(std::forward<Args>(args)...)) {
         ih_.status_commit();
         itid_.store(ih_.rtid(), std::memory_order_relaxed);
     }
 #else
-    MvObject() : h_(new history_type(this)) {
+    MvObject() : h_(new history_type(this)), ndeltas_(0) {
         if (std::is_trivial<T>::value) {
             h_.load()->v_ = T();
             h_.load()->status_delete();
@@ -415,16 +479,16 @@ public:
         h_.load()->status_commit();
     }
     explicit MvObject(const T& value)
-            : h_(new history_type(0, this, value)) {
+            : h_(new history_type(0, this, value)), ndeltas_(0) {
         h_.load()->status_commit();
     }
     explicit MvObject(T&& value)
-            : h_(new history_type(0, this, value)) {
+            : h_(new history_type(0, this, value)), ndeltas_(0) {
         h_.load()->status_commit();
     }
     template <typename... Args>
     explicit MvObject(Args&&... args)
-            : h_(new history_type(0, this, T(std::forward<Args>(args)...))) {
+            : h_(new history_type(0, this, T(std::forward<Args>(args)...))), ndeltas_(0) {
         h_.load()->status_commit();
     }
 #endif
@@ -493,6 +557,15 @@ public:
         }
 #endif
 
+        if (h->status_is(COMMITTED_DELTA)) {
+            unsigned depth = MvFlattener::depth();
+            if (depth && (ndeltas_.fetch_add(1, std::memory_order_relaxed) + 1) % depth == 0) {
+                MvFlattener::enqueue(this, background_flatten);
+            }
+        } else if (ndeltas_.load(std::memory_order_relaxed)) {
+            ndeltas_.store(0, std::memory_order_relaxed);
+        }
+
         if (h->status_is(COMMITTED_DELTA, COMMITTED)) {
             // Put predecessors in the RCU list, but only if they aren't already
             history_type *prev = h->prev();
@@ -705,6 +778,19 @@ public:
     }
 
 protected:
+    // Called by MvFlattener: turn the newest delta that no pending write
+    // precedes into a full version
+    static void background_flatten(void *ptr, type safe_tid) {
+        MvObject<T> *obj = static_cast<MvObject<T>*>(ptr);
+        history_type *h = obj->h_;
+        while (h && (h->wtid() > safe_tid || !h->status_is(COMMITTED))) {
+            h = h->prev();
+        }
+        if (h && h->status_is(DELTA)) {
+            h->enflatten();
+        }
+    }
+
     // Spin-wait on interested item
     void wait_if_pending(const history_type *h) const {
         while (h->status_is(MvStatus::PENDING)) {
@@ -714,6 +800,7 @@ protected:
     }
 
     std::atomic<history_type*> h_;
+    std::atomic<unsigned> ndeltas_;  // Deltas committed since the last full version
 #if MVCC_INLINING
     history_type ih_;  // Inlined version
     std::atomic<type> itid_;  // TID representing until when the inlined version is correct
@@ -0,0 +1,143 @@
+#include "TAbortProfile.hh"
+#include "Transaction.hh"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <execinfo.h>
+#include <map>
+#include <tuple>
+#include <typeinfo>
+
+std::atomic<bool> TAbortProfile::enabled_(false);
+TAbortProfile::table TAbortProfile::tables_[MAX_THREADS];
+
+void* TAbortProfile::caller_pc() {
+    return __builtin_return_address(0);
+}
+
+void TAbortProfile::account(const char* reason, const TransItem* item, void* pc) {
+    table& t = tables_[TThread::id()];
+    if (t.slots.empty())
+        t.slots.resize(table_size);
+    const void* type = nullptr;
+    unsigned bucket = key_buckets;  // no item
+    void* key = nullptr;
+    if (item) {
+        type = &typeid(*item->owner());
+        key = item->key<void*>();
+        bucket = (reinterpret_cast<uintptr_t>(key) * 0x9E3779B97F4A7C15ULL) >> 40;
+        bucket %= key_buckets;
+    }
+    if (!reason)
+        reason = "unspecified";
+
+    uintptr_t h = reinterpret_cast<uintptr_t>(reason) ^ reinterpret_cast<uintptr_t>(type)
+        ^ reinterpret_cast<uintptr_t>(pc) ^ (uintptr_t(bucket) << 20);
+    h = (h * 0x9E3779B97F4A7C15ULL) >> 32;
+    for (unsigned n = 0; n != table_size; ++n) {
+        entry& e = t.slots[(h + n) % table_size];
+        if (!e.count) {
+            if (t.used == table_size / 2)
+                break;
+            e = entry{reason, type, bucket, pc, 1, key};
+            ++t.used;
+            return;
+        }
+        if (e.reason == reason && e.type == type && e.bucket == bucket && e.pc == pc) {
+            ++e.count;
+            return;
+        }
+    }
+    ++t.overflow;
+}
+
+void TAbortProfile::reset() {
+    for (auto& t : tables_) {
+        std::fill(t.slots.begin(), t.slots.end(), entry());
+        t.used = 0;
+        t.overflow = 0;
+    }
+}
+
+static std::string demangle(const void* type) {
+    if (!type)
+        return "-";
+    const char* name = static_cast<const std::type_info*>(type)->name();
+    int status;
+    char* d = abi::__cxa_demangle(name, nullptr, nullptr, &status);
+    std::string s(d && status == 0 ? d : name);
+    free(d);
+    return s;
+}
+
+static std::string symbolize(void* pc) {
+    if (!pc)
+        return "-";
+    char** syms = backtrace_symbols(&pc, 1);
+    std::string s(syms ? syms[0] : "?");
+    free(syms);
+    return s;
+}
+
+void TAbortProfile::print_report(std::ostream& w, unsigned top_n) {
+    // merge by reason text, since equal literals in different translation
+    // units may have different addresses
+    typedef std::tuple<std::string, const void*, unsigned, void*> key_type;
+    std::map<key_type, entry> merged;
+    uint64_t total = 0, overflow = 0;
+    for (auto& t : tables_) {
+        overflow += t.overflow;
+        for (auto& e : t.slots) {
+            if (!e.count)
+                continue;
+            total += e.count;
+            auto& m = merged[key_type(e.reason, e.type, e.bucket, e.pc)];
+            if (!m.count)
+                m = e;
+            else
+                m.count += e.count;
+        }
+    }
+    total += overflow;
+
+    std::vector<entry> top;
+    for (auto& m : merged)
+        top.push_back(m.second);
+    std::sort(top.begin(), top.end(), [](const entry& a, const entry& b) {
+        return a.count > b.count;
+    });
+    if (top.size() > top_n)
+        top.resize(top_n);
+
+    w << "$ abort profile: " << total << " aborts, " << merged.size()
+      << " distinct sites";
+    if (overflow)
+        w << ", " << overflow << " not attributed (table full)";
+    w << "\n";
+    for (auto& e : top) {
+        char buf[64];
+        snprintf(buf, sizeof(buf), "$ %10llu %6.2f%%  ",
+                 (unsigned long long) e.count, 100.0 * e.count / total);
+        w << buf << e.reason << "  " << demangle(e.type);
+        if (e.bucket != key_buckets)
+            w << " bucket " << e.bucket << " (e.g. key " << e.sample_key << ")";
+        w << "\n$            at " << symbolize(e.pc) << "\n";
+    }
+}
+
+namespace {
+struct env_configure {
+    unsigned top_n = 0;
+    env_configure() {
+        if (const char* s = getenv("STO_ABORT_PROFILE")) {
+            top_n = atoi(s);
+            TAbortProfile::set_enabled(top_n != 0);
+        }
+    }
+    ~env_configure() {
+        if (top_n)
+            TAbortProfile::print_report(std::cerr, top_n);
+    }
+} env_configure_instance;
+}
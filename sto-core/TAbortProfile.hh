@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <vector>
+#include "compiler.hh"
+#include "TThread.hh"
+
+class TransItem;
+
+// Abort attribution. When enabled, every abort is counted in a per-thread
+// table keyed by (reason, owner TObject type, key hash bucket, code site).
+// The code site is the PC at which the abort was marked: the
+// mark_abort_because() call for aborts detected by the concurrency control,
+// or the Transaction::abort() call for explicit aborts. Both are inlined, so
+// the PC lies in the function that (after inlining) contains the abort; run
+// `addr2line -i -f -e BINARY PC` for the source lines (for position
+// independent binaries, use the offset the report prints in parentheses).
+//
+// Tables are merged when a report is printed, which is meant to happen after
+// the worker threads have finished. Starting a process with
+// STO_ABORT_PROFILE=N enables the profiler and prints the N hottest entries
+// to stderr at exit.
+class TAbortProfile {
+public:
+    static constexpr unsigned key_buckets = 1024;
+
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    static void set_enabled(bool on) {
+        enabled_.store(on, std::memory_order_relaxed);
+    }
+
+    // Returns the address this function returns to, i.e. the caller's PC.
+    static void* caller_pc() __attribute__((noinline));
+
+    static void account(const char* reason, const TransItem* item, void* pc);
+    static void reset();
+    static void print_report(std::ostream& w, unsigned top_n = 20);
+
+private:
+    struct entry {
+        const char* reason;
+        const void* type;       // std::type_info of the owner, if any
+        unsigned bucket;
+        void* pc;
+        uint64_t count;
+        void* sample_key;
+    };
+    struct __attribute__((aligned(CACHE_LINE_SIZE))) table {
+        std::vector<entry> slots;
+        unsigned used;
+        uint64_t overflow;
+    };
+    static constexpr unsigned table_size = 4096;  // power of two
+
+    static std::atomic<bool> enabled_;
+    static table tables_[MAX_THREADS];
+};
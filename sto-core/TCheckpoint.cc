@@ -0,0 +1,309 @@
+#include "TCheckpoint.hh"
+#include "Transaction.hh"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <ostream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+// A part file is a header, rows ({key_length, value_length}, key, value),
+// and a trailer; a file without its trailer is incomplete. The MANIFEST
+// lists the parts after a header of its own.
+struct file_header {
+    uint32_t magic;
+    uint32_t table;
+    uint32_t part;
+    uint32_t unused;
+    uint64_t tid;
+};
+struct file_trailer {
+    uint32_t magic;
+    uint32_t unused;
+    uint64_t nrows;
+};
+struct row_header {
+    uint32_t key_length;
+    uint32_t value_length;
+};
+struct manifest_header {
+    uint32_t magic;
+    uint32_t nfiles;
+    uint64_t tid;
+    uint64_t epoch;
+    uint64_t nrows;
+    uint64_t nbytes;
+};
+struct manifest_entry {
+    uint32_t table;
+    uint32_t part;
+};
+constexpr uint32_t file_magic = 0x434f5453;      // "STOC"
+constexpr uint32_t trailer_magic = 0x454f5453;   // "STOE"
+constexpr uint32_t manifest_magic = 0x4b4f5453;  // "STOK"
+constexpr size_t writer_buffer_size = 1 << 20;
+
+bool write_all(int fd, const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+bool read_file(const std::string& path, std::string& out) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    char buf[1 << 16];
+    ssize_t r;
+    while ((r = ::read(fd, buf, sizeof(buf))) > 0 || (r < 0 && errno == EINTR))
+        if (r > 0)
+            out.append(buf, r);
+    ::close(fd);
+    return true;
+}
+
+bool sync_path(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    bool ok = ::fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+std::string part_name(uint32_t table, uint32_t part) {
+    return std::to_string(table) + "." + std::to_string(part);
+}
+
+// Numbered checkpoint subdirectories of @dir, in increasing order
+std::vector<unsigned long> list_checkpoints(const std::string& dir) {
+    std::vector<unsigned long> seqs;
+    if (DIR* d = ::opendir(dir.c_str())) {
+        while (struct dirent* de = ::readdir(d)) {
+            char* end;
+            unsigned long seq = strtoul(de->d_name, &end, 10);
+            if (de->d_name[0] >= '0' && de->d_name[0] <= '9' && !*end)
+                seqs.push_back(seq);
+        }
+        ::closedir(d);
+    }
+    std::sort(seqs.begin(), seqs.end());
+    return seqs;
+}
+
+void remove_checkpoint(const std::string& path) {
+    if (DIR* d = ::opendir(path.c_str())) {
+        while (struct dirent* de = ::readdir(d))
+            if (strcmp(de->d_name, ".") != 0 && strcmp(de->d_name, "..") != 0)
+                ::unlink((path + "/" + de->d_name).c_str());
+        ::closedir(d);
+    }
+    ::rmdir(path.c_str());
+}
+
+double ms_since(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
+}
+}
+
+void TCheckpoint::writer::add(const void* key, uint32_t key_length,
+                              const void* value, uint32_t value_length) {
+    row_header rh{key_length, value_length};
+    buf_.append(reinterpret_cast<const char*>(&rh), sizeof(rh));
+    buf_.append(static_cast<const char*>(key), key_length);
+    buf_.append(static_cast<const char*>(value), value_length);
+    ++nrows_;
+    if (buf_.size() >= writer_buffer_size)
+        flush();
+}
+
+bool TCheckpoint::writer::flush() {
+    ok_ = ok_ && write_all(fd_, buf_.data(), buf_.size());
+    nbytes_ += buf_.size();
+    buf_.clear();
+    return ok_;
+}
+
+bool TCheckpoint::write(const std::string& dir, tid_type tid,
+                        const std::vector<task>& tasks,
+                        unsigned nthreads, int first_thread_id,
+                        const std::function<void()>& thread_init, stats& st) {
+    auto start = std::chrono::steady_clock::now();
+    if (::mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+        perror(dir.c_str());
+        return false;
+    }
+    auto old = list_checkpoints(dir);
+    std::string path = dir + "/" + std::to_string(old.empty() ? 1 : old.back() + 1);
+    if (::mkdir(path.c_str(), 0777) != 0) {
+        perror(path.c_str());
+        return false;
+    }
+
+    st = stats{tid, Transaction::global_epochs.global_epoch.load(), tasks.size(), 0, 0, 0};
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> nrows(0), nbytes(0);
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i != nthreads; ++i)
+        threads.emplace_back([&, i]() {
+            TThread::set_id(first_thread_id + i);
+            thread_init();
+            for (size_t t; (t = next++) < tasks.size(); ) {
+                const task& tk = tasks[t];
+                std::string fn = path + "/" + part_name(tk.table, tk.part);
+                writer w;
+                w.fd_ = ::open(fn.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+                w.ok_ = w.fd_ >= 0;
+                w.nrows_ = w.nbytes_ = 0;
+                if (!w.ok_) {
+                    perror(fn.c_str());
+                    ok = false;
+                    continue;
+                }
+                file_header fh{file_magic, tk.table, tk.part, 0, tid};
+                w.buf_.append(reinterpret_cast<const char*>(&fh), sizeof(fh));
+                {
+                    TransactionGuard guard;
+                    Sto::declare_read_only();
+                    Sto::pin_snapshot(tid);
+                    tk.scan(w);
+                }
+                file_trailer ft{trailer_magic, 0, w.nrows_};
+                w.buf_.append(reinterpret_cast<const char*>(&ft), sizeof(ft));
+                if (!w.flush() || ::fdatasync(w.fd_) != 0)
+                    ok = false;
+                ::close(w.fd_);
+                nrows += w.nrows_;
+                nbytes += w.nbytes_;
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+    st.nrows = nrows;
+    st.nbytes = nbytes;
+    if (!ok)
+        return false;
+
+    manifest_header mh{manifest_magic, uint32_t(tasks.size()), tid, st.epoch, st.nrows, st.nbytes};
+    std::string m(reinterpret_cast<const char*>(&mh), sizeof(mh));
+    for (auto& tk : tasks) {
+        manifest_entry me{tk.table, tk.part};
+        m.append(reinterpret_cast<const char*>(&me), sizeof(me));
+    }
+    std::string tmp = path + "/MANIFEST.tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    bool mok = fd >= 0 && write_all(fd, m.data(), m.size()) && ::fdatasync(fd) == 0;
+    if (fd >= 0)
+        ::close(fd);
+    if (!mok || ::rename(tmp.c_str(), (path + "/MANIFEST").c_str()) != 0
+        || !sync_path(path)) {
+        perror(tmp.c_str());
+        return false;
+    }
+
+    for (auto seq : old)
+        remove_checkpoint(dir + "/" + std::to_string(seq));
+    st.ms = ms_since(start);
+    return true;
+}
+
+bool TCheckpoint::read(const std::string& dir, unsigned nthreads,
+                       const std::function<void()>& thread_init,
+                       const load_type& load, stats& st) {
+    auto start = std::chrono::steady_clock::now();
+    auto seqs = list_checkpoints(dir);
+    std::string path, m;
+    manifest_header mh;
+    while (!seqs.empty()) {
+        path = dir + "/" + std::to_string(seqs.back());
+        seqs.pop_back();
+        m.clear();
+        if (read_file(path + "/MANIFEST", m) && m.size() >= sizeof(mh)) {
+            memcpy(&mh, m.data(), sizeof(mh));
+            if (mh.magic == manifest_magic
+                && m.size() == sizeof(mh) + mh.nfiles * sizeof(manifest_entry))
+                break;
+        }
+        path.clear();
+    }
+    if (path.empty())
+        return false;
+
+    std::vector<manifest_entry> entries(mh.nfiles);
+    memcpy(entries.data(), m.data() + sizeof(mh), mh.nfiles * sizeof(manifest_entry));
+    st = stats{mh.tid, mh.epoch, mh.nfiles, 0, 0, 0};
+    std::atomic<size_t> next(0);
+    std::atomic<uint64_t> nrows(0), nbytes(0);
+    std::atomic<bool> ok(true);
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i != nthreads; ++i)
+        threads.emplace_back([&, i]() {
+            TThread::set_id(i);
+            thread_init();
+            for (size_t f; (f = next++) < entries.size(); ) {
+                std::string data;
+                std::string fn = path + "/" + part_name(entries[f].table, entries[f].part);
+                file_header fh;
+                file_trailer ft;
+                if (!read_file(fn, data) || data.size() < sizeof(fh) + sizeof(ft)) {
+                    ok = false;
+                    continue;
+                }
+                memcpy(&fh, data.data(), sizeof(fh));
+                memcpy(&ft, data.data() + data.size() - sizeof(ft), sizeof(ft));
+                if (fh.magic != file_magic || ft.magic != trailer_magic || fh.tid != mh.tid) {
+                    ok = false;
+                    continue;
+                }
+                size_t pos = sizeof(fh), end = data.size() - sizeof(ft);
+                uint64_t n = 0;
+                while (pos + sizeof(row_header) <= end) {
+                    row_header rh;
+                    memcpy(&rh, data.data() + pos, sizeof(rh));
+                    pos += sizeof(rh);
+                    if (pos + rh.key_length + rh.value_length > end)
+                        break;
+                    load(fh.table, data.data() + pos, rh.key_length,
+                         data.data() + pos + rh.key_length, rh.value_length);
+                    pos += rh.key_length + rh.value_length;
+                    ++n;
+                }
+                if (pos != end || n != ft.nrows)
+                    ok = false;
+                nrows += n;
+                nbytes += data.size();
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+    st.nrows = nrows;
+    st.nbytes = nbytes;
+    st.ms = ms_since(start);
+    return ok;
+}
+
+void TCheckpoint::print_stats(std::ostream& w, const char* what, const stats& st) {
+    char buf[256];
+    snprintf(buf, sizeof(buf),
+             "%s: tid %llu, epoch %llu, %llu files, %llu rows, %.1f MB, %.1f ms\n",
+             what, (unsigned long long) st.tid, (unsigned long long) st.epoch,
+             (unsigned long long) st.nfiles, (unsigned long long) st.nrows,
+             st.nbytes / 1048576.0, st.ms);
+    w << buf;
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+#include "TLog.hh"
+
+// Consistent online checkpoints. A checkpoint is the state of a set of
+// tables at one snapshot tid, taken while transactions keep running: the
+// caller holds the snapshot in a running read-only transaction (hybrid OCC
+// tables keep overwritten rows for it, MVCC tables keep their versions), and
+// checkpoint threads, each in a read-only transaction pinned to the same
+// tid, scan table parts into one file each. A checkpoint lives in its own
+// numbered subdirectory of DIR; it is complete once its MANIFEST, written
+// and synced after every part, exists, and older checkpoints are removed
+// then.
+//
+// A checkpoint plus the TLog records with larger tids restores the database:
+// read() loads the latest complete checkpoint with one thread per file, and
+// the log is replayed on top of it (bench::db_checkpointer does both).
+class TCheckpoint {
+public:
+    typedef TLog::tid_type tid_type;
+    typedef TLog::epoch_type epoch_type;
+
+    // Rows of one table part, buffered and written by one thread
+    class writer {
+    public:
+        void add(const void* key, uint32_t key_length,
+                 const void* value, uint32_t value_length);
+        uint64_t nrows() const {
+            return nrows_;
+        }
+
+    private:
+        int fd_;
+        bool ok_;
+        std::string buf_;
+        uint64_t nrows_;
+        uint64_t nbytes_;
+
+        bool flush();
+        friend class TCheckpoint;
+    };
+
+    struct task {
+        uint32_t table;
+        uint32_t part;
+        std::function<void(writer&)> scan;
+    };
+
+    struct stats {
+        tid_type tid;
+        epoch_type epoch;
+        uint64_t nfiles;
+        uint64_t nrows;
+        uint64_t nbytes;
+        double ms;
+    };
+
+    // Take a checkpoint at @tid, which the calling thread's transaction must
+    // hold, into a new subdirectory of @dir. The tasks are run by @nthreads
+    // threads with TThread ids @first_thread_id and up; each calls
+    // @thread_init first.
+    static bool write(const std::string& dir, tid_type tid,
+                      const std::vector<task>& tasks,
+                      unsigned nthreads, int first_thread_id,
+                      const std::function<void()>& thread_init, stats& st);
+
+    // Load the latest complete checkpoint in @dir with @nthreads threads,
+    // which have TThread ids 0 and up. @load is called concurrently for rows
+    // of different files. Returns false if there is no complete checkpoint
+    // or it cannot be read.
+    typedef std::function<void(uint32_t table, const char* key, uint32_t key_length,
+                               const char* value, uint32_t value_length)> load_type;
+    static bool read(const std::string& dir, unsigned nthreads,
+                     const std::function<void()>& thread_init,
+                     const load_type& load, stats& st);
+
+    static void print_stats(std::ostream& w, const char* what, const stats& st);
+};
@@ -0,0 +1,205 @@
+#pragma once
+
+// Interleaved transaction execution with C++20 coroutines (build with
+// COROUTINES=1 or -DSTO_COROUTINES=ON). A worker thread runs several
+// transactions at once, each a coroutine with its own Transaction and
+// TThread id. Before a lookup likely to miss in the cache, a transaction
+// prefetches the line and suspends, and the scheduler resumes another
+// transaction while the line arrives.
+//
+// Per-thread state (tinfo, RCU sets, log buffers) is indexed by TThread id,
+// so each coroutine slot needs its own id, and a worker with N slots uses N
+// ids. MAX_THREADS bounds the total.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define STO_COROUTINES 1
+#else
+#define STO_COROUTINES 0
+#endif
+
+#if STO_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <utility>
+#include <vector>
+#include "Transaction.hh"
+
+class TCoroutine {
+public:
+    // A coroutine transaction body. It starts suspended; the scheduler
+    // resumes it, with its slot's Transaction current, until it is done.
+    class task {
+    public:
+        struct promise_type {
+            std::exception_ptr exception;
+
+            task get_return_object() {
+                return task(handle_type::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept {
+                return {};
+            }
+            std::suspend_always final_suspend() noexcept {
+                return {};
+            }
+            void return_void() {
+            }
+            void unhandled_exception() {
+                exception = std::current_exception();
+            }
+        };
+        typedef std::coroutine_handle<promise_type> handle_type;
+
+        task() = default;
+        task(task&& x) noexcept
+            : h_(std::exchange(x.h_, nullptr)) {
+        }
+        task& operator=(task&& x) noexcept {
+            if (this != &x) {
+                if (h_)
+                    h_.destroy();
+                h_ = std::exchange(x.h_, nullptr);
+            }
+            return *this;
+        }
+        ~task() {
+            if (h_)
+                h_.destroy();
+        }
+
+        explicit operator bool() const {
+            return bool(h_);
+        }
+        bool done() const {
+            return h_.done();
+        }
+        // Run until the next suspension; rethrows what the body threw
+        void resume() {
+            h_.resume();
+            if (h_.done() && h_.promise().exception)
+                std::rethrow_exception(h_.promise().exception);
+        }
+
+    private:
+        handle_type h_;
+
+        explicit task(handle_type h)
+            : h_(h) {
+        }
+    };
+
+    // co_await prefetch(p): prefetch the line at @p and let other
+    // transactions run while it arrives. A null @p continues at once.
+    class prefetch {
+    public:
+        explicit prefetch(const void* p)
+            : p_(p) {
+            if (p)
+                ::prefetch(p);
+        }
+        bool await_ready() const noexcept {
+            return !p_;
+        }
+        void await_suspend(std::coroutine_handle<>) const noexcept {
+        }
+        void await_resume() const noexcept {
+        }
+
+    private:
+        const void* p_;
+    };
+
+    // co_await yield(): let other transactions run, e.g. after several
+    // prefetches
+    static std::suspend_always yield() {
+        return {};
+    }
+
+    // Round-robin scheduler over @nslots coroutine slots, which use TThread
+    // ids @first_id and up. Construct and run it on the worker thread.
+    class scheduler {
+    public:
+        scheduler(int first_id, int nslots)
+            : saved_id_(TThread::id()), saved_txn_(TThread::txn) {
+            always_assert(nslots > 0 && first_id >= 0 && first_id + nslots <= MAX_THREADS,
+                          "too many coroutine slots for MAX_THREADS");
+            for (int i = 0; i != nslots; ++i) {
+                TThread::set_id(first_id + i);
+                slots_.push_back(slot{first_id + i, new Transaction(false), task()});
+            }
+            restore();
+        }
+        scheduler(const scheduler&) = delete;
+        scheduler& operator=(const scheduler&) = delete;
+        ~scheduler() {
+            // unfinished bodies abort their transactions as they unwind
+            for (auto& s : slots_) {
+                use(s);
+                s.body = task();
+                delete s.txn;
+            }
+            restore();
+        }
+
+        int nslots() const {
+            return int(slots_.size());
+        }
+
+        // Run transaction bodies until every slot is out of work. @next(i)
+        // returns slot i's next body, or an empty task if there is none;
+        // it is called outside any slot. Returns the number of bodies run
+        // to completion. An exception thrown by a body leaves run() with
+        // the thread's own id and transaction restored.
+        template <typename F>
+        uint64_t run(F next) {
+            uint64_t ndone = 0;
+            int nlive = 0;
+            for (int i = 0; i != nslots(); ++i)
+                if ((slots_[i].body = next(i)))
+                    ++nlive;
+            while (nlive) {
+                for (int i = 0; i != nslots(); ++i) {
+                    slot& s = slots_[i];
+                    if (!s.body)
+                        continue;
+                    use(s);
+                    try {
+                        s.body.resume();
+                    } catch (...) {
+                        restore();
+                        throw;
+                    }
+                    if (s.body.done()) {
+                        ++ndone;
+                        restore();
+                        if (!(s.body = next(i)))
+                            --nlive;
+                    }
+                }
+            }
+            restore();
+            return ndone;
+        }
+
+    private:
+        struct slot {
+            int id;
+            Transaction* txn;
+            task body;
+        };
+
+        std::vector<slot> slots_;
+        int saved_id_;
+        Transaction* saved_txn_;
+
+        void use(slot& s) {
+            TThread::set_id(s.id);
+            TThread::txn = s.txn;
+        }
+        void restore() {
+            TThread::set_id(saved_id_);
+            TThread::txn = saved_txn_;
+        }
+    };
+};
+#endif
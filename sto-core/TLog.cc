@@ -0,0 +1,347 @@
+#include "TLog.hh"
+#include "Transaction.hh"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::atomic<bool> TLog::enabled_(false);
+std::atomic<bool> TLog::running_(false);
+std::atomic<TLog::epoch_type> TLog::durable_epoch_(0);
+std::atomic<uint64_t> TLog::durable_tsc_[TLog::durable_ring];
+TLog::worker TLog::workers_[MAX_THREADS];
+std::vector<TLog::logger*> TLog::loggers_;
+std::atomic<uint64_t> TLog::nsyncs_(0);
+
+namespace {
+// Logs are sequences of blocks. A data block holds the records of one
+// buffer; a marker block says that every record of an epoch <= its epoch
+// written before it is on disk.
+struct block_header {
+    uint32_t magic;
+    uint32_t nbytes;
+    uint64_t epoch;
+};
+constexpr uint32_t data_magic = 0x4c4f5453;    // "STOL"
+constexpr uint32_t marker_magic = 0x4d4f5453;  // "STOM"
+constexpr unsigned us_per_flush = 1000;
+
+std::mutex publish_mutex;
+
+std::string log_path(const std::string& dir, unsigned i) {
+    return dir + "/log." + std::to_string(i);
+}
+
+bool write_all(int fd, const void* data, size_t n) {
+    const char* p = static_cast<const char*>(data);
+    while (n) {
+        ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+bool read_file(const std::string& path, std::string& out) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    char buf[1 << 16];
+    ssize_t r;
+    while ((r = ::read(fd, buf, sizeof(buf))) > 0 || (r < 0 && errno == EINTR))
+        if (r > 0)
+            out.append(buf, r);
+    ::close(fd);
+    return true;
+}
+
+inline size_t record_size(uint32_t key_length, uint32_t value_length) {
+    size_t n = sizeof(TLog::record_header) + key_length
+        + (value_length == TLog::delete_length ? 0 : value_length);
+    return (n + 7) & ~size_t(7);
+}
+}
+
+bool TLog::start(const std::string& dir, unsigned nloggers) {
+    always_assert(!enabled() && nloggers > 0, "TLog::start");
+    if (::mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST) {
+        perror(dir.c_str());
+        return false;
+    }
+    for (unsigned i = 0; i != nloggers; ++i) {
+        logger* l = new logger;
+        l->index = i;
+        l->fd = ::open(log_path(dir, i).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+        if (l->fd < 0) {
+            perror(log_path(dir, i).c_str());
+            delete l;
+            return false;
+        }
+        l->durable = 0;
+        loggers_.push_back(l);
+    }
+    durable_epoch_ = 0;
+    running_ = true;
+    enabled_ = true;
+    for (auto l : loggers_)
+        l->thread = std::thread(run_logger, l);
+    return true;
+}
+
+void TLog::stop() {
+    if (!enabled())
+        return;
+    running_ = false;
+    for (auto l : loggers_)
+        l->thread.join();
+    // no transaction is committing, so every record is in an epoch <= this
+    epoch_type bound = Transaction::global_epochs.global_epoch.load();
+    for (auto l : loggers_)
+        flush(l, bound, true);
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i)
+        retire_acks(workers_[i], durable_epoch());
+    enabled_ = false;
+    for (auto l : loggers_) {
+        ::close(l->fd);
+        delete l;
+    }
+    loggers_.clear();
+}
+
+void TLog::run_logger(logger* l) {
+    while (running_) {
+        epoch_type g = Transaction::global_epochs.global_epoch.load();
+        flush(l, g - 1, false);
+        usleep(us_per_flush);
+    }
+}
+
+// Write out the buffers of @l's threads. Threads take their log epoch while
+// holding their mutex, and the global epoch was @bound + 1 or more before we
+// took the mutexes, so afterwards no thread can log a record for an epoch
+// <= @bound. Once the buffers are synced, @bound is durable for @l.
+bool TLog::flush(logger* l, epoch_type bound, bool force) {
+    std::vector<std::pair<worker*, buffer*>> bufs;
+    for (int i = l->index, n = TThread::num_ids(); i < n; i += loggers_.size()) {
+        worker& w = workers_[i];
+        std::lock_guard<std::mutex> guard(w.mutex);
+        for (auto b : w.full)
+            bufs.emplace_back(&w, b);
+        w.full.clear();
+        if (w.open && w.open->size) {
+            bufs.emplace_back(&w, w.open);
+            w.open = nullptr;
+        }
+    }
+    bool advance = force || signed_epoch_type(bound - l->durable.load()) > 0;
+    if (bufs.empty() && !advance)
+        return false;
+
+    bool ok = true;
+    for (auto& wb : bufs) {
+        block_header bh{data_magic, uint32_t(wb.second->size), 0};
+        ok = ok && write_all(l->fd, &bh, sizeof(bh))
+            && write_all(l->fd, wb.second->data, wb.second->size);
+    }
+    if (!bufs.empty()) {
+        ok = ok && ::fdatasync(l->fd) == 0;
+        ++nsyncs_;
+    }
+    if (advance) {
+        block_header bh{marker_magic, 0, bound};
+        ok = ok && write_all(l->fd, &bh, sizeof(bh)) && ::fdatasync(l->fd) == 0;
+        ++nsyncs_;
+    }
+    always_assert(ok, "TLog write failed");
+    if (advance) {
+        l->durable = bound;
+        publish_durable();
+    }
+
+    for (auto& wb : bufs) {
+        wb.second->size = 0;
+        std::lock_guard<std::mutex> guard(wb.first->mutex);
+        wb.first->free.push_back(wb.second);
+    }
+    return true;
+}
+
+void TLog::publish_durable() {
+    std::lock_guard<std::mutex> guard(publish_mutex);
+    epoch_type m = loggers_[0]->durable;
+    for (auto l : loggers_)
+        if (signed_epoch_type(l->durable - m) < 0)
+            m = l->durable;
+    epoch_type old = durable_epoch_.load(std::memory_order_relaxed);
+    if (signed_epoch_type(m - old) <= 0)
+        return;
+    uint64_t now = read_tsc();
+    // stamp epochs old+1..m, or only the last durable_ring of them
+    epoch_type first = old + 1;
+    if (signed_epoch_type(m - old) > signed_epoch_type(durable_ring))
+        first = m - durable_ring + 1;
+    for (epoch_type e = first; e != m + 1; ++e)
+        durable_tsc_[e % durable_ring].store(now, std::memory_order_relaxed);
+    durable_epoch_.store(m, std::memory_order_release);
+}
+
+void TLog::begin_commit() {
+    worker& w = workers_[TThread::id()];
+    w.mutex.lock();
+    w.commit_epoch = Transaction::global_epochs.global_epoch.load();
+}
+
+void TLog::abort_commit() {
+    workers_[TThread::id()].mutex.unlock();
+}
+
+void TLog::end_commit() {
+    worker& w = workers_[TThread::id()];
+    w.mutex.unlock();
+    uint64_t now = read_tsc();
+    if (!w.pending.empty() && w.pending.back().epoch == w.commit_epoch) {
+        ++w.pending.back().count;
+        w.pending.back().tsc_sum += now;
+    } else
+        w.pending.push_back(worker::pending_ack{w.commit_epoch, 1, now, now});
+    retire_acks(w, durable_epoch());
+}
+
+void TLog::retire_acks(worker& w, epoch_type durable) {
+    while (!w.pending.empty()
+           && signed_epoch_type(w.pending.front().epoch - durable) <= 0) {
+        auto& p = w.pending.front();
+        uint64_t t = durable_tsc_[p.epoch % durable_ring].load(std::memory_order_relaxed);
+        w.latency_sum += p.count * t - p.tsc_sum;
+        w.latency_max = std::max(w.latency_max, t - p.first_tsc);
+        w.nacked += p.count;
+        w.pending.erase(w.pending.begin());
+    }
+}
+
+TLog::buffer* TLog::new_buffer(worker& w) {
+    buffer* b;
+    if (w.free.empty())
+        b = new buffer;
+    else {
+        b = w.free.back();
+        w.free.pop_back();
+    }
+    b->size = 0;
+    return b;
+}
+
+void TLog::append(tid_type tid, uint32_t table, uint32_t cell,
+                  const void* key, uint32_t key_length,
+                  const void* value, uint32_t value_length) {
+    worker& w = workers_[TThread::id()];
+    if (!value)
+        value_length = delete_length;
+    size_t need = record_size(key_length, value_length);
+    always_assert(need <= buffer_size, "log record too large");
+    if (!w.open || w.open->size + need > buffer_size) {
+        if (w.open)
+            w.full.push_back(w.open);
+        w.open = new_buffer(w);
+    }
+    char* p = w.open->data + w.open->size;
+    record_header h{tid, w.commit_epoch, table, key_length, value_length, cell};
+    memcpy(p, &h, sizeof(h));
+    memcpy(p + sizeof(h), key, key_length);
+    if (value)
+        memcpy(p + sizeof(h) + key_length, value, value_length);
+    w.open->size += need;
+    ++w.nrecords;
+    w.nbytes += need;
+}
+
+void TLog::wait_durable(epoch_type e) {
+    while (signed_epoch_type(durable_epoch() - e) < 0)
+        usleep(us_per_flush / 4);
+}
+
+void TLog::reset_stats() {
+    for (auto& w : workers_)
+        w.nrecords = w.nbytes = w.nacked = w.latency_sum = w.latency_max = 0;
+    nsyncs_ = 0;
+}
+
+void TLog::print_stats(std::ostream& w) {
+    uint64_t nrecords = 0, nbytes = 0, nacked = 0, lsum = 0, lmax = 0;
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+        auto& wk = workers_[i];
+        nrecords += wk.nrecords;
+        nbytes += wk.nbytes;
+        nacked += wk.nacked;
+        lsum += wk.latency_sum;
+        lmax = std::max(lmax, wk.latency_max);
+    }
+    char buf[512];
+    snprintf(buf, sizeof(buf),
+             "log: %llu records, %.1f MB, %llu syncs, durable epoch %llu\n"
+             "log: %llu commits acknowledged, latency avg %.3f ms, max %.3f ms\n",
+             (unsigned long long) nrecords, nbytes / 1048576.0,
+             (unsigned long long) nsyncs_.load(), (unsigned long long) durable_epoch(),
+             (unsigned long long) nacked,
+             nacked ? lsum / (double) nacked / PROC_TSC_FREQ / 1e6 : 0.0,
+             lmax / PROC_TSC_FREQ / 1e6);
+    w << buf;
+}
+
+TLog::epoch_type TLog::recover(const std::string& dir,
+                               const std::function<void(const record&)>& apply) {
+    std::vector<std::string> logs;
+    std::vector<size_t> valid;  // length of the complete prefix
+    epoch_type persistent = 0;
+    for (unsigned i = 0; ; ++i) {
+        std::string data;
+        if (!read_file(log_path(dir, i), data))
+            break;
+        epoch_type last = 0;
+        size_t pos = 0;
+        block_header bh;
+        while (pos + sizeof(bh) <= data.size()) {
+            memcpy(&bh, data.data() + pos, sizeof(bh));
+            if ((bh.magic != data_magic && bh.magic != marker_magic)
+                || pos + sizeof(bh) + bh.nbytes > data.size())
+                break;
+            pos += sizeof(bh) + bh.nbytes;
+            if (bh.magic == marker_magic)
+                last = bh.epoch;
+        }
+        persistent = i == 0 ? last : std::min(persistent, last);
+        logs.push_back(std::move(data));
+        valid.push_back(pos);
+    }
+
+    std::vector<std::thread> replayers;
+    for (size_t i = 0; i != logs.size(); ++i)
+        replayers.emplace_back([&, i]() {
+            const char* data = logs[i].data();
+            size_t pos = 0;
+            while (pos < valid[i]) {
+                block_header bh;
+                memcpy(&bh, data + pos, sizeof(bh));
+                pos += sizeof(bh);
+                for (size_t end = pos + bh.nbytes; pos < end; ) {
+                    record r;
+                    r.h = reinterpret_cast<const record_header*>(data + pos);
+                    r.key = data + pos + sizeof(record_header);
+                    r.value = r.h->value_length == delete_length ? nullptr
+                        : r.key + r.h->key_length;
+                    if (signed_epoch_type(r.h->epoch - persistent) <= 0)
+                        apply(r);
+                    pos += record_size(r.h->key_length, r.h->value_length);
+                }
+            }
+        });
+    for (auto& t : replayers)
+        t.join();
+    return persistent;
+}
@@ -0,0 +1,168 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Epoch-based redo logging with group commit, after Silo. While enabled,
+// every transaction with writes takes a log epoch (the global epoch, read
+// once its write locks are held) and its TObjects append redo records --
+// commit TID, table id, cell, key and new value, or a delete -- to a
+// per-thread buffer from install(). Logger threads each own the threads with
+// TThread::id() % nloggers == their index; they collect the buffers, write
+// them to DIR/log.<index>, fdatasync, and then write and sync an epoch
+// marker. Epoch E is durable, and every transaction that committed in an
+// epoch <= E is acknowledged, once every logger has synced a marker for E.
+//
+// Commits never wait for the disk: the owner of a thread learns that its
+// commits are durable from durable_epoch() and last_commit_epoch(), or
+// blocks in wait_durable(). Acknowledgement latency (from commit to the
+// moment its epoch became durable) is accounted per thread and reported by
+// print_stats(); it is about one epoch period plus two syncs, so set a short
+// Transaction::set_epoch_cycle when logging.
+//
+// Recovery reads every log, finds the persistent epoch (the smallest last
+// marker over all logs), and replays the records of epochs up to it. Records
+// for the same key may come from different logs; the one with the largest
+// TID wins. The cell says what a value means to its table: 0 is a whole
+// row, c + 1 is a row of which only cell c is current, and delta_cell is a
+// commutative update to apply, in TID order, to the row.
+class TLog {
+public:
+    typedef uint64_t epoch_type;
+    typedef int64_t signed_epoch_type;
+    typedef uint64_t tid_type;
+    static constexpr uint32_t delete_length = ~uint32_t(0);
+    static constexpr uint32_t delta_cell = ~uint32_t(0);
+
+    struct record_header {
+        tid_type tid;
+        epoch_type epoch;
+        uint32_t table;
+        uint32_t key_length;
+        uint32_t value_length;  // delete_length for deletes
+        uint32_t cell;
+    };
+    struct record {
+        const record_header* h;
+        const char* key;
+        const char* value;      // nullptr for deletes
+
+        tid_type tid() const {
+            return h->tid;
+        }
+        epoch_type epoch() const {
+            return h->epoch;
+        }
+        uint32_t table() const {
+            return h->table;
+        }
+        uint32_t cell() const {
+            return h->cell;
+        }
+        uint32_t key_length() const {
+            return h->key_length;
+        }
+        uint32_t value_length() const {
+            return value ? h->value_length : 0;
+        }
+        bool is_delete() const {
+            return !value;
+        }
+    };
+
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    // Create @dir if needed, truncate its logs, and start @nloggers loggers.
+    static bool start(const std::string& dir, unsigned nloggers);
+    // Flush everything and stop the loggers. Call after the workers have
+    // stopped committing; every committed transaction is then durable.
+    static void stop();
+
+    // Called by Transaction::try_commit around the install phase of a
+    // transaction with writes.
+    static void begin_commit();
+    static void abort_commit();
+    static void end_commit();
+
+    // Append a redo record from TObject::install(). @value is nullptr for a
+    // delete.
+    static void append(tid_type tid, uint32_t table, uint32_t cell,
+                       const void* key, uint32_t key_length,
+                       const void* value, uint32_t value_length);
+
+    static epoch_type durable_epoch() {
+        return durable_epoch_.load(std::memory_order_acquire);
+    }
+    // Epoch of the calling thread's last logged commit
+    static epoch_type last_commit_epoch() {
+        return workers_[TThread::id()].commit_epoch;
+    }
+    static void wait_durable(epoch_type e);
+
+    static void reset_stats();
+    static void print_stats(std::ostream& w);
+
+    // Replay the logs in @dir; returns the persistent epoch. Each log is read
+    // by its own thread, so @apply may be called concurrently.
+    static epoch_type recover(const std::string& dir,
+                              const std::function<void(const record&)>& apply);
+
+private:
+    static constexpr size_t buffer_size = 1 << 20;
+    static constexpr unsigned durable_ring = 1024;
+
+    struct buffer {
+        size_t size;
+        char data[buffer_size];
+    };
+
+    struct __attribute__((aligned(CACHE_LINE_SIZE))) worker {
+        std::mutex mutex;             // held by the thread while it commits
+        buffer* open;
+        std::vector<buffer*> full;
+        std::vector<buffer*> free;
+        epoch_type commit_epoch;
+        // acknowledgements: commits per epoch not yet known to be durable
+        struct pending_ack {
+            epoch_type epoch;
+            uint64_t count;
+            uint64_t first_tsc;
+            uint64_t tsc_sum;
+        };
+        std::vector<pending_ack> pending;
+        uint64_t nrecords;
+        uint64_t nbytes;
+        uint64_t nacked;
+        uint64_t latency_sum;
+        uint64_t latency_max;
+    };
+
+    struct __attribute__((aligned(CACHE_LINE_SIZE))) logger {
+        unsigned index;
+        int fd;
+        std::atomic<epoch_type> durable;
+        std::thread thread;
+    };
+
+    static std::atomic<bool> enabled_;
+    static std::atomic<bool> running_;
+    static std::atomic<epoch_type> durable_epoch_;
+    static std::atomic<uint64_t> durable_tsc_[durable_ring];
+    static worker workers_[MAX_THREADS];
+    static std::vector<logger*> loggers_;
+    static std::atomic<uint64_t> nsyncs_;
+
+    static void run_logger(logger* l);
+    static bool flush(logger* l, epoch_type bound, bool force);
+    static void publish_durable();
+    static void retire_acks(worker& w, epoch_type durable);
+    static buffer* new_buffer(worker& w);
+};
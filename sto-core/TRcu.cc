@@ -1,7 +1,7 @@
 #include "TRcu.hh"
 
 TRcuSet::TRcuSet()
-    : clean_epoch_(0) {
+    : clean_epoch_(0), pending_(0) {
     unsigned capacity = (4080 - sizeof(TRcuGroup)) / sizeof(TRcuGroup::TRcuElement);
     current_ = first_ = TRcuGroup::make(capacity);
     // ngroups_ = 1;
@@ -49,12 +49,13 @@ void TRcuSet::grow() {
     assert(current_->head_ == 0 && current_->tail_ == 0);
 }
 
-inline bool TRcuGroup::clean_until(epoch_type max_epoch) {
+inline bool TRcuGroup::clean_until(epoch_type max_epoch, size_t& ncalled) {
     while (head_ != tail_ && signed_epoch_type(max_epoch - e_[head_].u.epoch) > 0) {
         ++head_;
         while (head_ != tail_ && e_[head_].function) {
             e_[head_].function(e_[head_].u.argument);
             ++head_;
+            ++ncalled;
         }
     }
     if (head_ == tail_) {
@@ -67,17 +68,20 @@ inline bool TRcuGroup::clean_until(epoch_type max_epoch) {
 void TRcuSet::hard_clean_until(epoch_type max_epoch) {
     TRcuGroup* empty_head = nullptr;
     TRcuGroup* empty_tail = nullptr;
+    size_t ncalled = 0;
     // clean [first_, current_]
-    while (first_->clean_until(max_epoch)) {
+    while (first_->clean_until(max_epoch, ncalled)) {
         if (!empty_head)
             empty_head = first_;
         empty_tail = first_;
         if (first_ == current_) {
             first_ = current_ = empty_head;
+            pending_.store(pending_.load(std::memory_order_relaxed) - ncalled, std::memory_order_relaxed);
             return;
         }
         first_ = first_->next_;
     }
+    pending_.store(pending_.load(std::memory_order_relaxed) - ncalled, std::memory_order_relaxed);
     // hook empties after current_; everything after current_ guaranteed empty
     if (empty_head) {
         empty_tail->next_ = current_->next_;
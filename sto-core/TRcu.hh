@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <new>
 #include "compiler.hh"
 #include <assert.h>
@@ -58,7 +59,7 @@ public:
         e_[tail_].u.argument = argument;
         ++tail_;
     }
-    inline bool clean_until(epoch_type max_epoch);
+    inline bool clean_until(epoch_type max_epoch, size_t& ncalled);
 };
 
 class TRcuSet {
@@ -73,6 +74,7 @@ public:
         if (unlikely(current_->tail_ + 2 > current_->capacity_))
             grow();
         current_->add(epoch, function, argument);
+        pending_.store(pending_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
     }
     void clean_until(epoch_type max_epoch) {
         if (clean_epoch_ != max_epoch)
@@ -82,11 +84,17 @@ public:
     epoch_type clean_epoch() const {
         return clean_epoch_;
     }
+    // Number of callbacks not run yet. Only the owning thread changes it;
+    // others may read it.
+    size_t pending() const {
+        return pending_.load(std::memory_order_relaxed);
+    }
 
 private:
     TRcuGroup* current_;
     TRcuGroup* first_;
     epoch_type clean_epoch_;
+    std::atomic<size_t> pending_;
     // unsigned ngroups_;
 
     TRcuSet(const TRcuSet&) = delete;
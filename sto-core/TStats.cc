@@ -0,0 +1,257 @@
+#include "TStats.hh"
+#include "Transaction.hh"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+std::atomic<bool> TStats::enabled_(false);
+TStats::thread_stats TStats::tstats_[MAX_THREADS];
+
+namespace {
+const char* const phase_names[] = {"lock", "check", "install", "cleanup"};
+
+std::mutex export_mutex;
+std::atomic<bool> export_running(false);
+std::thread file_exporter;
+std::thread socket_exporter;
+int socket_fd = -1;
+std::string socket_path;
+
+void write_string(std::ostream& w, const char* s) {
+    w << '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\')
+            w << '\\';
+        if ((unsigned char) *s >= 0x20)
+            w << *s;
+    }
+    w << '"';
+}
+}
+
+void TStats::reset() {
+    for (auto& ts : tstats_) {
+        ts.starts = ts.commits = ts.aborts = ts.commit_aborts = 0;
+        ts.phase_samples = 0;
+        for (auto& c : ts.phase_ticks)
+            c = 0;
+        for (auto& c : ts.tset_hist)
+            c = 0;
+        for (auto& c : ts.reason_counts)
+            c = 0;
+    }
+}
+
+void TStats::account_reason(thread_stats& ts, const char* reason) {
+    // reasons are string literals, so a handful of distinct pointers
+    for (unsigned i = 0; i != max_reasons; ++i) {
+        const char* r = ts.reasons[i].load(std::memory_order_relaxed);
+        if (!r) {
+            ts.reasons[i].store(reason, std::memory_order_release);
+            r = reason;
+        }
+        if (r == reason) {
+            bump(ts.reason_counts[i]);
+            return;
+        }
+    }
+    // table full: count under the last slot
+    bump(ts.reason_counts[max_reasons - 1]);
+}
+
+void TStats::account_stop(bool committed, bool at_commit,
+                          const char* reason, unsigned tset_size) {
+    thread_stats& ts = local();
+    if (committed)
+        bump(ts.commits);
+    else {
+        bump(ts.aborts);
+        if (at_commit)
+            bump(ts.commit_aborts);
+        account_reason(ts, reason ? reason : "unspecified");
+    }
+    unsigned b = 0;
+    while (tset_size > 1 && b != tset_buckets - 1) {
+        tset_size = (tset_size + 1) / 2;
+        ++b;
+    }
+    bump(ts.tset_hist[b]);
+}
+
+void TStats::write_json(std::ostream& w) {
+    uint64_t starts = 0, commits = 0, aborts = 0, commit_aborts = 0, samples = 0;
+    uint64_t ticks[ph_count] = {};
+    uint64_t hist[tset_buckets] = {};
+    std::map<std::string, uint64_t> reasons;
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+        thread_stats& ts = tstats_[i];
+        starts += ts.starts.load(std::memory_order_relaxed);
+        commits += ts.commits.load(std::memory_order_relaxed);
+        aborts += ts.aborts.load(std::memory_order_relaxed);
+        commit_aborts += ts.commit_aborts.load(std::memory_order_relaxed);
+        samples += ts.phase_samples.load(std::memory_order_relaxed);
+        for (unsigned p = 0; p != ph_count; ++p)
+            ticks[p] += ts.phase_ticks[p].load(std::memory_order_relaxed);
+        for (unsigned b = 0; b != tset_buckets; ++b)
+            hist[b] += ts.tset_hist[b].load(std::memory_order_relaxed);
+        for (unsigned r = 0; r != max_reasons; ++r)
+            if (const char* reason = ts.reasons[r].load(std::memory_order_acquire))
+                reasons[reason] += ts.reason_counts[r].load(std::memory_order_relaxed);
+    }
+
+    w << "{\"enabled\": " << (enabled() ? "true" : "false")
+      << ", \"threads\": " << TThread::num_ids()
+      << ", \"starts\": " << starts
+      << ", \"commits\": " << commits
+      << ", \"aborts\": " << aborts
+      << ", \"commit_time_aborts\": " << commit_aborts
+      << ", \"abort_reasons\": {";
+    bool first = true;
+    for (auto& r : reasons) {
+        if (!r.second)
+            continue;
+        w << (first ? "" : ", ");
+        write_string(w, r.first.c_str());
+        w << ": " << r.second;
+        first = false;
+    }
+    w << "}, \"commit_phases\": {\"samples\": " << samples;
+    for (unsigned p = 0; p != ph_count; ++p)
+        w << ", \"" << phase_names[p] << "_ns\": "
+          << (uint64_t) (ticks[p] / PROC_TSC_FREQ);
+    w << "}, \"tset_size_log2_hist\": [";
+    for (unsigned b = 0; b != tset_buckets; ++b)
+        w << (b ? ", " : "") << hist[b];
+    w << "]}";
+}
+
+std::string TStats::json() {
+    std::ostringstream buf;
+    write_json(buf);
+    return buf.str();
+}
+
+bool TStats::start_file_export(const std::string& path, unsigned ms) {
+    std::lock_guard<std::mutex> guard(export_mutex);
+    if (file_exporter.joinable())
+        return false;
+    export_running = true;
+    file_exporter = std::thread([path, ms]() {
+        std::string tmp = path + ".tmp";
+        while (export_running) {
+            {
+                std::ofstream f(tmp, std::ios::trunc);
+                write_json(f);
+                f << '\n';
+            }
+            ::rename(tmp.c_str(), path.c_str());
+            for (unsigned t = 0; t < ms && export_running; t += 10)
+                usleep(10000);
+        }
+    });
+    return true;
+}
+
+bool TStats::start_socket_export(const std::string& path) {
+    std::lock_guard<std::mutex> guard(export_mutex);
+    if (socket_exporter.joinable())
+        return false;
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path))
+        return false;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    ::unlink(path.c_str());
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) != 0
+        || listen(fd, 8) != 0) {
+        close(fd);
+        return false;
+    }
+    socket_fd = fd;
+    socket_path = path;
+    export_running = true;
+    socket_exporter = std::thread([fd]() {
+        while (export_running) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            if (poll(&pfd, 1, 100) <= 0)
+                continue;
+            int c = accept(fd, nullptr, nullptr);
+            if (c < 0)
+                continue;
+            // an optional command, then the snapshot
+            struct pollfd cfd = {c, POLLIN, 0};
+            char cmd[32];
+            ssize_t n = 0;
+            if (poll(&cfd, 1, 50) > 0)
+                n = read(c, cmd, sizeof(cmd) - 1);
+            cmd[n > 0 ? n : 0] = 0;
+            if (strncmp(cmd, "enable", 6) == 0)
+                set_enabled(true);
+            else if (strncmp(cmd, "disable", 7) == 0)
+                set_enabled(false);
+            else if (strncmp(cmd, "reset", 5) == 0)
+                reset();
+            std::string s = json() + "\n";
+            for (size_t off = 0; off < s.size(); ) {
+                ssize_t w = write(c, s.data() + off, s.size() - off);
+                if (w <= 0)
+                    break;
+                off += w;
+            }
+            close(c);
+        }
+    });
+    return true;
+}
+
+void TStats::stop_export() {
+    std::lock_guard<std::mutex> guard(export_mutex);
+    export_running = false;
+    if (file_exporter.joinable())
+        file_exporter.join();
+    if (socket_exporter.joinable()) {
+        socket_exporter.join();
+        close(socket_fd);
+        ::unlink(socket_path.c_str());
+        socket_fd = -1;
+    }
+}
+
+namespace {
+struct env_configure {
+    env_configure() {
+        if (const char* s = getenv("STO_STATS"))
+            TStats::set_enabled(atoi(s) != 0);
+        if (const char* s = getenv("STO_STATS_FILE")) {
+            std::string path(s);
+            unsigned ms = 1000;
+            size_t colon = path.rfind(':');
+            if (colon != std::string::npos) {
+                ms = atoi(path.c_str() + colon + 1);
+                path.resize(colon);
+            }
+            if (!TStats::start_file_export(path, ms ? ms : 1000))
+                fprintf(stderr, "STO_STATS_FILE: cannot export to %s\n", path.c_str());
+        }
+        if (const char* s = getenv("STO_STATS_SOCKET"))
+            if (!TStats::start_socket_export(s))
+                fprintf(stderr, "STO_STATS_SOCKET: cannot listen on %s\n", s);
+    }
+    ~env_configure() {
+        TStats::stop_export();
+    }
+} env_configure_instance;
+}
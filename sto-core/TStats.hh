@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <string>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Runtime transaction statistics. Unlike the STO_PROFILE_COUNTERS counters
+// these are always compiled in and cost one predictable branch per
+// transaction while disabled, so a running process can be diagnosed without
+// a rebuild. Each thread updates a private, cache-line aligned block; readers
+// merge the blocks without stopping the writers, so a snapshot is only
+// approximately consistent.
+//
+// Enable with TStats::set_enabled(true) or by starting the process with
+// STO_STATS=1. Snapshots are JSON (TStats::write_json) and can be exported
+// periodically to a file (STO_STATS_FILE=path[:ms]) or served on a Unix
+// socket (STO_STATS_SOCKET=path). A socket client receives a snapshot; it may
+// first send one of "enable", "disable" or "reset".
+class TStats {
+public:
+    // commit phases timed by try_commit()
+    enum phase_type {
+        ph_lock = 0, ph_check, ph_install, ph_cleanup, ph_count
+    };
+    // bucket b counts transactions whose tset size is in (2^(b-1), 2^b]
+    static constexpr unsigned tset_buckets = 16;
+    static constexpr unsigned max_reasons = 32;
+
+    static bool enabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    static void set_enabled(bool on) {
+        enabled_.store(on, std::memory_order_relaxed);
+    }
+    static void reset();
+
+    static void account_start() {
+        bump(local().starts);
+    }
+    static void account_stop(bool committed, bool at_commit,
+                             const char* reason, unsigned tset_size);
+    static void account_phase(phase_type ph, uint64_t ticks) {
+        bump(local().phase_ticks[ph], ticks);
+        if (ph == ph_lock)
+            bump(local().phase_samples);
+    }
+
+    // Times consecutive phases of one commit; a no-op while disabled.
+    class phase_timer {
+    public:
+        phase_timer()
+            : t_(enabled() ? read_tsc() : 0) {
+        }
+        void mark(phase_type ph) {
+            if (t_) {
+                uint64_t now = read_tsc();
+                account_phase(ph, now - t_);
+                t_ = now;
+            }
+        }
+    private:
+        uint64_t t_;
+    };
+
+    static void write_json(std::ostream& w);
+    static std::string json();
+
+    // Rewrite @path with a snapshot every @ms milliseconds.
+    static bool start_file_export(const std::string& path, unsigned ms);
+    // Serve snapshots on the Unix socket @path.
+    static bool start_socket_export(const std::string& path);
+    static void stop_export();
+
+private:
+    typedef std::atomic<uint64_t> counter_type;
+
+    struct __attribute__((aligned(CACHE_LINE_SIZE))) thread_stats {
+        counter_type starts;
+        counter_type commits;
+        counter_type aborts;
+        counter_type commit_aborts;
+        counter_type phase_samples;
+        counter_type phase_ticks[ph_count];
+        counter_type tset_hist[tset_buckets];
+        std::atomic<const char*> reasons[max_reasons];
+        counter_type reason_counts[max_reasons];
+    };
+
+    static std::atomic<bool> enabled_;
+    static thread_stats tstats_[MAX_THREADS];
+
+    static thread_stats& local() {
+        return tstats_[TThread::id()];
+    }
+    // only the owning thread writes its counters
+    static void bump(counter_type& c, uint64_t n = 1) {
+        c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+    static void account_reason(thread_stats& ts, const char* reason);
+};
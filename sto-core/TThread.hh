@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cassert>
 #include <random>
 #include <ContentionManager.hh>
@@ -31,6 +32,7 @@ class TThread {
     static __thread int the_id;
     static __thread bool always_allocate_;
     static __thread int hashsize_;
+    static std::atomic<int> num_ids_;
 public:
     static __thread Transaction* txn;
     static PercentGen gen[];
@@ -39,8 +41,16 @@ public:
         return the_id;
     }
     static void set_id(int id) {
-        assert(id >= 0 && id < 128);
+        assert(id >= 0 && id < MAX_THREADS);
         the_id = id;
+        int n = num_ids_.load(std::memory_order_relaxed);
+        while (n <= id && !num_ids_.compare_exchange_weak(n, id + 1))
+            relax_fence();
+    }
+    // One past the largest thread id ever passed to set_id(). Per-thread
+    // state above this bound is untouched, so global scans can stop here.
+    static int num_ids() {
+        return num_ids_.load(std::memory_order_acquire);
     }
     static bool always_allocate() {
         return always_allocate_;
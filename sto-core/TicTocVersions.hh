@@ -93,11 +93,13 @@ public:
     // TTid bits: compatibility bits as defined in TransactionTid
 
     // |-----WTS value-----|-delta-|--TTid bits--|
-    //        44 bits       8 bits    12 bits
+    //      64-13-W bits    8 bits   W+5 bits
+    // (44 / 8 / 12 bits with the historical W = 7)
 
-    static constexpr type delta_shift = type(12);
-    static constexpr type wts_shift = type(20);
+    static constexpr type delta_shift = TransactionTid::mask_width + 5;
+    static constexpr type wts_shift = delta_shift + 8;
     static constexpr type delta_mask = type(0xff) << delta_shift;
+    static_assert(64 - wts_shift >= 32, "MAX_THREADS too large for compressed TicToc timestamps");
 
     static type wts_value(type t) {
         return t >> wts_shift;
@@ -134,7 +136,7 @@ public:
                     type shift = delta - (delta & 0xff);
                     vv += (shift << wts_shift);
                     vv &= ~delta_mask;
-                    vv |= (delta & 0xff << delta_shift);
+                    vv |= (delta & 0xff) << delta_shift;
                     if (bool_cmpxchg(&t, v, vv))
                         return true;
                 } else {
@@ -321,10 +323,10 @@ public:
     static inline type& cp_access_tid_impl(Transaction& txn);
     inline type cp_commit_tid_impl(Transaction& txn);
 
-    void cp_set_version_unlock(type new_ts) {
+    void cp_set_version_unlock_impl(type new_ts) {
         TicTocCompressedTid::set_timestamps_unlock(v_, new_ts, 0);
     }
-    void cp_set_version(type new_ts) {
+    void cp_set_version_impl(type new_ts) {
         TicTocCompressedTid::set_timestamps(v_, new_ts, 0);
     }
 
@@ -0,0 +1,91 @@
+#include "TransArena.hh"
+#include "Transaction.hh"
+#include <cstring>
+#include <sys/mman.h>
+
+TransArena TransArena::thread_arenas[MAX_THREADS];
+
+TransArena::~TransArena() {
+    if (!private_)
+        return;
+    for (auto& r : regions_)
+        unmap(r);
+    for (auto& b : buffers_)
+        if (b.p)
+            unmap(b);
+}
+
+TransArena* TransArena::acquire(int threadid) {
+    if (threadid >= 0 && threadid < MAX_THREADS
+        && !thread_arenas[threadid].busy_.exchange(true))
+        return &thread_arenas[threadid];
+    return new TransArena(true);
+}
+
+void TransArena::release(TransArena* arena) {
+    if (arena->private_)
+        delete arena;
+    else
+        arena->busy_.store(false);
+}
+
+// @bytes rounded up to whole regions, aligned so that the kernel can back
+// them with huge pages
+void* TransArena::map(size_t bytes) {
+    void* p;
+#if HAVE_MAP_HUGETLB
+    p = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED)
+        return p;
+#endif
+    size_t len = bytes + region_size;
+    p = ::mmap(nullptr, len, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    always_assert(p != MAP_FAILED, "TransArena out of memory");
+    char* base = static_cast<char*>(p);
+    char* aligned = reinterpret_cast<char*>
+        ((reinterpret_cast<uintptr_t>(base) + region_size - 1) & ~uintptr_t(region_size - 1));
+    if (aligned != base)
+        ::munmap(base, aligned - base);
+    if (aligned + bytes != base + len)
+        ::munmap(aligned + bytes, base + len - (aligned + bytes));
+#if HAVE_MADV_HUGEPAGE
+    ::madvise(aligned, bytes, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+void TransArena::unmap(const mapping& m) {
+    ::munmap(m.p, m.bytes);
+}
+
+void* TransArena::chunk(unsigned i, size_t chunk_bytes) {
+    if (i < chunks_.size() && chunks_[i])
+        return chunks_[i];
+    chunk_bytes = (chunk_bytes + CACHE_LINE_SIZE - 1) & ~size_t(CACHE_LINE_SIZE - 1);
+    if (size_t(region_end_ - region_next_) < chunk_bytes) {
+        size_t bytes = (chunk_bytes + region_size - 1) & ~(region_size - 1);
+        region_next_ = static_cast<char*>(map(bytes));
+        region_end_ = region_next_ + bytes;
+        regions_.push_back({region_next_, bytes});
+    }
+    if (chunks_.size() <= i)
+        chunks_.resize(i + 1, nullptr);
+    chunks_[i] = region_next_;
+    region_next_ += chunk_bytes;
+    return chunks_[i];
+}
+
+unsigned* TransArena::buffer(int which, size_t n, bool zero) {
+    mapping& b = buffers_[which];
+    size_t bytes = n * sizeof(unsigned);
+    if (b.bytes < bytes) {
+        if (b.p)
+            unmap(b);
+        b.bytes = (bytes + region_size - 1) & ~(region_size - 1);
+        b.p = map(b.bytes);
+    } else if (zero)
+        memset(b.p, 0, bytes);
+    return static_cast<unsigned*>(b.p);
+}
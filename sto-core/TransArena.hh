@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include "compiler.hh"
+#include "TThread.hh"
+
+// Memory for large transactions: tset chunks beyond the ones built into
+// Transaction, the commit-time write-set index, and the hashtable of a tset
+// too large for Transaction::hashtable_. Memory comes from 2MB regions,
+// huge-page-backed where the system allows, and stays with the arena, so
+// each thread's arena is reused by all of its transactions. A Transaction
+// checks out its thread's arena the first time it needs one; if another
+// Transaction of the same thread id holds it, it gets a private arena.
+class TransArena {
+public:
+    static constexpr size_t region_size = 2 << 20;
+
+    explicit TransArena(bool is_private = false)
+        : private_(is_private), busy_(false),
+          region_next_(nullptr), region_end_(nullptr) {
+    }
+    ~TransArena();
+
+    static TransArena* acquire(int threadid);
+    static void release(TransArena* arena);
+
+    // Chunk @i of @chunk_bytes bytes, the same memory every time
+    void* chunk(unsigned i, size_t chunk_bytes);
+    // Scratch space for @n unsigneds; zeroed if @zero. Each call may reuse
+    // (and so invalidate) the previous result for the same @which.
+    enum { writeset_buffer = 0, hash_buffer, nbuffers };
+    unsigned* buffer(int which, size_t n, bool zero);
+
+private:
+    struct mapping {
+        void* p;
+        size_t bytes;
+    };
+
+    bool private_;
+    std::atomic<bool> busy_;
+    std::vector<void*> chunks_;
+    std::vector<mapping> regions_;
+    char* region_next_;
+    char* region_end_;
+    mapping buffers_[nbuffers] = {};
+
+    static TransArena thread_arenas[MAX_THREADS];
+
+    static void* map(size_t bytes);
+    static void unmap(const mapping& m);
+};
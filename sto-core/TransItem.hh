@@ -42,12 +42,14 @@ class TransItem {
     static constexpr flags_type cl_bit = flags_type(1) << 58;
     static constexpr flags_type commute_bit = flags_type(1) << 57;
     static constexpr flags_type mvhistory_bit = flags_type(1) << 56;
+    // the read is of a TVersion, which changes only by taking a commit TID
+    static constexpr flags_type opaque_read_bit = flags_type(1) << 55;
     static constexpr flags_type pointer_mask = (flags_type(1) << 48) - 1;
     static constexpr flags_type owner_mask = pointer_mask;
     static constexpr flags_type user0_bit = flags_type(1) << 48;
     static constexpr int userf_shift = 48;
     static constexpr flags_type shifted_userf_mask = 0x7FF;
-    static constexpr flags_type special_mask = owner_mask | cl_bit | read_bit | write_bit | lock_bit | predicate_bit | stash_bit | commute_bit | mvhistory_bit;
+    static constexpr flags_type special_mask = owner_mask | cl_bit | read_bit | write_bit | lock_bit | predicate_bit | stash_bit | commute_bit | mvhistory_bit | opaque_read_bit;
 
 
     TransItem() : s_(), key_(), rdata_(), wdata_(), mode_(CCMode::none) {};
@@ -77,6 +79,9 @@ class TransItem {
     bool has_mvhistory() const {
         return flags() & mvhistory_bit;
     }
+    bool has_opaque_read() const {
+        return flags() & opaque_read_bit;
+    }
     bool needs_unlock() const {
         return flags() & lock_bit;
     }
@@ -346,7 +351,7 @@ class TransProxy {
     inline bool add_read_opaque(T rdata);
 
     inline TransProxy& clear_read() {
-        item().__rm_flags(TransItem::read_bit);
+        item().__rm_flags(TransItem::read_bit | TransItem::opaque_read_bit);
         return *this;
     }
     template <typename T>
@@ -490,7 +495,7 @@ class TransProxy {
     }
 
     TransProxy& remove_read() { // XXX should also cleanup_read
-        item().__rm_flags(TransItem::read_bit);
+        item().__rm_flags(TransItem::read_bit | TransItem::opaque_read_bit);
         return *this;
     }
     TransProxy& remove_write() { // XXX should also cleanup_write
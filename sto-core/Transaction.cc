@@ -11,6 +11,7 @@
 Transaction::testing_type Transaction::testing;
 threadinfo_t Transaction::tinfo[MAX_THREADS];
 __thread int TThread::the_id;
+std::atomic<int> TThread::num_ids_(1);
 PercentGen TThread::gen[MAX_THREADS];
 
 Transaction::epoch_state __attribute__((aligned(128))) Transaction::global_epochs = {
@@ -21,7 +22,19 @@ std::function<void(threadinfo_t::epoch_type)> Transaction::epoch_advance_callbac
 TransactionTid::type __attribute__((aligned(128))) Transaction::_TID = 3 * TransactionTid::increment_value;
 std::atomic<TransactionTid::type> __attribute__((aligned(128))) Transaction::_RTID(Transaction::_TID - TransactionTid::increment_value);
    // reserve TransactionTid::increment_value for prepopulated
+// running transactions holding a snapshot_tid() (hybrid read-only readers)
+std::atomic<unsigned> __attribute__((aligned(128))) Transaction::_snapshot_readers(0);
+std::atomic<uint64_t> __attribute__((aligned(128))) Transaction::_RTID_stamp(0);
 unsigned Transaction::us_per_epoch = 100000;  // Defaults to 100ms
+unsigned Transaction::us_per_epoch_min = 1000;
+std::atomic<unsigned> Transaction::us_epoch_period_(100000);
+size_t Transaction::rcu_backlog_limit = 1 << 16;
+bool Transaction::cooperative_epochs_ = false;
+std::atomic<bool> __attribute__((aligned(128))) Transaction::epoch_advancing_(false);
+std::atomic<uint64_t> Transaction::epoch_advance_tsc_(0);
+uint64_t Transaction::rtid_refresh_cycles = 0;
+unsigned Transaction::us_per_rtid_publish = 10;
+bool Transaction::rtid_publisher_running = false;
 
 static void __attribute__((used)) check_static_assertions() {
     static_assert(sizeof(threadinfo_t) % 128 == 0, "threadinfo is 2-cache-line aligned");
@@ -32,35 +45,100 @@ void Transaction::initialize() {
     hash_base_ = 32768;
     tset_size_ = 0;
     lrng_state_ = 12897;
+    abort_reason_ = nullptr;
+    abort_item_ = nullptr;
+    abort_pc_ = nullptr;
 #if SAFE_FLATTEN
     write_tid_inf_ = 0;
 #endif
+    snapshot_tid_inf_ = 0;
 #if CICADA_HASHTABLE == 0 && defined(TRANSACTION_HASHTABLE)
     bzero(hashtable_, sizeof(hashtable_));
 #endif
+    snapshot_tid_ = 0;
     commit_tid_ = 0;
     prev_commit_tid_ = 0;
+    tset_ = tset_inline_;
+    tset_nchunks_ = tset_inline_chunks;
     for (unsigned i = 0; i != tset_initial_capacity / tset_chunk; ++i)
         tset_[i] = &tset0_[i * tset_chunk];
-    for (unsigned i = tset_initial_capacity / tset_chunk; i != arraysize(tset_); ++i)
+    for (unsigned i = tset_initial_capacity / tset_chunk; i != tset_nchunks_; ++i)
         tset_[i] = nullptr;
+    arena_ = nullptr;
+    big_hash_ = nullptr;
+    big_hash_mask_ = big_hash_count_ = 0;
 }
 
 Transaction::~Transaction() {
     if (in_progress())
         silent_abort();
-    TransItem* live = tset0_;
-    for (unsigned i = 0; i != arraysize(tset_); ++i, live += tset_chunk)
-        if (live != tset_[i])
-            delete[] tset_[i];
+    // the chunks belong to the arena
+    if (arena_)
+        TransArena::release(arena_);
+    if (tset_ != tset_inline_)
+        delete[] tset_;
 }
 
 void Transaction::refresh_tset_chunk() {
     assert(tset_size_ % tset_chunk == 0);
-    assert(tset_size_ < tset_max_capacity);
-    if (!tset_[tset_size_ / tset_chunk])
-        tset_[tset_size_ / tset_chunk] = new TransItem[tset_chunk];
-    tset_next_ = tset_[tset_size_ / tset_chunk];
+    unsigned c = tset_size_ / tset_chunk;
+    // stop() reads the table entry just past the last chunk in use
+    if (c + 1 >= tset_nchunks_) {
+        TransItem** t = new TransItem*[2 * tset_nchunks_];
+        std::copy(tset_, tset_ + tset_nchunks_, t);
+        std::fill(t + tset_nchunks_, t + 2 * tset_nchunks_, nullptr);
+        if (tset_ != tset_inline_)
+            delete[] tset_;
+        tset_ = t;
+        tset_nchunks_ *= 2;
+    }
+    if (!tset_[c])
+        tset_[c] = static_cast<TransItem*>(arena()->chunk(c, tset_chunk * sizeof(TransItem)));
+    tset_next_ = tset_[c];
+}
+
+// Hashtable for tsets larger than tset_hash_limit: open addressing over
+// every item, keeping the first of duplicate items, as find_item_scan does
+static inline unsigned big_hash_index(const TObject* obj, void* key, unsigned mask) {
+    uint64_t n = reinterpret_cast<uintptr_t>(key) ^ (reinterpret_cast<uintptr_t>(obj) << 16);
+    return unsigned((n * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+void Transaction::big_hash_rebuild(unsigned capacity) {
+    big_hash_ = arena()->buffer(TransArena::hash_buffer, capacity, true);
+    big_hash_mask_ = capacity - 1;
+    big_hash_count_ = 0;
+    const TransItem* it = nullptr;
+    for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
+        it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+        big_hash_insert(it->owner(), it->key_, tidx);
+    }
+}
+
+void Transaction::big_hash_insert(const TObject* obj, void* xkey, unsigned tidx) {
+    if (2 * (big_hash_count_ + 1) > big_hash_mask_ + 1) {
+        // the rebuild inserts every item up to tset_size_, this one included
+        big_hash_rebuild(2 * (big_hash_mask_ + 1));
+        return;
+    }
+    unsigned hi = big_hash_index(obj, xkey, big_hash_mask_);
+    for (unsigned e; (e = big_hash_[hi]); hi = (hi + 1) & big_hash_mask_) {
+        const TransItem& ti = tset_[(e - 1) / tset_chunk][(e - 1) % tset_chunk];
+        if (ti.owner() == obj && ti.key_ == xkey)
+            return;
+    }
+    big_hash_[hi] = tidx + 1;
+    ++big_hash_count_;
+}
+
+TransItem* Transaction::big_hash_find(const TObject* obj, void* xkey) const {
+    unsigned hi = big_hash_index(obj, xkey, big_hash_mask_);
+    for (unsigned e; (e = big_hash_[hi]); hi = (hi + 1) & big_hash_mask_) {
+        TransItem& ti = tset_[(e - 1) / tset_chunk][(e - 1) % tset_chunk];
+        if (ti.owner() == obj && ti.key_ == xkey)
+            return &ti;
+    }
+    return nullptr;
 }
 
 void* Transaction::epoch_advancer(void*) {
@@ -71,37 +149,90 @@ void* Transaction::epoch_advancer(void*) {
     // don't bother epoch'ing til things have picked up
     usleep(us_per_epoch);
     while (global_epochs.run) {
-        epoch_type ge = global_epochs.global_epoch.load();
-        epoch_type re = global_epochs.global_epoch.load();
-        epoch_type ae = global_epochs.read_epoch.load();
-        for (auto& t : tinfo) {
-            auto twepoch = t.write_snapshot_epoch.load();
-            auto trepoch = t.epoch.load();
-            if (twepoch != 0 && signed_epoch_type(twepoch - re) < 0) {
-                re = twepoch;
-            }
-            if (trepoch != 0 && signed_epoch_type(trepoch - ae) < 0) {
-                ae = trepoch;
-            }
+        epoch_advance_step(true);
+        usleep(us_epoch_period_);
+    }
+
+    fetch_and_add(&num_epoch_advancers, -1);
+    return NULL;
+}
+
+// Advances the global epoch if the current period has elapsed (or @force),
+// and adapts the period to the RCU backlog. At most one thread advances at
+// a time; returns false if another thread was advancing or it wasn't due.
+bool Transaction::epoch_advance_step(bool force) {
+    uint64_t now = read_tsc();
+    if (!force
+        && now - epoch_advance_tsc_.load(std::memory_order_relaxed)
+           < uint64_t(us_epoch_period_.load(std::memory_order_relaxed) * PROC_TSC_FREQ * 1000))
+        return false;
+    if (epoch_advancing_.load(std::memory_order_relaxed)
+        || epoch_advancing_.exchange(true))
+        return false;
+
+    epoch_type ge = global_epochs.global_epoch.load();
+    epoch_type re = global_epochs.global_epoch.load();
+    epoch_type ae = global_epochs.read_epoch.load();
+    size_t backlog = 0;
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+        auto& t = tinfo[i];
+        auto twepoch = t.write_snapshot_epoch.load();
+        auto trepoch = t.epoch.load();
+        if (twepoch != 0 && signed_epoch_type(twepoch - re) < 0) {
+            re = twepoch;
         }
-        global_epochs.global_epoch = std::max(ge + 1, epoch_type(1));
-        global_epochs.read_epoch = re;
-        global_epochs.active_epoch = ae;
-        global_epochs.recent_tid = _TID;
+        if (trepoch != 0 && signed_epoch_type(trepoch - ae) < 0) {
+            ae = trepoch;
+        }
+        backlog += t.rcu_set.pending();
+    }
+    global_epochs.global_epoch = std::max(ge + 1, epoch_type(1));
+    global_epochs.read_epoch = re;
+    global_epochs.active_epoch = ae;
+    global_epochs.recent_tid = _TID;
+
+    if (epoch_advance_callback)
+        epoch_advance_callback(global_epochs.global_epoch);
+
+    unsigned period = us_epoch_period_.load(std::memory_order_relaxed);
+    if (backlog > rcu_backlog_limit)
+        period = std::max(period / 2, us_per_epoch_min);
+    else if (backlog <= rcu_backlog_limit / 4)
+        period = std::min(std::max(period * 2, 1U), us_per_epoch);
+    us_epoch_period_.store(period, std::memory_order_relaxed);
+
+    epoch_advance_tsc_.store(read_tsc(), std::memory_order_relaxed);
+    epoch_advancing_.store(false, std::memory_order_release);
+    return true;
+}
 
-        if (epoch_advance_callback)
-            epoch_advance_callback(global_epochs.global_epoch);
+// Keeps _RTID fresh in the background so that transactions never have to
+// scan tinfo themselves in read_tid()
+void* Transaction::rtid_publisher(void*) {
+    static int num_rtid_publishers = 0;
+    if (fetch_and_add(&num_rtid_publishers, 1) != 0)
+        std::cerr << "WARNING: more than one rtid_publisher thread\n";
 
-        usleep(us_per_epoch);
+    epoch_advance_once();
+    fence();
+    rtid_publisher_running = true;
+    while (global_epochs.run) {
+        if (us_per_rtid_publish)
+            usleep(us_per_rtid_publish);
+        else
+            relax_fence();
+        epoch_advance_once();
     }
+    rtid_publisher_running = false;
 
-    fetch_and_add(&num_epoch_advancers, -1);
+    fetch_and_add(&num_rtid_publishers, -1);
     return NULL;
 }
 
 void Transaction::epoch_advance_once() {
     tid_type min_wtid = _TID;
-    for (auto& t : tinfo) {
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+        auto& t = tinfo[i];
         fence();
         tid_type wtid = t.wtid;
         if (wtid != 0 && wtid < min_wtid)
@@ -121,7 +252,8 @@ Transaction::tid_type Transaction::compute_rtid_inf() {
     tid_type rtid_inf = _RTID;
 
     // Find an infimum for the rtid
-    for (auto &ti : tinfo) {
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+        auto& ti = tinfo[i];
         if (!rtid_inf) {
             rtid_inf = ti.rtid.load();
         } else if (ti.rtid) {
@@ -132,16 +264,41 @@ Transaction::tid_type Transaction::compute_rtid_inf() {
     return rtid_inf;
 }
 
-bool Transaction::preceding_duplicate_read(TransItem* needle) const {
-    const TransItem* it = nullptr;
-    for (unsigned tidx = 0; ; ++tidx) {
-        it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
-        if (it == needle)
-            return false;
-        if (it->owner() == needle->owner() && it->key_ == needle->key_
-            && it->has_read())
-            return true;
+Transaction::tid_type Transaction::compute_snapshot_tid_inf() {
+    tid_type inf = _TID;
+    for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+        auto& ti = tinfo[i];
+        tid_type rtid = ti.rtid.load();
+        if (rtid && rtid < inf)
+            inf = rtid;
     }
+    return inf;
+}
+
+bool Transaction::preceding_duplicate_read(TransItem* needle, unsigned tidx) const {
+    auto before = [](const indexed_read& a, const indexed_read& b) {
+        if (a.owner != b.owner)
+            return a.owner < b.owner;
+        if (a.key != b.key)
+            return a.key < b.key;
+        return a.tidx < b.tidx;
+    };
+    if (!read_index_valid_) {
+        read_index_.clear();
+        const TransItem* it = nullptr;
+        for (unsigned i = 0; i != tset_size_; ++i) {
+            it = (i % tset_chunk ? it + 1 : tset_[i / tset_chunk]);
+            if (it->has_read())
+                read_index_.push_back({it->owner(), it->key_, i});
+        }
+        std::sort(read_index_.begin(), read_index_.end(), before);
+        read_index_valid_ = true;
+    }
+    // the first read of (owner, key)
+    indexed_read probe{needle->owner(), needle->key_, 0};
+    auto first = std::lower_bound(read_index_.begin(), read_index_.end(), probe, before);
+    return first != read_index_.end() && first->owner == probe.owner
+        && first->key == probe.key && first->tidx < tidx;
 }
 
 bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
@@ -175,15 +332,28 @@ bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
         TXP_INCREMENT(txp_hco_invalid);
 
     state_ = s_opacity_check;
-    start_tid_ = _TID;
+    // If no commit has taken a TID since the last validation, the TVersion
+    // reads it covered are still current: every commit that could change
+    // them would have a TID above start_tid_. Check only the items added
+    // since, plus predicates and all other reads; nonopaque, lock, Swiss
+    // and TicToc versions, and node versions, change without taking a TID.
+    tid_type now = _TID;
+    unsigned skip = start_tid_ == now ? opacity_checked_ : 0;
+    if (skip)
+        TXP_INCREMENT(txp_hco_incremental);
+    start_tid_ = now;
+    read_index_valid_ = false;
     release_fence();
     TransItem* it = nullptr;
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
         it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
+        if (tidx < skip && it->has_opaque_read() && !it->has_predicate()
+            && !(it->read_value<TransactionTid::type>() & TransactionTid::nonopaque_bit))
+            continue;
         if (it->has_read()) {
             TXP_INCREMENT(txp_total_check_read);
             if (!it->owner()->check(*it, *this)
-                && (!may_duplicate_items_ || !preceding_duplicate_read(it))) {
+                && (!may_duplicate_items_ || !preceding_duplicate_read(it, tidx))) {
                 mark_abort_because(item, "opacity check");
                 goto abort;
             }
@@ -195,6 +365,7 @@ bool Transaction::hard_check_opacity(TransItem* item, TransactionTid::type t) {
             }
         }
     }
+    opacity_checked_ = tset_size_;
     state_ = s_in_progress;
     return true;
 }
@@ -209,8 +380,12 @@ void Transaction::stop(bool committed, unsigned* writeset, unsigned nwriteset) {
 #if STO_TSC_PROFILE
     TimeKeeper<tc_cleanup> tk;
 #endif
+    if (TStats::enabled())
+        TStats::account_stop(committed, state_ >= s_committing, abort_reason_, tset_size_);
     if (!committed) {
         TXP_INCREMENT(txp_total_aborts);
+        if (TAbortProfile::enabled())
+            TAbortProfile::account(abort_reason_, abort_item_, abort_pc_);
 #if STO_DEBUG_ABORTS
         if (local_random() <= uint32_t(0xFFFFFFFF * STO_DEBUG_ABORTS_FRACTION)) {
             std::ostringstream buf;
@@ -293,6 +468,10 @@ unlock_all:
     if (thr.trans_end_callback)
         thr.trans_end_callback();
     thr.rtid = thr.wtid = 0;
+    if (snapshot_tid_) {
+        _snapshot_readers.fetch_sub(1);
+        snapshot_tid_ = 0;
+    }
     // XXX should reset trans_end_callback after calling it...
     state_ = s_aborted + committed;
     restarted = true;
@@ -306,6 +485,12 @@ unlock_all:
     // clear/consolidate transactional scratch space
     scratch_.clear();
 
+    // announce a quiescent state
+    if (cooperative_epochs_) {
+        thr.write_snapshot_epoch = 0;
+        thr.epoch = 0;
+    }
+
 #if STO_TSC_PROFILE
     auto endtime = read_tsc();
     if (!committed)
@@ -346,10 +531,14 @@ bool Transaction::try_commit() {
 #endif
 
     state_ = s_committing;
+    TStats::phase_timer phases;
 
-    unsigned writeset[tset_size_];
+    unsigned writeset_stack[writeset_stack_capacity];
+    unsigned* writeset = tset_size_ <= writeset_stack_capacity ? writeset_stack
+        : arena()->buffer(TransArena::writeset_buffer, tset_size_, false);
     unsigned nwriteset = 0;
     writeset[0] = tset_size_;
+    bool logging = false;
 
     TransItem* it = nullptr;
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
@@ -420,20 +609,30 @@ bool Transaction::try_commit() {
     commit_tid();
     fence();
 #endif
+    phases.mark(TStats::ph_lock);
+
+    // take the log epoch while the write locks are held
+    if (nwriteset && TLog::enabled()) {
+        logging = true;
+        TLog::begin_commit();
+    }
 
     //phase2
+    read_index_valid_ = false;
     for (unsigned tidx = 0; tidx != tset_size_; ++tidx) {
         it = (tidx % tset_chunk ? it + 1 : tset_[tidx / tset_chunk]);
         if (it->has_read() && (it->locked_at_commit() || !it->needs_unlock())) {
             TXP_INCREMENT(txp_total_check_read);
             if (!it->owner()->check(*it, *this)
-                && (!may_duplicate_items_ || !preceding_duplicate_read(it))) {
+                && (!may_duplicate_items_ || !preceding_duplicate_read(it, tidx))) {
                 mark_abort_because(it, "commit check");
                 goto abort;
             }
         }
     }
 
+    phases.mark(TStats::ph_check);
+
     // fence();
 
     //phase3
@@ -459,8 +658,13 @@ bool Transaction::try_commit() {
     }
 #endif
 
+    if (logging)
+        TLog::end_commit();
+    phases.mark(TStats::ph_install);
+
     // fence();
     stop(true, writeset, nwriteset);
+    phases.mark(TStats::ph_cleanup);
 
     //COZ_PROGRESS;
     return true;
@@ -469,6 +673,8 @@ abort:
     //outfile.close();
     // fence();
     TXP_INCREMENT(txp_commit_time_aborts);
+    if (logging)
+        TLog::abort_commit();
     // scan the whole read set for locks if aborting
     // XXX this can be optimized later
     stop(false, nullptr, 0);
@@ -516,8 +722,9 @@ void Transaction::print_stats() {
                 100.0 * (double) out.p(txp_commit_time_nonopaque) / txc_commit_attempts);
     }
     if (txp_count >= txp_hco_abort)
-        fprintf(stderr, "$ %llu HCO (%llu lock, %llu invalid, %llu aborts) out of %llu check attempts (%.3f%%)\n",
-                out.p(txp_hco), out.p(txp_hco_lock), out.p(txp_hco_invalid), out.p(txp_hco_abort), out.p(txp_tco),
+        fprintf(stderr, "$ %llu HCO (%llu lock, %llu invalid, %llu incremental, %llu aborts) out of %llu check attempts (%.3f%%)\n",
+                out.p(txp_hco), out.p(txp_hco_lock), out.p(txp_hco_invalid), out.p(txp_hco_incremental),
+                out.p(txp_hco_abort), out.p(txp_tco),
                 100.0 * (double) out.p(txp_hco) / out.p(txp_tco));
     if (txp_count >= txp_hash_collision)
         fprintf(stderr, "$ %llu (%.3f%%) hash collisions, %llu second level\n", out.p(txp_hash_collision),
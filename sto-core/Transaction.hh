@@ -7,6 +7,10 @@
 #include "ContentionManager.hh"
 #include "TransScratch.hh"
 #include "VersionBase.hh"
+#include "TStats.hh"
+#include "TAbortProfile.hh"
+#include "TLog.hh"
+#include "TransArena.hh"
 #include <algorithm>
 #include <functional>
 #include <memory>
@@ -16,6 +20,7 @@
 #include <sstream>
 #include <fstream>
 #include <atomic>
+#include <vector>
 
 //#include <coz.h>
 
@@ -132,6 +137,20 @@
             __txn_guard.start();                  \
             Sto::mvcc_rw_upgrade();
 
+// Declared read-only transaction: objects supporting snapshot reads
+// (MVCC objects, hybrid OCC/MVCC bench indexes) serve it from a consistent
+// snapshot without adding items to the tset, so it never aborts; it must
+// not perform any writes
+#define ROTRANSACTION                             \
+    do {                                          \
+        __label__ abort_in_progress;              \
+        __label__ try_commit;                     \
+        __label__ after_commit;                   \
+        TransactionLoopGuard __txn_guard;         \
+        while (1) {                               \
+            __txn_guard.start();                  \
+            Sto::declare_read_only();
+
 #define RETRY(retry)                              \
             goto try_commit;                      \
 abort_in_progress:                                \
@@ -167,6 +186,14 @@ if (!(trans_op))             \
             Sto::mvcc_rw_upgrade();               \
             try {
 
+#define ROTRANSACTION_E                           \
+    do {                                          \
+        TransactionLoopGuard __txn_guard;         \
+        while (1) {                               \
+            __txn_guard.start();                  \
+            Sto::declare_read_only();             \
+            try {
+
 #define RETRY_E(retry)                            \
                 if (__txn_guard.try_commit())     \
                     break;                        \
@@ -188,6 +215,7 @@ if (!(trans_op)) {throw Transaction::Abort();}
 
 #define TXN   TRANSACTION_E
 #define RWTXN RWTRANSACTION_E
+#define ROTXN ROTRANSACTION_E
 #define CHK   TXN_DO_E
 #define TEND  RETRY_E
 
@@ -195,6 +223,7 @@ if (!(trans_op)) {throw Transaction::Abort();}
 
 #define TXN   TRANSACTION
 #define RWTXN RWTRANSACTION
+#define ROTXN ROTRANSACTION
 #define CHK   TXN_DO
 #define TEND  RETRY
 
@@ -222,6 +251,7 @@ enum txp {
     txp_hco,
     txp_hco_lock,
     txp_hco_invalid,
+    txp_hco_incremental,
     txp_hco_abort,
     // STO_PROFILE_COUNTERS > 1 only
     txp_mvcc_flat_runs,
@@ -489,14 +519,25 @@ public:
 private:
     static tid_type _TID;
     static std::atomic<tid_type> _RTID;
+    static std::atomic<unsigned> _snapshot_readers;
+    static std::atomic<uint64_t> _RTID_stamp;  // tsc of the last _RTID refresh
     static unsigned us_per_epoch;  // Defaults to 100ms
+    static unsigned us_per_epoch_min;  // Shortest adaptive period
+    static std::atomic<unsigned> us_epoch_period_;  // Current period
+    static size_t rcu_backlog_limit;
+    static bool cooperative_epochs_;
+    static std::atomic<bool> epoch_advancing_;
+    static std::atomic<uint64_t> epoch_advance_tsc_;
+    static uint64_t rtid_refresh_cycles;  // 0: refresh _RTID on every read_tid()
+    static unsigned us_per_rtid_publish;
+    static bool rtid_publisher_running;
 public:
 
     static std::function<void(threadinfo_t::epoch_type)> epoch_advance_callback;
 
     static txp_counters txp_counters_combined() {
         txp_counters out;
-        for (int i = 0; i != MAX_THREADS; ++i)
+        for (int i = 0, n = TThread::num_ids(); i != n; ++i)
             for (int p = 0; p != txp_count; ++p) {
                 if (txp_is_max(p))
                     out.p_[p] = std::max(out.p_[p], tinfo[i].p_.p_[p]);
@@ -508,7 +549,7 @@ public:
 
     static tc_counters tc_counters_combined() {
         tc_counters ret;
-        for (int i = 0; i < MAX_THREADS; ++i) {
+        for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
             for (int t = 0; t < tc_count; ++t) {
                 ret.tcs_[t] += tinfo[i].tcs_.tcs_[t];
             }
@@ -543,32 +584,48 @@ public:
     }
 
     static void* epoch_advancer(void*);
+    static void* rtid_publisher(void*);
     static void epoch_advance_once();
+    static bool epoch_advance_step(bool force);
     static tid_type compute_rtid_inf();
+    static tid_type compute_snapshot_tid_inf();
+    // Epoch at which an object retired now may be freed. A thread that
+    // announced a quiescent state has no snapshot epoch; use the current one.
+    static epoch_type rcu_epoch(threadinfo_t& thr) {
+        epoch_type e = thr.write_snapshot_epoch;
+        return e ? e : global_epochs.global_epoch.load();
+    }
     template <typename T>
     static void rcu_delete(T* x) {
         auto& thr = tinfo[TThread::id()];
         txp_account<txp_rcu_del_req>(1);
-        thr.rcu_set.add(thr.write_snapshot_epoch, rcu_delete_cb<T>, x);
+        thr.rcu_set.add(rcu_epoch(thr), rcu_delete_cb<T>, x);
     }
     template <typename T>
     static void rcu_delete_array(T* x) {
         auto& thr = tinfo[TThread::id()];
         txp_account<txp_rcu_delarr_req>(1);
-        thr.rcu_set.add(thr.write_snapshot_epoch, rcu_delete_array_cb<T>, x);
+        thr.rcu_set.add(rcu_epoch(thr), rcu_delete_array_cb<T>, x);
     }
     static void rcu_free(void* ptr) {
         auto& thr = tinfo[TThread::id()];
         txp_account<txp_rcu_free_req>(1);
-        thr.rcu_set.add(thr.write_snapshot_epoch, rcu_free_cb, ptr);
+        thr.rcu_set.add(rcu_epoch(thr), rcu_free_cb, ptr);
     }
     static void rcu_call(void (*function)(void*), void* argument) {
         auto& thr = tinfo[TThread::id()];
-        thr.rcu_set.add(thr.write_snapshot_epoch, function, argument);
+        thr.rcu_set.add(rcu_epoch(thr), function, argument);
     }
     static void rcu_quiesce() {
         tinfo[TThread::id()].epoch = 0;
     }
+    // Callbacks registered by all threads and not yet run
+    static size_t rcu_backlog() {
+        size_t n = 0;
+        for (int i = 0, nt = TThread::num_ids(); i != nt; ++i)
+            n += tinfo[i].rcu_set.pending();
+        return n;
+    }
 
 #if STO_PROFILE_COUNTERS
     template <unsigned P> static void txp_account(txp_counter_type n) {
@@ -594,13 +651,71 @@ public:
     static void set_epoch_cycle(const unsigned us) {
         fence();
         us_per_epoch = us;
+        if (us_per_epoch_min > us)
+            us_per_epoch_min = us;
+        us_epoch_period_ = us;
+        fence();
+    }
+
+    // The epoch period adapts between these bounds: it halves while the
+    // RCU backlog exceeds the limit and doubles back once the backlog falls
+    // below a quarter of it. Setting the minimum equal to the cycle turns
+    // adaptation off.
+    static void set_epoch_cycle_min(const unsigned us) {
+        fence();
+        us_per_epoch_min = std::min(us, us_per_epoch);
+        fence();
+    }
+    static unsigned get_epoch_period() {
+        return us_epoch_period_;
+    }
+    static void set_rcu_backlog_limit(const size_t n) {
+        fence();
+        rcu_backlog_limit = n;
+        fence();
+    }
+
+    // In cooperative mode, transactions advance the epoch themselves when
+    // it is due, so no epoch_advancer thread is needed, and every thread
+    // announces a quiescent state when its transaction ends. Threads idle
+    // between transactions then never hold back reclamation, but must not
+    // keep pointers to RCU-protected data across transactions.
+    static void set_cooperative_epochs(const bool on) {
+        fence();
+        cooperative_epochs_ = on;
+        fence();
+    }
+    static bool cooperative_epochs() {
+        return cooperative_epochs_;
+    }
+
+    // Allow _RTID to lag by up to @cycles TSC cycles: within that interval
+    // only one thread scans tinfo, the others use the current _RTID.
+    // Zero (the default) refreshes _RTID on every read_tid().
+    static void set_rtid_refresh_cycles(const uint64_t cycles) {
+        fence();
+        rtid_refresh_cycles = cycles;
+        fence();
+    }
+
+    // Interval at which a running rtid_publisher thread refreshes _RTID;
+    // zero makes it refresh continuously.
+    static void set_rtid_publish_cycle(const unsigned us) {
+        fence();
+        us_per_rtid_publish = us;
         fence();
     }
 
 
 private:
     static constexpr unsigned tset_chunk = 512;
-    static constexpr unsigned tset_max_capacity = 32768;
+    // chunk pointers held in the Transaction; the table grows past them
+    static constexpr unsigned tset_inline_chunks = 64;
+    // items past this are found through a hashtable in the arena, since
+    // hashtable_ entries (hash_base_ + index) must fit in 16 bits
+    static constexpr unsigned tset_hash_limit = 16384;
+    // larger write sets are indexed in the arena at commit
+    static constexpr unsigned writeset_stack_capacity = 2048;
 
     void initialize();
 
@@ -640,14 +755,17 @@ private:
 #endif
         special_txp = false;
         //thr.epoch = global_epochs.global_epoch;
+        if (cooperative_epochs_)
+            epoch_advance_step(false);
         thr.write_snapshot_epoch = global_epochs.global_epoch.load();
         thr.epoch = global_epochs.read_epoch.load();
         thr.rcu_set.clean_until(global_epochs.active_epoch.load());
         thr.rtid = thr.wtid = 0;
         if (thr.trans_start_callback)
             thr.trans_start_callback();
-        hash_base_ += tset_size_ + 1;
+        hash_base_ += std::min(tset_size_, tset_hash_limit) + 1;
         tset_size_ = 0;
+        big_hash_mask_ = 0;
         tset_next_ = tset0_;
         cht_.clear();
 #if CICADA_HASHTABLE == 0 && TRANSACTION_HASHTABLE
@@ -662,22 +780,29 @@ private:
         }
 #endif
         any_writes_ = any_nonopaque_ = may_duplicate_items_ = false;
+        read_index_valid_ = false;
         first_write_ = 0;
         mvcc_rw = false;
+        read_only_ = false;
         if (commit_tid_ > 0)
             prev_commit_tid_ = commit_tid_;
 #if SAFE_FLATTEN
         write_tid_inf_ = 0;
 #endif
+        snapshot_tid_inf_ = 0;
         start_tid_ = read_tid_ = commit_tid_ = 0;
+        opacity_checked_ = 0;
         tictoc_tid_ = 0;
         buf_.clear();
-#if STO_DEBUG_ABORTS
-        abort_item_ = nullptr;
         abort_reason_ = nullptr;
+        abort_item_ = nullptr;
+        abort_pc_ = nullptr;
+#if STO_DEBUG_ABORTS
         abort_version_ = 0;
 #endif
         TXP_INCREMENT(txp_total_starts);
+        if (TStats::enabled())
+            TStats::account_start();
         state_ = s_in_progress;
         callCMstart();
     }
@@ -706,12 +831,27 @@ private:
 #endif
 
     void refresh_tset_chunk();
+    TransArena* arena() {
+        if (!arena_)
+            arena_ = TransArena::acquire(threadid_);
+        return arena_;
+    }
+    void big_hash_insert(const TObject* obj, void* xkey, unsigned tidx);
+    TransItem* big_hash_find(const TObject* obj, void* xkey) const;
+    void big_hash_rebuild(unsigned capacity);
 
     void allocate_item_update_hash(const TObject* obj, void* xkey) {
 #if CICADA_HASHTABLE
         cht_.put(const_cast<TObject *>(obj), xkey, tset_size_ - 1);
 #else
 #if TRANSACTION_HASHTABLE
+        if (unlikely(tset_size_ > tset_hash_limit)) {
+            if (!big_hash_mask_)
+                big_hash_rebuild(4 * tset_hash_limit);
+            else
+                big_hash_insert(obj, xkey, tset_size_ - 1);
+            return;
+        }
         unsigned hi = hash(obj, xkey);
         //bitvector_[hi % bv_size] = true;
 # if TRANSACTION_HASHTABLE > 1
@@ -772,6 +912,8 @@ private:
         return item(obj, key);
 #else
 #if TRANSACTION_HASHTABLE
+        if (unlikely(tset_size_ >= tset_hash_limit))
+            return item(obj, key);
         bool found = false;
         TransItem* ti;
         void* xkey = Packer<T>::pack_unique(buf_, std::move(key));
@@ -862,6 +1004,8 @@ private:
 #else
 #if TRANSACTION_HASHTABLE
         TXP_INCREMENT(txp_hash_find);
+        if (unlikely(big_hash_mask_))
+            return big_hash_find(obj, xkey);
         unsigned hi = hash(obj, xkey);
         for (int steps = 0; steps < TRANSACTION_HASHTABLE; ++steps) {
             if (hashtable_[hi] <= hash_base_)
@@ -894,20 +1038,25 @@ private:
 #endif
    }
 
-    bool preceding_duplicate_read(TransItem *it) const;
+    // Duplicate items (see may_duplicate_items_) pass validation if an
+    // earlier item with the same owner and key has a read. The reads are
+    // indexed by (owner, key) on the first failed check of a validation
+    // pass, so each further lookup is a binary search.
+    bool preceding_duplicate_read(TransItem *it, unsigned tidx) const;
 
 public:
-#if STO_DEBUG_ABORTS
     void mark_abort_because(TransItem* item, const char* reason, TransactionTid::type version = 0) const {
         abort_item_ = item;
         abort_reason_ = reason;
+        if (TAbortProfile::enabled())
+            abort_pc_ = TAbortProfile::caller_pc();
+#if STO_DEBUG_ABORTS
         if (version)
             abort_version_ = version;
-    }
 #else
-    void mark_abort_because(TransItem*, const char*, TransactionTid::type = 0) const {
-    }
+        (void) version;
 #endif
+    }
 
     void abort_because(TransItem& item, const char* reason, TransactionTid::type version = 0) {
         mark_abort_because(&item, reason, version);
@@ -920,6 +1069,8 @@ public:
     }
 
     void abort() {
+        if (!abort_pc_ && TAbortProfile::enabled())
+            abort_pc_ = TAbortProfile::caller_pc();
         silent_abort();
         throw Abort();
         //longjmp(env, 1);
@@ -1003,11 +1154,65 @@ public:
         mvcc_rw = true;
     }
 
+    // declares the transaction read-only (see ROTRANSACTION)
+    void declare_read_only() const {
+        read_only_ = true;
+    }
+
+    bool is_read_only() const {
+        return read_only_;
+    }
+
+    // Snapshot tid of a declared read-only transaction. Every commit with a
+    // tid at or below it has finished installing or still holds its locks;
+    // writers that commit above it and observe snapshot_readers_active()
+    // preserve the versions they overwrite. The provisional rtid published
+    // before registering keeps writers from trimming history we may need.
+    tid_type snapshot_tid() const {
+        if (!snapshot_tid_) {
+            threadinfo_t& thr = tinfo[TThread::id()];
+            tid_type published = thr.rtid;
+            if (!published)
+                thr.rtid = _RTID.load();
+            _snapshot_readers.fetch_add(1);
+            fence();
+            snapshot_tid_ = _TID - TransactionTid::increment_value;
+            thr.rtid = published ? std::min(published, snapshot_tid_) : snapshot_tid_;
+        }
+        return snapshot_tid_;
+    }
+
+    static bool snapshot_readers_active() {
+        return _snapshot_readers.load() != 0;
+    }
+
+    // Lower bound of the snapshots of running read-only transactions,
+    // computed once per commit. A reader that registers later has a snapshot
+    // at or above every version this commit overwrites, so the stale bound
+    // only keeps more history.
+    tid_type snapshot_tid_inf() const {
+        if (!snapshot_tid_inf_)
+            snapshot_tid_inf_ = compute_snapshot_tid_inf();
+        return snapshot_tid_inf_;
+    }
+
+    // Read at @tid, a snapshot held by another running transaction (its
+    // snapshot_tid() or, for MVCC, its read_tid()), so that several threads
+    // read the same consistent state. See TCheckpoint.
+    void pin_snapshot(tid_type tid) const {
+        threadinfo_t& thr = tinfo[TThread::id()];
+        if (!snapshot_tid_)
+            _snapshot_readers.fetch_add(1);
+        snapshot_tid_ = read_tid_ = tid;
+        thr.rtid = tid;
+    }
+
 #if SAFE_FLATTEN
     tid_type write_tid_inf() const {
         if (!write_tid_inf_) {
             tid_type min_wtid = _TID;
-            for (auto& t : tinfo) {
+            for (int i = 0, n = TThread::num_ids(); i != n; ++i) {
+                auto& t = tinfo[i];
                 acquire_fence();
                 tid_type wtid = t.wtid;
                 if (wtid != 0 && wtid < min_wtid)
@@ -1019,6 +1224,28 @@ public:
     }
 #endif
 
+    // Bring _RTID up to date before it is used as a read timestamp
+    static void refresh_rtid() {
+        if (rtid_publisher_running)
+            return;
+        if (!rtid_refresh_cycles) {
+            epoch_advance_once();
+            return;
+        }
+        uint64_t now = read_tsc();
+        uint64_t last = _RTID_stamp.load(std::memory_order_relaxed);
+        if (now - last >= rtid_refresh_cycles
+            && _RTID_stamp.compare_exchange_strong(last, now))
+            epoch_advance_once();
+    }
+
+    // A TID that no write still in flight precedes: every write with a
+    // smaller TID has committed or aborted
+    static tid_type resolved_tid() {
+        refresh_rtid();
+        return _RTID.load();
+    }
+
     // transaction start
     template <bool Commute>
     tid_type read_tid() const {
@@ -1031,7 +1258,7 @@ public:
             if (mvcc_rw) {
                 thr.rtid = read_tid_ = _TID;
             } else {
-                epoch_advance_once();
+                refresh_rtid();
                 thr.rtid = read_tid_ = _RTID.load();
             }
             // Can't we just get the most recent tid (_TID?)
@@ -1041,14 +1268,14 @@ public:
                     //thr.rtid = read_tid_ = std::max(_RTID.load(), prev_commit_tid_);
                     thr.rtid = read_tid_ = _TID;
                 } else {
-                    epoch_advance_once();
+                    refresh_rtid();
                     thr.rtid = read_tid_ = _RTID;
                 }
             } else {
                 // When we use CU we can't do the timestamp hack above because
                 // flattening delta versions require the invariant that all
                 // reads never observe information based on pending versions
-                epoch_advance_once();
+                refresh_rtid();
                 thr.rtid = read_tid_ = _RTID;
             }
 #endif
@@ -1195,40 +1422,58 @@ private:
 
     int threadid_;
     uint16_t hash_base_;
-    uint16_t first_write_;
+    unsigned first_write_;
     uint8_t state_;
     bool any_writes_;
 public:
     bool any_nonopaque_;
 private:
     bool may_duplicate_items_;
+    mutable bool read_index_valid_;  // read_index_ matches this validation pass
     bool is_test_;
     bool restarted;
     TransItem* tset_next_;
     unsigned tset_size_;
     mutable bool mvcc_rw;  // manual MVCC read-write flag
+    mutable bool read_only_;  // declared read-only (ROTRANSACTION)
     mutable tid_type start_tid_;
+    unsigned opacity_checked_;  // tset prefix validated as of start_tid_
 #if SAFE_FLATTEN
     mutable tid_type write_tid_inf_;
 #endif
+    mutable tid_type snapshot_tid_inf_;
     mutable tid_type read_tid_;
+    mutable tid_type snapshot_tid_;
     mutable tid_type commit_tid_;
     mutable tid_type prev_commit_tid_;
     mutable tid_type tictoc_tid_; // commit tid reserved for TicToc
+    struct indexed_read {
+        TObject* owner;
+        void* key;
+        unsigned tidx;
+    };
+    mutable std::vector<indexed_read> read_index_;
 public:
     mutable TransactionBuffer buf_;
     mutable TransScratch scratch_;
 private:
     mutable uint32_t lrng_state_;
-#if STO_DEBUG_ABORTS
-    mutable TransItem* abort_item_;
     mutable const char* abort_reason_;
+    mutable TransItem* abort_item_;
+    mutable void* abort_pc_;
+#if STO_DEBUG_ABORTS
     mutable tid_type abort_version_;
 #endif
 #if STO_TSC_PROFILE
     mutable tc_counter_type start_tsc_;
 #endif
-    TransItem* tset_[tset_max_capacity / tset_chunk];
+    TransItem** tset_;          // chunk table: tset_inline_ or grown
+    unsigned tset_nchunks_;
+    TransItem* tset_inline_[tset_inline_chunks];
+    TransArena* arena_;
+    unsigned* big_hash_;        // tset index + 1, or 0; in the arena
+    unsigned big_hash_mask_;    // 0 unless tset_size_ > tset_hash_limit
+    unsigned big_hash_count_;
     CicadaHashtable cht_;
 #if CICADA_HASHTABLE == 0
 #if TRANSACTION_HASHTABLE
@@ -1244,6 +1489,7 @@ private:
     friend class TransItem;
     friend class Sto;
     friend class TestTransaction;
+    friend class TCoroutine;
     friend class MvHistoryBase;
     friend class CicadaHashtable;
 
@@ -1437,6 +1683,28 @@ public:
         TThread::txn->mvcc_rw_upgrade();
     }
 
+    static void declare_read_only() {
+        always_assert(in_progress());
+        TThread::txn->declare_read_only();
+    }
+
+    static bool read_only() {
+        return TThread::txn && TThread::txn->is_read_only();
+    }
+
+    static TransactionTid::type snapshot_tid() {
+        return TThread::txn->snapshot_tid();
+    }
+
+    static void pin_snapshot(TransactionTid::type tid) {
+        always_assert(in_progress());
+        TThread::txn->pin_snapshot(tid);
+    }
+
+    static bool snapshot_readers_active() {
+        return Transaction::snapshot_readers_active();
+    }
+
 #if SAFE_FLATTEN
     static TransactionTid::type write_tid_inf() {
         return TThread::txn->write_tid_inf();
@@ -8,6 +8,11 @@
 #include "TransItem.hh"
 #include "TThread.hh"
 
+// Number of bits needed to store thread ids 0..n-1
+constexpr int sto_threadid_bits(unsigned n, int w = 0) {
+    return (1ULL << w) >= n ? w : sto_threadid_bits(n, w + 1);
+}
+
 class TransactionTid {
 public:
     typedef WideTid::single_type type;
@@ -16,28 +21,32 @@ public:
     // Common layout definition
 
     // |-----VALUE-----|O|D|U|N|L|--MASK--|
-    //       52 bits    1 1 1 1 1  7 bits
+    //     64-5-W bits  1 1 1 1 1  W bits
 
-    static constexpr signed_type mask_width = 7;
+    // W is the number of bits needed for thread ids below MAX_THREADS, but
+    // never less than 7 (the historical layout, 52 bits of value).
+    static constexpr signed_type mask_width =
+        sto_threadid_bits(MAX_THREADS) < 7 ? 7 : sto_threadid_bits(MAX_THREADS);
+    static_assert(mask_width <= 16, "MAX_THREADS too large for the version layout");
 
     // bits holding thread id of the thread holding the exclusive lock
-    static constexpr type threadid_mask = type(0x7F);
+    static constexpr type threadid_mask = (type(1) << mask_width) - 1;
     // the exclusive lock bit, used for write locks
-    static constexpr type lock_bit = type(0x1 << mask_width);
+    static constexpr type lock_bit = type(1) << mask_width;
     // Used for data structures that don't use opacity. When they increment
     // a version they set the nonopaque_bit, forcing any opacity check to be
     // hard (checking the full read set)
-    static constexpr type nonopaque_bit = type(0x1 << (mask_width + 1));
+    static constexpr type nonopaque_bit = type(1) << (mask_width + 1);
     // Reserved user bit, usually used for eager write-write conflict detection
     // in various data types (the so-called "invalid bit")
-    static constexpr type user_bit = type(0x1 << (mask_width + 2));
+    static constexpr type user_bit = type(1) << (mask_width + 2);
     // Dirty bit, set while the version is being modified
-    static constexpr type dirty_bit = type(0x1 << (mask_width + 3));
+    static constexpr type dirty_bit = type(1) << (mask_width + 3);
     // Bit signaling optimistic concurrency control for readers
     // used in adaptive reader/write lock version
-    static constexpr type opt_bit = type(0x1 << (mask_width + 4));
+    static constexpr type opt_bit = type(1) << (mask_width + 4);
     // start of te actual version (Tid) value
-    static constexpr type increment_value = type(0x1 << (mask_width + 5));
+    static constexpr type increment_value = type(1) << (mask_width + 5);
     // Max Tid value, absent any other bits
     static constexpr type max_value = type((~0x0ULL) << (mask_width + 5));
 
@@ -1,5 +1,7 @@
 #include <iostream>
+#include <fstream>
 #include <sstream>
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 #include <cassert>
@@ -8,11 +10,14 @@
 #include <string>
 
 #include <map>
+#include <functional>
 #include <set>
 
 #include "driver.hpp"
+#include "profile.hpp"
 
 const std::string TName_str[] = {"int64_t", "int32_t", "float", "var_string", "fix_string"};
+const std::string TName_defs_str[] = {"BIGINT", "SMALLINT", "FLOAT", "VARCHAR", "CHAR"};
 
 unsigned int integer_log2(uint64_t input) {
     if (input == 0 && input == 1)
@@ -158,11 +163,10 @@ void generate_code_single_struct(StructSpec &result) {
         ss << f.name;
         if (i == 0)
             ss << " = 0";
-        if (i != (fields.size() - 1))
-            ss << ", ";
+        ss << ", ";
         ++i;
     }
-    ss << " };" << std::endl << std::endl;
+    ss << "COLCOUNT };" << std::endl << std::endl;
 
     for (auto& f : fields)
         ss << idt << cxx_type_name(f.t) << ' ' << f.name << ';' << std::endl;
@@ -229,6 +233,66 @@ void generate_code_single_versel(StructSpec &result) {
 
 
 
+bool apply_profile(std::vector<StructSpec>& result, const std::map<std::string, ColumnProfile>& profiles,
+                   double conflict_weight) {
+    for (auto& spec : result) {
+        auto it = profiles.find(spec.struct_name);
+        if (it == profiles.end()) {
+            std::cerr << "Warning: no profile for struct " << spec.struct_name << ", keeping its groups" << std::endl;
+            continue;
+        }
+        if (it->second.ncols > static_cast<int>(spec.fields.size())) {
+            std::cerr << "Error: profile of struct " << spec.struct_name << " has " << it->second.ncols
+                      << " columns, but only " << spec.fields.size() << " fields are declared" << std::endl;
+            return false;
+        }
+        spec.groups.clear();
+        for (auto& g : group_columns(static_cast<int>(spec.fields.size()), it->second, conflict_weight)) {
+            std::vector<std::string> names;
+            for (auto c : g)
+                names.push_back(spec.fields[c].name);
+            spec.groups.push_back(names);
+        }
+    }
+    return true;
+}
+
+// Print the struct definitions back in the input format, with the groups
+// produced by apply_profile(), so the result can be checked in as a defs file.
+void print_defs(std::vector<StructSpec> &result) {
+    for (auto &spec : result) {
+        std::cout << "@@@" << std::endl;
+        std::cout << "@name: " << spec.struct_name << std::endl;
+        std::cout << "@fields: {";
+        size_t i = 0;
+        for (auto& f : spec.fields) {
+            std::cout << f.name << '(' << TName_defs_str[f.t.tname];
+            if (f.t.tname == VarChar || f.t.tname == Char)
+                std::cout << '(' << f.t.len << ')';
+            std::cout << ')';
+            if (++i != spec.fields.size())
+                std::cout << ", ";
+        }
+        std::cout << '}' << std::endl;
+        std::cout << "@groups: {";
+        i = 0;
+        for (auto& g : spec.groups) {
+            std::cout << '{';
+            size_t j = 0;
+            for (auto& fn : g) {
+                std::cout << fn;
+                if (++j != g.size())
+                    std::cout << ", ";
+            }
+            std::cout << '}';
+            if (++i != spec.groups.size())
+                std::cout << ", ";
+        }
+        std::cout << '}' << std::endl;
+        std::cout << "@@@" << std::endl << std::endl;
+    }
+}
+
 void generate_code(std::vector<StructSpec> &result) {
     std::cout << "#pragma once" << std::endl << std::endl;
 
@@ -247,33 +311,59 @@ void generate_code(std::vector<StructSpec> &result) {
     std::cout << "}; // namespace ver_sel" << std::endl;
 }
 
+void print_help() {
+    std::cout << "usage: my_wc [-p <profile> [-w <weight>] [-g]] (-o | <filename>)\n";
+    std::cout << "use -o for pipe to std::cin\n";
+    std::cout << "just give a filename to count from a file\n";
+    std::cout << "use -p <profile> to derive @groups from a benchmark column profile\n";
+    std::cout << "use -w <weight> to set the false conflict weight used with -p (default 1.0)\n";
+    std::cout << "use -g to print the struct definitions with the derived groups instead of code\n";
+    std::cout << "use -h to get this menu\n";
+}
+
 int main(const int argc, const char **argv) {
-    /** check for the right # of arguments **/
     std::vector<StructSpec> result;
-    if( argc == 2 ) {
-        MC::MC_Driver driver;
-        /** example for piping input from terminal, i.e., using cat **/
-        if( std::strncmp( argv[ 1 ], "-o", 2 ) == 0 ) {
-            driver.parse( std::cin, result );
-        }
-        /** simple help menu **/
-        else if( std::strncmp( argv[ 1 ], "-h", 2 ) == 0 ) {
-            std::cout << "use -o for pipe to std::cin\n";
-            std::cout << "just give a filename to count from a file\n";
-            std::cout << "use -h to get this menu\n";
+    const char *profile_file = nullptr;
+    double conflict_weight = 1.0;
+    bool print_groups = false;
+    const char *input = nullptr;
+
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            profile_file = argv[++i];
+        } else if (std::strcmp(argv[i], "-w") == 0 && i + 1 < argc) {
+            conflict_weight = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "-g") == 0) {
+            print_groups = true;
+        } else if (std::strncmp(argv[i], "-h", 2) == 0) {
+            /** simple help menu **/
+            print_help();
             return( EXIT_SUCCESS );
+        } else if (input == nullptr) {
+            input = argv[i];
+        } else {
+            print_help();
+            return( EXIT_FAILURE );
         }
-        /** example reading input from a file **/
-        else {
-            /** assume file, prod code, use stat to check **/
-            driver.parse( argv[1], result );
-        }
-    } else {
+    }
+
+    /** check for the right # of arguments **/
+    if (input == nullptr) {
         /** exit with failure condition **/
         return ( EXIT_FAILURE );
     }
 
-    
+    MC::MC_Driver driver;
+    /** example for piping input from terminal, i.e., using cat **/
+    if( std::strncmp( input, "-o", 2 ) == 0 ) {
+        driver.parse( std::cin, result );
+    }
+    /** example reading input from a file **/
+    else {
+        /** assume file, prod code, use stat to check **/
+        driver.parse( input, result );
+    }
+
     if (result.empty()) {
         std::cout << "No structures identified." << std::endl;
         return ( EXIT_FAILURE );     
@@ -286,7 +376,20 @@ int main(const int argc, const char **argv) {
         return ( EXIT_FAILURE );
     }
 
-    generate_code(result);
+    if (profile_file != nullptr) {
+        std::map<std::string, ColumnProfile> profiles;
+        if (!load_profile(profile_file, profiles) || !apply_profile(result, profiles, conflict_weight))
+            return ( EXIT_FAILURE );
+        if (!type_check(result)) {
+            std::cout << "Type checker error after applying profile: Exited." << std::endl;
+            return ( EXIT_FAILURE );
+        }
+    }
+
+    if (print_groups)
+        print_defs(result);
+    else
+        generate_code(result);
 
     return( EXIT_SUCCESS );
 }
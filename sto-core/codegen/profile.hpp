@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Column access profile of a single table, as written by the benchmark
+// column profiler (benchmark/DB_colprofile.hh, BENCH_PROFILE_COLUMNS=1).
+struct ColumnProfile {
+    int ncols;
+    uint64_t naccesses;
+    std::vector<uint64_t> reads;
+    std::vector<uint64_t> writes;
+    std::vector<uint64_t> conflicts;
+    std::map<std::pair<int, int>, uint64_t> coaccesses;
+};
+
+inline bool load_profile(const char *filename, std::map<std::string, ColumnProfile>& profiles) {
+    std::ifstream in(filename);
+    if (!in.is_open()) {
+        std::cerr << "Error: cannot open profile \"" << filename << "\"" << std::endl;
+        return false;
+    }
+
+    std::string tag;
+    std::string name;
+    ColumnProfile *cur = nullptr;
+    while (in >> tag) {
+        if (tag == "table") {
+            in >> name;
+            cur = &profiles[name];
+            in >> cur->ncols >> cur->naccesses;
+            cur->reads.assign(cur->ncols, 0);
+            cur->writes.assign(cur->ncols, 0);
+            cur->conflicts.assign(cur->ncols, 0);
+        } else if (cur != nullptr && tag == "col") {
+            int c;
+            in >> c;
+            if (c < 0 || c >= cur->ncols)
+                break;
+            in >> cur->reads[c] >> cur->writes[c] >> cur->conflicts[c];
+        } else if (cur != nullptr && tag == "pair") {
+            int a, b;
+            uint64_t n;
+            in >> a >> b >> n;
+            cur->coaccesses[std::make_pair(a, b)] = n;
+        } else if (cur != nullptr && tag == "end") {
+            cur = nullptr;
+        } else {
+            break;
+        }
+        if (!in)
+            break;
+    }
+
+    if (cur != nullptr || !in.eof()) {
+        std::cerr << "Error: malformed profile \"" << filename << "\" near \"" << tag << "\"" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Derive column groups from an access profile by greedy agglomerative merging.
+//
+// Every column starts in its own group. Merging two groups saves the per-cell
+// bookkeeping (one TransItem and one version check) for accesses touching
+// both, estimated by the largest pairwise co-access count between them. It
+// costs false conflicts: reads of one group become invalidated by writes to
+// the other, estimated as W(A)*R(B) + W(B)*R(A) over the number of row
+// accesses, and amplified by the table's observed conflict rate. Pairs are
+// merged best-first while the gain is non-negative, so read-only and unused
+// columns always collapse into a single group. Groups are emitted with the
+// most written group first (cell 0), matching the hand-written selectors.
+// Returns the column numbers (0 to @ncols - 1) of each group.
+inline std::vector<std::vector<int>> group_columns(int ncols, const ColumnProfile& prof, double conflict_weight) {
+    double n = static_cast<double>(std::max<uint64_t>(prof.naccesses, 1));
+    uint64_t total_conflicts = 0;
+    for (auto k : prof.conflicts)
+        total_conflicts += k;
+    double contention = 1.0 + total_conflicts / n;
+
+    auto reads = [&](int c) { return (c < prof.ncols) ? prof.reads[c] : 0; };
+    auto writes = [&](int c) { return (c < prof.ncols) ? prof.writes[c] : 0; };
+    auto coaccess = [&](int a, int b) -> uint64_t {
+        auto it = prof.coaccesses.find(std::make_pair(std::min(a, b), std::max(a, b)));
+        return (it == prof.coaccesses.end()) ? 0 : it->second;
+    };
+
+    std::vector<std::vector<int>> groups;
+    for (int c = 0; c < ncols; ++c)
+        groups.push_back({c});
+
+    auto sum = [](const std::vector<int>& g, std::function<uint64_t(int)> f) {
+        double s = 0;
+        for (auto c : g)
+            s += f(c);
+        return s;
+    };
+
+    while (groups.size() > 1) {
+        double best_gain = 0;
+        double best_saving = -1;
+        size_t best_i = 0, best_j = 0;
+        for (size_t i = 0; i < groups.size(); ++i) {
+            for (size_t j = i + 1; j < groups.size(); ++j) {
+                auto& a = groups[i];
+                auto& b = groups[j];
+                uint64_t saving = 0;
+                for (auto x : a)
+                    for (auto y : b)
+                        saving = std::max(saving, coaccess(x, y));
+                double penalty = conflict_weight * contention
+                                 * (sum(a, writes) * sum(b, reads) + sum(b, writes) * sum(a, reads)) / n;
+                double gain = saving - penalty;
+                if (gain < 0)
+                    continue;
+                if (best_saving < 0 || gain > best_gain || (gain == best_gain && saving > best_saving)) {
+                    best_gain = gain;
+                    best_saving = saving;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+        if (best_saving < 0)
+            break;
+        auto& dst = groups[best_i];
+        dst.insert(dst.end(), groups[best_j].begin(), groups[best_j].end());
+        std::sort(dst.begin(), dst.end());
+        groups.erase(groups.begin() + best_j);
+    }
+
+    std::stable_sort(groups.begin(), groups.end(), [&](const std::vector<int>& a, const std::vector<int>& b) {
+        return sum(a, writes) > sum(b, writes);
+    });
+
+    return groups;
+}
@@ -15,6 +15,8 @@
 #include "PlatformFeatures.hh"
 
 #include "TFlexArray.hh"
+#include "SkipMap.hh"
+#include "TOpenHashtable.hh"
 //#include "TGeneric.hh"
 //#include "Hashtable.hh"
 //#include "Queue.hh"
@@ -50,6 +52,16 @@
 #define USE_SWISSARRAY 12
 //#define USE_SWISSGENERICARRAY 13
 #define USE_ARRAY_TICTOC 14
+#define USE_SKIPMAP 15
+#define USE_ARRAY_PADDED 16
+#define USE_ARRAY_SPLIT 17
+#define USE_ARRAY_GROUPED 18
+#define USE_OPEN_HASHTABLE 19
+
+// elements per version word for USE_ARRAY_GROUPED
+#ifndef ARRAY_GROUP_SIZE
+#define ARRAY_GROUP_SIZE 8
+#endif
 
 // set this to USE_DATASTRUCTUREYOUWANT
 #define DATA_STRUCTURE USE_HASHTABLE
@@ -191,6 +203,38 @@ private:
     type v_;
 };
 
+// USE_ARRAY with a different element layout
+template <typename L> struct LayoutArrayContainer {
+    typedef TFlexArray<value_type, ARRAY_SZ, TOpaqueWrapped, L> type;
+    typedef int index_type;
+    static constexpr bool has_delete = false;
+    value_type nontrans_get(index_type key) {
+        return v_.nontrans_get(key);
+    }
+    void nontrans_put(index_type key, const value_type& val) {
+        v_.nontrans_put(key, val);
+    }
+    bool transGet(index_type key, value_type& ret) {
+        return v_.transGet(key, ret);
+    }
+    bool transPut(index_type key, value_type value) {
+        return v_.transPut(key, value);
+    }
+    static void init() {}
+    void init_ns() {}
+    void finalize() {}
+    static void thread_init(LayoutArrayContainer<L>&) {}
+private:
+    type v_;
+};
+
+template <> struct Container<USE_ARRAY_PADDED>
+    : public LayoutArrayContainer<array_layout::padded> {};
+template <> struct Container<USE_ARRAY_SPLIT>
+    : public LayoutArrayContainer<array_layout::split> {};
+template <> struct Container<USE_ARRAY_GROUPED>
+    : public LayoutArrayContainer<array_layout::grouped<ARRAY_GROUP_SIZE>> {};
+
 template <> struct Container<USE_SWISSARRAY> {
     typedef TSwissArray<value_type, ARRAY_SZ> type;
     typedef int index_type;
@@ -295,6 +339,76 @@ private:
     type v_;
 };
 
+template <> struct Container<USE_SKIPMAP> {
+    typedef SkipMap<int, value_type> type;
+    typedef int index_type;
+    static constexpr bool has_delete = false;
+    value_type nontrans_get(index_type key) {
+        return v_.nontrans_find(key);
+    }
+    void nontrans_put(index_type key, const value_type& val) {
+        v_.nontrans_insert(key, val);
+    }
+    bool transGet(index_type key, value_type& ret) {
+        try {
+            if (!v_.find(key, ret))
+                ret = value_type();
+            return true;
+        } catch (Transaction::Abort e) {
+            return false;
+        }
+    }
+    bool transPut(index_type key, value_type value) {
+        try {
+            v_[key] = value;
+            return true;
+        } catch (Transaction::Abort e) {
+            return false;
+        }
+    }
+    static void init() {}
+    void init_ns() {}
+    void finalize() {}
+    static void thread_init(Container<USE_SKIPMAP>&) {}
+private:
+    type v_;
+};
+
+template <> struct Container<USE_OPEN_HASHTABLE> {
+    typedef TOpenHashtable<int, value_type, true, static_cast<unsigned>(ARRAY_SZ/HASHTABLE_LOAD_FACTOR)> type;
+    typedef int index_type;
+    static constexpr bool has_delete = false;
+    value_type nontrans_get(index_type key) {
+        return v_.unsafe_get(key);
+    }
+    void nontrans_put(index_type key, const value_type& val) {
+        v_.nontrans_insert(key, val);
+    }
+    bool transGet(index_type key, value_type& ret) {
+        try {
+            if (!v_.transGet(key, ret))
+                ret = value_type();
+            return true;
+        } catch (Transaction::Abort e) {
+            return false;
+        }
+    }
+    bool transPut(index_type key, value_type value) {
+        try {
+            v_.transPut(key, value);
+            return true;
+        } catch (Transaction::Abort e) {
+            return false;
+        }
+    }
+    static void init() {}
+    void init_ns() {}
+    void finalize() {}
+    static void thread_init(Container<USE_OPEN_HASHTABLE>&) {}
+private:
+    type v_;
+};
+
 /*
 template <> struct Container<USE_VECTOR> {
     typedef Vector<value_type> type;
@@ -1766,7 +1880,12 @@ void print_time(double time) {
     {name, desc, 10, new type<10, ## __VA_ARGS__>},   \
     {name, desc, 11, new type<11, ## __VA_ARGS__>},   \
     {name, desc, 12, new type<12, ## __VA_ARGS__>},   \
-    {name, desc, 14, new type<14, ## __VA_ARGS__>}
+    {name, desc, 14, new type<14, ## __VA_ARGS__>},   \
+    {name, desc, 15, new type<15, ## __VA_ARGS__>},   \
+    {name, desc, 16, new type<16, ## __VA_ARGS__>},   \
+    {name, desc, 17, new type<17, ## __VA_ARGS__>},   \
+    {name, desc, 18, new type<18, ## __VA_ARGS__>},   \
+    {name, desc, 19, new type<19, ## __VA_ARGS__>}
 
 //    {name, desc, 1, new type<1, ## __VA_ARGS__>},     
 //    {name, desc, 2, new type<2, ## __VA_ARGS__>},     
@@ -1805,9 +1924,14 @@ struct {
     {"array-nonopaque", USE_ARRAY_NONOPAQUE},
     {"array-adaptive", USE_ARRAY_ADAPTIVE},
     {"array-tictoc", USE_ARRAY_TICTOC},
+    {"array-padded", USE_ARRAY_PADDED},
+    {"array-split", USE_ARRAY_SPLIT},
+    {"array-grouped", USE_ARRAY_GROUPED},
     {"hashtable", USE_HASHTABLE},
     {"hash", USE_HASHTABLE},
     {"hash-str", USE_HASHTABLE_STR},
+    {"open-hashtable", USE_OPEN_HASHTABLE},
+    {"ohash", USE_OPEN_HASHTABLE},
     {"masstree", USE_MASSTREE},
     {"mass", USE_MASSTREE},
     {"masstree-str", USE_MASSTREE_STR},
@@ -1815,7 +1939,8 @@ struct {
     {"queue", USE_QUEUE},
 //    {"vector", USE_VECTOR},
     {"tvector", USE_TVECTOR},
-    {"swissarray", USE_SWISSARRAY}
+    {"swissarray", USE_SWISSARRAY},
+    {"skipmap", USE_SKIPMAP}
 //    {"swissgeneric", USE_SWISSGENERICARRAY}
 };
 
@@ -0,0 +1,247 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <unistd.h>
+#include <sys/time.h>
+#include "Transaction.hh"
+#include "TCounter.hh"
+#include "TStripedCounter.hh"
+#include "clp.h"
+
+// Throughput of blind increments to one hot counter, optionally mixed with
+// transactions that read the total. TCommuteIntegerBox lives in
+// benchmark/DB_index.hh, which needs Masstree; CommuteBox below uses the
+// same commit path (lock, add the delta, unlock) without the dependency.
+
+int max_threads = 64;
+int opspertrans = 1;
+double read_percent = 0;
+int runtime = 2;
+
+volatile bool running = true;
+
+class CommuteBox : public TObject {
+public:
+    typedef TVersion version_type;
+
+    long read() const {
+        auto item = Sto::item(this, 0);
+        if (!item.observe(vers_))
+            Sto::abort();
+        return value_;
+    }
+    void increment(long i) {
+        auto item = Sto::item(this, 0);
+        item.acquire_write(vers_, item.template write_value<long>(0) + i);
+    }
+    long nontrans_read() const {
+        return value_;
+    }
+
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, vers_);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        return vers_.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        value_ += item.write_value<long>();
+        txn.set_version_unlock(vers_, item);
+    }
+    void unlock(TransItem& item) override {
+        vers_.cp_unlock(item);
+    }
+
+private:
+    mutable version_type vers_;
+    long value_ = 0;
+};
+
+struct CounterTest {
+    static constexpr const char* name = "tcounter";
+    TCounter<long> c;
+    void increment() {
+        ++c;
+    }
+    long read() {
+        return c;
+    }
+    long nontrans_read() {
+        return c.nontrans_read();
+    }
+};
+
+struct StripedTest {
+    static constexpr const char* name = "striped";
+    TStripedCounter<long> c;
+    void increment() {
+        ++c;
+    }
+    long read() {
+        return c;
+    }
+    long nontrans_read() {
+        return c.nontrans_read();
+    }
+};
+
+struct CommuteTest {
+    static constexpr const char* name = "commute";
+    CommuteBox c;
+    void increment() {
+        c.increment(1);
+    }
+    long read() {
+        return c.read();
+    }
+    long nontrans_read() {
+        return c.nontrans_read();
+    }
+};
+
+template <typename T>
+struct Tester {
+    T* test;
+    int me;
+    uint64_t ncommits;
+    uint64_t nincrements;
+};
+
+template <typename T>
+void* run(void* arg) {
+    Tester<T>* t = (Tester<T>*) arg;
+    TThread::set_id(t->me);
+    std::mt19937 gen(t->me);
+    std::uniform_real_distribution<double> opdist(0, 1);
+    uint64_t ncommits = 0, nincrements = 0;
+    while (running) {
+        bool reader = opdist(gen) < read_percent;
+        long sum = 0;
+        TRANSACTION_E {
+            if (reader)
+                sum += t->test->read();
+            else
+                for (int i = 0; i < opspertrans; ++i)
+                    t->test->increment();
+        } RETRY_E(true);
+        ++ncommits;
+        if (!reader)
+            nincrements += opspertrans;
+        (void) sum;
+    }
+    t->ncommits = ncommits;
+    t->nincrements = nincrements;
+    return nullptr;
+}
+
+template <typename T>
+void run_and_report(int nthreads) {
+    T* test = new T;
+    running = true;
+    pthread_t tids[nthreads];
+    std::vector<Tester<T>> testers(nthreads);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    for (int i = 0; i < nthreads; ++i) {
+        testers[i] = Tester<T>{test, i, 0, 0};
+        pthread_create(&tids[i], NULL, run<T>, &testers[i]);
+    }
+    sleep(runtime);
+    running = false;
+    __sync_synchronize();
+    uint64_t ncommits = 0, nincrements = 0;
+    for (int i = 0; i < nthreads; ++i) {
+        pthread_join(tids[i], NULL);
+        ncommits += testers[i].ncommits;
+        nincrements += testers[i].nincrements;
+    }
+    gettimeofday(&tv2, NULL);
+    always_assert((uint64_t) test->nontrans_read() == nincrements, "lost increments");
+
+    double time = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("%s, %d threads: %llu txns/s\n", T::name, nthreads,
+           (unsigned long long) (ncommits / time));
+    delete test;
+}
+
+template <typename T>
+void run_all() {
+    for (int n = 1; n <= max_threads; n *= 2)
+        run_and_report<T>(n);
+}
+
+enum {
+    opt_maxthreads = 1, opt_opspertrans, opt_readpercent, opt_runtime
+};
+
+static const Clp_Option options[] = {
+    { "maxthreads", 0, opt_maxthreads, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "readpercent", 0, opt_readpercent, Clp_ValDouble, Clp_Optional },
+    { "runtime", 0, opt_runtime, Clp_ValInt, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: [OPTIONS] [tcounter|striped|commute]...\n\
+           Runs 1, 2, 4, ... MAXTHREADS threads.\n\
+           Options:\n\
+           --maxthreads=MAXTHREADS (default %d)\n\
+           --opspertrans=OPSPERTRANS, increments per transaction (default %d)\n\
+           --readpercent=READPERCENT, probability of a transaction reading the total (default %f)\n\
+           --runtime=SECONDS, per thread count (default %d)\n",
+           max_threads, opspertrans, read_percent, runtime);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    std::vector<std::string> tests;
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+            case opt_maxthreads:
+                max_threads = clp->val.i;
+                break;
+            case opt_opspertrans:
+                opspertrans = clp->val.i;
+                break;
+            case opt_readpercent:
+                read_percent = clp->val.d;
+                break;
+            case opt_runtime:
+                runtime = clp->val.i;
+                break;
+            case Clp_NotOption:
+                tests.push_back(clp->vstr);
+                break;
+            default:
+                help();
+        }
+    }
+    Clp_DeleteParser(clp);
+    always_assert(max_threads > 0 && max_threads <= MAX_THREADS, "bad thread count");
+
+    if (tests.empty()) {
+        tests.push_back("tcounter");
+        tests.push_back("striped");
+        tests.push_back("commute");
+    }
+
+    pthread_t advancer;
+    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+    pthread_detach(advancer);
+
+    for (auto& test : tests) {
+        if (test == "tcounter")
+            run_all<CounterTest>();
+        else if (test == "striped")
+            run_all<StripedTest>();
+        else if (test == "commute")
+            run_all<CommuteTest>();
+        else
+            help();
+    }
+    return 0;
+}
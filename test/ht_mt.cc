@@ -3,11 +3,13 @@
 #include <stdio.h>
 
 #include "Hashtable.hh"
+#include "TOpenHashtable.hh"
 #include "MassTrans.hh"
 #include "Transaction.hh"
 #include "simple_str.hh"
 #include "randgen.hh"
 
+// 0: Hashtable, 1: MassTrans, 2: TOpenHashtable
 #define DS 0
 #define USE_STRINGS 1
 
@@ -17,6 +19,12 @@ typedef Hashtable<std::string, std::string, false, 1000000, simple_str> ds;
 #else
 typedef Hashtable<int, std::string, false, 1000000, simple_str> ds;
 #endif
+#elif DS == 2
+#if USE_STRINGS == 1
+typedef TOpenHashtable<std::string, std::string, false, 1000000, simple_str> ds;
+#else
+typedef TOpenHashtable<int, std::string, false, 1000000, simple_str> ds;
+#endif
 #else
 typedef MassTrans<std::string> ds;
 #endif
@@ -40,7 +48,7 @@ void run(ds& h) {
             
         int key = slotdist(transgen);
         std::string value;
-#if DS == 0
+#if DS != 1
         TRANSACTION{
 #if USE_STRINGS == 1
             std::string s = std::to_string(key);
@@ -86,7 +94,7 @@ void print_time(struct timeval tv1, struct timeval tv2) {
 int main() {
     value = std::string('a', 100);
     ds h;
-#if DS != 0
+#if DS == 1
     h.thread_init();
 #endif
     
@@ -0,0 +1,155 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <random>
+#include <sys/time.h>
+#include "Transaction.hh"
+#include "TOpenHashtable.hh"
+#include "clp.h"
+
+// Multithreaded version of ht_mt: string keys and values, a NINIT-key
+// preload, then a fixed number of transactions per thread. Each transaction
+// looks up or writes OPSPERTRANS random keys from [0, 2*NINIT), so half the
+// lookups miss. The chained Hashtable no longer builds against the current
+// core; compare a presized table (--initsize=NINIT, the default) with one
+// that grows online from --initsize=1.
+
+typedef TOpenHashtable<std::string, std::string, false> ds;
+
+int nthreads = 4;
+int ntrans = 1000000;
+int ninit = 100000;
+int initsize = -1;
+int opspertrans = 1;
+double write_percent = 0;
+std::string value(100, 'a');
+
+struct Tester {
+    ds* h;
+    int me;
+    uint64_t nfound;
+};
+
+void* run(void* arg) {
+    Tester* t = (Tester*) arg;
+    TThread::set_id(t->me);
+    std::mt19937 gen(t->me);
+    std::uniform_int_distribution<long> slotdist(0, 2 * ninit - 1);
+    std::uniform_real_distribution<double> opdist(0, 1);
+    std::vector<std::pair<bool, std::string>> ops(opspertrans);
+    uint64_t nfound = 0;
+    for (int i = 0; i < ntrans; ++i) {
+        for (auto& op : ops)
+            op = std::make_pair(opdist(gen) < write_percent, std::to_string(slotdist(gen)));
+        TRANSACTION_E {
+            std::string v;
+            for (auto& op : ops)
+                if (op.first)
+                    t->h->transPut(op.second, value);
+                else
+                    nfound += t->h->transGet(op.second, v);
+        } RETRY_E(true);
+    }
+    t->nfound = nfound;
+    return nullptr;
+}
+
+void init(ds& h) {
+    for (int i = 0; i < ninit; ++i) {
+        TRANSACTION_E {
+            h.transPut(std::to_string(i), value);
+        } RETRY_E(false);
+    }
+}
+
+void print_time(struct timeval tv1, struct timeval tv2) {
+    printf("%f\n", (tv2.tv_sec-tv1.tv_sec) + (tv2.tv_usec-tv1.tv_usec)/1000000.0);
+}
+
+enum {
+    opt_nthreads = 1, opt_ntrans, opt_ninit, opt_initsize, opt_opspertrans, opt_writepercent
+};
+
+static const Clp_Option options[] = {
+    { "nthreads", 0, opt_nthreads, Clp_ValInt, Clp_Optional },
+    { "ntrans", 0, opt_ntrans, Clp_ValInt, Clp_Optional },
+    { "ninit", 0, opt_ninit, Clp_ValInt, Clp_Optional },
+    { "initsize", 0, opt_initsize, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "writepercent", 0, opt_writepercent, Clp_ValDouble, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: [OPTIONS]\n\
+           Options:\n\
+           --nthreads=NTHREADS (default %d)\n\
+           --ntrans=NTRANS, transactions per thread (default %d)\n\
+           --ninit=NINIT, keys inserted before the run (default %d)\n\
+           --initsize=INITSIZE, initial table size (default NINIT)\n\
+           --opspertrans=OPSPERTRANS, operations per transaction (default %d)\n\
+           --writepercent=WRITEPERCENT, probability of a put (default %f)\n",
+           nthreads, ntrans, ninit, opspertrans, write_percent);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+            case opt_nthreads:
+                nthreads = clp->val.i;
+                break;
+            case opt_ntrans:
+                ntrans = clp->val.i;
+                break;
+            case opt_ninit:
+                ninit = clp->val.i;
+                break;
+            case opt_initsize:
+                initsize = clp->val.i;
+                break;
+            case opt_opspertrans:
+                opspertrans = clp->val.i;
+                break;
+            case opt_writepercent:
+                write_percent = clp->val.d;
+                break;
+            default:
+                help();
+        }
+    }
+    Clp_DeleteParser(clp);
+    always_assert(nthreads > 0 && nthreads <= MAX_THREADS, "bad thread count");
+
+    pthread_t advancer;
+    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+    pthread_detach(advancer);
+
+    ds h(initsize < 0 ? ninit : initsize);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    init(h);
+    gettimeofday(&tv2, NULL);
+    printf("Init time: ");
+    print_time(tv1, tv2);
+
+    pthread_t tids[nthreads];
+    std::vector<Tester> testers(nthreads);
+    gettimeofday(&tv1, NULL);
+    for (int i = 0; i < nthreads; ++i) {
+        testers[i] = Tester{&h, i, 0};
+        pthread_create(&tids[i], NULL, run, &testers[i]);
+    }
+    for (int i = 0; i < nthreads; ++i)
+        pthread_join(tids[i], NULL);
+    gettimeofday(&tv2, NULL);
+    printf("Time taken: ");
+    print_time(tv1, tv2);
+    h.print_stats();
+#if STO_PROFILE_COUNTERS
+    Transaction::print_stats();
+#endif
+    return 0;
+}
@@ -0,0 +1,179 @@
+#include <string>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <sys/time.h>
+#include "Sto.hh"
+#include "clp.h"
+
+// Commit-time validation of large scan transactions with duplicate items.
+// Each transaction scans a table of NITEMS rows with fresh_item (as
+// ordered_index::range_scan does), updating every row, and then scans it
+// again. The rereads are duplicates of rows the transaction has locked at
+// commit, so each fails check() and is accepted only because an earlier
+// duplicate read the same row. Threads use separate tables, so every
+// transaction commits and the time measured is the transaction's own.
+
+int max_threads = 1;
+int nitems = 10000;
+int runtime = 2;
+
+volatile bool running = true;
+
+class ScanTable : public TObject {
+public:
+    typedef TVersion version_type;
+
+    explicit ScanTable(int n)
+        : rows_(n) {
+    }
+
+    // Increment every row, then sum the rows
+    long scan_update_scan() {
+        for (unsigned i = 0; i != rows_.size(); ++i) {
+            auto item = Sto::fresh_item(this, i);
+            if (!item.observe(rows_[i].vers))
+                Sto::abort();
+            item.add_write(rows_[i].value + 1);
+        }
+        long sum = 0;
+        for (unsigned i = 0; i != rows_.size(); ++i) {
+            auto item = Sto::fresh_item(this, i);
+            if (!item.observe(rows_[i].vers))
+                Sto::abort();
+            sum += rows_[i].value;
+        }
+        return sum;
+    }
+    long nontrans_sum() const {
+        long sum = 0;
+        for (auto& r : rows_)
+            sum += r.value;
+        return sum;
+    }
+
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, rows_[item.key<unsigned>()].vers);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        return rows_[item.key<unsigned>()].vers.cp_check_version(txn, item);
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        auto& r = rows_[item.key<unsigned>()];
+        r.value = item.write_value<long>();
+        txn.set_version_unlock(r.vers, item);
+    }
+    void unlock(TransItem& item) override {
+        rows_[item.key<unsigned>()].vers.cp_unlock(item);
+    }
+
+private:
+    struct row {
+        mutable version_type vers;
+        long value = 0;
+    };
+    std::vector<row> rows_;
+};
+
+struct Tester {
+    ScanTable* table;
+    int me;
+    uint64_t ncommits;
+};
+
+void* run(void* arg) {
+    Tester* t = (Tester*) arg;
+    TThread::set_id(t->me);
+    uint64_t ncommits = 0;
+    while (running) {
+        long sum = 0;
+        TRANSACTION_E {
+            sum = t->table->scan_update_scan();
+        } RETRY_E(true);
+        ++ncommits;
+        (void) sum;
+    }
+    t->ncommits = ncommits;
+    return nullptr;
+}
+
+void run_and_report(int nthreads) {
+    running = true;
+    pthread_t tids[nthreads];
+    std::vector<Tester> testers(nthreads);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    for (int i = 0; i < nthreads; ++i) {
+        testers[i] = Tester{new ScanTable(nitems), i, 0};
+        pthread_create(&tids[i], NULL, run, &testers[i]);
+    }
+    sleep(runtime);
+    running = false;
+    __sync_synchronize();
+    uint64_t ncommits = 0;
+    for (int i = 0; i < nthreads; ++i) {
+        pthread_join(tids[i], NULL);
+        ncommits += testers[i].ncommits;
+        always_assert(testers[i].table->nontrans_sum() == (long) testers[i].ncommits * nitems,
+                      "lost updates");
+        delete testers[i].table;
+    }
+    gettimeofday(&tv2, NULL);
+
+    double time = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("%d items, %d threads: %.1f txns/s, %.1f us/txn\n", nitems, nthreads,
+           ncommits / time, time * 1e6 * nthreads / ncommits);
+}
+
+enum {
+    opt_maxthreads = 1, opt_nitems, opt_runtime
+};
+
+static const Clp_Option options[] = {
+    { "maxthreads", 0, opt_maxthreads, Clp_ValInt, Clp_Optional },
+    { "nitems", 0, opt_nitems, Clp_ValInt, Clp_Optional },
+    { "runtime", 0, opt_runtime, Clp_ValInt, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: [OPTIONS]\n\
+           Runs 1, 2, 4, ... MAXTHREADS threads.\n\
+           Options:\n\
+           --maxthreads=MAXTHREADS (default %d)\n\
+           --nitems=NITEMS, rows scanned per transaction (default %d)\n\
+           --runtime=SECONDS, per thread count (default %d)\n",
+           max_threads, nitems, runtime);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+            case opt_maxthreads:
+                max_threads = clp->val.i;
+                break;
+            case opt_nitems:
+                nitems = clp->val.i;
+                break;
+            case opt_runtime:
+                runtime = clp->val.i;
+                break;
+            default:
+                help();
+        }
+    }
+    Clp_DeleteParser(clp);
+    always_assert(max_threads > 0 && max_threads <= MAX_THREADS, "bad thread count");
+    always_assert(nitems > 0, "bad item count");
+
+    pthread_t advancer;
+    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+    pthread_detach(advancer);
+
+    for (int n = 1; n <= max_threads; n *= 2)
+        run_and_report(n);
+    return 0;
+}
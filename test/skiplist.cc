@@ -0,0 +1,251 @@
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "TSkipList.hh"
+
+typedef TSkipList<int> list_type;
+
+// initialize the list: contains 1, 2, 3
+void reset_list(list_type& list) {
+    TestTransaction t(1);
+    t.use();
+    list.transInsert(1);
+    list.transInsert(2);
+    list.transInsert(3);
+    assert(t.try_commit());
+}
+
+void single_thread_tests() {
+    list_type list;
+    TestTransaction t(1);
+    // find_my_inserts
+    for (int i = 99; i >= 0; --i) {
+        assert(!list.transFind(i));
+        assert(list.transInsert(i));
+        assert(!list.transInsert(i));
+        const int* x = list.transFind(i);
+        assert(x && *x == i);
+    }
+    // delete_my_inserts and find_my_deletes
+    for (int i = 0; i < 100; i += 2) {
+        assert(list.transDelete(i));
+        assert(!list.transContains(i));
+        assert(!list.transDelete(i));
+    }
+    assert(t.try_commit());
+    assert(list.nontrans_size() == 50);
+
+    TestTransaction t2(2);
+    for (int i = 0; i < 100; ++i)
+        assert(list.transContains(i) == (i % 2 == 1));
+    // delete-insert of committed elements
+    assert(list.transDelete(1));
+    assert(!list.transContains(1));
+    assert(list.transInsert(1));
+    assert(list.transContains(1));
+    assert(list.transDelete(3));
+    assert(t2.try_commit());
+
+    TestTransaction after(3);
+    assert(list.transContains(1));
+    assert(!list.transContains(3));
+    // insert a tombstone back
+    assert(list.transInsert(3));
+    assert(after.try_commit());
+    assert(list.nontrans_size() == 50);
+    assert(list.nontrans_find(3));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void conflict_tests() {
+    {
+        // t1:insert - t2:insert - t2:commit - t1:abort
+        list_type list;
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        assert(list.transInsert(5));
+        t2.use();
+        assert(list.transInsert(5));
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+        assert(list.nontrans_size() == 1);
+    }
+    {
+        // t1:find - t2:delete - t2:commit - t1:abort
+        list_type list;
+        reset_list(list);
+        TestTransaction t1(1), t2(2), after(3);
+        t1.use();
+        assert(list.transContains(2));
+        assert(list.transInsert(50)); // prevent read-only txn
+        t2.use();
+        assert(list.transDelete(2));
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+        after.use();
+        assert(!list.transContains(2));
+        assert(!list.transContains(50));
+        assert(after.try_commit());
+    }
+    {
+        // t1:delete - t2:delete - t2:commit - t1:abort
+        list_type list;
+        reset_list(list);
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        assert(list.transDelete(1));
+        t2.use();
+        assert(list.transDelete(1));
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void phantom_tests() {
+    {
+        // absent read, then a concurrent insert into the same range
+        list_type list;
+        reset_list(list);
+        TestTransaction t1(1), t2(2), after(3);
+        t1.use();
+        assert(list.transInsert(50));
+        assert(!list.transContains(4));
+        t2.use();
+        assert(list.transInsert(5));
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+        after.use();
+        assert(!list.transContains(4));
+        assert(list.transContains(5));
+        assert(after.try_commit());
+    }
+    {
+        // inserts into other ranges do not conflict
+        list_type list;
+        reset_list(list);
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        assert(list.transInsert(50));
+        assert(!list.transContains(0));
+        t2.use();
+        assert(list.transInsert(5));
+        assert(t2.try_commit());
+        t1.use();
+        assert(t1.try_commit());
+    }
+    {
+        // absent read, then the range's lower element is deleted and the
+        // key inserted under its predecessor
+        list_type list;
+        reset_list(list);
+        TestTransaction t1(1), t2(2), t3(3);
+        t1.use();
+        assert(list.transInsert(50));
+        assert(!list.transContains(4));
+        t2.use();
+        assert(list.transDelete(3));
+        assert(t2.try_commit());
+        t3.use();
+        assert(list.transInsert(4));
+        assert(t3.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    {
+        // an absent read of a deleted element conflicts with its revival
+        list_type list;
+        reset_list(list);
+        TestTransaction t1(1), t2(2), t3(3);
+        t1.use();
+        assert(list.transDelete(2));
+        assert(t1.try_commit());
+        t2.use();
+        assert(list.transInsert(50));
+        assert(!list.transContains(2));
+        t3.use();
+        assert(list.transInsert(2));
+        assert(t3.try_commit());
+        t2.use();
+        assert(!t2.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void commit_time_insert_tests() {
+    // many inserts into one range link in order at commit
+    list_type list;
+    reset_list(list);
+    TestTransaction t1(1), t2(2), after(3);
+    t1.use();
+    for (int i = 1000; i > 3; --i)
+        assert(list.transInsert(i));
+    assert(list.transDelete(2));
+    assert(list.nontrans_size() == 3);
+    t2.use();
+    assert(list.transContains(1));
+    assert(list.transInsert(0));
+    assert(t2.try_commit());
+    t1.use();
+    assert(t1.try_commit());
+    after.use();
+    for (int i = 0; i <= 1000; ++i)
+        assert(list.transContains(i) == (i != 2));
+    assert(after.try_commit());
+    assert(list.nontrans_size() == 1000);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads move elements between a left and right half; each element is in
+// exactly one half, so the number of elements is invariant.
+void concurrent_tests() {
+    static constexpr int nthreads = 4;
+    static constexpr int nkeys = 256;
+    list_type list;
+    for (int i = 0; i < nkeys; ++i)
+        list.nontrans_insert(2 * i + (i % 2));
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < nthreads; ++id) {
+        threads.emplace_back([&list, id]() {
+            TThread::set_id(id);
+            std::mt19937 gen(id);
+            for (int n = 0; n < 20000; ++n) {
+                int k = gen() % nkeys;
+                TRANSACTION_E {
+                    if (list.transDelete(2 * k))
+                        list.transInsert(2 * k + 1);
+                    else if (list.transDelete(2 * k + 1))
+                        list.transInsert(2 * k);
+                } RETRY_E(true);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    TThread::set_id(0);
+    TestTransaction t(1);
+    for (int k = 0; k < nkeys; ++k)
+        assert(list.transContains(2 * k) != list.transContains(2 * k + 1));
+    assert(t.try_commit());
+    assert(list.nontrans_size() == nkeys);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::txn = nullptr;
+    TThread::set_id(0);
+    single_thread_tests();
+    conflict_tests();
+    phantom_tests();
+    commit_time_insert_tests();
+    concurrent_tests();
+    std::cout << "ALL TESTS PASS!!" << std::endl;
+    return 0;
+}
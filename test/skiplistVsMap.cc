@@ -0,0 +1,231 @@
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <vector>
+#include <random>
+#include <unistd.h>
+#include <sys/time.h>
+#include "Transaction.hh"
+#include "TSkipList.hh"
+#include "SkipMap.hh"
+#include "clp.h"
+
+// Mixed insert/lookup/erase throughput of the ordered containers. List and
+// RBTree still use the pre-TransProxy interface and do not build against the
+// current core, so the commit-time skiplist set is compared with SkipMap,
+// which links inserts at execution time.
+
+int nthreads = 4;
+int opspertrans = 4;
+int max_value = 100000;
+int prepopulate = 50000;
+double insert_percent = 0.25;
+double erase_percent = 0.25;
+int runtime = 5;
+int global_seed = 0;
+
+volatile bool running = true;
+
+struct SkipListSet {
+    static constexpr const char* name = "skiplist";
+    TSkipList<int> s;
+
+    void nontrans_insert(int k) {
+        s.nontrans_insert(k);
+    }
+    void insert(int k) {
+        s.transInsert(k);
+    }
+    bool find(int k) {
+        return s.transContains(k);
+    }
+    void erase(int k) {
+        s.transDelete(k);
+    }
+};
+
+struct SkipMapSet {
+    static constexpr const char* name = "skipmap";
+    SkipMap<int, int> s;
+
+    void nontrans_insert(int k) {
+        s.nontrans_insert(k, 0);
+    }
+    void insert(int k) {
+        s.insert(k, 0);
+    }
+    bool find(int k) {
+        return s.count(k);
+    }
+    void erase(int k) {
+        s.erase(k);
+    }
+};
+
+template <typename T>
+struct Tester {
+    T* set;
+    int me;
+    uint64_t ntrans;
+    uint64_t nfound;
+};
+
+template <typename T>
+void* run(void* arg) {
+    Tester<T>* t = (Tester<T>*) arg;
+    TThread::set_id(t->me);
+    std::mt19937 gen(global_seed * 131 + t->me);
+    std::uniform_int_distribution<int> keydist(0, max_value - 1);
+    std::uniform_real_distribution<double> opdist(0, 1);
+    uint64_t ntrans = 0, nfound = 0;
+    std::vector<std::pair<double, int>> ops(opspertrans);
+    while (running) {
+        for (auto& op : ops)
+            op = std::make_pair(opdist(gen), keydist(gen));
+        TRANSACTION_E {
+            for (auto& op : ops) {
+                if (op.first < insert_percent)
+                    t->set->insert(op.second);
+                else if (op.first < insert_percent + erase_percent)
+                    t->set->erase(op.second);
+                else
+                    nfound += t->set->find(op.second);
+            }
+        } RETRY_E(true);
+        ++ntrans;
+    }
+    t->ntrans = ntrans;
+    t->nfound = nfound;
+    return nullptr;
+}
+
+template <typename T>
+void run_and_report() {
+    T* set = new T;
+    std::mt19937 gen(global_seed);
+    std::uniform_int_distribution<int> keydist(0, max_value - 1);
+    for (int i = 0; i < prepopulate; ++i)
+        set->nontrans_insert(keydist(gen));
+
+    running = true;
+    pthread_t tids[nthreads];
+    std::vector<Tester<T>> testers(nthreads);
+    struct timeval tv1, tv2;
+    gettimeofday(&tv1, NULL);
+    for (int i = 0; i < nthreads; ++i) {
+        testers[i] = Tester<T>{set, i, 0, 0};
+        pthread_create(&tids[i], NULL, run<T>, &testers[i]);
+    }
+    sleep(runtime);
+    running = false;
+    __sync_synchronize();
+    uint64_t ntrans = 0;
+    for (int i = 0; i < nthreads; ++i) {
+        pthread_join(tids[i], NULL);
+        ntrans += testers[i].ntrans;
+    }
+    gettimeofday(&tv2, NULL);
+
+    double time = tv2.tv_sec - tv1.tv_sec + (tv2.tv_usec - tv1.tv_usec) / 1000000.0;
+    printf("%s: %llu txns/s\n", T::name, (unsigned long long) (ntrans / time));
+#if STO_PROFILE_COUNTERS
+    Transaction::print_stats();
+    {
+        txp_counters tc = Transaction::txp_counters_combined();
+        printf("total_n: %llu, total_r: %llu, total_w: %llu, total_aborts: %llu (%llu aborts at commit time)\n", tc.p(txp_total_n), tc.p(txp_total_r), tc.p(txp_total_w), tc.p(txp_total_aborts), tc.p(txp_commit_time_aborts));
+    }
+    Transaction::clear_stats();
+#endif
+}
+
+enum {
+    opt_nthreads = 1, opt_opspertrans, opt_maxvalue, opt_prepopulate, opt_insertpercent,
+    opt_erasepercent, opt_runtime, opt_seed
+};
+
+static const Clp_Option options[] = {
+    { "nthreads", 0, opt_nthreads, Clp_ValInt, Clp_Optional },
+    { "opspertrans", 0, opt_opspertrans, Clp_ValInt, Clp_Optional },
+    { "maxvalue", 0, opt_maxvalue, Clp_ValInt, Clp_Optional },
+    { "prepopulate", 0, opt_prepopulate, Clp_ValInt, Clp_Optional },
+    { "insertpercent", 0, opt_insertpercent, Clp_ValDouble, Clp_Optional },
+    { "erasepercent", 0, opt_erasepercent, Clp_ValDouble, Clp_Optional },
+    { "runtime", 0, opt_runtime, Clp_ValInt, Clp_Optional },
+    { "seed", 0, opt_seed, Clp_ValInt, Clp_Optional }
+};
+
+static void help() {
+    printf("Usage: [OPTIONS] [skiplist|skipmap]...\n\
+           Options:\n\
+           --nthreads=NTHREADS (default %d)\n\
+           --opspertrans=OPSPERTRANS, operations per transaction (default %d)\n\
+           --maxvalue=MAXVALUE, keys are drawn from [0, MAXVALUE) (default %d)\n\
+           --prepopulate=PREPOPULATE, number of keys inserted up front (default %d)\n\
+           --insertpercent=INSERTPERCENT, probability of an insert (default %f)\n\
+           --erasepercent=ERASEPERCENT, probability of an erase (default %f)\n\
+           --runtime=SECONDS (default %d)\n\
+           --seed=SEED, global seed to run the experiment\n",
+           nthreads, opspertrans, max_value, prepopulate, insert_percent, erase_percent, runtime);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
+    std::vector<std::string> tests;
+
+    int opt;
+    while ((opt = Clp_Next(clp)) != Clp_Done) {
+        switch (opt) {
+            case opt_nthreads:
+                nthreads = clp->val.i;
+                break;
+            case opt_opspertrans:
+                opspertrans = clp->val.i;
+                break;
+            case opt_maxvalue:
+                max_value = clp->val.i;
+                break;
+            case opt_prepopulate:
+                prepopulate = clp->val.i;
+                break;
+            case opt_insertpercent:
+                insert_percent = clp->val.d;
+                break;
+            case opt_erasepercent:
+                erase_percent = clp->val.d;
+                break;
+            case opt_runtime:
+                runtime = clp->val.i;
+                break;
+            case opt_seed:
+                global_seed = clp->val.i;
+                break;
+            case Clp_NotOption:
+                tests.push_back(clp->vstr);
+                break;
+            default:
+                help();
+        }
+    }
+    Clp_DeleteParser(clp);
+    always_assert(nthreads > 0 && nthreads <= MAX_THREADS, "bad thread count");
+
+    if (tests.empty()) {
+        tests.push_back("skiplist");
+        tests.push_back("skipmap");
+    }
+
+    pthread_t advancer;
+    pthread_create(&advancer, NULL, Transaction::epoch_advancer, NULL);
+    pthread_detach(advancer);
+
+    for (auto& test : tests) {
+        if (test == "skiplist")
+            run_and_report<SkipListSet>();
+        else if (test == "skipmap")
+            run_and_report<SkipMapSet>();
+        else
+            help();
+    }
+    return 0;
+}
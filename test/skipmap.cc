@@ -0,0 +1,325 @@
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+#include "SkipMap.hh"
+
+typedef SkipMap<int, int, true> map_type;
+
+// initialize the map: contains (1,1), (2,2), (3,3)
+void reset_map(map_type& map) {
+    TestTransaction t(1);
+    t.use();
+    map[1] = 1;
+    map[2] = 2;
+    map[3] = 3;
+    assert(t.try_commit());
+}
+
+void single_thread_tests() {
+    map_type map;
+    TestTransaction t(1);
+    // read_my_inserts
+    assert(map.size() == 0);
+    for (int i = 0; i < 100; ++i) {
+        map[i] = i;
+        assert(map[i] == i);
+        map[i] = 100 - i;
+        assert(map[i] == 100 - i);
+    }
+    assert(map.size() == 100);
+    // count_my_inserts
+    for (int i = 0; i < 100; ++i)
+        assert(map.count(i) == 1);
+    // delete_my_inserts and read_my_deletes
+    for (int i = 0; i < 100; ++i) {
+        assert(map.erase(i) == 1);
+        assert(map.count(i) == 0);
+    }
+    assert(map.size() == 0);
+    // delete_my_deletes
+    for (int i = 0; i < 100; ++i)
+        assert(map.erase(i) == 0);
+    // insert_my_deletes
+    for (int i = 0; i < 100; ++i) {
+        assert(map.insert(i, 1));
+        assert(!map.insert(i, 2));
+        assert(map.count(i) == 1);
+    }
+    assert(map.size() == 100);
+    // operator[] inserts empty value
+    int x = map[102];
+    assert(x == 0);
+    assert(map.count(102) == 1);
+    assert(map.size() == 101);
+    assert(t.try_commit());
+
+    TestTransaction after(2);
+    int v;
+    for (int i = 0; i < 100; ++i)
+        assert(map.find(i, v) && v == 1);
+    assert(map.find(102, v) && v == 0);
+    assert(!map.find(101, v));
+    assert(after.try_commit());
+    assert(map.nontrans_size() == 101);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void update_conflict_tests() {
+    {
+        map_type map;
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        map[55] = 56;
+        map[57] = 58;
+        t2.use();
+        int x = map[58];
+        assert(x == 0);
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    {
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        int x = map[2];
+        map[3] = x;
+        t2.use();
+        map[2] = 22;
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void erase_conflict_tests() {
+    {
+        // t1:count - t1:erase - t2:count - t1:commit - t2:abort
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), t2(2), after(3);
+        t1.use();
+        assert(map.count(1) == 1);
+        assert(map.erase(1) == 1);
+        t2.use();
+        map[50] = 50; // prevent read-only txn
+        assert(map.count(1) == 1);
+        assert(t1.try_commit());
+        assert(!t2.try_commit());
+        after.use();
+        assert(map.count(1) == 0);
+        assert(after.try_commit());
+    }
+    {
+        // t1:count - t1:erase - t1:count - t2:erase - t2:commit - t1:abort
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), t2(2), after(3);
+        t1.use();
+        assert(map.count(1) == 1);
+        assert(map.erase(1) == 1);
+        assert(map.count(1) == 0);
+        t2.use();
+        assert(map.erase(1) == 1);
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+        after.use();
+        assert(map.count(1) == 0);
+        assert(after.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void phantom_tests() {
+    {
+        // absent read, then a concurrent insert into the same gap
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), t2(2), after(3);
+        t1.use();
+        map[50] = 50;
+        assert(map.count(4) == 0);
+        t2.use();
+        map[5] = 5;
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+        after.use();
+        assert(map.count(4) == 0);
+        assert(map[5] == 5);
+        assert(after.try_commit());
+    }
+    {
+        // inserts into other gaps do not conflict
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        map[50] = 50;
+        assert(map.count(0) == 0);
+        t2.use();
+        map[5] = 5;
+        assert(t2.try_commit());
+        t1.use();
+        assert(t1.try_commit());
+    }
+    {
+        // absent read, then the gap's lower node is erased and the key
+        // inserted under its predecessor
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), t2(2), t3(3);
+        t1.use();
+        map[50] = 50;
+        assert(map.count(4) == 0);
+        t2.use();
+        assert(map.erase(3) == 1);
+        assert(t2.try_commit());
+        t3.use();
+        map[4] = 4;
+        assert(t3.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void insert_then_delete_tests() {
+    {
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), after(2);
+        t1.use();
+        map[5] = 5;
+        map[4] = 4;
+        assert(map.count(4) == 1);
+        // insert-then-delete
+        assert(map.erase(4) == 1);
+        assert(map.count(4) == 0);
+        assert(map.erase(4) == 0);
+        // insert-delete-insert
+        map[4] = 44;
+        assert(map[4] == 44);
+        assert(map.count(4) == 1);
+        assert(t1.try_commit());
+        after.use();
+        assert(map[4] == 44);
+        for (int i = 1; i <= 5; ++i) {
+            if (i != 4)
+                assert(map[i] == i);
+        }
+        assert(after.try_commit());
+    }
+    {
+        // absent reads around our own inserts and erases
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), after(2);
+        t1.use();
+        assert(map.count(4) == 0);
+        map[5] = 5;
+        assert(map.count(4) == 0);
+        assert(map.count(6) == 0);
+        assert(map.erase(5) == 1);
+        assert(map.count(6) == 0);
+        map[4] = 4;
+        assert(map.count(4) == 1);
+        assert(t1.try_commit());
+        after.use();
+        for (int i = 1; i <= 4; ++i)
+            assert(map[i] == i);
+        assert(map.count(5) == 0);
+        assert(after.try_commit());
+    }
+    {
+        map_type map;
+        reset_map(map);
+        TestTransaction t1(1), t2(2), t3(3), after(4);
+        t1.use();
+        map[3] = 13;
+        t2.use();
+        assert(map.erase(3) == 1);
+        assert(t2.try_commit());
+        t3.use();
+        assert(map.count(3) == 0);
+        map[3] = 33;
+        assert(t3.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+        after.use();
+        assert(map[3] == 33);
+        assert(after.try_commit());
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Threads move units between random keys; the total is invariant and the
+// transactional size must match the structure.
+void concurrent_tests() {
+    static constexpr int nthreads = 4;
+    static constexpr int nkeys = 256;
+    map_type map;
+    for (int i = 0; i < nkeys; i += 2)
+        map.nontrans_insert(i, 1);
+
+    std::vector<std::thread> threads;
+    for (int id = 0; id < nthreads; ++id) {
+        threads.emplace_back([&map, id]() {
+            TThread::set_id(id);
+            std::mt19937 gen(id);
+            for (int n = 0; n < 20000; ++n) {
+                int a = gen() % nkeys, b = gen() % nkeys;
+                if (a == b)
+                    continue;
+                TRANSACTION_E {
+                    int va = 0, vb = 0;
+                    bool ha = map.find(a, va), hb = map.find(b, vb);
+                    if (ha) {
+                        if (va > 1)
+                            map[a] = va - 1;
+                        else
+                            map.erase(a);
+                        if (hb)
+                            map[b] = vb + 1;
+                        else
+                            map.insert(b, 1);
+                    }
+                } RETRY_E(true);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    TThread::set_id(0);
+    int sum = 0;
+    size_t present = 0;
+    for (int i = 0; i < nkeys; ++i) {
+        int v;
+        if (map.nontrans_find(i, v)) {
+            sum += v;
+            ++present;
+        }
+    }
+    assert(sum == nkeys / 2);
+    assert(present == map.nontrans_size());
+    TestTransaction t(1);
+    assert(map.size() == present);
+    assert(t.try_commit());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::txn = nullptr;
+    TThread::set_id(0);
+    single_thread_tests();
+    update_conflict_tests();
+    erase_conflict_tests();
+    phantom_tests();
+    insert_then_delete_tests();
+    concurrent_tests();
+    std::cout << "ALL TESTS PASS!!" << std::endl;
+    return 0;
+}
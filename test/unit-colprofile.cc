@@ -0,0 +1,143 @@
+#undef NDEBUG
+#define BENCH_PROFILE_COLUMNS 1
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "DB_colprofile.hh"
+#include "codegen/profile.hpp"
+
+using bench::column_profile;
+
+// Six columns in two cells: {a} and {b, c, d, e, f}
+struct wide_row {
+    enum class NamedColumn : int { a = 0, b, c, d, e, f, COLCOUNT };
+};
+struct wide_container {
+    static int map(int col_n) {
+        return col_n == 0 ? 0 : 1;
+    }
+};
+
+// No COLCOUNT: the columns accessed so far stand in for the row
+struct narrow_row {
+    enum class NamedColumn : int { x = 0, y };
+};
+struct narrow_container {
+    static int map(int) {
+        return 0;
+    }
+};
+
+struct col_access {
+    int col_id;
+    uint8_t access;  // 1: read, 2: write, 3: update
+};
+
+static std::string temp_file(const char* tag) {
+    return std::string("/tmp/unit-colprofile-") + tag + "-" + std::to_string(getpid());
+}
+
+static std::string read_file(const std::string& fn) {
+    std::ifstream in(fn);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static std::vector<std::vector<int>> load_and_group(const std::string& fn, const char* table,
+                                                    int ncols, double weight) {
+    std::map<std::string, ColumnProfile> profiles;
+    assert(load_profile(fn.c_str(), profiles));
+    assert(profiles.count(table));
+    return group_columns(ncols, profiles[table], weight);
+}
+
+void testDump() {
+    std::string fn = temp_file("dump");
+
+    // thread 1 reads a and writes b
+    TThread::set_id(1);
+    for (int i = 0; i != 3; ++i)
+        column_profile<wide_row>::access(std::vector<col_access>{{0, 1}, {1, 2}});
+    column_profile<wide_row>::conflict<wide_container>(0);
+    column_profile<narrow_row>::access(std::vector<col_access>{{0, 1}, {1, 1}});
+
+    // thread 2 only ever touched column a, but a conflict on cell 1 is still
+    // charged to all of b..f
+    TThread::set_id(2);
+    column_profile<wide_row>::access(std::vector<col_access>{{0, 1}});
+    column_profile<wide_row>::conflict<wide_container>(1);
+    column_profile<wide_row>::conflict<wide_container>(1);
+    column_profile<narrow_row>::conflict<narrow_container>(0);
+    TThread::set_id(0);
+
+    assert(bench::column_profile_base::dump(fn.c_str()));
+    assert(read_file(fn) ==
+           "table wide_row 6 4\n"
+           "col 0 4 0 1\n"
+           "col 1 0 3 2\n"
+           "col 2 0 0 2\n"
+           "col 3 0 0 2\n"
+           "col 4 0 0 2\n"
+           "col 5 0 0 2\n"
+           "pair 0 1 3\n"
+           "end\n"
+           "table narrow_row 2 1\n"
+           "col 0 1 0 1\n"
+           "col 1 1 0 1\n"
+           "pair 0 1 1\n"
+           "end\n");
+
+    // the dump reads back; a and b are co-accessed, but b's writes would
+    // invalidate a's reads, so b keeps its own cell
+    auto groups = load_and_group(fn, "wide_row", 6, 1.0);
+    assert((groups == std::vector<std::vector<int>>{{1}, {0, 2, 3, 4, 5}}));
+    unlink(fn.c_str());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testGrouping() {
+    std::string fn = temp_file("groups");
+    {
+        std::ofstream out(fn);
+        // column 0 is a hot counter, 1 and 2 are always read together, and
+        // 3 is never accessed
+        out << "table counter_row 4 1000\n"
+            << "col 0 0 1000 50\n"
+            << "col 1 1000 0 0\n"
+            << "col 2 1000 0 0\n"
+            << "col 3 0 0 0\n"
+            << "pair 0 1 100\n"
+            << "pair 1 2 1000\n"
+            << "end\n";
+    }
+    auto groups = load_and_group(fn, "counter_row", 4, 1.0);
+    assert((groups == std::vector<std::vector<int>>{{0, 3}, {1, 2}}));
+
+    // without a false conflict cost every co-access is worth merging
+    groups = load_and_group(fn, "counter_row", 4, 0.0);
+    assert((groups == std::vector<std::vector<int>>{{0, 1, 2, 3}}));
+
+    // a column outside the table is rejected
+    {
+        std::ofstream out(fn);
+        out << "table bad_row 2 10\n"
+            << "col 2 1 1 0\n"
+            << "end\n";
+    }
+    std::map<std::string, ColumnProfile> profiles;
+    assert(!load_profile(fn.c_str(), profiles));
+    unlink(fn.c_str());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testDump();
+    testGrouping();
+    printf("Test pass\n");
+    return 0;
+}
@@ -0,0 +1,200 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <random>
+#include <vector>
+#include "Sto.hh"
+#include "Commutators.hh"
+#include "TMvBox.hh"
+
+using namespace commutators;
+
+// Applying @ops one at a time must match applying them coalesced into one
+template <typename V, typename Op>
+void check_coalesced(V v, const std::vector<Op>& ops, bool (*eq)(const V&, const V&)) {
+    V separate = v;
+    for (auto& op : ops)
+        op.operate(separate);
+    Op merged = ops[0];
+    for (size_t i = 1; i != ops.size(); ++i) {
+        bool ok = coalesce(merged, ops[i]);
+        assert(ok);
+    }
+    merged.operate(v);
+    assert(eq(v, separate));
+}
+
+bool eq_int(const int64_t& a, const int64_t& b) {
+    return a == b;
+}
+
+void testScalarOps() {
+    std::mt19937 rng(1);
+    for (int round = 0; round != 200; ++round) {
+        int64_t v = int64_t(rng() % 2000) - 1000;
+        std::vector<add<int64_t>> adds;
+        std::vector<min<int64_t>> mins;
+        std::vector<max<int64_t>> maxs;
+        std::vector<bit_or<int64_t>> ors;
+        std::vector<bit_and<int64_t>> ands;
+        std::vector<bounded_counter<int64_t>> bcs;
+        for (int i = 0; i != 1 + round % 7; ++i) {
+            int64_t x = int64_t(rng() % 2000) - 1000;
+            adds.push_back(i % 2 ? add<int64_t>(x) : sub<int64_t>(x));
+            mins.emplace_back(x);
+            maxs.emplace_back(x);
+            ors.emplace_back(x & 0xff);
+            ands.emplace_back(x | ~int64_t(0xff));
+            int64_t lo = int64_t(rng() % 200) - 100;
+            bcs.emplace_back(x / 8, lo, lo + int64_t(rng() % 300));
+        }
+        check_coalesced(v, adds, eq_int);
+        check_coalesced(v, mins, eq_int);
+        check_coalesced(v, maxs, eq_int);
+        check_coalesced(v, ors, eq_int);
+        check_coalesced(v, ands, eq_int);
+        check_coalesced(v, bcs, eq_int);
+    }
+
+    int64_t v = 5;
+    bounded_counter<int64_t>(-10, 0, 100).operate(v);
+    assert(v == 0);
+    bounded_counter<int64_t>(150, 0, 100).operate(v);
+    assert(v == 100);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+typedef bounded_list<int, 4> list_type;
+typedef bounded_set<int, 4> set_type;
+
+bool eq_list(const list_type& a, const list_type& b) {
+    if (a.size() != b.size())
+        return false;
+    for (unsigned i = 0; i != a.size(); ++i)
+        if (a[i] != b[i])
+            return false;
+    return true;
+}
+
+bool eq_set(const set_type& a, const set_type& b) {
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin());
+}
+
+void testContainerOps() {
+    list_type l;
+    for (int i = 0; i != 6; ++i)
+        bounded_list_append<int, 4>(i).operate(l);
+    assert(l.size() == 4 && l[0] == 2 && l[3] == 5);
+
+    set_type s;
+    for (int x : {7, 3, 9, 3, 1, 8, 2})
+        set_insert<int, 4>(x).operate(s);
+    assert(s.size() == 4);
+    assert(s.contains(1) && s.contains(2) && s.contains(3) && s.contains(7));
+    assert(!s.contains(8) && !s.contains(9));
+
+    std::mt19937 rng(2);
+    for (int round = 0; round != 100; ++round) {
+        std::vector<bounded_list_append<int, 4>> appends;
+        std::vector<set_insert<int, 4>> inserts;
+        for (int i = 0; i != 1 + round % 9; ++i) {
+            appends.emplace_back(int(rng() % 100));
+            inserts.emplace_back(int(rng() % 20));
+        }
+        list_type l0;
+        l0.push_back(-1);
+        check_coalesced(l0, appends, eq_list);
+        set_type s0;
+        s0.insert(10);
+        check_coalesced(s0, inserts, eq_set);
+        // inserts commute
+        set_type a = s0, b = s0;
+        for (auto& op : inserts)
+            op.operate(a);
+        for (auto it = inserts.rbegin(); it != inserts.rend(); ++it)
+            it->operate(b);
+        assert(eq_set(a, b));
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+struct account {
+    int64_t balance;
+    int64_t low_water;
+};
+
+namespace commutators {
+template <>
+class Commutator<account>
+    : public on_field<account, int64_t, &account::low_water, min<int64_t>> {
+public:
+    Commutator() = default;
+    explicit Commutator(int64_t x) : on_field(min<int64_t>(x)) {}
+};
+}
+
+void testOnField() {
+    static_assert(can_coalesce<Commutator<account>>::value, "row commutator coalesces");
+    static_assert(can_coalesce<Commutator<int64_t>>::value, "int64_t commutator coalesces");
+    static_assert(!can_coalesce<Commutator<std::string>>::value, "default commutator does not");
+
+    account a{100, 50};
+    Commutator<account> c(70);
+    assert(coalesce(c, Commutator<account>(20)));
+    c.operate(a);
+    assert(a.balance == 100 && a.low_water == 20);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPendingCoalesce() {
+    TMvCommuteIntegerBox box;
+    box = 10;
+    {
+        TransactionGuard t;
+        box.increment(5);
+        box.increment(-2);
+        box.increment(7);
+    }
+    {
+        TransactionGuard t;
+        int64_t v = box;
+        assert(v == 20);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testFlattenChain() {
+    TMvCommuteIntegerBox box;
+    box = 0;
+    int64_t expected = 0;
+    for (int i = 1; i != 100; ++i) {
+        {
+            TransactionGuard t;
+            box.increment(i);
+        }
+        expected += i;
+        if (i % 17 == 0) {
+            TransactionGuard t;
+            int64_t v = box;
+            assert(v == expected);
+        }
+    }
+    {
+        TransactionGuard t;
+        int64_t v = box;
+        assert(v == expected);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testScalarOps();
+    testContainerOps();
+    testOnField();
+    testPendingCoalesce();
+    testFlattenChain();
+    printf("Test pass\n");
+    return 0;
+}
@@ -0,0 +1,215 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "DB_ccpolicy.hh"
+
+using bench::cc_policy;
+typedef cc_policy::mode_id mode_id;
+
+// Integer rows, selected and validated the way a bench index does it
+class row_table : public TObject {
+public:
+    typedef TLockVersion<true> version_type;
+
+    explicit row_table(size_t n) : rows_(n) {}
+
+    bool select(size_t i, int64_t& v) {
+        auto item = Sto::item(this, i);
+        policy.before_access(item, rows_[i].vers, false);
+        if (!item.observe(rows_[i].vers)) {
+            policy.conflict();
+            return false;
+        }
+        v = item.has_write() ? item.write_value<int64_t>() : rows_[i].v;
+        return true;
+    }
+    bool update(size_t i, int64_t v) {
+        auto item = Sto::item(this, i);
+        policy.before_access(item, rows_[i].vers, true);
+        if (!item.acquire_write(rows_[i].vers, v)) {
+            policy.conflict();
+            return false;
+        }
+        return true;
+    }
+    // Number of read locks held on row @i
+    uint64_t readers(size_t i) const {
+        return rows_[i].vers.value() & TransactionTid::threadid_mask;
+    }
+
+    bool lock(TransItem& item, Transaction& txn) override {
+        return txn.try_lock(item, rows_[item.key<size_t>()].vers);
+    }
+    bool check(TransItem& item, Transaction& txn) override {
+        bool ok = rows_[item.key<size_t>()].vers.cp_check_version(txn, item);
+        if (!ok)
+            policy.conflict();
+        return ok;
+    }
+    void install(TransItem& item, Transaction& txn) override {
+        auto& r = rows_[item.key<size_t>()];
+        r.v = item.write_value<int64_t>();
+        txn.set_version_unlock(r.vers, item);
+    }
+    void unlock(TransItem& item) override {
+        rows_[item.key<size_t>()].vers.cp_unlock(item);
+    }
+
+    cc_policy policy;
+
+private:
+    struct row {
+        version_type vers;
+        int64_t v;
+
+        row() : vers(Sto::initialized_tid()), v(0) {}
+    };
+    std::vector<row> rows_;
+};
+
+void testReadModes() {
+    row_table t(4);
+    int64_t v;
+    t.policy.set_mode(mode_id::OCC);
+    {
+        TransactionGuard g;
+        assert(t.select(0, v));
+        assert(t.readers(0) == 0);
+    }
+    t.policy.set_mode(mode_id::TwoPL);
+    {
+        TransactionGuard g;
+        assert(t.select(0, v));
+        assert(t.readers(0) == 1);
+        // the read lock upgrades to the write lock
+        assert(t.update(0, 5));
+    }
+    assert(t.readers(0) == 0);
+    {
+        TransactionGuard g;
+        assert(t.select(0, v) && v == 5);
+    }
+    assert(t.readers(0) == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSwitchMidTransaction() {
+    row_table t(4);
+    int64_t v;
+    t.policy.set_mode(mode_id::OCC);
+    {
+        TransactionGuard g;
+        assert(t.select(0, v));
+        t.policy.set_mode(mode_id::TwoPL);
+        // row 0 keeps the mode this transaction first read it with
+        assert(t.select(0, v));
+        assert(t.readers(0) == 0);
+        assert(t.select(1, v));
+        assert(t.readers(1) == 1);
+        assert(t.update(2, 7));
+    }
+    assert(t.readers(0) == 0 && t.readers(1) == 0);
+
+    // an optimistic reader still sees a locked reader's commit
+    t.policy.set_mode(mode_id::OCC);
+    TestTransaction t1(0);
+    assert(t.select(3, v));
+    t.policy.set_mode(mode_id::TwoPL);
+    TestTransaction t2(1);
+    assert(t.select(3, v));
+    assert(t.update(3, 9));
+    assert(t2.try_commit());
+    t1.use();
+    assert(!t1.try_commit());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPolicySwitches() {
+    cc_policy::config saved = cc_policy::defaults();
+    cc_policy::defaults() = {1024, 0.01, 0.1, mode_id::OCC};
+    row_table t(64);
+    int64_t v;
+
+    // a writer holds row 0 while thread 0 keeps selecting it
+    TestTransaction holder(1);
+    assert(t.update(0, 1));
+    for (int i = 0; i != 8192; ++i) {
+        TestTransaction reader(0);
+        t.select(0, v);
+        t.select(1 + i % 8, v);
+        Sto::silent_abort();
+    }
+    TestTransaction::hard_reset();
+    assert(t.policy.mode() == mode_id::TwoPL);
+
+    holder.use();
+    Sto::silent_abort();
+    TestTransaction::hard_reset();
+    TThread::set_id(0);
+    for (int i = 0; i != 8192; ++i) {
+        TransactionGuard g;
+        t.select(i % 64, v);
+    }
+    assert(t.policy.mode() == mode_id::OCC);
+
+    std::stringstream ss;
+    t.policy.print_stats(ss, "rows");
+    assert(ss.str().find("4 switches") != std::string::npos);
+    cc_policy::defaults() = saved;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConcurrentSwitching() {
+    cc_policy::config saved = cc_policy::defaults();
+    cc_policy::defaults() = {512, 0.01, 0.05, mode_id::OCC};
+    row_table t(8);
+    constexpr int nthreads = 4, ntxns = 4000;
+    std::vector<std::thread> thrs;
+    for (int id = 0; id != nthreads; ++id)
+        thrs.emplace_back([&t, id] () {
+            TThread::set_id(id);
+            for (int i = 0; i != ntxns; ++i) {
+                // flip the table's mode under running transactions
+                if (i % 97 == 0)
+                    t.policy.set_mode(static_cast<mode_id>((i / 97 + id) % 3));
+                TRANSACTION {
+                    int64_t a, b;
+                    TXN_DO(t.select(i % 8, a));
+                    TXN_DO(t.select((i + 1) % 8, b));
+                    TXN_DO(t.update(i % 8, a + 1));
+                    (void) b;
+                } RETRY(true);
+            }
+        });
+    for (auto& th : thrs)
+        th.join();
+
+    int64_t sum = 0, v;
+    {
+        TransactionGuard g;
+        for (int i = 0; i != 8; ++i) {
+            assert(t.select(i, v));
+            sum += v;
+        }
+    }
+    assert(sum == nthreads * ntxns);
+    for (int i = 0; i != 8; ++i)
+        assert(t.readers(i) == 0);
+    cc_policy::defaults() = saved;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testReadModes();
+    testSwitchMidTransaction();
+    testPolicySwitches();
+    testConcurrentSwitching();
+    printf("Test pass\n");
+    return 0;
+}
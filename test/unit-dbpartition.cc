@@ -0,0 +1,119 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <cstring>
+#include <map>
+#include <thread>
+#include <vector>
+#include "DB_partition.hh"
+
+// Just the nontrans_ methods of a bench index
+struct row_type {
+    int64_t balance;
+    char name[12];
+};
+
+class map_index {
+public:
+    typedef uint64_t key_type;
+    typedef row_type value_type;
+
+    value_type* nontrans_get(const key_type& k) {
+        auto it = rows_.find(k);
+        return it == rows_.end() ? nullptr : &it->second;
+    }
+    void nontrans_put(const key_type& k, const value_type& v) {
+        rows_[k] = v;
+    }
+    bool nontrans_remove(const key_type& k) {
+        return rows_.erase(k) != 0;
+    }
+    size_t size() const {
+        return rows_.size();
+    }
+
+private:
+    std::map<key_type, value_type> rows_;
+};
+
+void testRollback() {
+    map_index t;
+    t.nontrans_put(1, {100, "one"});
+    t.nontrans_put(2, {200, "two"});
+
+    bench::db_undo_log undo;
+    undo.update(t, 1)->balance += 5;
+    undo.update(t, 1)->balance += 5;
+    undo.insert(t, 3, {300, "three"});
+    auto r = undo.update(t, 3);
+    r->balance = 0;
+    strcpy(r->name, "changed");
+    assert(undo.update(t, 4) == nullptr);
+    assert(t.nontrans_get(1)->balance == 110);
+    undo.rollback();
+    assert(undo.empty());
+    assert(t.size() == 2);
+    assert(t.nontrans_get(1)->balance == 100);
+    assert(strcmp(t.nontrans_get(1)->name, "one") == 0);
+    assert(t.nontrans_get(2)->balance == 200);
+
+    undo.update(t, 2)->balance = 1;
+    undo.insert(t, 5, {500, "five"});
+    undo.commit();
+    undo.rollback();
+    assert(t.size() == 3);
+    assert(t.nontrans_get(2)->balance == 1);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testLocks() {
+    const int nthreads = 4;
+    const int niters = 20000;
+    const unsigned nparts = 4;
+    bench::db_partition_locks locks(nparts);
+    std::vector<int64_t> counts(nparts, 0);
+    std::vector<int64_t> expected(nthreads, 0);
+
+    // each thread bumps the counts of two partitions, locked together
+    std::vector<std::thread> thrs;
+    for (int i = 0; i != nthreads; ++i)
+        thrs.emplace_back([&, i] () {
+            for (int n = 0; n != niters; ++n) {
+                unsigned a = (i + n) % nparts, b = (i * 3 + n * 7) % nparts;
+                bench::db_partition_locks::set ps;
+                ps.add(b);
+                ps.add(a);
+                locks.lock(ps);
+                ++counts[a];
+                if (b != a)
+                    ++counts[b];
+                locks.unlock(ps);
+                expected[i] += (b != a) ? 2 : 1;
+            }
+        });
+    for (auto& t : thrs)
+        t.join();
+
+    int64_t sum = 0, expected_sum = 0;
+    for (auto c : counts)
+        sum += c;
+    for (auto e : expected)
+        expected_sum += e;
+    assert(sum == expected_sum);
+
+    bench::db_partition_locks::set ps;
+    ps.add(2);
+    ps.add(3);
+    ps.add(2);
+    assert(ps.within(2, 3));
+    assert(!ps.within(1, 2));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testRollback();
+    testLocks();
+    printf("Test pass\n");
+    return 0;
+}
@@ -0,0 +1,116 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <random>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TArray.hh"
+#include "DB_deterministic.hh"
+
+const int nworkers = 4;
+const unsigned batch_per_worker = 64;
+const int nbatches = 50;
+const unsigned nitems = 32;
+
+typedef TArray<unsigned, nitems> items_type;
+
+// Reads item src and overwrites item dst; the result depends on the order
+struct mix_txn {
+    unsigned src;
+    unsigned dst;
+    unsigned extra_read;
+};
+
+void run_mix(items_type& a, const mix_txn& t) {
+    unsigned v = a[t.src] + a[t.extra_read];
+    a[t.dst] = a[t.dst] * 3 + v;
+}
+
+void testSerialOrder() {
+    items_type a;
+    std::vector<std::vector<mix_txn>> generated(nworkers);
+    std::vector<uint64_t> executed(nworkers), aborts(nworkers);
+    bench::det_executor<mix_txn> det(nworkers, batch_per_worker);
+    int batches = 0;
+
+    std::vector<std::thread> thrs;
+    for (int w = 0; w != nworkers; ++w)
+        thrs.emplace_back([&, w] () {
+            TThread::set_id(w);
+            std::mt19937 rng(w + 1);
+            executed[w] = det.run(w, [&] (mix_txn& t, bench::det_locks& locks) {
+                t.src = rng() % nitems;
+                t.dst = rng() % nitems;
+                t.extra_read = rng() % nitems;
+                locks.read(t.src);
+                locks.read(t.extra_read);
+                locks.write(t.dst);
+                generated[w].push_back(t);
+            }, [&] (mix_txn& t) {
+                uint64_t starts = 0;
+                TRANSACTION_E {
+                    ++starts;
+                    run_mix(a, t);
+                } RETRY_E(true);
+                aborts[w] += starts - 1;
+            }, [&] () {
+                return batches++ == nbatches;
+            });
+        });
+    for (auto& t : thrs)
+        t.join();
+
+    // the same transactions one at a time, in batch order
+    unsigned expected[nitems];
+    items_type b;
+    for (int i = 0; i != nbatches; ++i)
+        for (int w = 0; w != nworkers; ++w)
+            for (unsigned k = 0; k != batch_per_worker; ++k) {
+                TRANSACTION_E {
+                    run_mix(b, generated[w][i * batch_per_worker + k]);
+                } RETRY_E(true);
+            }
+    TRANSACTION_E {
+        for (unsigned i = 0; i != nitems; ++i)
+            expected[i] = b[i];
+    } RETRY_E(true);
+
+    uint64_t total = 0, total_aborts = 0;
+    for (int w = 0; w != nworkers; ++w) {
+        total += executed[w];
+        total_aborts += aborts[w];
+    }
+    assert(total == uint64_t(nbatches) * nworkers * batch_per_worker);
+    // the declared sets cover every access, so nothing conflicts
+    assert(total_aborts == 0);
+    TRANSACTION_E {
+        for (unsigned i = 0; i != nitems; ++i)
+            assert(a[i] == expected[i]);
+    } RETRY_E(true);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testNormalize() {
+    bench::det_locks locks;
+    locks.read(5);
+    locks.write(3);
+    locks.read(3);
+    locks.read(5);
+    locks.write(bench::det_locks::key(1, 3));
+    locks.normalize();
+    assert(locks.size() == 3);
+    assert(locks[0].key == 3 && locks[0].write);
+    assert(locks[1].key == 5 && !locks[1].write);
+    assert(locks[2].key == (uint64_t(1) << 56 | 3) && locks[2].write);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testNormalize();
+    testSerialOrder();
+    printf("Test pass\n");
+    return 0;
+}
@@ -1,3 +1,5 @@
+#undef NDEBUG
+#include <cassert>
 #include <iostream>
 #include <sstream>
 #include <thread>
@@ -61,9 +63,52 @@ void array_init(array_type& arr) {
         arr.nontrans_put(i, 0);
 }
 
+void incremental_check(array_type& arr) {
+    // repeated validations with no commit in between check only new reads
+    TestTransaction t1(0);
+    for (int i = 0; i < 64; ++i)
+        (void) (int) arr[i];
+    assert(t1.get_tx().check_opacity());
+    for (int i = 64; i < 128; ++i)
+        (void) (int) arr[i];
+    assert(t1.get_tx().check_opacity());
+
+    // a commit moves the clock, so the next validation covers everything
+    {
+        TestTransaction t2(1);
+        arr[3] = arr[3] + 1;
+        assert(t2.try_commit());
+    }
+    t1.use();
+    assert(!t1.get_tx().check_opacity());
+    t1.get_tx().silent_abort();
+    TestTransaction::hard_reset();
+
+    // lock versions change without taking a TID, so their optimistic reads
+    // are always rechecked
+    TBox<int, TAdaptiveWrapped<int>> box;
+    {
+        TestTransaction t3(0);
+        (void) (int) arr[0];
+        Sto::item(&box, 0).cc_mode(CCMode::opt);
+        (void) (int) box;
+        assert(t3.get_tx().check_opacity());
+
+        TestTransaction t4(1);
+        box = 1;
+        assert(t4.try_commit());
+        t3.use();
+        assert(!t3.get_tx().check_opacity());
+        t3.get_tx().silent_abort();
+        TestTransaction::hard_reset();
+    }
+    std::cout << "incremental check passed." << std::endl;
+}
+
 int main() {
     array_type arr;
     array_init(arr);
+    incremental_check(arr);
 
     auto tw = std::thread(writer, std::ref(arr));
     auto tr = std::thread(reader, std::ref(arr));
@@ -37,15 +37,72 @@ void* tracker_run(void* argument) {
 }
 
 
+// Drains thread 0's RCU set by advancing epochs and starting transactions
+static void drain() {
+    for (int i = 0; i < 100 && Transaction::rcu_backlog() != 0; ++i) {
+        Transaction::epoch_advance_step(true);
+        TRANSACTION_E {
+        } RETRY_E(false);
+    }
+    always_assert(Transaction::rcu_backlog() == 0, "rcu drain");
+}
+
+void test_adaptive_period() {
+    Transaction::set_epoch_cycle(64000);
+    Transaction::set_epoch_cycle_min(1000);
+    Transaction::set_rcu_backlog_limit(100);
+
+    TRANSACTION_E {
+        for (int i = 0; i < 1000; ++i)
+            Transaction::rcu_delete(new Tracker);
+    } RETRY_E(false);
+    always_assert(Transaction::rcu_backlog() == 1000, "rcu backlog");
+    Transaction::epoch_advance_step(true);
+    always_assert(Transaction::get_epoch_period() == 32000, "period shrinks");
+
+    drain();
+    always_assert(nfreed == nallocated, "rcu check");
+    for (int i = 0; i < 10; ++i)
+        Transaction::epoch_advance_step(true);
+    always_assert(Transaction::get_epoch_period() == 64000, "period recovers");
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void test_quiescent_announcement() {
+    Transaction::set_cooperative_epochs(true);
+    // thread 1 runs once, then idles without holding back reclamation
+    std::thread([]() {
+        TThread::set_id(1);
+        TRANSACTION_E {
+        } RETRY_E(false);
+    }).join();
+    always_assert(Transaction::tinfo[1].epoch == 0
+                  && Transaction::tinfo[1].write_snapshot_epoch == 0, "quiescent");
+
+    TRANSACTION_E {
+        for (int i = 0; i < 10; ++i)
+            Transaction::rcu_delete(new Tracker);
+    } RETRY_E(false);
+    // retired outside a transaction
+    Transaction::rcu_delete(new Tracker);
+    drain();
+    always_assert(nfreed == nallocated, "rcu check");
+    Transaction::set_cooperative_epochs(false);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+
 static const Clp_Option options[] = {
     { "delay", 'd', 'd', Clp_ValDouble, Clp_Negate },
     { "nthreads", 'j', 'j', Clp_ValInt, 0 },
-    { "nepochs", 'e', 'e', Clp_ValInt, 0 }
+    { "nepochs", 'e', 'e', Clp_ValInt, 0 },
+    { "cooperative", 'c', 'c', 0, Clp_Negate }
 };
 
 int main(int argc, char* argv[]) {
     unsigned nthreads = 4;
     TRcuSet::epoch_type nepochs = 1000;
+    bool cooperative = false;
     delay = 0.000001;
 
     Clp_Parser *clp = Clp_NewParser(argc, argv, arraysize(options), options);
@@ -61,6 +118,9 @@ int main(int argc, char* argv[]) {
         case 'e':
             nepochs = clp->val.i;
             break;
+        case 'c':
+            cooperative = !clp->negated;
+            break;
         default:
             abort();
         }
@@ -72,11 +132,19 @@ int main(int argc, char* argv[]) {
         exit(1);
     }
 
+    test_adaptive_period();
+    test_quiescent_announcement();
+    Transaction::set_rcu_backlog_limit(1 << 16);
+
+    // with -c, the workers advance epochs themselves
+    Transaction::set_epoch_cycle(1000);
+    Transaction::set_cooperative_epochs(cooperative);
     pthread_t tids[nthreads];
     for (uintptr_t i = 0; i < nthreads; ++i)
         pthread_create(&tids[i], NULL, tracker_run, reinterpret_cast<void*>(i));
-    Transaction::set_epoch_cycle(1000);
-    auto advancer = std::thread(&Transaction::epoch_advancer, nullptr);
+    std::thread advancer;
+    if (!cooperative)
+        advancer = std::thread(&Transaction::epoch_advancer, nullptr);
 
     while (Transaction::global_epochs.global_epoch < nepochs + 1)
         usleep(useconds_t(delay * 1e6));
@@ -93,7 +161,8 @@ int main(int argc, char* argv[]) {
     always_assert(nallocated == nfreed, "rcu check");
     always_assert(nfreed_before > 0, "rcu check");
     printf("created %" PRIu64 ", deleted %" PRIu64 ", finally deleted %" PRIu64 "\n", nallocated, nfreed_before, nfreed);
-    advancer.join();
+    if (advancer.joinable())
+        advancer.join();
     printf("Test pass.\n");
     return 0;
 }
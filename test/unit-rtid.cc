@@ -0,0 +1,123 @@
+#undef NDEBUG
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "Sto.hh"
+#include "TBox.hh"
+
+typedef Transaction::tid_type tid_type;
+
+// TSC cycles per millisecond, measured against usleep
+static uint64_t cycles_per_ms() {
+    uint64_t start = read_tsc();
+    usleep(20000);
+    return (read_tsc() - start) / 20;
+}
+
+void testRefreshWindow() {
+    constexpr unsigned window_ms = 200;
+    Transaction::set_rtid_refresh_cycles(window_ms * cycles_per_ms());
+    TBox<int> held, other;
+
+    // thread 1 holds a write TID and stays in flight
+    TestTransaction writer(1);
+    held = 1;
+    tid_type wtid = writer.get_tx().write_tid();
+    TestTransaction::hard_reset();
+
+    // past the window, the next call refreshes
+    TThread::set_id(0);
+    usleep(window_ms * 1000 + 20000);
+    tid_type r0 = Transaction::resolved_tid();
+    assert(r0 < wtid);
+
+    // later commits cannot move _RTID past the writer
+    TThread::set_id(2);
+    for (int i = 0; i != 10; ++i) {
+        TransactionGuard g;
+        other = i;
+    }
+    TThread::set_id(0);
+    tid_type r1 = Transaction::resolved_tid();
+    assert(r1 >= r0 && r1 < wtid);
+
+    // the writer aborts; inside the window _RTID stays where it was
+    writer.use();
+    Sto::silent_abort();
+    TestTransaction::hard_reset();
+    TThread::set_id(0);
+    tid_type r2 = Transaction::resolved_tid();
+    assert(r2 == r1);
+
+    // and once the window has passed it catches up with the commits
+    usleep(window_ms * 1000 + 20000);
+    tid_type r3 = Transaction::resolved_tid();
+    assert(r3 > wtid);
+
+    Transaction::set_rtid_refresh_cycles(0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testPublisher() {
+    constexpr int nwriters = 3, ntxns = 20000;
+    Transaction::set_rtid_publish_cycle(10);
+    std::thread publisher(&Transaction::rtid_publisher, nullptr);
+
+    TBox<int> boxes[nwriters];
+    std::atomic<int> nrunning(nwriters);
+    std::vector<std::thread> writers;
+    for (int id = 1; id <= nwriters; ++id)
+        writers.emplace_back([&, id] () {
+            TThread::set_id(id);
+            for (int i = 0; i != ntxns; ++i) {
+                TRANSACTION {
+                    boxes[id - 1] = i;
+                } RETRY(true);
+            }
+            nrunning.fetch_sub(1);
+        });
+
+    // _RTID is monotonic and below the TID of every write still in flight
+    TThread::set_id(0);
+    tid_type prev = 0, max_wtid = 0;
+    while (nrunning.load() != 0) {
+        for (int id = 1; id <= nwriters; ++id) {
+            tid_type w = Transaction::tinfo[id].wtid;
+            fence();
+            tid_type r = Transaction::resolved_tid();
+            assert(r >= prev);
+            prev = r;
+            fence();
+            if (w != 0 && Transaction::tinfo[id].wtid == w)
+                assert(r < w);
+            max_wtid = std::max(max_wtid, w);
+        }
+        relax_fence();
+    }
+    for (auto& th : writers)
+        th.join();
+
+    // with no writers left, the publisher catches up within a few cycles
+    int waited_ms = 0;
+    while (Transaction::resolved_tid() < max_wtid && waited_ms < 1000) {
+        usleep(1000);
+        ++waited_ms;
+    }
+    assert(Transaction::resolved_tid() >= max_wtid);
+
+    Transaction::global_epochs.run = false;
+    publisher.join();
+    Transaction::global_epochs.run = true;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testRefreshWindow();
+    testPublisher();
+    printf("Test pass\n");
+    return 0;
+}
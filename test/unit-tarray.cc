@@ -339,6 +339,79 @@ void testRWLock1() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+template <typename L>
+void testLayout() {
+    typedef TArray<int, 64, TOpaqueWrapped, L> array_type;
+    array_type* f = new array_type;
+    {
+        TransactionGuard t;
+        for (int i = 0; i < 64; ++i)
+            (*f)[i] = i;
+    }
+    {
+        // writes to neighbouring elements do not conflict
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        int x = (*f)[1];
+        (*f)[2] = x + 1;
+        (*f)[3] = x + 2;
+        t2.use();
+        int y = (*f)[40];
+        (*f)[41] = y;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+    {
+        TransactionGuard t;
+        assert((*f)[2] == 2 && (*f)[3] == 3 && (*f)[41] == 40);
+    }
+    delete f;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testGroupedLayout() {
+    typedef TArray<int, 64, TOpaqueWrapped, array_layout::grouped<8>> array_type;
+    array_type* f = new array_type;
+    {
+        // a write conflicts with reads of other members of its group
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        int x = (*f)[0];
+        (*f)[20] = x;
+        t2.use();
+        (*f)[1] = 1;
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    {
+        // but not with other groups
+        TestTransaction t1(1), t2(2);
+        t1.use();
+        int x = (*f)[0];
+        (*f)[20] = x;
+        t2.use();
+        (*f)[8] = 1;
+        assert(t2.try_commit());
+        t1.use();
+        assert(t1.try_commit());
+    }
+    {
+        // several members of one group in one transaction
+        TestTransaction t1(1), after(2);
+        t1.use();
+        for (int i = 16; i < 24; ++i)
+            (*f)[i] = (*f)[i] + i;
+        assert(t1.try_commit());
+        after.use();
+        for (int i = 16; i < 24; ++i)
+            assert((*f)[i] == (i == 20 ? 20 : i));
+        assert(after.try_commit());
+    }
+    delete f;
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 int main() {
     testSimpleInt();
     testSimpleString();
@@ -353,5 +426,9 @@ int main() {
     testNoOpacity1();
     benchArray64();
     testRWLock1();
+    testLayout<array_layout::padded>();
+    testLayout<array_layout::split>();
+    testLayout<array_layout::grouped<4>>();
+    testGroupedLayout();
     return 0;
 }
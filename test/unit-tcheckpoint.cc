@@ -0,0 +1,146 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <fstream>
+#include <assert.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "Sto.hh"
+#include "TBox.hh"
+#include "TCheckpoint.hh"
+
+// Rows (key i of table t has value t * 1000 + i) split into parts by key
+const uint32_t ntables = 3, nparts = 4, nrows = 1000;
+
+std::vector<TCheckpoint::task> make_tasks(std::atomic<int>& bad_snapshots,
+                                          TCheckpoint::tid_type tid) {
+    std::vector<TCheckpoint::task> tasks;
+    for (uint32_t t = 1; t <= ntables; ++t)
+        for (uint32_t p = 0; p != nparts; ++p)
+            tasks.push_back({t, p, [&bad_snapshots, tid, t, p](TCheckpoint::writer& w) {
+                // every checkpoint thread reads at the caller's snapshot
+                if (!Sto::read_only() || Sto::snapshot_tid() != tid)
+                    ++bad_snapshots;
+                for (uint32_t i = p; i < nrows; i += nparts) {
+                    uint64_t v = t * 1000 + i;
+                    w.add(&i, sizeof(i), &v, sizeof(v));
+                }
+            }});
+    return tasks;
+}
+
+bool take_checkpoint(const std::string& dir, TCheckpoint::stats& st) {
+    std::atomic<int> bad_snapshots(0);
+    TThread::set_id(0);
+    TransactionGuard guard;
+    Sto::declare_read_only();
+    auto tid = Sto::snapshot_tid();
+    bool ok = TCheckpoint::write(dir, tid, make_tasks(bad_snapshots, tid), 3, 1, []{}, st);
+    assert(bad_snapshots == 0 && st.tid == tid);
+    return ok;
+}
+
+bool load_checkpoint(const std::string& dir, std::vector<std::vector<uint64_t>>& tables,
+                     TCheckpoint::stats& st) {
+    std::mutex m;
+    tables.assign(ntables + 1, std::vector<uint64_t>(nrows, 0));
+    return TCheckpoint::read(dir, 4, []{},
+        [&](uint32_t table, const char* key, uint32_t key_length,
+            const char* value, uint32_t value_length) {
+            uint32_t i;
+            uint64_t v;
+            assert(table >= 1 && table <= ntables);
+            assert(key_length == sizeof(i) && value_length == sizeof(v));
+            memcpy(&i, key, sizeof(i));
+            memcpy(&v, value, sizeof(v));
+            std::lock_guard<std::mutex> guard(m);
+            assert(i < nrows && tables[table][i] == 0);
+            tables[table][i] = v;
+        }, st);
+}
+
+std::vector<std::string> subdirs(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* d = opendir(dir.c_str());
+    assert(d);
+    while (struct dirent* de = readdir(d))
+        if (de->d_name[0] != '.')
+            names.push_back(de->d_name);
+    closedir(d);
+    return names;
+}
+
+void testRoundTrip(const std::string& dir) {
+    TCheckpoint::stats st;
+    assert(take_checkpoint(dir, st));
+    assert(st.nfiles == ntables * nparts && st.nrows == ntables * nrows);
+
+    std::vector<std::vector<uint64_t>> tables;
+    TCheckpoint::stats rst;
+    assert(load_checkpoint(dir, tables, rst));
+    assert(rst.tid == st.tid && rst.nrows == st.nrows && rst.nfiles == st.nfiles);
+    for (uint32_t t = 1; t <= ntables; ++t)
+        for (uint32_t i = 0; i != nrows; ++i)
+            assert(tables[t][i] == t * 1000 + i);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testReplaceOld(const std::string& dir) {
+    TCheckpoint::stats st1, st2;
+    assert(take_checkpoint(dir, st1));
+    {
+        // commits in between advance the snapshot
+        TBox<int> b;
+        TRANSACTION_E {
+            b = 1;
+        } RETRY_E(true);
+    }
+    assert(take_checkpoint(dir, st2));
+    assert(st2.tid > st1.tid);
+    auto names = subdirs(dir);
+    assert(names.size() == 1);
+
+    // an unfinished checkpoint (no MANIFEST) is ignored
+    std::string partial = dir + "/" + std::to_string(std::stoul(names[0]) + 1);
+    mkdir(partial.c_str(), 0777);
+    std::ofstream(partial + "/1.0") << "garbage";
+    std::vector<std::vector<uint64_t>> tables;
+    TCheckpoint::stats rst;
+    assert(load_checkpoint(dir, tables, rst));
+    assert(rst.tid == st2.tid);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testCorruptPart(const std::string& dir) {
+    TCheckpoint::stats st;
+    assert(take_checkpoint(dir, st));
+    auto names = subdirs(dir);
+    std::string last;
+    for (auto& n : names)
+        if (last.empty() || std::stoul(n) > std::stoul(last))
+            last = n;
+    // a truncated part fails the load
+    std::string part = dir + "/" + last + "/2.1";
+    struct stat s;
+    assert(stat(part.c_str(), &s) == 0);
+    assert(truncate(part.c_str(), s.st_size - 8) == 0);
+    std::vector<std::vector<uint64_t>> tables;
+    TCheckpoint::stats rst;
+    assert(!load_checkpoint(dir, tables, rst));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    char tmpl[] = "/tmp/unit-tcheckpoint.XXXXXX";
+    std::string dir = mkdtemp(tmpl);
+    testRoundTrip(dir + "/a");
+    testReplaceOld(dir + "/b");
+    testCorruptPart(dir + "/c");
+    system(("rm -rf " + dir).c_str());
+    printf("Test pass\n");
+    return 0;
+}
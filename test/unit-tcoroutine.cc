@@ -0,0 +1,114 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <stdexcept>
+#include "Sto.hh"
+#include "TArray.hh"
+#include "TCoroutine.hh"
+
+#if STO_COROUTINES
+const int nslots = 8;
+const int nbodies = 2000;
+const int nincrements = 4;
+
+typedef TArray<int, 16> counters_type;
+
+int sum(counters_type& a) {
+    int s = 0;
+    TRANSACTION_E {
+        s = 0;
+        for (int i = 0; i != 16; ++i)
+            s += a[i];
+    } RETRY_E(true);
+    return s;
+}
+
+// Increments that suspend between reads and writes, so the slots conflict
+TCoroutine::task increment(counters_type& a, unsigned seed) {
+    TRANSACTION_E {
+        for (int k = 0; k != nincrements; ++k) {
+            unsigned i = (seed + k * 7) % 16;
+            co_await TCoroutine::prefetch(&a);
+            int v = a[i];
+            co_await TCoroutine::yield();
+            a[i] = v + 1;
+        }
+    } RETRY_E(true);
+}
+
+void testInterleaved() {
+    counters_type a;
+    int started = 0;
+    uint64_t ndone;
+    {
+        TCoroutine::scheduler sched(1, nslots);
+        ndone = sched.run([&] (int slot) -> TCoroutine::task {
+            // next() runs outside the slots
+            assert(TThread::id() == 0 && !TThread::txn);
+            if (started == nbodies)
+                return {};
+            ++started;
+            return increment(a, started * 3 + slot);
+        });
+    }
+    assert(ndone == nbodies);
+    assert(sum(a) == nbodies * nincrements);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+TCoroutine::task throw_after_suspend(counters_type& a) {
+    TRANSACTION_E {
+        a[0] = 100;
+        co_await TCoroutine::yield();
+        throw std::runtime_error("body failed");
+    } RETRY_E(true);
+}
+
+TCoroutine::task stuck(counters_type& a) {
+    TRANSACTION_E {
+        a[1] = 100;
+        for (;;)
+            co_await TCoroutine::yield();
+    } RETRY_E(true);
+}
+
+void testAbandoned() {
+    counters_type a;
+    bool threw = false;
+    Transaction* txn = TThread::txn;
+    {
+        TCoroutine::scheduler sched(1, 2);
+        int started = 0;
+        try {
+            sched.run([&] (int slot) -> TCoroutine::task {
+                if (started++ >= 2)
+                    return {};
+                return slot ? stuck(a) : throw_after_suspend(a);
+            });
+        } catch (std::runtime_error&) {
+            // the handler runs as the thread, not as the failed slot
+            assert(TThread::id() == 0 && TThread::txn == txn);
+            assert(sum(a) == 0);
+            threw = true;
+        }
+        // the scheduler aborts the stuck transaction
+    }
+    assert(threw);
+    assert(sum(a) == 0);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    TThread::set_id(0);
+    testInterleaved();
+    testAbandoned();
+    printf("Test pass\n");
+    return 0;
+}
+#else
+int main() {
+    printf("Test skipped: build with COROUTINES=1\n");
+    return 0;
+}
+#endif
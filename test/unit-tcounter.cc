@@ -4,8 +4,11 @@
 #include <assert.h>
 #include <vector>
 #include <algorithm>
+#include <thread>
+#include <functional>
 #include "Transaction.hh"
 #include "TCounter.hh"
+#include "TStripedCounter.hh"
 #include "TBox.hh"
 
 void testTrivial() {
@@ -402,6 +405,241 @@ void testNoOpacity() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testStripedConcurrentUpdate() {
+    TStripedCounter<int> c;
+    bool b;
+
+    std::vector<int> permutation{1, 2, 3, 4};
+    do {
+        c.nontrans_write(0);
+
+        TestTransaction t1(1);
+        ++c;
+
+        TestTransaction t2(2);
+        ++c;
+
+        TestTransaction t3(3);
+        c -= 1;
+
+        TestTransaction t4(4);
+        c += 5;
+
+        for (auto which : permutation)
+            switch (which) {
+            case 1:
+                assert(t1.try_commit());
+                break;
+            case 2:
+                assert(t2.try_commit());
+                break;
+            case 3:
+                assert(t3.try_commit());
+                break;
+            case 4:
+                assert(t4.try_commit());
+                break;
+            }
+
+        assert(c.nontrans_read() == 6);
+    } while (std::next_permutation(permutation.begin(), permutation.end()));
+
+    {
+        TestTransaction t1(1);
+        b = c >= 4;
+        assert(b);
+        c += 4;
+
+        TestTransaction t2(2);
+        c -= 2;
+        assert(t2.try_commit());
+
+        t1.use();
+        b = c >= 8;
+        assert(b);
+        assert(t1.try_commit());
+        assert(c.nontrans_read() == 8);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testStripedRanges() {
+    TStripedCounter<int> c;
+    TBox<int> box;
+    bool match;
+
+    {
+        // increments on other stripes keep the predicate true
+        TestTransaction t1(1);
+        match = c > -4;
+        assert(match);
+        box = 9; /* avoid read-only txn */
+
+        TestTransaction t2(2);
+        c += 2;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+    }
+
+    {
+        TestTransaction t1(1);
+        match = c < 3;
+        assert(match);
+        box = 9; /* avoid read-only txn */
+
+        TestTransaction t2(2);
+        c += 5;
+        assert(t2.try_commit());
+        assert(!t1.try_commit());
+    }
+
+    try {
+        // opacity: the sum is revalidated on the next read
+        TestTransaction t1(1);
+        int x = c;
+        assert(x == 7);
+        box = 9;
+
+        TestTransaction t2(3);
+        ++c;
+        assert(t2.try_commit());
+
+        t1.use();
+        x = c;
+        assert(false && "should not get here b/c opacity");
+    } catch (Transaction::Abort e) {
+        TestTransaction::hard_reset();
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// Runs @f on another thread while the transaction that wrote it is
+// locking its write set
+class LockHook : public TObject {
+public:
+    explicit LockHook(std::function<void()> f)
+        : f_(f) {
+    }
+    void arm() {
+        Sto::item(this, 0).add_write(0);
+    }
+    bool lock(TransItem&, Transaction&) override {
+        std::thread(f_).join();
+        return true;
+    }
+    bool check(TransItem&, Transaction&) override {
+        return true;
+    }
+    void install(TransItem&, Transaction&) override {
+    }
+    void unlock(TransItem&) override {
+    }
+private:
+    std::function<void()> f_;
+};
+
+void testStripedCommitRace() {
+    TStripedCounter<int> c;
+    bool match;
+
+    // a delta that commits to another stripe after t1's predicate was
+    // checked at commit, but before t1 validates, must abort t1
+    LockHook hook([&c]() {
+        TThread::set_id(2);
+        TRANSACTION_E {
+            c += 5;
+        } RETRY_E(false);
+    });
+    {
+        TestTransaction t1(1);
+        match = c < 3;
+        assert(match);
+        hook.arm();
+        assert(!t1.try_commit());
+        assert(c.nontrans_read() == 5);
+    }
+
+    {
+        // without the concurrent delta the same transaction commits
+        TestTransaction t1(1);
+        match = c < 7;
+        assert(match);
+        c += 1;
+        assert(t1.try_commit());
+        assert(c.nontrans_read() == 6);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testStripedAssign() {
+    TStripedCounter<int> c;
+
+    {
+        TestTransaction t1(1);
+        c += 3;
+        TestTransaction t2(2);
+        c += 4;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+        assert(c.nontrans_read() == 7);
+    }
+
+    {
+        TestTransaction t1(1);
+        c += 1;
+        c = 10;
+        int x = c;
+        assert(x == 10);
+        ++c;
+        x = c;
+        assert(x == 11);
+        TestTransaction t2(2);
+        c += 100;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+        assert(c.nontrans_read() == 11);
+    }
+
+    {
+        // a blind increment serializes after a concurrent assignment
+        TestTransaction t1(1);
+        ++c;
+        TestTransaction t2(2);
+        c = 0;
+        assert(t2.try_commit());
+        assert(t1.try_commit());
+        assert(c.nontrans_read() == 1);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testStripedThreads() {
+    TStripedCounter<long> c;
+    std::vector<std::thread> threads;
+    for (int id = 0; id < 4; ++id)
+        threads.emplace_back([&c, id]() {
+            TThread::set_id(id);
+            for (int n = 0; n < 10000; ++n) {
+                TRANSACTION_E {
+                    if (n % 10 == 0) {
+                        long x = c;
+                        c = x + 1;
+                    } else
+                        ++c;
+                } RETRY_E(true);
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+    TThread::set_id(0);
+    assert(c.nontrans_read() == 40000);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 int main() {
     testTrivial();
     testConcurrentUpdate();
@@ -411,5 +649,10 @@ int main() {
     testUpdateRead();
     testOpacity();
     testNoOpacity();
+    testStripedConcurrentUpdate();
+    testStripedRanges();
+    testStripedCommitRace();
+    testStripedAssign();
+    testStripedThreads();
     return 0;
 }
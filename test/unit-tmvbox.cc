@@ -2,6 +2,7 @@
 #include <string>
 #include <iostream>
 #include <cassert>
+#include <thread>
 #include <vector>
 #include "Sto.hh"
 #include "Commutators.hh"
@@ -281,6 +282,42 @@ void testMvWrites() {
     printf("PASS: %s\n", __FUNCTION__);
 }
 
+void testMvReadOnly() {
+    TMvBox<int> f, g;
+    f.nontrans_write(1);
+    g.nontrans_write(2);
+
+    // Declared read-only transactions read a snapshot without tset entries
+    {
+        TestTransaction t1(1);
+        Sto::declare_read_only();
+        int x = f;
+        assert(x == 1);
+        assert(!Sto::check_item(&f, 0));
+
+        TestTransaction t2(2);
+        f = 3;
+        g = 4;
+        assert(t2.try_commit());
+
+        t1.use();
+        x = f + g;
+        assert(x == 3);
+        assert(!Sto::check_item(&g, 0));
+        assert(t1.try_commit());
+    }
+
+    {
+        TestTransaction t(1);
+        Sto::declare_read_only();
+        int x = f + g;
+        assert(x == 7);
+        assert(t.try_commit());
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 void testMvCommute1() {
     TMvCommuteIntegerBox box;
     box.nontrans_write(0);
@@ -424,6 +461,67 @@ void testCommuteGC() {
 }
 
 
+// Committed deltas above the newest full version
+int delta_depth(MvHistory<int64_t> *h) {
+    int n = 0;
+    for (; h->status() != COMMITTED; h = h->prev()) {
+        if (h->status_is(COMMITTED_DELTA))
+            ++n;
+    }
+    return n;
+}
+
+void testBackgroundFlatten() {
+    TMvCommuteIntegerBox box;
+    box.nontrans_write(0);
+    MvFlattener::set_depth(8);
+
+    for (int i = 1; i <= 100; ++i) {
+        TransactionGuard t;
+        box.increment(i);
+    }
+    {
+        TestTransaction t(1);
+        assert(delta_depth(TMvBoxAccess::head(box)) == 100);
+        assert(t.try_commit());
+    }
+
+    MvFlattener::flatten_once();
+    {
+        TestTransaction t(1);
+        auto h = TMvBoxAccess::head(box);
+        assert(delta_depth(h) == 0);
+        assert(h->v() == 5050);
+        assert(t.try_commit());
+    }
+
+    // concurrent increments with the flattener thread running
+    const int nthreads = 2, nincrements = 2000;
+    MvFlattener::start(nthreads + 1, 100);
+    std::vector<std::thread> thrs;
+    for (int i = 0; i != nthreads; ++i)
+        thrs.emplace_back([&, i] () {
+            TThread::set_id(i + 1);
+            for (int n = 0; n != nincrements; ++n) {
+                TRANSACTION_E {
+                    box.increment(1);
+                } RETRY_E(true);
+            }
+        });
+    for (auto& t : thrs)
+        t.join();
+    MvFlattener::stop();
+    MvFlattener::set_depth(0);
+
+    {
+        TransactionGuard t;
+        int64_t v = box;
+        assert(v == 5050 + nthreads * nincrements);
+    }
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
 int main() {
     testSimpleInt();
     testSimpleString();
@@ -431,9 +529,11 @@ int main() {
     testOpacity1();
     testMvReads();
     testMvWrites();
+    testMvReadOnly();
     testMvCommute1();
     testMvCommute2();
     testCommuteGC();
+    testBackgroundFlatten();
 #if MVCC_INLINING
     testMvInline();
 #endif
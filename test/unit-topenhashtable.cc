@@ -0,0 +1,335 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <functional>
+#include "Transaction.hh"
+#include "TOpenHashtable.hh"
+#include "TBox.hh"
+
+typedef TOpenHashtable<int, int> ht_type;
+
+void testSimple() {
+    ht_type h;
+
+    {
+        TransactionGuard t;
+        assert(!h.transPut(1, 10));
+        assert(h.transPut(1, 11));
+        assert(h.transInsert(2, 20));
+        assert(!h.transInsert(2, 21));
+        assert(!h.transUpdate(3, 30));
+        int v;
+        assert(h.transGet(1, v) && v == 11);
+        assert(!h.transGet(3, v));
+    }
+
+    {
+        TransactionGuard t;
+        int v;
+        assert(h.transGet(1, v) && v == 11);
+        assert(h.transGet(2, v) && v == 20);
+        assert(h.transUpdate(2, 22));
+        assert(h.transDelete(1));
+        assert(!h.transDelete(1));
+        assert(!h.transGet(1, v));
+        assert(h.transGet(2, v) && v == 22);
+    }
+
+    int v;
+    assert(!h.nontrans_find(1, v));
+    assert(h.nontrans_find(2, v) && v == 22);
+    assert(h.nontrans_size() == 1);
+
+    {
+        // delete-then-insert is an update
+        TransactionGuard t;
+        assert(h.transDelete(2));
+        assert(h.transInsert(2, 23));
+    }
+    assert(h.nontrans_find(2, v) && v == 23);
+
+    {
+        // insert-then-delete leaves nothing behind
+        TransactionGuard t;
+        assert(h.transInsert(4, 40));
+        assert(h.transDelete(4));
+        assert(!h.transGet(4, v));
+    }
+    assert(!h.nontrans_find(4, v));
+    assert(h.nontrans_size() == 1);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbsentConflict() {
+    ht_type h;
+    h.nontrans_insert(1, 10);
+
+    {
+        // an insert into a probed group aborts the miss
+        TestTransaction t1(1);
+        int v;
+        assert(!h.transGet(2, v));
+
+        TestTransaction t2(2);
+        h.transPut(2, 20);
+        assert(t2.try_commit());
+
+        t1.use();
+        h.transPut(3, 30);
+        assert(!t1.try_commit());
+    }
+
+    {
+        // our own insert doesn't
+        TestTransaction t1(1);
+        int v;
+        assert(!h.transGet(5, v));
+        h.transPut(5, 50);
+        assert(t1.try_commit());
+    }
+
+    {
+        // two inserts of the same key
+        TestTransaction t1(1);
+        assert(h.transInsert(6, 60));
+
+        TestTransaction t2(2);
+        try {
+            h.transInsert(6, 61);
+            assert(false);
+        } catch (Transaction::Abort e) {
+        }
+
+        t1.use();
+        assert(t1.try_commit());
+    }
+
+    int v;
+    assert(h.nontrans_find(2, v) && v == 20);
+    assert(!h.nontrans_find(3, v));
+    assert(h.nontrans_find(6, v) && v == 60);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+// all keys share one home group
+struct same_group_hash {
+    size_t operator()(int) const {
+        return 0;
+    }
+};
+
+// Runs @f on another thread while the transaction that wrote it installs
+class InstallHook : public TObject {
+public:
+    explicit InstallHook(std::function<void()> f)
+        : f_(f) {
+    }
+    void arm() {
+        Sto::item(this, 0).add_write(0);
+    }
+    bool lock(TransItem&, Transaction&) override {
+        return true;
+    }
+    bool check(TransItem&, Transaction&) override {
+        return true;
+    }
+    void install(TransItem&, Transaction& txn) override {
+        txn.commit_tid();
+        std::thread(f_).join();
+    }
+    void unlock(TransItem&) override {
+    }
+private:
+    std::function<void()> f_;
+};
+
+void testInsertOrder() {
+    typedef TOpenHashtable<int, int, true, 8, int, same_group_hash> sg_type;
+    sg_type h;
+    TBox<int> box;
+    std::unique_ptr<TestTransaction> reader;
+
+    // t1 takes its commit tid, then t2 inserts into the same group and
+    // commits with a higher tid, and t3's insert bumps the group again
+    // before t1 converts the group version. t1 must leave the bump, so a
+    // miss observed after it still validates.
+    InstallHook hook([&]() {
+        TThread::set_id(2);
+        TRANSACTION_E {
+            h.transInsert(2, 20);
+        } RETRY_E(false);
+        {
+            TestTransaction t3(3);
+            h.transInsert(3, 30);
+            Sto::silent_abort();
+        }
+        reader->use();
+        int v;
+        assert(!h.transGet(9, v));
+        TestTransaction::hard_reset();
+    });
+
+    TestTransaction t1(1);
+    hook.arm();
+    h.transInsert(1, 10);
+    reader.reset(new TestTransaction(4));
+    box = 1; /* avoid read-only txn */
+    assert(t1.try_commit());
+    assert(reader->try_commit());
+
+    int v;
+    assert(h.nontrans_find(1, v) && v == 10);
+    assert(h.nontrans_find(2, v) && v == 20);
+    assert(!h.nontrans_find(3, v));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testDeleteConflict() {
+    ht_type h;
+    h.nontrans_insert(1, 10);
+    h.nontrans_insert(2, 20);
+
+    {
+        TestTransaction t1(1);
+        int v;
+        assert(h.transGet(1, v) && v == 10);
+        h.transPut(2, 21);
+
+        TestTransaction t2(2);
+        assert(h.transDelete(1));
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    {
+        TestTransaction t1(1);
+        assert(h.transDelete(2));
+
+        TestTransaction t2(2);
+        assert(h.transUpdate(2, 22));
+        assert(t2.try_commit());
+
+        t1.use();
+        assert(!t1.try_commit());
+    }
+
+    int v;
+    assert(!h.nontrans_find(1, v));
+    assert(h.nontrans_find(2, v) && v == 22);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testGrowth() {
+    TOpenHashtable<int, int, true, 4> h;
+    size_t nslots = h.nslots();
+
+    {
+        TestTransaction t1(1);
+        int v;
+        h.nontrans_insert(-1, -1);
+        assert(h.transGet(-1, v) && v == -1);
+
+        TestTransaction t2(2);
+        assert(!h.transGet(-2, v));
+
+        // grow the table underneath both transactions
+        TestTransaction t3(3);
+        for (int i = 0; i < 1000; ++i)
+            h.transPut(i, i);
+        assert(t3.try_commit());
+        assert(h.nslots() > nslots);
+
+        // element reads survive growth; misses don't
+        t1.use();
+        h.transPut(-1, -3);
+        assert(t1.try_commit());
+        t2.use();
+        h.transPut(-4, -4);
+        assert(!t2.try_commit());
+    }
+
+    for (int i = 0; i < 1000; i += 2) {
+        TransactionGuard t;
+        assert(h.transDelete(i));
+    }
+    {
+        TransactionGuard t;
+        int v;
+        for (int i = 0; i < 1000; ++i)
+            assert(h.transGet(i, v) == (i % 2 == 1) && (i % 2 == 0 || v == i));
+        assert(h.transGet(-1, v) && v == -3);
+    }
+
+    // tombstones are dropped when the table is rebuilt
+    nslots = h.nslots();
+    for (int round = 0; round < 20; ++round)
+        for (int i = 0; i < 1000; i += 2) {
+            {
+                TransactionGuard t;
+                h.transPut(i + 1000 * (round + 1), 0);
+            }
+            {
+                TransactionGuard t;
+                assert(h.transDelete(i + 1000 * (round + 1)));
+            }
+        }
+    assert(h.nslots() == nslots);
+    assert(h.nontrans_size() == 501);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testThreads() {
+    TOpenHashtable<int, int, true, 4> h;
+    const int nthreads = 4, nkeys = 20000;
+    std::vector<std::thread> threads;
+    for (int me = 0; me < nthreads; ++me)
+        threads.emplace_back([&, me]() {
+            TThread::set_id(me);
+            for (int i = me; i < nkeys; i += nthreads) {
+                TRANSACTION_E {
+                    int v;
+                    if (!h.transGet(i, v))
+                        h.transInsert(i, i);
+                    // everyone fights over the same counter
+                    int c = 0;
+                    h.transGet(-1, c);
+                    h.transPut(-1, c + 1);
+                } RETRY_E(true);
+                if (i % 3 == 0) {
+                    TRANSACTION_E {
+                        assert(h.transDelete(i));
+                    } RETRY_E(true);
+                }
+            }
+        });
+    for (auto& t : threads)
+        t.join();
+
+    int v = 0;
+    for (int i = 0; i < nkeys; ++i)
+        assert(h.nontrans_find(i, v) == (i % 3 != 0) && (i % 3 == 0 || v == i));
+    assert(h.nontrans_find(-1, v) && v == nkeys);
+
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testSimple();
+    testAbsentConflict();
+    testInsertOrder();
+    testDeleteConflict();
+    testGrowth();
+    testThreads();
+    printf("Test pass\n");
+    return 0;
+}
@@ -0,0 +1,89 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <assert.h>
+#include "Sto.hh"
+#include "TArray.hh"
+
+// Transactions far larger than the built-in tset, the transaction
+// hashtable and the on-stack write set
+const unsigned N = 100000;
+typedef TArray<int, N> big_array;
+
+void testLargeWrite(big_array& a) {
+    {
+        TransactionGuard t;
+        for (unsigned i = 0; i != N; ++i)
+            a[i] = i;
+    }
+    {
+        TransactionGuard t;
+        for (unsigned i = 0; i != N; ++i)
+            assert(a[i] == int(i));
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testLookupPastHashLimit(big_array& a) {
+    {
+        TransactionGuard t;
+        for (unsigned i = 0; i != N; ++i)
+            a[i] = a[i] + 1;
+        // every item is found again, so each increment sees the last
+        for (unsigned i = N; i-- != 0; )
+            a[i] = a[i] + 1;
+    }
+    {
+        TransactionGuard t;
+        for (unsigned i = 0; i != N; ++i)
+            assert(a[i] == int(i) + 2);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testReuse(big_array& a) {
+    // the thread's arena serves one transaction after another, and a
+    // second transaction on the same thread id gets its own
+    for (int round = 0; round != 3; ++round) {
+        TestTransaction t1(0), t2(0);
+        t1.use();
+        for (unsigned i = 0; i < N; i += 2)
+            a[i] = a[i] + 1;
+        t2.use();
+        for (unsigned i = 1; i < N; i += 2)
+            a[i] = a[i] + 1;
+        assert(t1.try_commit());
+        assert(t2.try_commit());
+    }
+    {
+        TransactionGuard t;
+        for (unsigned i = 0; i != N; ++i)
+            assert(a[i] == int(i) + 5);
+    }
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testConflictPastHashLimit(big_array& a) {
+    TestTransaction t1(0), t2(1);
+    t1.use();
+    for (unsigned i = 0; i != N; ++i)
+        (void) int(a[i]);
+    t2.use();
+    a[N - 1] = 0;
+    assert(t2.try_commit());
+    t1.use();
+    a[0] = 0;
+    assert(!t1.try_commit());
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    big_array* a = new big_array;
+    testLargeWrite(*a);
+    testLookupPastHashLimit(*a);
+    testReuse(*a);
+    testConflictPastHashLimit(*a);
+    delete a;
+    printf("Test pass\n");
+    return 0;
+}
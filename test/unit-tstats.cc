@@ -0,0 +1,125 @@
+#undef NDEBUG
+#include <string>
+#include <iostream>
+#include <sstream>
+#include <assert.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "Transaction.hh"
+#include "TBox.hh"
+
+static bool contains(const std::string& s, const std::string& x) {
+    return s.find(x) != std::string::npos;
+}
+
+void testDisabled() {
+    TStats::set_enabled(false);
+    TStats::reset();
+    TBox<int> b;
+    {
+        TransactionGuard t;
+        b = 1;
+    }
+    std::string s = TStats::json();
+    assert(contains(s, "\"enabled\": false"));
+    assert(contains(s, "\"starts\": 0,"));
+    assert(contains(s, "\"commits\": 0,"));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testCounts() {
+    TStats::set_enabled(true);
+    TStats::reset();
+    TBox<int> b;
+    {
+        TransactionGuard t;
+        b = 1;
+    }
+    {
+        // t1 read, t2 write, t1 fails validation
+        TestTransaction t1(1);
+        int x = b;
+        b = x + 1;
+        TestTransaction t2(2);
+        b = 5;
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    std::string s = TStats::json();
+    TStats::set_enabled(false);
+    assert(contains(s, "\"enabled\": true"));
+    assert(contains(s, "\"starts\": 3,"));
+    assert(contains(s, "\"commits\": 2,"));
+    assert(contains(s, "\"aborts\": 1,"));
+    assert(contains(s, "\"commit_time_aborts\": 1,"));
+    assert(contains(s, "\"commit check\": 1"));
+    assert(contains(s, "\"samples\": 3"));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testSocketExport() {
+    std::string path = "/tmp/sto-unit-tstats." + std::to_string(getpid());
+    assert(TStats::start_socket_export(path));
+    TStats::set_enabled(false);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path.c_str());
+    assert(connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+    assert(write(fd, "enable\n", 7) == 7);
+    std::string reply;
+    char buf[1024];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        reply.append(buf, n);
+    close(fd);
+    TStats::stop_export();
+
+    assert(TStats::enabled());
+    assert(contains(reply, "\"enabled\": true"));
+    assert(contains(reply, "\"tset_size_log2_hist\""));
+    TStats::set_enabled(false);
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+void testAbortProfile() {
+    TAbortProfile::set_enabled(true);
+    TAbortProfile::reset();
+    TBox<int> b;
+    for (int i = 0; i < 3; ++i) {
+        TestTransaction t1(1);
+        int x = b;
+        b = x + 1;
+        TestTransaction t2(2);
+        b = 5;
+        assert(t2.try_commit());
+        t1.use();
+        assert(!t1.try_commit());
+    }
+    {
+        TestTransaction t(1);
+        try {
+            Sto::abort();
+        } catch (Transaction::Abort e) {
+        }
+    }
+    TAbortProfile::set_enabled(false);
+    std::ostringstream buf;
+    TAbortProfile::print_report(buf, 10);
+    std::string s = buf.str();
+    assert(contains(s, "4 aborts, 2 distinct sites"));
+    assert(contains(s, "commit check  TBox<int"));
+    assert(contains(s, "unspecified  -"));
+    printf("PASS: %s\n", __FUNCTION__);
+}
+
+int main() {
+    testDisabled();
+    testCounts();
+    testSocketExport();
+    testAbortProfile();
+    return 0;
+}